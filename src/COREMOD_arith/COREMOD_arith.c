@@ -57,6 +57,7 @@
 #include "image_total.h"
 #include "imfunctions.h"
 #include "set_pixel.h"
+#include "stream_arith.h"
 
 #include "image_arith__im__im.h"
 #include "image_arith__im_f__im.h"
@@ -90,6 +91,8 @@ static errno_t init_module_CLI()
 
     CLIADDCMD_COREMODE_arith__cropmask();
 
+    CLIADDCMD_COREMOD_arith__streamarith();
+
     // add atexit functions here
 
     return RETURN_SUCCESS;
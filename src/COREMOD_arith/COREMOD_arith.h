@@ -5,6 +5,7 @@
 
 //int init_COREMOD_arith();
 
+#include "COREMOD_arith/arith_expr.h"
 #include "COREMOD_arith/execute_arith.h"
 #include "COREMOD_arith/image_arith__Cim_Cim__Cim.h"
 #include "COREMOD_arith/image_arith__im__im.h"
@@ -18,6 +19,7 @@
 #include "COREMOD_arith/image_total.h"
 #include "COREMOD_arith/imfunctions.h"
 #include "COREMOD_arith/set_pixel.h"
+#include "COREMOD_arith/stream_arith.h"
 
 //imageID arith_make_slopexy(const char *ID_name, long l1,long l2, double sx, double sy);
 
@@ -0,0 +1,1279 @@
+/**
+ * @file    arith_expr.c
+ * @brief   compiled image arithmetic expressions
+ *
+ * An expression such as "out=(a-b)*c/d+1" is parsed once into a tree.
+ * Constant sub-expressions are folded, and the tree is flattened into
+ * a postfix program.
+ *
+ * The program is evaluated on blocks of ARITHEXPR_BLOCKSIZE pixels,
+ * using a small per-thread stack of blocks allocated at compile time.
+ * The whole expression is computed in a single pass over the input
+ * images, without full size temporary images, and without memory
+ * allocation at evaluation time.
+ *
+ * Only pixel-wise operators and functions can be compiled. Image
+ * reductions (itot, imean, perc ...) and derivatives (imdx, imdy) are
+ * rejected, and execute_arith falls back to operator-by-operator
+ * evaluation for those expressions.
+ *
+ * Image and variable IDs are resolved at compile time, so that a
+ * compiled expression can be evaluated repeatedly, for example on
+ * every new frame of a stream. Variable values are read on each
+ * evaluation.
+ */
+
+#include <ctype.h>
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "arith_expr.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 1000000
+#endif
+
+#define ARITHEXPR_BLOCKSIZE 256 // pixels per block, stack fits in L1/L2
+#define ARITHEXPR_MAXNODE   256
+#define ARITHEXPR_MAXLEAF   32
+#define ARITHEXPR_MAXARG    3
+
+// operand codes
+#define ARITHEXPR_OP_CONST 1
+#define ARITHEXPR_OP_VAR   2
+#define ARITHEXPR_OP_IMAGE 3
+
+// operators
+#define ARITHEXPR_OP_NEG    10
+#define ARITHEXPR_OP_ADD    11
+#define ARITHEXPR_OP_SUB    12
+#define ARITHEXPR_OP_MULT   13
+#define ARITHEXPR_OP_DIV    14
+#define ARITHEXPR_OP_POW    15
+#define ARITHEXPR_OP_FMOD   16
+#define ARITHEXPR_OP_MIN    17
+#define ARITHEXPR_OP_MAX    18
+#define ARITHEXPR_OP_TESTLT 19
+#define ARITHEXPR_OP_TESTMT 20
+#define ARITHEXPR_OP_TRUNC  21
+
+// single argument functions
+#define ARITHEXPR_OP_ACOS  30
+#define ARITHEXPR_OP_ASIN  31
+#define ARITHEXPR_OP_ATAN  32
+#define ARITHEXPR_OP_CEIL  33
+#define ARITHEXPR_OP_COS   34
+#define ARITHEXPR_OP_COSH  35
+#define ARITHEXPR_OP_EXP   36
+#define ARITHEXPR_OP_FABS  37
+#define ARITHEXPR_OP_FLOOR 38
+#define ARITHEXPR_OP_LN    39
+#define ARITHEXPR_OP_LOG   40
+#define ARITHEXPR_OP_SQRT  41
+#define ARITHEXPR_OP_SIN   42
+#define ARITHEXPR_OP_SINH  43
+#define ARITHEXPR_OP_TAN   44
+#define ARITHEXPR_OP_TANH  45
+#define ARITHEXPR_OP_POSI  46
+
+typedef struct
+{
+    const char *name;
+    int         op;
+    int         nbarg;
+} ARITHEXPR_FUNC;
+
+static const ARITHEXPR_FUNC arithexpr_functable[] = {
+    {"acos", ARITHEXPR_OP_ACOS, 1},
+    {"asin", ARITHEXPR_OP_ASIN, 1},
+    {"atan", ARITHEXPR_OP_ATAN, 1},
+    {"ceil", ARITHEXPR_OP_CEIL, 1},
+    {"cos", ARITHEXPR_OP_COS, 1},
+    {"cosh", ARITHEXPR_OP_COSH, 1},
+    {"exp", ARITHEXPR_OP_EXP, 1},
+    {"fabs", ARITHEXPR_OP_FABS, 1},
+    {"floor", ARITHEXPR_OP_FLOOR, 1},
+    {"ln", ARITHEXPR_OP_LN, 1},
+    {"log", ARITHEXPR_OP_LOG, 1},
+    {"sqrt", ARITHEXPR_OP_SQRT, 1},
+    {"sin", ARITHEXPR_OP_SIN, 1},
+    {"sinh", ARITHEXPR_OP_SINH, 1},
+    {"tan", ARITHEXPR_OP_TAN, 1},
+    {"tanh", ARITHEXPR_OP_TANH, 1},
+    {"posi", ARITHEXPR_OP_POSI, 1},
+    {"fmod", ARITHEXPR_OP_FMOD, 2},
+    {"min", ARITHEXPR_OP_MIN, 2},
+    {"max", ARITHEXPR_OP_MAX, 2},
+    {"testlt", ARITHEXPR_OP_TESTLT, 2},
+    {"testmt", ARITHEXPR_OP_TESTMT, 2},
+    {"trunc", ARITHEXPR_OP_TRUNC, 3},
+    {NULL, 0, 0}
+};
+
+// functions known to execute_arith that are not pixel-wise
+static const char *arithexpr_nonlocal[] = {
+    "imedian", "itot", "imean", "imin", "imax", "perc", "imdx", "imdy", NULL
+};
+
+typedef struct ARITHEXPR_NODE
+{
+    int                    op;
+    int                    arg; // image leaf index or variable ID
+    double                 cst;
+    int                    nbchild;
+    struct ARITHEXPR_NODE *child[ARITHEXPR_MAXARG];
+} ARITHEXPR_NODE;
+
+typedef struct
+{
+    imageID  ID;
+    uint8_t  datatype;
+    uint8_t  naxis;
+    uint32_t size[3];
+    uint64_t nelement;
+    void    *ptr; // refreshed on each evaluation
+} ARITHEXPR_LEAF;
+
+typedef struct
+{
+    int    op;
+    int    arg;
+    double cst;
+} ARITHEXPR_INSTR;
+
+struct ARITHEXPR
+{
+    char outname[STRINGMAXLEN_IMAGE_NAME]; // empty if no "="
+
+    int            nbleaf;
+    ARITHEXPR_LEAF leaf[ARITHEXPR_MAXLEAF];
+
+    int             nbinstr;
+    ARITHEXPR_INSTR instr[ARITHEXPR_MAXNODE];
+    int             stackdepth;
+
+    // output format
+    uint8_t  datatype;
+    uint8_t  naxis;
+    uint32_t size[3];
+    uint64_t nelement;
+
+    // per-thread block stacks
+    int     nbthread;
+    double *scratch;
+};
+
+typedef struct
+{
+    const char    *str;
+    int            pos;
+    int            errmode;
+    int            err;
+    int            nbnode;
+    ARITHEXPR_NODE node[ARITHEXPR_MAXNODE];
+    ARITHEXPR     *expr;
+} ARITHEXPR_PARSER;
+
+static void arithexpr_error(ARITHEXPR_PARSER *p, const char *msg)
+{
+    if(p->err == 0)
+    {
+        p->err = 1;
+        if(p->errmode != ERRMODE_NULL)
+        {
+            PRINT_WARNING("expression \"%s\" col %d: %s", p->str, p->pos, msg);
+        }
+        if(p->errmode == ERRMODE_ABORT)
+        {
+            abort();
+        }
+    }
+}
+
+/**
+ * @brief Apply operator to n values, result written in a
+ *
+ * Used for both block evaluation and constant folding.
+ */
+static void arithexpr_apply(int op,
+                            double *__restrict a,
+                            const double *__restrict b,
+                            const double *__restrict c,
+                            int n)
+{
+    switch(op)
+    {
+        case ARITHEXPR_OP_NEG:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = -a[i];
+            }
+            break;
+        case ARITHEXPR_OP_ADD:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] += b[i];
+            }
+            break;
+        case ARITHEXPR_OP_SUB:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] -= b[i];
+            }
+            break;
+        case ARITHEXPR_OP_MULT:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] *= b[i];
+            }
+            break;
+        case ARITHEXPR_OP_DIV:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] /= b[i];
+            }
+            break;
+        case ARITHEXPR_OP_POW:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = pow(a[i], b[i]);
+            }
+            break;
+        case ARITHEXPR_OP_FMOD:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = fmod(a[i], b[i]);
+            }
+            break;
+        case ARITHEXPR_OP_MIN:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = (a[i] < b[i]) ? a[i] : b[i];
+            }
+            break;
+        case ARITHEXPR_OP_MAX:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = (a[i] > b[i]) ? a[i] : b[i];
+            }
+            break;
+        case ARITHEXPR_OP_TESTLT:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = (a[i] < b[i]) ? 1.0 : 0.0;
+            }
+            break;
+        case ARITHEXPR_OP_TESTMT:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = (a[i] < b[i]) ? 0.0 : 1.0;
+            }
+            break;
+        case ARITHEXPR_OP_TRUNC:
+            for(int i = 0; i < n; i++)
+            {
+                double v = a[i];
+                v        = (v < b[i]) ? b[i] : v;
+                a[i]     = (a[i] > c[i]) ? c[i] : v;
+            }
+            break;
+        case ARITHEXPR_OP_ACOS:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = acos(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_ASIN:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = asin(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_ATAN:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = atan(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_CEIL:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = ceil(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_COS:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = cos(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_COSH:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = cosh(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_EXP:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = exp(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_FABS:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = fabs(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_FLOOR:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = floor(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_LN:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = log(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_LOG:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = log10(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_SQRT:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = sqrt(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_SIN:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = sin(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_SINH:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = sinh(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_TAN:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = tan(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_TANH:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = tanh(a[i]);
+            }
+            break;
+        case ARITHEXPR_OP_POSI:
+            for(int i = 0; i < n; i++)
+            {
+                a[i] = (a[i] > 0.0) ? 1.0 : 0.0;
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Allocate tree node, folding constant operands
+ */
+static ARITHEXPR_NODE *arithexpr_node(ARITHEXPR_PARSER *p,
+                                      int               op,
+                                      int               nbchild,
+                                      ARITHEXPR_NODE   *c0,
+                                      ARITHEXPR_NODE   *c1,
+                                      ARITHEXPR_NODE   *c2)
+{
+    ARITHEXPR_NODE *child[ARITHEXPR_MAXARG] = {c0, c1, c2};
+
+    int allconst = (nbchild > 0);
+    for(int i = 0; i < nbchild; i++)
+    {
+        if(child[i] == NULL)
+        {
+            return NULL;
+        }
+        if(child[i]->op != ARITHEXPR_OP_CONST)
+        {
+            allconst = 0;
+        }
+    }
+
+    if(allconst == 1)
+    {
+        double v[ARITHEXPR_MAXARG] = {0.0, 0.0, 0.0};
+        for(int i = 0; i < nbchild; i++)
+        {
+            v[i] = child[i]->cst;
+        }
+        arithexpr_apply(op, &v[0], &v[1], &v[2], 1);
+        c0->cst = v[0];
+        return c0;
+    }
+
+    if(p->nbnode >= ARITHEXPR_MAXNODE)
+    {
+        arithexpr_error(p, "expression too long");
+        return NULL;
+    }
+
+    ARITHEXPR_NODE *node = &p->node[p->nbnode];
+    p->nbnode++;
+    node->op      = op;
+    node->arg     = 0;
+    node->cst     = 0.0;
+    node->nbchild = nbchild;
+    for(int i = 0; i < nbchild; i++)
+    {
+        node->child[i] = child[i];
+    }
+
+    return node;
+}
+
+static int arithexpr_isseparator(char c)
+{
+    return ((c == '\0') || (strchr("+-*/^(),=", c) != NULL));
+}
+
+/**
+ * @brief Register image as expression input, return leaf index
+ */
+static int arithexpr_addleaf(ARITHEXPR_PARSER *p, imageID ID)
+{
+    ARITHEXPR *expr = p->expr;
+
+    for(int k = 0; k < expr->nbleaf; k++)
+    {
+        if(expr->leaf[k].ID == ID)
+        {
+            return k;
+        }
+    }
+
+    uint8_t datatype = data.image[ID].md[0].datatype;
+    if((datatype == _DATATYPE_COMPLEX_FLOAT) ||
+            (datatype == _DATATYPE_COMPLEX_DOUBLE))
+    {
+        arithexpr_error(p, "complex images not supported");
+        return -1;
+    }
+    if((data.image[ID].md[0].naxis < 1) || (data.image[ID].md[0].naxis > 3))
+    {
+        arithexpr_error(p, "image must have 1 to 3 axes");
+        return -1;
+    }
+    if(expr->nbleaf >= ARITHEXPR_MAXLEAF)
+    {
+        arithexpr_error(p, "too many input images");
+        return -1;
+    }
+
+    ARITHEXPR_LEAF *leaf = &expr->leaf[expr->nbleaf];
+    leaf->ID             = ID;
+    leaf->datatype       = datatype;
+    leaf->naxis          = data.image[ID].md[0].naxis;
+    for(int i = 0; i < 3; i++)
+    {
+        leaf->size[i] = 1;
+    }
+    for(int i = 0; i < leaf->naxis; i++)
+    {
+        leaf->size[i] = data.image[ID].md[0].size[i];
+    }
+    leaf->nelement = data.image[ID].md[0].nelement;
+    leaf->ptr      = NULL;
+    expr->nbleaf++;
+
+    return expr->nbleaf - 1;
+}
+
+static ARITHEXPR_NODE *arithexpr_parse_expr(ARITHEXPR_PARSER *p);
+static ARITHEXPR_NODE *arithexpr_parse_unary(ARITHEXPR_PARSER *p);
+
+// primary := number | name | function "(" args ")" | "(" expr ")"
+static ARITHEXPR_NODE *arithexpr_parse_primary(ARITHEXPR_PARSER *p)
+{
+    const char *s = p->str;
+
+    if(s[p->pos] == '(')
+    {
+        p->pos++;
+        ARITHEXPR_NODE *node = arithexpr_parse_expr(p);
+        if(s[p->pos] != ')')
+        {
+            arithexpr_error(p, "missing \")\"");
+            return NULL;
+        }
+        p->pos++;
+        return node;
+    }
+
+    if(arithexpr_isseparator(s[p->pos]))
+    {
+        arithexpr_error(p, "operand expected");
+        return NULL;
+    }
+
+    // number
+    if(isdigit((unsigned char) s[p->pos]) || (s[p->pos] == '.'))
+    {
+        char  *endptr;
+        double v = strtod(s + p->pos, &endptr);
+        if((endptr != s + p->pos) && arithexpr_isseparator(*endptr))
+        {
+            ARITHEXPR_NODE *node =
+                arithexpr_node(p, ARITHEXPR_OP_CONST, 0, NULL, NULL, NULL);
+            if(node != NULL)
+            {
+                node->cst = v;
+            }
+            p->pos = (int)(endptr - s);
+            return node;
+        }
+    }
+
+    // name
+    char name[STRINGMAXLEN_IMAGE_NAME];
+    int  l = 0;
+    while(!arithexpr_isseparator(s[p->pos]))
+    {
+        if(l == STRINGMAXLEN_IMAGE_NAME - 1)
+        {
+            arithexpr_error(p, "name too long");
+            return NULL;
+        }
+        name[l] = s[p->pos];
+        l++;
+        p->pos++;
+    }
+    name[l] = '\0';
+
+    if(s[p->pos] == '(')
+    {
+        for(int i = 0; arithexpr_nonlocal[i] != NULL; i++)
+        {
+            if(strcmp(name, arithexpr_nonlocal[i]) == 0)
+            {
+                arithexpr_error(p, "function is not pixel-wise");
+                return NULL;
+            }
+        }
+
+        const ARITHEXPR_FUNC *func = NULL;
+        for(int i = 0; arithexpr_functable[i].name != NULL; i++)
+        {
+            if(strcmp(name, arithexpr_functable[i].name) == 0)
+            {
+                func = &arithexpr_functable[i];
+            }
+        }
+        if(func == NULL)
+        {
+            arithexpr_error(p, "unknown function");
+            return NULL;
+        }
+
+        ARITHEXPR_NODE *arg[ARITHEXPR_MAXARG] = {NULL, NULL, NULL};
+        p->pos++;
+        for(int i = 0; i < func->nbarg; i++)
+        {
+            if(i > 0)
+            {
+                if(s[p->pos] != ',')
+                {
+                    arithexpr_error(p, "wrong number of function arguments");
+                    return NULL;
+                }
+                p->pos++;
+            }
+            arg[i] = arithexpr_parse_expr(p);
+            if(arg[i] == NULL)
+            {
+                return NULL;
+            }
+        }
+        if(s[p->pos] != ')')
+        {
+            arithexpr_error(p, "wrong number of function arguments");
+            return NULL;
+        }
+        p->pos++;
+
+        return arithexpr_node(p, func->op, func->nbarg, arg[0], arg[1], arg[2]);
+    }
+
+    // variables take precedence over images, as in execute_arith
+    variableID IDvar = variable_ID(name);
+    if(IDvar != -1)
+    {
+        ARITHEXPR_NODE *node =
+            arithexpr_node(p, ARITHEXPR_OP_VAR, 0, NULL, NULL, NULL);
+        if(node != NULL)
+        {
+            node->arg = (int) IDvar;
+        }
+        return node;
+    }
+
+    imageID ID = image_ID(name);
+    if(ID != -1)
+    {
+        int k = arithexpr_addleaf(p, ID);
+        if(k < 0)
+        {
+            return NULL;
+        }
+        ARITHEXPR_NODE *node =
+            arithexpr_node(p, ARITHEXPR_OP_IMAGE, 0, NULL, NULL, NULL);
+        if(node != NULL)
+        {
+            node->arg = k;
+        }
+        return node;
+    }
+
+    arithexpr_error(p, "non-existing variable or image");
+    return NULL;
+}
+
+// power := primary [ "^" unary ]   (right associative)
+static ARITHEXPR_NODE *arithexpr_parse_power(ARITHEXPR_PARSER *p)
+{
+    ARITHEXPR_NODE *node = arithexpr_parse_primary(p);
+
+    if((node != NULL) && (p->str[p->pos] == '^'))
+    {
+        p->pos++;
+        ARITHEXPR_NODE *rnode = arithexpr_parse_unary(p);
+        node = arithexpr_node(p, ARITHEXPR_OP_POW, 2, node, rnode, NULL);
+    }
+
+    return node;
+}
+
+// unary := ("-" | "+") unary | power
+static ARITHEXPR_NODE *arithexpr_parse_unary(ARITHEXPR_PARSER *p)
+{
+    if(p->str[p->pos] == '-')
+    {
+        p->pos++;
+        ARITHEXPR_NODE *node = arithexpr_parse_unary(p);
+        return arithexpr_node(p, ARITHEXPR_OP_NEG, 1, node, NULL, NULL);
+    }
+    if(p->str[p->pos] == '+')
+    {
+        p->pos++;
+        return arithexpr_parse_unary(p);
+    }
+
+    return arithexpr_parse_power(p);
+}
+
+// term := unary { ("*" | "/") unary }
+static ARITHEXPR_NODE *arithexpr_parse_term(ARITHEXPR_PARSER *p)
+{
+    ARITHEXPR_NODE *node = arithexpr_parse_unary(p);
+
+    while((node != NULL) &&
+            ((p->str[p->pos] == '*') || (p->str[p->pos] == '/')))
+    {
+        int op = (p->str[p->pos] == '*') ? ARITHEXPR_OP_MULT : ARITHEXPR_OP_DIV;
+        p->pos++;
+        ARITHEXPR_NODE *rnode = arithexpr_parse_unary(p);
+        node = arithexpr_node(p, op, 2, node, rnode, NULL);
+    }
+
+    return node;
+}
+
+// expr := term { ("+" | "-") term }
+static ARITHEXPR_NODE *arithexpr_parse_expr(ARITHEXPR_PARSER *p)
+{
+    ARITHEXPR_NODE *node = arithexpr_parse_term(p);
+
+    while((node != NULL) &&
+            ((p->str[p->pos] == '+') || (p->str[p->pos] == '-')))
+    {
+        int op = (p->str[p->pos] == '+') ? ARITHEXPR_OP_ADD : ARITHEXPR_OP_SUB;
+        p->pos++;
+        ARITHEXPR_NODE *rnode = arithexpr_parse_term(p);
+        node = arithexpr_node(p, op, 2, node, rnode, NULL);
+    }
+
+    return node;
+}
+
+/**
+ * @brief Flatten tree into postfix program, track stack depth
+ */
+static errno_t arithexpr_flatten(ARITHEXPR_NODE *node, ARITHEXPR *expr, int *sp)
+{
+    for(int i = 0; i < node->nbchild; i++)
+    {
+        arithexpr_flatten(node->child[i], expr, sp);
+    }
+
+    ARITHEXPR_INSTR *instr = &expr->instr[expr->nbinstr];
+    expr->nbinstr++;
+    instr->op  = node->op;
+    instr->arg = node->arg;
+    instr->cst = node->cst;
+
+    if(node->nbchild == 0)
+    {
+        (*sp)++;
+    }
+    else
+    {
+        (*sp) -= node->nbchild - 1;
+    }
+    if(*sp > expr->stackdepth)
+    {
+        expr->stackdepth = *sp;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Set output format from input images
+ *
+ * Output takes the shape of the largest input. Other inputs must have
+ * the same number of elements, or be 2D images matching the first two
+ * axes of a 3D output, in which case they apply to each slice.
+ * Output is double if any input is double, float otherwise.
+ */
+static errno_t arithexpr_outformat_init(ARITHEXPR_PARSER *p)
+{
+    ARITHEXPR *expr = p->expr;
+
+    int kmax = 0;
+    for(int k = 1; k < expr->nbleaf; k++)
+    {
+        if(expr->leaf[k].nelement > expr->leaf[kmax].nelement)
+        {
+            kmax = k;
+        }
+    }
+
+    expr->naxis    = expr->leaf[kmax].naxis;
+    expr->nelement = expr->leaf[kmax].nelement;
+    for(int i = 0; i < 3; i++)
+    {
+        expr->size[i] = expr->leaf[kmax].size[i];
+    }
+
+    expr->datatype = _DATATYPE_FLOAT;
+    for(int k = 0; k < expr->nbleaf; k++)
+    {
+        ARITHEXPR_LEAF *leaf = &expr->leaf[k];
+
+        if(leaf->datatype == _DATATYPE_DOUBLE)
+        {
+            expr->datatype = _DATATYPE_DOUBLE;
+        }
+
+        if(leaf->nelement != expr->nelement)
+        {
+            if((expr->naxis != 3) || (leaf->naxis != 2) ||
+                    (leaf->size[0] != expr->size[0]) ||
+                    (leaf->size[1] != expr->size[1]))
+            {
+                arithexpr_error(p, "images have different sizes");
+                return RETURN_FAILURE;
+            }
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
+
+errno_t arith_expr_compile(const char *exprstr, int errmode, ARITHEXPR **pexpr)
+{
+    DEBUG_TRACE_FSTART();
+
+    *pexpr = NULL;
+
+    ARITHEXPR_PARSER *p = (ARITHEXPR_PARSER *) malloc(sizeof(ARITHEXPR_PARSER));
+    ARITHEXPR        *expr = (ARITHEXPR *) calloc(1, sizeof(ARITHEXPR));
+    if((p == NULL) || (expr == NULL))
+    {
+        PRINT_ERROR("malloc() error");
+        abort();
+    }
+
+    // remove spaces
+    size_t slen = strlen(exprstr);
+    char  *str  = (char *) malloc(slen + 1);
+    if(str == NULL)
+    {
+        PRINT_ERROR("malloc() error");
+        abort();
+    }
+    {
+        size_t j = 0;
+        for(size_t i = 0; i < slen; i++)
+        {
+            if(!isspace((unsigned char) exprstr[i]))
+            {
+                str[j] = exprstr[i];
+                j++;
+            }
+        }
+        str[j] = '\0';
+    }
+
+    p->str     = str;
+    p->pos     = 0;
+    p->errmode = errmode;
+    p->err     = 0;
+    p->nbnode  = 0;
+    p->expr    = expr;
+
+    // optional "outname=" prefix
+    char *equ = strchr(str, '=');
+    if(equ != NULL)
+    {
+        size_t l = (size_t)(equ - str);
+        if((l == 0) || (l > STRINGMAXLEN_IMAGE_NAME - 1))
+        {
+            arithexpr_error(p, "invalid output name");
+        }
+        else
+        {
+            strncpy(expr->outname, str, l);
+            expr->outname[l] = '\0';
+            for(size_t i = 0; i < l; i++)
+            {
+                if(arithexpr_isseparator(expr->outname[i]))
+                {
+                    arithexpr_error(p, "invalid output name");
+                }
+            }
+        }
+        p->pos = (int) l + 1;
+    }
+
+    ARITHEXPR_NODE *root = NULL;
+    if(p->err == 0)
+    {
+        root = arithexpr_parse_expr(p);
+    }
+    if((p->err == 0) && (str[p->pos] != '\0'))
+    {
+        arithexpr_error(p, "unexpected character");
+    }
+    if((p->err == 0) && (expr->nbleaf == 0))
+    {
+        arithexpr_error(p, "no input image");
+    }
+    if(p->err == 0)
+    {
+        arithexpr_outformat_init(p);
+    }
+
+    if(p->err != 0)
+    {
+        free(str);
+        free(p);
+        free(expr);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+
+    int sp = 0;
+    arithexpr_flatten(root, expr, &sp);
+
+    expr->nbthread = 1;
+#ifdef _OPENMP
+    expr->nbthread = omp_get_max_threads();
+#endif
+    expr->scratch = (double *) malloc(sizeof(double) * ARITHEXPR_BLOCKSIZE *
+                                      expr->stackdepth * expr->nbthread);
+    if(expr->scratch == NULL)
+    {
+        PRINT_ERROR("malloc() error");
+        abort();
+    }
+
+    DEBUG_TRACEPOINT("compiled \"%s\": %d instructions, %d images, stack %d",
+                     str,
+                     expr->nbinstr,
+                     expr->nbleaf,
+                     expr->stackdepth);
+
+    free(str);
+    free(p);
+
+    *pexpr = expr;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+errno_t arith_expr_free(ARITHEXPR *expr)
+{
+    if(expr != NULL)
+    {
+        free(expr->scratch);
+        free(expr);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+const char *arith_expr_outname(const ARITHEXPR *expr)
+{
+    return expr->outname;
+}
+
+errno_t arith_expr_outformat(const ARITHEXPR *expr,
+                             uint8_t         *datatype,
+                             uint8_t         *naxis,
+                             uint32_t        *size)
+{
+    *datatype = expr->datatype;
+    *naxis    = expr->naxis;
+    for(int i = 0; i < expr->naxis; i++)
+    {
+        size[i] = expr->size[i];
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Convert n input pixels to double, starting at output index i0
+ *
+ * Inputs smaller than the output (2D image applied to 3D output) wrap
+ * around on each slice.
+ */
+static void arithexpr_load(const ARITHEXPR_LEAF *leaf,
+                           uint64_t              i0,
+                           int                   n,
+                           double *__restrict dst)
+{
+    while(n > 0)
+    {
+        uint64_t j = i0 % leaf->nelement;
+        int      m = n;
+        if((uint64_t) m > leaf->nelement - j)
+        {
+            m = (int)(leaf->nelement - j);
+        }
+
+        switch(leaf->datatype)
+        {
+            case _DATATYPE_FLOAT:
+            {
+                const float *src = (const float *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            break;
+            case _DATATYPE_DOUBLE:
+                memcpy(dst, (const double *) leaf->ptr + j, sizeof(double) * m);
+                break;
+            case _DATATYPE_UINT8:
+            {
+                const uint8_t *src = (const uint8_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            break;
+            case _DATATYPE_INT8:
+            {
+                const int8_t *src = (const int8_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            break;
+            case _DATATYPE_UINT16:
+            {
+                const uint16_t *src = (const uint16_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            break;
+            case _DATATYPE_INT16:
+            {
+                const int16_t *src = (const int16_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            break;
+            case _DATATYPE_UINT32:
+            {
+                const uint32_t *src = (const uint32_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            break;
+            case _DATATYPE_INT32:
+            {
+                const int32_t *src = (const int32_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            break;
+            case _DATATYPE_UINT64:
+            {
+                const uint64_t *src = (const uint64_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = (double) src[i];
+                }
+            }
+            break;
+            case _DATATYPE_INT64:
+            {
+                const int64_t *src = (const int64_t *) leaf->ptr + j;
+                for(int i = 0; i < m; i++)
+                {
+                    dst[i] = (double) src[i];
+                }
+            }
+            break;
+        }
+
+        dst += m;
+        i0 += m;
+        n -= m;
+    }
+}
+
+/**
+ * @brief Run program on n pixels starting at i0, write to output
+ */
+static void arithexpr_run_block(const ARITHEXPR *expr,
+                                double           *stack,
+                                uint64_t          i0,
+                                int               n,
+                                void             *out)
+{
+    int sp = 0;
+
+    for(int ii = 0; ii < expr->nbinstr; ii++)
+    {
+        const ARITHEXPR_INSTR *instr = &expr->instr[ii];
+
+        switch(instr->op)
+        {
+            case ARITHEXPR_OP_IMAGE:
+                arithexpr_load(&expr->leaf[instr->arg],
+                               i0,
+                               n,
+                               stack + sp * ARITHEXPR_BLOCKSIZE);
+                sp++;
+                break;
+
+            case ARITHEXPR_OP_CONST:
+            case ARITHEXPR_OP_VAR:
+            {
+                double *dst = stack + sp * ARITHEXPR_BLOCKSIZE;
+                for(int i = 0; i < n; i++)
+                {
+                    dst[i] = instr->cst;
+                }
+                sp++;
+            }
+            break;
+
+            case ARITHEXPR_OP_TRUNC:
+                sp -= 2;
+                arithexpr_apply(instr->op,
+                                stack + (sp - 1) * ARITHEXPR_BLOCKSIZE,
+                                stack + sp * ARITHEXPR_BLOCKSIZE,
+                                stack + (sp + 1) * ARITHEXPR_BLOCKSIZE,
+                                n);
+                break;
+
+            case ARITHEXPR_OP_ADD:
+            case ARITHEXPR_OP_SUB:
+            case ARITHEXPR_OP_MULT:
+            case ARITHEXPR_OP_DIV:
+            case ARITHEXPR_OP_POW:
+            case ARITHEXPR_OP_FMOD:
+            case ARITHEXPR_OP_MIN:
+            case ARITHEXPR_OP_MAX:
+            case ARITHEXPR_OP_TESTLT:
+            case ARITHEXPR_OP_TESTMT:
+                sp--;
+                arithexpr_apply(instr->op,
+                                stack + (sp - 1) * ARITHEXPR_BLOCKSIZE,
+                                stack + sp * ARITHEXPR_BLOCKSIZE,
+                                NULL,
+                                n);
+                break;
+
+            default:
+                arithexpr_apply(instr->op,
+                                stack + (sp - 1) * ARITHEXPR_BLOCKSIZE,
+                                NULL,
+                                NULL,
+                                n);
+                break;
+        }
+    }
+
+    if(expr->datatype == _DATATYPE_DOUBLE)
+    {
+        memcpy((double *) out + i0, stack, sizeof(double) * n);
+    }
+    else
+    {
+        float *dst = (float *) out + i0;
+        for(int i = 0; i < n; i++)
+        {
+            dst[i] = (float) stack[i];
+        }
+    }
+}
+
+errno_t arith_expr_eval(ARITHEXPR *expr, imageID IDout)
+{
+    // check inputs have not changed since compilation
+    for(int k = 0; k < expr->nbleaf; k++)
+    {
+        ARITHEXPR_LEAF *leaf = &expr->leaf[k];
+        if((data.image[leaf->ID].used == 0) ||
+                (data.image[leaf->ID].md[0].datatype != leaf->datatype) ||
+                (data.image[leaf->ID].md[0].nelement != leaf->nelement))
+        {
+            PRINT_ERROR("input image %ld changed since expression compilation",
+                        (long) leaf->ID);
+            return RETURN_FAILURE;
+        }
+        leaf->ptr = data.image[leaf->ID].array.raw;
+    }
+
+    if((data.image[IDout].md[0].datatype != expr->datatype) ||
+            (data.image[IDout].md[0].nelement != expr->nelement))
+    {
+        PRINT_ERROR("output image %s does not match expression format",
+                    data.image[IDout].name);
+        return RETURN_FAILURE;
+    }
+    void *out = data.image[IDout].array.raw;
+
+    // variables are read once per evaluation
+    for(int ii = 0; ii < expr->nbinstr; ii++)
+    {
+        if(expr->instr[ii].op == ARITHEXPR_OP_VAR)
+        {
+            expr->instr[ii].cst = data.variable[expr->instr[ii].arg].value.f;
+        }
+    }
+
+    uint64_t nelement = expr->nelement;
+    uint64_t nblock   = (nelement + ARITHEXPR_BLOCKSIZE - 1) / ARITHEXPR_BLOCKSIZE;
+    size_t   stacksize = (size_t) ARITHEXPR_BLOCKSIZE * expr->stackdepth;
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) num_threads(expr->nbthread) \
+    if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t ib = 0; ib < nblock; ib++)
+    {
+        int it = 0;
+#ifdef _OPENMP
+        it = omp_get_thread_num();
+#endif
+        uint64_t i0 = ib * ARITHEXPR_BLOCKSIZE;
+        int      n  = ARITHEXPR_BLOCKSIZE;
+        if(i0 + n > nelement)
+        {
+            n = (int)(nelement - i0);
+        }
+        arithexpr_run_block(expr, expr->scratch + it * stacksize, i0, n, out);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Compile and evaluate "out=expression" in a single pass
+ *
+ * Returns RETURN_FAILURE without side effect if the expression cannot
+ * be compiled, so that the caller can fall back to another method.
+ */
+errno_t arith_expr_execute(const char *exprstr)
+{
+    DEBUG_TRACE_FSTART();
+
+    ARITHEXPR *expr = NULL;
+
+    if(arith_expr_compile(exprstr, ERRMODE_NULL, &expr) != RETURN_SUCCESS)
+    {
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+    if(expr->outname[0] == '\0')
+    {
+        arith_expr_free(expr);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+
+    // output may also be an input: evaluate into new image, then rename
+    imageID IDout;
+    CREATE_IMAGENAME(tmpname, "_tmparith_%d", (int) getpid());
+    FUNC_CHECK_RETURN(create_image_ID(tmpname,
+                                      expr->naxis,
+                                      expr->size,
+                                      expr->datatype,
+                                      data.SHARED_DFT,
+                                      NB_KEYWNODE_MAX,
+                                      0,
+                                      &IDout));
+
+    errno_t ret = arith_expr_eval(expr, IDout);
+    if(ret == RETURN_SUCCESS)
+    {
+        if(variable_ID(expr->outname) != -1)
+        {
+            delete_variable_ID(expr->outname);
+        }
+        if(image_ID(expr->outname) != -1)
+        {
+            delete_image_ID(expr->outname, DELETE_IMAGE_ERRMODE_WARNING);
+        }
+        chname_image_ID(tmpname, expr->outname);
+    }
+    else
+    {
+        delete_image_ID(tmpname, DELETE_IMAGE_ERRMODE_WARNING);
+    }
+
+    arith_expr_free(expr);
+
+    DEBUG_TRACE_FEXIT();
+    return ret;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file    arith_expr.h
+ * @brief   compiled image arithmetic expressions
+ *
+ */
+
+#ifndef _ARITH_EXPR_H
+#define _ARITH_EXPR_H
+
+// compiled expression handle, see arith_expr.c
+typedef struct ARITHEXPR ARITHEXPR;
+
+errno_t
+arith_expr_compile(const char *exprstr, int errmode, ARITHEXPR **pexpr);
+
+errno_t arith_expr_free(ARITHEXPR *expr);
+
+const char *arith_expr_outname(const ARITHEXPR *expr);
+
+errno_t arith_expr_outformat(const ARITHEXPR *expr,
+                             uint8_t         *datatype,
+                             uint8_t         *naxis,
+                             uint32_t        *size);
+
+errno_t arith_expr_eval(ARITHEXPR *expr, imageID IDout);
+
+errno_t arith_expr_execute(const char *exprstr);
+
+#endif
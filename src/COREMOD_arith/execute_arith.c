@@ -12,6 +12,7 @@
 
 #include "COREMOD_memory/COREMOD_memory.h"
 
+#include "arith_expr.h"
 #include "image_arith__Cim_Cim__Cim.h"
 #include "image_arith__im__im.h"
 #include "image_arith__im_f__im.h"
@@ -316,6 +317,13 @@ int execute_arith(const char *cmd1)
     //  if( Debug > 0 )   fprintf(stdout, "[execute_arith]\n");
     //  if( Debug > 0 )   fprintf(stdout, "[execute_arith] str: [%s]\n", cmd1);
 
+    // pixel-wise image expressions are evaluated in a single fused pass
+    // other expressions are processed one operation at a time below
+    if(arith_expr_execute(cmd1) == RETURN_SUCCESS)
+    {
+        return (0);
+    }
+
     for(int i = 0; i < 100; i++)
     {
         word_type[i]     = 0;
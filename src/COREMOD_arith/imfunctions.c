@@ -11,6 +11,8 @@
 
 #include "COREMOD_memory/COREMOD_memory.h"
 
+#include "imfunctions_kernels.h"
+
 #ifdef _OPENMP
 #include <omp.h>
 #define OMP_NELEMENT_LIMIT 1000000
@@ -68,6 +70,13 @@ errno_t arith_image_function_im_im__d_d(
                     0,
                     &IDout);
 
+    // specialized kernel for common operators
+    if(arith_fastop_1_1_byID(ID, IDout, arith_fastop_code_d_d(pt2function)) ==
+            RETURN_SUCCESS)
+    {
+        DEBUG_TRACEPOINT("arith_image_function_d_d  DONE\n");
+        return RETURN_SUCCESS;
+    }
 
     uint_fast64_t nelement = data.image[ID].md[0].nelement;
 
@@ -616,6 +625,13 @@ errno_t arith_image_function_1_1_byID(imageID ID,
 
     free(naxes);
 
+    // specialized kernel for common operators
+    if(arith_fastop_1_1_byID(ID, IDout, arith_fastop_code_d_d(pt2function)) ==
+            RETURN_SUCCESS)
+    {
+        return RETURN_SUCCESS;
+    }
+
     nelement = data.image[ID].md[0].nelement;
 
 #ifdef _OPENMP
@@ -791,6 +807,13 @@ errno_t arith_image_function_1_1(const char *ID_name,
                     &IDout);
     free(naxes);
 
+    // specialized kernel for common operators
+    if(arith_fastop_1_1_byID(ID, IDout, arith_fastop_code_d_d(pt2function)) ==
+            RETURN_SUCCESS)
+    {
+        return RETURN_SUCCESS;
+    }
+
     nelement = data.image[ID].md[0].nelement;
 
 #ifdef _OPENMP
@@ -1347,6 +1370,15 @@ errno_t arith_image_function_2_1(const char *ID_name1,
             exit(0);
         }
 
+    // specialized kernel for common operators
+    if(arith_fastop_2_1_byID(ID1, ID2, IDout, arith_fastop_code_dd_d(pt2function))
+            == RETURN_SUCCESS)
+    {
+        free(naxes);
+        free(naxes2);
+        return RETURN_SUCCESS;
+    }
+
     //# ifdef _OPENMP
     //    #pragma omp parallel if (nelement>OMP_NELEMENT_LIMIT)
     //    {
@@ -0,0 +1,676 @@
+/**
+ * @file    imfunctions_kernels.c
+ * @brief   type-specialized kernels for common per-pixel operators
+ *
+ * The generic arith_image_function_* routines call a function pointer
+ * on every pixel, converting the value to double and back. For the
+ * most common operators, this file provides kernels specialized at
+ * compile time for each (input type, input type, output type)
+ * combination, so that the compiler can vectorize the loops.
+ *
+ * Kernels compute in double precision and cast to the output type, as
+ * the function pointer path does.
+ *
+ * The float,float -> float case, which dominates calibration
+ * pipelines, is explicitly vectorized with AVX-512 or AVX when
+ * available (see -march=native in top level CMakeLists.txt), computing
+ * in single precision. For the operators handled here, with IEEE
+ * compliant arithmetic, single precision results are identical to the
+ * double precision results rounded to float. Release builds use
+ * -Ofast, which may relax this for division.
+ *
+ * Operators are identified from the function pointer, so existing
+ * callers do not need to change. Any other function falls back to
+ * the function pointer path.
+ *
+ */
+
+#include <math.h>
+
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "imfunctions_kernels.h"
+#include "mathfuncs.h"
+
+#define OMP_NELEMENT_LIMIT 1000000
+
+#ifdef _OPENMP
+#include <omp.h>
+#define ARITHK_SIMD _Pragma("omp simd")
+#else
+#define ARITHK_SIMD
+#endif
+
+// datatype codes are used as table indices
+#define ARITHK_NBDATATYPE 16
+
+typedef void (*ARITHKERNEL1)(int fastop,
+                             const void *__restrict in,
+                             void *__restrict out,
+                             uint64_t nelem);
+
+typedef void (*ARITHKERNEL2)(int fastop,
+                             const void *__restrict in1,
+                             const void *__restrict in2,
+                             void *__restrict out,
+                             uint64_t nelem);
+
+/* ------------------------------------------------------------------------- */
+/* Kernel templates                                                          */
+/* ------------------------------------------------------------------------- */
+
+#define ARITHK_LOOP1(TO, expr)                                                 \
+    ARITHK_SIMD                                                                \
+    for (uint64_t ii = 0; ii < nelem; ii++)                                    \
+    {                                                                          \
+        double va = (double) a[ii];                                            \
+        c[ii]     = (TO) (expr);                                               \
+    }
+
+#define ARITHK_LOOP2(TO, expr)                                                 \
+    ARITHK_SIMD                                                                \
+    for (uint64_t ii = 0; ii < nelem; ii++)                                    \
+    {                                                                          \
+        double va = (double) a[ii];                                            \
+        double vb = (double) b[ii];                                            \
+        c[ii]     = (TO) (expr);                                               \
+    }
+
+#define ARITHK_DEFINE_1(S1, T1, SO, TO)                                        \
+    static void arithk1_##S1##_##SO(int fastop,                                \
+                                    const void *__restrict in,                 \
+                                    void *__restrict out,                      \
+                                    uint64_t nelem)                            \
+    {                                                                          \
+        const T1 *__restrict a = (const T1 *) in;                              \
+        TO *__restrict       c = (TO *) out;                                   \
+        switch (fastop)                                                        \
+        {                                                                      \
+        case ARITH_FASTOP_FABS:                                                \
+            ARITHK_LOOP1(TO, fabs(va))                                         \
+            break;                                                             \
+        case ARITH_FASTOP_SQRT:                                                \
+            ARITHK_LOOP1(TO, sqrt(va))                                         \
+            break;                                                             \
+        case ARITH_FASTOP_FLOOR:                                               \
+            ARITHK_LOOP1(TO, floor(va))                                        \
+            break;                                                             \
+        case ARITH_FASTOP_CEIL:                                                \
+            ARITHK_LOOP1(TO, ceil(va))                                         \
+            break;                                                             \
+        case ARITH_FASTOP_POSITIVE:                                            \
+            ARITHK_LOOP1(TO, (va > 0.0) ? 1.0 : 0.0)                           \
+            break;                                                             \
+        }                                                                      \
+    }
+
+#define ARITHK_DEFINE_2(S1, T1, S2, T2, SO, TO)                                \
+    static void arithk2_##S1##_##S2##_##SO(int fastop,                         \
+                                           const void *__restrict in1,         \
+                                           const void *__restrict in2,         \
+                                           void *__restrict out,               \
+                                           uint64_t nelem)                     \
+    {                                                                          \
+        const T1 *__restrict a = (const T1 *) in1;                             \
+        const T2 *__restrict b = (const T2 *) in2;                             \
+        TO *__restrict       c = (TO *) out;                                   \
+        switch (fastop)                                                        \
+        {                                                                      \
+        case ARITH_FASTOP_ADD:                                                 \
+            ARITHK_LOOP2(TO, va + vb)                                          \
+            break;                                                             \
+        case ARITH_FASTOP_SUB:                                                 \
+            ARITHK_LOOP2(TO, va - vb)                                          \
+            break;                                                             \
+        case ARITH_FASTOP_SUBM:                                                \
+            ARITHK_LOOP2(TO, vb - va)                                          \
+            break;                                                             \
+        case ARITH_FASTOP_MULT:                                                \
+            ARITHK_LOOP2(TO, va * vb)                                          \
+            break;                                                             \
+        case ARITH_FASTOP_DIV:                                                 \
+            ARITHK_LOOP2(TO, va / vb)                                          \
+            break;                                                             \
+        case ARITH_FASTOP_DIV1:                                                \
+            ARITHK_LOOP2(TO, vb / va)                                          \
+            break;                                                             \
+        case ARITH_FASTOP_MIN:                                                 \
+            ARITHK_LOOP2(TO, (va < vb) ? va : vb)                              \
+            break;                                                             \
+        case ARITH_FASTOP_MAX:                                                 \
+            ARITHK_LOOP2(TO, (va > vb) ? va : vb)                              \
+            break;                                                             \
+        case ARITH_FASTOP_TESTLT:                                              \
+            ARITHK_LOOP2(TO, (va < vb) ? 1.0 : 0.0)                            \
+            break;                                                             \
+        case ARITH_FASTOP_TESTMT:                                              \
+            ARITHK_LOOP2(TO, (va < vb) ? 0.0 : 1.0)                            \
+            break;                                                             \
+        }                                                                      \
+    }
+
+/* ------------------------------------------------------------------------- */
+/* Instantiation over all real input types, float and double output          */
+/* ------------------------------------------------------------------------- */
+
+#define ARITHK_FOREACH_INTYPE(M)                                               \
+    M(UI8, uint8_t, _DATATYPE_UINT8)                                           \
+    M(SI8, int8_t, _DATATYPE_INT8)                                             \
+    M(UI16, uint16_t, _DATATYPE_UINT16)                                        \
+    M(SI16, int16_t, _DATATYPE_INT16)                                          \
+    M(UI32, uint32_t, _DATATYPE_UINT32)                                        \
+    M(SI32, int32_t, _DATATYPE_INT32)                                          \
+    M(UI64, uint64_t, _DATATYPE_UINT64)                                        \
+    M(SI64, int64_t, _DATATYPE_INT64)                                          \
+    M(F, float, _DATATYPE_FLOAT)                                               \
+    M(D, double, _DATATYPE_DOUBLE)
+
+#define ARITHK_FOREACH_INTYPE2(M, S1, T1, DT1)                                 \
+    M(S1, T1, DT1, UI8, uint8_t, _DATATYPE_UINT8)                              \
+    M(S1, T1, DT1, SI8, int8_t, _DATATYPE_INT8)                                \
+    M(S1, T1, DT1, UI16, uint16_t, _DATATYPE_UINT16)                           \
+    M(S1, T1, DT1, SI16, int16_t, _DATATYPE_INT16)                             \
+    M(S1, T1, DT1, UI32, uint32_t, _DATATYPE_UINT32)                           \
+    M(S1, T1, DT1, SI32, int32_t, _DATATYPE_INT32)                             \
+    M(S1, T1, DT1, UI64, uint64_t, _DATATYPE_UINT64)                           \
+    M(S1, T1, DT1, SI64, int64_t, _DATATYPE_INT64)                             \
+    M(S1, T1, DT1, F, float, _DATATYPE_FLOAT)                                  \
+    M(S1, T1, DT1, D, double, _DATATYPE_DOUBLE)
+
+// kernel definitions
+#define ARITHK_DEFINE_1_FD(S1, T1, DT1)                                        \
+    ARITHK_DEFINE_1(S1, T1, F, float)                                          \
+    ARITHK_DEFINE_1(S1, T1, D, double)
+
+#define ARITHK_DEFINE_2_FD(S1, T1, DT1, S2, T2, DT2)                           \
+    ARITHK_DEFINE_2(S1, T1, S2, T2, F, float)                                  \
+    ARITHK_DEFINE_2(S1, T1, S2, T2, D, double)
+
+#define ARITHK_DEFINE_2_ALL(S1, T1, DT1)                                       \
+    ARITHK_FOREACH_INTYPE2(ARITHK_DEFINE_2_FD, S1, T1, DT1)
+
+ARITHK_FOREACH_INTYPE(ARITHK_DEFINE_1_FD)
+ARITHK_FOREACH_INTYPE(ARITHK_DEFINE_2_ALL)
+
+// dispatch tables, indexed by [input datatype]...[output 0:float 1:double]
+#define ARITHK_TABLE_1(S1, T1, DT1)                                            \
+    [DT1][0] = arithk1_##S1##_F, [DT1][1] = arithk1_##S1##_D,
+
+#define ARITHK_TABLE_2(S1, T1, DT1, S2, T2, DT2)                               \
+    [DT1][DT2][0] = arithk2_##S1##_##S2##_F,                                   \
+    [DT1][DT2][1] = arithk2_##S1##_##S2##_D,
+
+#define ARITHK_TABLE_2_ALL(S1, T1, DT1)                                        \
+    ARITHK_FOREACH_INTYPE2(ARITHK_TABLE_2, S1, T1, DT1)
+
+static const ARITHKERNEL1 arithk1_table[ARITHK_NBDATATYPE][2] =
+{
+    ARITHK_FOREACH_INTYPE(ARITHK_TABLE_1)
+};
+
+static const ARITHKERNEL2 arithk2_table[ARITHK_NBDATATYPE][ARITHK_NBDATATYPE][2] =
+{
+    ARITHK_FOREACH_INTYPE(ARITHK_TABLE_2_ALL)
+};
+
+/* ------------------------------------------------------------------------- */
+/* Explicitly vectorized float,float -> float kernel                         */
+/* ------------------------------------------------------------------------- */
+
+#if defined(__AVX512F__)
+
+#define ARITHK_VF_LEN 16
+#define ARITHK_VF     __m512
+#define ARITHK_VF_LOAD(p)     _mm512_loadu_ps(p)
+#define ARITHK_VF_STORE(p, v) _mm512_storeu_ps(p, v)
+#define ARITHK_VF_SET1(x)     _mm512_set1_ps(x)
+#define ARITHK_VF_ADD(x, y)   _mm512_add_ps(x, y)
+#define ARITHK_VF_SUB(x, y)   _mm512_sub_ps(x, y)
+#define ARITHK_VF_MUL(x, y)   _mm512_mul_ps(x, y)
+#define ARITHK_VF_DIV(x, y)   _mm512_div_ps(x, y)
+#define ARITHK_VF_MIN(x, y)   _mm512_min_ps(x, y)
+#define ARITHK_VF_MAX(x, y)   _mm512_max_ps(x, y)
+// 1.0 where x < y (ordered), 0.0 otherwise
+#define ARITHK_VF_LT1(x, y)                                                    \
+    _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, y, _CMP_LT_OQ), vone)
+// 1.0 where !(x < y), 0.0 otherwise
+#define ARITHK_VF_NLT1(x, y)                                                   \
+    _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, y, _CMP_NLT_UQ), vone)
+
+#elif defined(__AVX__)
+
+#define ARITHK_VF_LEN 8
+#define ARITHK_VF     __m256
+#define ARITHK_VF_LOAD(p)     _mm256_loadu_ps(p)
+#define ARITHK_VF_STORE(p, v) _mm256_storeu_ps(p, v)
+#define ARITHK_VF_SET1(x)     _mm256_set1_ps(x)
+#define ARITHK_VF_ADD(x, y)   _mm256_add_ps(x, y)
+#define ARITHK_VF_SUB(x, y)   _mm256_sub_ps(x, y)
+#define ARITHK_VF_MUL(x, y)   _mm256_mul_ps(x, y)
+#define ARITHK_VF_DIV(x, y)   _mm256_div_ps(x, y)
+#define ARITHK_VF_MIN(x, y)   _mm256_min_ps(x, y)
+#define ARITHK_VF_MAX(x, y)   _mm256_max_ps(x, y)
+#define ARITHK_VF_LT1(x, y)                                                    \
+    _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_LT_OQ), vone)
+#define ARITHK_VF_NLT1(x, y)                                                   \
+    _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_NLT_UQ), vone)
+
+#endif
+
+#ifdef ARITHK_VF_LEN
+
+#define ARITHK_VF_LOOP(vexpr)                                                  \
+    for (; ii + ARITHK_VF_LEN <= nelem; ii += ARITHK_VF_LEN)                   \
+    {                                                                          \
+        ARITHK_VF va = ARITHK_VF_LOAD(a + ii);                                 \
+        ARITHK_VF vb = ARITHK_VF_LOAD(b + ii);                                 \
+        ARITHK_VF_STORE(c + ii, vexpr);                                        \
+    }
+
+static void arithk2_F_F_F_vec(int fastop,
+                              const void *__restrict in1,
+                              const void *__restrict in2,
+                              void *__restrict out,
+                              uint64_t nelem)
+{
+    const float *__restrict a = (const float *) in1;
+    const float *__restrict b = (const float *) in2;
+    float *__restrict       c = (float *) out;
+
+    __attribute__((unused)) const ARITHK_VF vone = ARITHK_VF_SET1(1.0f);
+
+    uint64_t ii = 0;
+    switch(fastop)
+    {
+        case ARITH_FASTOP_ADD:
+            ARITHK_VF_LOOP(ARITHK_VF_ADD(va, vb))
+            break;
+        case ARITH_FASTOP_SUB:
+            ARITHK_VF_LOOP(ARITHK_VF_SUB(va, vb))
+            break;
+        case ARITH_FASTOP_SUBM:
+            ARITHK_VF_LOOP(ARITHK_VF_SUB(vb, va))
+            break;
+        case ARITH_FASTOP_MULT:
+            ARITHK_VF_LOOP(ARITHK_VF_MUL(va, vb))
+            break;
+        case ARITH_FASTOP_DIV:
+            ARITHK_VF_LOOP(ARITHK_VF_DIV(va, vb))
+            break;
+        case ARITH_FASTOP_DIV1:
+            ARITHK_VF_LOOP(ARITHK_VF_DIV(vb, va))
+            break;
+        case ARITH_FASTOP_MIN:
+            // returns second operand unless va < vb, as Pminv()
+            ARITHK_VF_LOOP(ARITHK_VF_MIN(va, vb))
+            break;
+        case ARITH_FASTOP_MAX:
+            // returns second operand unless va > vb, as Pmaxv()
+            ARITHK_VF_LOOP(ARITHK_VF_MAX(va, vb))
+            break;
+        case ARITH_FASTOP_TESTLT:
+            ARITHK_VF_LOOP(ARITHK_VF_LT1(va, vb))
+            break;
+        case ARITH_FASTOP_TESTMT:
+            ARITHK_VF_LOOP(ARITHK_VF_NLT1(va, vb))
+            break;
+    }
+
+    // remainder
+    if(ii < nelem)
+    {
+        arithk2_F_F_F(fastop, a + ii, b + ii, c + ii, nelem - ii);
+    }
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Operator identification                                                   */
+/* ------------------------------------------------------------------------- */
+
+int arith_fastop_code_d_d(double (*pt2function)(double))
+{
+    if(pt2function == &Pfabs)
+    {
+        return ARITH_FASTOP_FABS;
+    }
+    if(pt2function == &Psqrt)
+    {
+        return ARITH_FASTOP_SQRT;
+    }
+    if(pt2function == &Pfloor)
+    {
+        return ARITH_FASTOP_FLOOR;
+    }
+    if(pt2function == &Pceil)
+    {
+        return ARITH_FASTOP_CEIL;
+    }
+    if(pt2function == &Ppositive)
+    {
+        return ARITH_FASTOP_POSITIVE;
+    }
+
+    return ARITH_FASTOP_NONE;
+}
+
+int arith_fastop_code_dd_d(double (*pt2function)(double, double))
+{
+    if(pt2function == &Padd)
+    {
+        return ARITH_FASTOP_ADD;
+    }
+    if(pt2function == &Psub)
+    {
+        return ARITH_FASTOP_SUB;
+    }
+    if(pt2function == &Psubm)
+    {
+        return ARITH_FASTOP_SUBM;
+    }
+    if(pt2function == &Pmult)
+    {
+        return ARITH_FASTOP_MULT;
+    }
+    if(pt2function == &Pdiv)
+    {
+        return ARITH_FASTOP_DIV;
+    }
+    if(pt2function == &Pdiv1)
+    {
+        return ARITH_FASTOP_DIV1;
+    }
+    if(pt2function == &Pminv)
+    {
+        return ARITH_FASTOP_MIN;
+    }
+    if(pt2function == &Pmaxv)
+    {
+        return ARITH_FASTOP_MAX;
+    }
+    if(pt2function == &Ptestlt)
+    {
+        return ARITH_FASTOP_TESTLT;
+    }
+    if(pt2function == &Ptestmt)
+    {
+        return ARITH_FASTOP_TESTMT;
+    }
+
+    return ARITH_FASTOP_NONE;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Kernel execution                                                          */
+/* ------------------------------------------------------------------------- */
+
+// returns 0 for float output, 1 for double output, -1 if not supported
+static int arithk_outindex(uint8_t datatypeout)
+{
+    if(datatypeout == _DATATYPE_FLOAT)
+    {
+        return 0;
+    }
+    if(datatypeout == _DATATYPE_DOUBLE)
+    {
+        return 1;
+    }
+    return -1;
+}
+
+#ifdef _OPENMP
+// split nelem in one contiguous block per thread
+// block boundaries are multiples of 64 elements to keep vector loops aligned
+static inline void arithk_threadblock(uint64_t  nelem,
+                                      uint64_t *i0,
+                                      uint64_t *n)
+{
+    uint64_t nt    = (uint64_t) omp_get_num_threads();
+    uint64_t it    = (uint64_t) omp_get_thread_num();
+    uint64_t chunk = (((nelem + nt - 1) / nt) + 63) & ~((uint64_t) 63);
+
+    *i0 = it * chunk;
+    *n  = 0;
+    if(*i0 < nelem)
+    {
+        *n = nelem - *i0;
+        if(*n > chunk)
+        {
+            *n = chunk;
+        }
+    }
+}
+#endif
+
+static void arithk1_run(ARITHKERNEL1 kernel,
+                        int          fastop,
+                        const char  *in,
+                        size_t       szin,
+                        char        *out,
+                        size_t       szout,
+                        uint64_t     nelem)
+{
+    (void) szin;
+    (void) szout;
+#ifdef _OPENMP
+    if(nelem > OMP_NELEMENT_LIMIT)
+    {
+        #pragma omp parallel
+        {
+            uint64_t i0, n;
+            arithk_threadblock(nelem, &i0, &n);
+            if(n > 0)
+            {
+                kernel(fastop, in + i0 * szin, out + i0 * szout, n);
+            }
+        }
+        return;
+    }
+#endif
+    kernel(fastop, in, out, nelem);
+}
+
+static void arithk2_run(ARITHKERNEL2 kernel,
+                        int          fastop,
+                        const char  *in1,
+                        size_t       szin1,
+                        const char  *in2,
+                        size_t       szin2,
+                        char        *out,
+                        size_t       szout,
+                        uint64_t     nelem)
+{
+    (void) szin1;
+    (void) szin2;
+    (void) szout;
+#ifdef _OPENMP
+    if(nelem > OMP_NELEMENT_LIMIT)
+    {
+        #pragma omp parallel
+        {
+            uint64_t i0, n;
+            arithk_threadblock(nelem, &i0, &n);
+            if(n > 0)
+            {
+                kernel(fastop,
+                       in1 + i0 * szin1,
+                       in2 + i0 * szin2,
+                       out + i0 * szout,
+                       n);
+            }
+        }
+        return;
+    }
+#endif
+    kernel(fastop, in1, in2, out, nelem);
+}
+
+/**
+ * @brief Apply one-argument operator with specialized kernel
+ *
+ * Output image IDout must exist, with same number of elements as ID.
+ *
+ * @return RETURN_SUCCESS if computed, RETURN_FAILURE if no kernel is
+ * available (caller should fall back to function pointer)
+ */
+errno_t arith_fastop_1_1_byID(imageID ID, imageID IDout, int fastop)
+{
+    if(fastop == ARITH_FASTOP_NONE)
+    {
+        return RETURN_FAILURE;
+    }
+
+    uint8_t datatype    = data.image[ID].md[0].datatype;
+    uint8_t datatypeout = data.image[IDout].md[0].datatype;
+    int     outindex    = arithk_outindex(datatypeout);
+
+    if((outindex == -1) || (datatype >= ARITHK_NBDATATYPE))
+    {
+        return RETURN_FAILURE;
+    }
+
+    ARITHKERNEL1 kernel = arithk1_table[datatype][outindex];
+    if(kernel == NULL)
+    {
+        return RETURN_FAILURE;
+    }
+
+    uint64_t nelement = data.image[ID].md[0].nelement;
+    if(data.image[IDout].md[0].nelement != nelement)
+    {
+        return RETURN_FAILURE;
+    }
+
+    DEBUG_TRACEPOINT("fastop %d  datatype %u -> %u", fastop, datatype,
+                     datatypeout);
+
+    arithk1_run(kernel,
+                fastop,
+                (const char *) data.image[ID].array.raw,
+                ImageStreamIO_typesize(datatype),
+                (char *) data.image[IDout].array.raw,
+                ImageStreamIO_typesize(datatypeout),
+                nelement);
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Apply two-argument operator with specialized kernel
+ *
+ * Output image IDout must exist, with same number of elements as ID1.
+ * Supports same-size inputs, and 3D ID1 with 2D ID2 of same xy size,
+ * in which case ID2 is applied to each slice of ID1.
+ *
+ * @return RETURN_SUCCESS if computed, RETURN_FAILURE if no kernel is
+ * available (caller should fall back to function pointer)
+ */
+errno_t arith_fastop_2_1_byID(imageID ID1,
+                              imageID ID2,
+                              imageID IDout,
+                              int     fastop)
+{
+    if(fastop == ARITH_FASTOP_NONE)
+    {
+        return RETURN_FAILURE;
+    }
+
+    uint8_t datatype1   = data.image[ID1].md[0].datatype;
+    uint8_t datatype2   = data.image[ID2].md[0].datatype;
+    uint8_t datatypeout = data.image[IDout].md[0].datatype;
+    int     outindex    = arithk_outindex(datatypeout);
+
+    if((outindex == -1) || (datatype1 >= ARITHK_NBDATATYPE) ||
+            (datatype2 >= ARITHK_NBDATATYPE))
+    {
+        return RETURN_FAILURE;
+    }
+
+    ARITHKERNEL2 kernel = arithk2_table[datatype1][datatype2][outindex];
+    if(kernel == NULL)
+    {
+        return RETURN_FAILURE;
+    }
+#ifdef ARITHK_VF_LEN
+    if((datatype1 == _DATATYPE_FLOAT) && (datatype2 == _DATATYPE_FLOAT) &&
+            (datatypeout == _DATATYPE_FLOAT))
+    {
+        kernel = arithk2_F_F_F_vec;
+    }
+#endif
+
+    uint64_t nelement1 = data.image[ID1].md[0].nelement;
+    uint64_t nelement2 = data.image[ID2].md[0].nelement;
+    if(data.image[IDout].md[0].nelement != nelement1)
+    {
+        return RETURN_FAILURE;
+    }
+
+    size_t szin1 = ImageStreamIO_typesize(datatype1);
+    size_t szin2 = ImageStreamIO_typesize(datatype2);
+    size_t szout = ImageStreamIO_typesize(datatypeout);
+
+    const char *in1 = (const char *) data.image[ID1].array.raw;
+    const char *in2 = (const char *) data.image[ID2].array.raw;
+    char       *out = (char *) data.image[IDout].array.raw;
+
+    DEBUG_TRACEPOINT("fastop %d  datatype %u %u -> %u", fastop, datatype1,
+                     datatype2, datatypeout);
+
+    // 3D image, 2D image -> 3D image
+    if((data.image[ID1].md[0].naxis == 3) &&
+            (data.image[ID2].md[0].naxis == 2) &&
+            (data.image[ID1].md[0].size[0] == data.image[ID2].md[0].size[0]) &&
+            (data.image[ID1].md[0].size[1] == data.image[ID2].md[0].size[1]))
+    {
+        uint64_t xysize = nelement2;
+        uint32_t zsize  = data.image[ID1].md[0].size[2];
+
+        if(xysize > OMP_NELEMENT_LIMIT)
+        {
+            // large slices: parallelize within slice
+            for(uint32_t kk = 0; kk < zsize; kk++)
+            {
+                arithk2_run(kernel,
+                            fastop,
+                            in1 + kk * xysize * szin1,
+                            szin1,
+                            in2,
+                            szin2,
+                            out + kk * xysize * szout,
+                            szout,
+                            xysize);
+            }
+        }
+        else
+        {
+            // small slices: parallelize across slices
+#ifdef _OPENMP
+            #pragma omp parallel for if (nelement1 > OMP_NELEMENT_LIMIT)
+#endif
+            for(uint32_t kk = 0; kk < zsize; kk++)
+            {
+                kernel(fastop,
+                       in1 + kk * xysize * szin1,
+                       in2,
+                       out + kk * xysize * szout,
+                       xysize);
+            }
+        }
+        return RETURN_SUCCESS;
+    }
+
+    if(nelement1 != nelement2)
+    {
+        return RETURN_FAILURE;
+    }
+
+    arithk2_run(kernel, fastop, in1, szin1, in2, szin2, out, szout, nelement1);
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file    imfunctions_kernels.h
+ *
+ * Type-specialized kernels for common per-pixel operators
+ *
+ */
+
+#ifndef _IMFUNCTIONS_KERNELS_H
+#define _IMFUNCTIONS_KERNELS_H
+
+// operator codes
+// ARITH_FASTOP_NONE : no specialized kernel, use function pointer
+#define ARITH_FASTOP_NONE     0
+
+// two-argument operators (a, b)
+#define ARITH_FASTOP_ADD      1  // a + b
+#define ARITH_FASTOP_SUB      2  // a - b
+#define ARITH_FASTOP_SUBM     3  // b - a
+#define ARITH_FASTOP_MULT     4  // a * b
+#define ARITH_FASTOP_DIV      5  // a / b
+#define ARITH_FASTOP_DIV1     6  // b / a
+#define ARITH_FASTOP_MIN      7  // min(a, b)
+#define ARITH_FASTOP_MAX      8  // max(a, b)
+#define ARITH_FASTOP_TESTLT   9  // 1 if a < b, 0 otherwise
+#define ARITH_FASTOP_TESTMT   10 // 0 if a < b, 1 otherwise
+
+// one-argument operators (a)
+#define ARITH_FASTOP_FABS     20
+#define ARITH_FASTOP_SQRT     21
+#define ARITH_FASTOP_FLOOR    22
+#define ARITH_FASTOP_CEIL     23
+#define ARITH_FASTOP_POSITIVE 24 // 1 if a > 0, 0 otherwise
+
+int arith_fastop_code_d_d(double (*pt2function)(double));
+
+int arith_fastop_code_dd_d(double (*pt2function)(double, double));
+
+errno_t arith_fastop_1_1_byID(imageID ID, imageID IDout, int fastop);
+
+errno_t arith_fastop_2_1_byID(imageID ID1,
+                              imageID ID2,
+                              imageID IDout,
+                              int     fastop);
+
+#endif
@@ -0,0 +1,300 @@
+/**
+ * @file    stream_arith.c
+ * @brief   evaluate arithmetic expression on streams
+ *
+ * The expression is compiled once (see arith_expr.c) and evaluated on
+ * every loop iteration into a preallocated output stream, so that a
+ * chain of single-operation stream processes can be replaced by one.
+ *
+ * Input streams are listed in .inputs, separated by spaces or commas.
+ * Each entry is either a stream name, or alias=streamname, in which
+ * case the alias can be used in the expression:
+ *
+ *   .inputs  "raw=cam0 dark=cam0dark flat=cam0flat"
+ *   .expr    "(raw-dark)*flat"
+ *
+ * The loop is triggered according to the standard processinfo trigger
+ * settings, typically on the raw input stream.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "arith_expr.h"
+
+#define STREAMARITH_MAXINPUT   32
+#define STREAMARITH_EXPRMAXLEN 2000
+
+static char *exprstr;
+static long  fpi_exprstr;
+
+static char *inputlist;
+static long  fpi_inputlist;
+
+static char *outsname;
+static long  fpi_outsname;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STR,
+        ".expr",
+        "expression, using input streams or aliases",
+        "raw-dark",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &exprstr,
+        &fpi_exprstr
+    },
+    {
+        CLIARG_STR,
+        ".inputs",
+        "input streams [alias=]stream, space-separated",
+        "raw=imraw dark=imdark",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inputlist,
+        &fpi_inputlist
+    },
+    {
+        CLIARG_STR,
+        ".outsname",
+        "output stream name",
+        "outim",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outsname,
+        &fpi_outsname
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamarith", "evaluate expression on streams", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Evaluate pixel-wise expression on input streams\n");
+    printf("Inputs are listed as [alias=]stream, space or comma separated\n");
+    printf("Example:\n");
+    printf("  inputs : \"raw=cam0 dark=cam0dark flat=cam0flat\"\n");
+    printf("  expr   : \"(raw-dark)*flat\"\n");
+    printf("Output stream is created with the expression output format\n");
+
+    return RETURN_SUCCESS;
+}
+
+typedef struct
+{
+    char alias[STRINGMAXLEN_IMAGE_NAME];
+    char sname[STRINGMAXLEN_IMAGE_NAME];
+} STREAMARITH_INPUT;
+
+/**
+ * @brief Parse input list into alias / stream name pairs
+ */
+static int streamarith_parse_inputs(const char        *list,
+                                    STREAMARITH_INPUT *input)
+{
+    int  NBinput = 0;
+    char entry[2 * STRINGMAXLEN_IMAGE_NAME];
+
+    memset(input, 0, sizeof(STREAMARITH_INPUT) * STREAMARITH_MAXINPUT);
+
+    const char *s = list;
+    while(*s != '\0')
+    {
+        while((*s == ' ') || (*s == ','))
+        {
+            s++;
+        }
+        if(*s == '\0')
+        {
+            break;
+        }
+
+        int l = 0;
+        while((*s != '\0') && (*s != ' ') && (*s != ','))
+        {
+            if(l < 2 * STRINGMAXLEN_IMAGE_NAME - 1)
+            {
+                entry[l] = *s;
+                l++;
+            }
+            s++;
+        }
+        entry[l] = '\0';
+
+        if(NBinput == STREAMARITH_MAXINPUT)
+        {
+            PRINT_WARNING("more than %d inputs, ignoring %s",
+                          STREAMARITH_MAXINPUT,
+                          entry);
+            continue;
+        }
+
+        char *equ = strchr(entry, '=');
+        if(equ != NULL)
+        {
+            *equ = '\0';
+            strncpy(input[NBinput].alias, entry, STRINGMAXLEN_IMAGE_NAME - 1);
+            strncpy(input[NBinput].sname, equ + 1, STRINGMAXLEN_IMAGE_NAME - 1);
+        }
+        else
+        {
+            strncpy(input[NBinput].alias, entry, STRINGMAXLEN_IMAGE_NAME - 1);
+            strncpy(input[NBinput].sname, entry, STRINGMAXLEN_IMAGE_NAME - 1);
+        }
+        NBinput++;
+    }
+
+    return NBinput;
+}
+
+/**
+ * @brief Replace aliases by stream names in expression
+ */
+static errno_t streamarith_substitute(const char        *expr,
+                                      STREAMARITH_INPUT *input,
+                                      int                NBinput,
+                                      char              *exprout)
+{
+    int j = 0;
+
+    const char *s = expr;
+    while(*s != '\0')
+    {
+        const char *word = s;
+        while((*s != '\0') && (strchr("+-*/^(),= ", *s) == NULL))
+        {
+            s++;
+        }
+        int wlen = (int)(s - word);
+
+        const char *wordout    = word;
+        int         wordoutlen = wlen;
+        for(int i = 0; i < NBinput; i++)
+        {
+            if(((int) strlen(input[i].alias) == wlen) &&
+                    (strncmp(input[i].alias, word, wlen) == 0))
+            {
+                wordout    = input[i].sname;
+                wordoutlen = strlen(input[i].sname);
+            }
+        }
+
+        // separator following word, if any
+        int seplen = (*s != '\0') ? 1 : 0;
+
+        if(j + wordoutlen + seplen >= STREAMARITH_EXPRMAXLEN)
+        {
+            PRINT_ERROR("expression too long");
+            return RETURN_FAILURE;
+        }
+        memcpy(exprout + j, wordout, wordoutlen);
+        j += wordoutlen;
+        if(seplen == 1)
+        {
+            exprout[j] = *s;
+            j++;
+            s++;
+        }
+    }
+    exprout[j] = '\0';
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    // CONNECT TO INPUT STREAMS
+    STREAMARITH_INPUT input[STREAMARITH_MAXINPUT];
+    int               NBinput = streamarith_parse_inputs(inputlist, input);
+    for(int i = 0; i < NBinput; i++)
+    {
+        IMGID img = stream_connect(input[i].sname);
+        if(img.ID == -1)
+        {
+            FUNC_RETURN_FAILURE("cannot connect to input stream %s",
+                                input[i].sname);
+        }
+        printf("input %-16s -> %s\n", input[i].alias, input[i].sname);
+    }
+
+    // COMPILE EXPRESSION
+    char exprsub[STREAMARITH_EXPRMAXLEN];
+    FUNC_CHECK_RETURN(
+        streamarith_substitute(exprstr, input, NBinput, exprsub));
+
+    ARITHEXPR *expr = NULL;
+    if(arith_expr_compile(exprsub, ERRMODE_WARN, &expr) != RETURN_SUCCESS)
+    {
+        FUNC_RETURN_FAILURE("cannot compile expression \"%s\"", exprsub);
+    }
+
+    // CONNECT TO OR CREATE OUTPUT STREAM
+    uint8_t  datatype;
+    uint8_t  naxis;
+    uint32_t size[3] = {1, 1, 1};
+    arith_expr_outformat(expr, &datatype, &naxis, size);
+
+    IMGID imgout;
+    if(naxis == 3)
+    {
+        imgout = stream_connect_create_3D(outsname,
+                                          size[0],
+                                          size[1],
+                                          size[2],
+                                          datatype);
+    }
+    else
+    {
+        imgout = stream_connect_create_2D(outsname, size[0], size[1], datatype);
+    }
+    if(imgout.ID == -1)
+    {
+        arith_expr_free(expr);
+        FUNC_RETURN_FAILURE("cannot create output stream %s", outsname);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    int evalOK = 1;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        imgout.md->write = 1;
+        if(arith_expr_eval(expr, imgout.ID) == RETURN_SUCCESS)
+        {
+            processinfo_update_output_stream(processinfo, imgout.ID);
+            evalOK = 1;
+        }
+        else
+        {
+            // output not updated
+            imgout.md->write = 0;
+            if((evalOK == 1) && (processinfo != NULL))
+            {
+                processinfo_WriteMessage(processinfo,
+                                         "expression evaluation failed");
+            }
+            evalOK = 0;
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    arith_expr_free(expr);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_arith__streamarith()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
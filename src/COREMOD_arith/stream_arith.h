@@ -0,0 +1,6 @@
+#ifndef COREMOD_ARITH_STREAM_ARITH_H
+#define COREMOD_ARITH_STREAM_ARITH_H
+
+errno_t CLIADDCMD_COREMOD_arith__streamarith();
+
+#endif
@@ -3,7 +3,10 @@
  * @brief   load FITS format files
  */
 
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "CommandLineInterface/CLIcore.h"
 
@@ -16,6 +19,11 @@
 #include "COREMOD_memory/image_keyword_addD.h"
 #include "COREMOD_memory/image_keyword_addL.h"
 #include "COREMOD_memory/image_keyword_addS.h"
+#include "COREMOD_memory/image_mmap.h"
+
+#include "loadfits.h"
+
+#define OMP_NELEMENT_LIMIT 1000000
 
 extern COREMOD_IOFITS_DATA COREMOD_iofits_data;
 
@@ -23,6 +31,7 @@ extern COREMOD_IOFITS_DATA COREMOD_iofits_data;
 static char *infilename;
 static char *outimname;
 static long *FITSIOerrmode;
+static long *mapmode;
 
 // CLI function arguments and parameters
 static CLICMDARGDEF farg[] =
@@ -53,6 +62,15 @@ static CLICMDARGDEF farg[] =
         CLIARG_HIDDEN_DEFAULT,
         (void **) &FITSIOerrmode,
         NULL
+    },
+    {
+        CLIARG_INT64,
+        ".mapmode",
+        "data unit read \n(0:cfitsio) (1:mmap+copy) (2:mmap, zero-copy)",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &mapmode,
+        NULL
     }
 };
 
@@ -71,21 +89,303 @@ static errno_t help_function()
         "Uses fitsio library, supports extended fitsio file syntax\n"
         "File name should be in double quotes unless free of special chars\n"
         "Examples:\n"
-        "   loadfits \"im1.fits\" im\n");
+        "   loadfits \"im1.fits\" im\n"
+        "Uncompressed float, double, uint16, int32 and int64 data units\n"
+        "are read through a memory mapping of the file (.mapmode 1).\n"
+        "With .mapmode 2, the local image array is the file mapping:\n"
+        "pages are loaded on access, the file must not be modified\n"
+        "while the image exists.\n");
 
     return RETURN_SUCCESS;
 }
 
+/**
+ * @brief Convert FITS data unit to native representation
+ *
+ * Byte swap on little-endian hosts, and sign bit flip for types stored
+ * with BZERO offset. dst and src may be equal.
+ */
+void loadfits_convert(void       *dst,
+                      const void *src,
+                      long        nelem,
+                      int         typesize,
+                      uint64_t    signmask)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if(signmask == 0)
+    {
+        if(dst != src)
+        {
+            memcpy(dst, src, nelem * typesize);
+        }
+        return;
+    }
+#endif
+
+#ifdef _OPENMP
+    #pragma omp parallel if (nelem > OMP_NELEMENT_LIMIT)
+    {
+#endif
+        switch(typesize)
+        {
+            case 1:
+            {
+                uint8_t        m = (uint8_t) signmask;
+                uint8_t       *d = (uint8_t *) dst;
+                const uint8_t *s = (const uint8_t *) src;
+#ifdef _OPENMP
+                #pragma omp for
+#endif
+                for(long ii = 0; ii < nelem; ii++)
+                {
+                    d[ii] = s[ii] ^ m;
+                }
+            }
+            break;
+            case 2:
+            {
+                uint16_t        m = (uint16_t) signmask;
+                uint16_t       *d = (uint16_t *) dst;
+                const uint16_t *s = (const uint16_t *) src;
+#ifdef _OPENMP
+                #pragma omp for
+#endif
+                for(long ii = 0; ii < nelem; ii++)
+                {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                    d[ii] = s[ii] ^ m;
+#else
+                    d[ii] = __builtin_bswap16(s[ii]) ^ m;
+#endif
+                }
+            }
+            break;
+            case 4:
+            {
+                uint32_t        m = (uint32_t) signmask;
+                uint32_t       *d = (uint32_t *) dst;
+                const uint32_t *s = (const uint32_t *) src;
+#ifdef _OPENMP
+                #pragma omp for
+#endif
+                for(long ii = 0; ii < nelem; ii++)
+                {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                    d[ii] = s[ii] ^ m;
+#else
+                    d[ii] = __builtin_bswap32(s[ii]) ^ m;
+#endif
+                }
+            }
+            break;
+            case 8:
+            {
+                uint64_t       *d = (uint64_t *) dst;
+                const uint64_t *s = (const uint64_t *) src;
+#ifdef _OPENMP
+                #pragma omp for
+#endif
+                for(long ii = 0; ii < nelem; ii++)
+                {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                    d[ii] = s[ii] ^ signmask;
+#else
+                    d[ii] = __builtin_bswap64(s[ii]) ^ signmask;
+#endif
+                }
+            }
+            break;
+        }
+#ifdef _OPENMP
+    }
+#endif
+}
+
+/**
+ * @brief Load data unit through memory mapping of the file
+ *
+ * Applies to uncompressed data units that map to the image type
+ * load_fits would create without scaling:
+ *   -32, -64 -> float, double
+ *   16 (BZERO 32768) -> uint16
+ *   32, 64 (BZERO 0) -> int32, int64
+ *
+ * LOADFITS_MAPMODE_COPY     : data converted from mapping into image
+ * LOADFITS_MAPMODE_ZEROCOPY : private mapping becomes the local image
+ *                             array, converted in place if needed
+ *
+ * @return 1 if image loaded, 0 if not applicable (use cfitsio)
+ */
+static int loadfits_map(fitsfile   *fptr,
+                        const char *file_name,
+                        const char *ID_name,
+                        int         bitpix,
+                        double      bscale,
+                        double      bzero,
+                        long        naxis,
+                        uint32_t   *naxes,
+                        long        nelements,
+                        int         mapmode,
+                        imageID    *ID)
+{
+    uint8_t  datatype;
+    int      typesize;
+    uint64_t signmask = 0;
+
+    if((bscale != 1.0) || (nelements < 1))
+    {
+        return 0;
+    }
+    switch(bitpix)
+    {
+        case -32:
+            datatype = _DATATYPE_FLOAT;
+            typesize = 4;
+            break;
+        case -64:
+            datatype = _DATATYPE_DOUBLE;
+            typesize = 8;
+            break;
+        case 16:
+            datatype = _DATATYPE_UINT16;
+            typesize = 2;
+            signmask = 0x8000;
+            break;
+        case 32:
+            datatype = _DATATYPE_INT32;
+            typesize = 4;
+            break;
+        case 64:
+            datatype = _DATATYPE_INT64;
+            typesize = 8;
+            break;
+        default:
+            return 0;
+    }
+    if(bzero != ((signmask == 0) ? 0.0 : 32768.0))
+    {
+        return 0;
+    }
+
+    // plain file name only, no extended syntax
+    if(strpbrk(file_name, "[]") != NULL)
+    {
+        return 0;
+    }
+
+    LONGLONG headstart;
+    LONGLONG datastart;
+    LONGLONG dataend;
+    {
+        int status = 0;
+        int iscomp = fits_is_compressed_image(fptr, &status);
+        fits_get_hduaddrll(fptr, &headstart, &datastart, &dataend, &status);
+        if((status != 0) || (iscomp != 0))
+        {
+            return 0;
+        }
+    }
+    size_t datasize = (size_t) nelements * typesize;
+
+    int fd = open(file_name, O_RDONLY);
+    if(fd == -1)
+    {
+        return 0;
+    }
+    struct stat st;
+    if((fstat(fd, &st) != 0) ||
+            ((off_t)(datastart + datasize) > st.st_size))
+    {
+        close(fd);
+        return 0;
+    }
+    {
+        // HDU is at the offsets cfitsio reports, in the file itself
+        // (not the case for files cfitsio uncompressed on the fly)
+        char card[8];
+        if((pread(fd, card, 8, headstart) != 8) ||
+                ((strncmp(card, "SIMPLE  ", 8) != 0) &&
+                 (strncmp(card, "XTENSION", 8) != 0)))
+        {
+            close(fd);
+            return 0;
+        }
+    }
+
+    // mapping offset is page-aligned, data unit is 2880-aligned
+    long   pagesize = sysconf(_SC_PAGESIZE);
+    off_t  mapstart = (datastart / pagesize) * pagesize;
+    size_t maplen   = (size_t)(datastart - mapstart) + datasize;
+
+    int zerocopy = (mapmode == LOADFITS_MAPMODE_ZEROCOPY) &&
+                   (data.SHARED_DFT == 0) && (image_ID(ID_name) == -1);
+
+    char *map = (char *) mmap(NULL,
+                              maplen,
+                              zerocopy ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                              MAP_PRIVATE,
+                              fd,
+                              mapstart);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        return 0;
+    }
+
+    char *mdata = map + (datastart - mapstart);
+
+    if(create_image_ID(ID_name,
+                       naxis,
+                       naxes,
+                       datatype,
+                       data.SHARED_DFT,
+                       NB_KEYWNODE_MAX,
+                       0,
+                       ID) != RETURN_SUCCESS)
+    {
+        munmap(map, maplen);
+        return 0;
+    }
+
+    if(zerocopy)
+    {
+        loadfits_convert(mdata, mdata, nelements, typesize, signmask);
+        if(image_mmap_attach(*ID, map, maplen, mdata) != RETURN_SUCCESS)
+        {
+            // image keeps its allocated array
+            loadfits_convert(data.image[*ID].array.raw,
+                             mdata,
+                             nelements,
+                             typesize,
+                             0);
+            munmap(map, maplen);
+        }
+    }
+    else
+    {
+        madvise(map, maplen, MADV_SEQUENTIAL);
+        loadfits_convert(data.image[*ID].array.raw,
+                         mdata,
+                         nelements,
+                         typesize,
+                         signmask);
+        munmap(map, maplen);
+    }
+
+    return 1;
+}
+
 /// errmode values :
 /// LOADFITS_ERRMODE_IGNORE  (0) print warning, do not show error messages, continue
 /// LOADFITS_ERRMODE_WARNING (1) print error, continue
 /// LOADFITS_ERRMODE_ERROR   (2) return error
 /// LOADFITS_ERRMODE_EXIT    (3) exit program at error
 
-errno_t load_fits(
+errno_t load_fits_opt(
     const char * __restrict file_name,
     const char * __restrict ID_name,
     int      errmode,
+    int      mapmode,
     imageID *IDout
 )
 {
@@ -288,8 +588,24 @@ errno_t load_fits(
         nelements *= naxes[i];
     }
 
+    int loaded = 0;
+    if(mapmode != LOADFITS_MAPMODE_CFITSIO)
+    {
+        loaded = loadfits_map(fptr,
+                              file_name,
+                              ID_name,
+                              bitpix,
+                              bscale,
+                              bzero,
+                              naxis,
+                              naxes,
+                              nelements,
+                              mapmode,
+                              &ID);
+    }
+
     /* bitpix = -32  TFLOAT */
-    if(bitpix == -32)
+    if((loaded == 0) && (bitpix == -32))
     {
         create_image_ID(ID_name,
                         naxis,
@@ -318,7 +634,7 @@ errno_t load_fits(
     }
 
     /* bitpix = -64  TDOUBLE */
-    if(bitpix == -64)
+    if((loaded == 0) && (bitpix == -64))
     {
         create_image_ID(ID_name,
                         naxis,
@@ -347,7 +663,7 @@ errno_t load_fits(
     }
 
     /* bitpix = 16   TSHORT */
-    if(bitpix == 16)
+    if((loaded == 0) && (bitpix == 16))
     {
         // ID = create_image_ID(ID_name, naxis, naxes, Dtype, data.SHARED_DFT, data.NBKEWORD_DFT);
         create_image_ID(ID_name,
@@ -378,7 +694,7 @@ errno_t load_fits(
     }
 
     /* bitpix = 32   TLONG */
-    if(bitpix == 32)
+    if((loaded == 0) && (bitpix == 32))
     {
         create_image_ID(ID_name,
                         naxis,
@@ -420,7 +736,7 @@ errno_t load_fits(
     }
 
     /* bitpix = 64   TLONG  */
-    if(bitpix == 64)
+    if((loaded == 0) && (bitpix == 64))
     {
         create_image_ID(ID_name,
                         naxis,
@@ -463,7 +779,7 @@ errno_t load_fits(
     }
 
     /* bitpix = 8   TBYTE */
-    if(bitpix == 8)
+    if((loaded == 0) && (bitpix == 8))
     {
         create_image_ID(ID_name,
                         naxis,
@@ -626,13 +942,38 @@ errno_t load_fits(
 
 
 
+errno_t load_fits(
+    const char * __restrict file_name,
+    const char * __restrict ID_name,
+    int      errmode,
+    imageID *IDout
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    FUNC_CHECK_RETURN(load_fits_opt(file_name,
+                                    ID_name,
+                                    errmode,
+                                    LOADFITS_MAPMODE_COPY,
+                                    IDout));
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
 static errno_t compute_function()
 {
     DEBUG_TRACE_FSTART();
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_START
 
-    FUNC_CHECK_RETURN(load_fits(infilename, outimname, *FITSIOerrmode, NULL));
+    FUNC_CHECK_RETURN(load_fits_opt(infilename,
+                                    outimname,
+                                    *FITSIOerrmode,
+                                    *mapmode,
+                                    NULL));
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
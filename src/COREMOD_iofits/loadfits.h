@@ -10,6 +10,11 @@
 #define LOADFITS_ERRMODE_ERROR   2
 #define LOADFITS_ERRMODE_EXIT    3
 
+// data unit read
+#define LOADFITS_MAPMODE_CFITSIO  0 // fits_read_img
+#define LOADFITS_MAPMODE_COPY     1 // mmap, convert into image
+#define LOADFITS_MAPMODE_ZEROCOPY 2 // mmap is local image array
+
 errno_t CLIADDCMD_COREMOD_iofits__loadfits();
 
 errno_t load_fits(const char *restrict file_name,
@@ -17,4 +22,16 @@ errno_t load_fits(const char *restrict file_name,
                   int      errmode,
                   imageID *ID);
 
+errno_t load_fits_opt(const char *restrict file_name,
+                      const char *restrict ID_name,
+                      int      errmode,
+                      int      mapmode,
+                      imageID *ID);
+
+void loadfits_convert(void       *dst,
+                      const void *src,
+                      long        nelem,
+                      int         typesize,
+                      uint64_t    signmask);
+
 #endif
@@ -17,6 +17,7 @@
 #include "check_fitsio_status.h"
 #include "file_exists.h"
 #include "is_fits_file.h"
+#include "savefits_parallel.h"
 
 extern COREMOD_IOFITS_DATA COREMOD_iofits_data;
 
@@ -25,6 +26,7 @@ static char *inimname;
 static char *outfname;
 static int  *outbitpix;
 static char *inheader; // import header from this file
+static uint32_t *NBthread;
 
 
 
@@ -68,6 +70,15 @@ static CLICMDARGDEF farg[] = {{
         CLIARG_HIDDEN_DEFAULT,
         (void **) &inheader,
         NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".NBthread",
+        "writer threads, 0: cfitsio (requires bitpix 0)",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &NBthread,
+        NULL
     }
 };
 
@@ -93,246 +104,27 @@ static errno_t help_function()
 
 
 /**
- * @brief Write FITS file - wrapper kept for backwards compatibility before introducing
- * optional input image truncation
+ * @brief Write image keywords to FITS header
  *
- * @param inputimname       input image name
- * @param truncate          truncate input image to truncate first slices - -1 to ignore
- * @param outputFITSname    output FITS file name
- * @param outputbitpix      bitpix of output image. 0 if match input
+ * Keywords are imported from importheaderfile (optional), then from
+ * image keywords, then from kwarray (optional).
+ *
+ * @param fptr              FITS file, current HDU
+ * @param imgin             input image
  * @param importheaderfile  optional FITS file from which to read keywords
  * @param kwarray           optional keyword array. Set to NULL if unused
- * @param kwarraysize       number of keywords in optional keyword array. Set to 0 if unused.
- * @param FITSIOext         extension to pass instructions to FITSIO
+ * @param kwarraysize       number of keywords in optional keyword array
  * @return errno_t
  */
-errno_t saveFITS_opt_trunc(
-    const char *__restrict inputimname,
-    int truncate,
-    const char *__restrict outputFITSname,
-    int outputbitpix,
+errno_t saveFITS_write_keywords(
+    fitsfile *fptr,
+    IMGID    *imgin,
     const char *__restrict importheaderfile,
     IMAGE_KEYWORD *kwarray,
-    int            kwarraysize,
-    const char *__restrict FITSIOext
+    int            kwarraysize
 )
 {
-
-
     DEBUG_TRACE_FSTART();
-    DEBUG_TRACEPOINT("Saving image %s to file %s, bitpix = %d, slice truncation %d\n",
-           inputimname,
-           outputFITSname,
-           outputbitpix,
-           truncate);
-
-    COREMOD_iofits_data.FITSIO_status = 0;
-
-    // get PID to include in file name, so that file name is unique
-    pthread_t self_id = pthread_self();
-
-    char fnametmp[STRINGMAXLEN_FILENAME];
-
-    DEBUG_TRACEPOINT(">> saving %s to %s\n", inputimname, outputFITSname);
-    /*
-        WRITE_FILENAME(fnametmp,
-                       "_savefits_atomic_%s_%d_%ld.tmp.fits",
-                       inputimname,
-                       (int) getpid(),
-                       (long) self_id);
-    */
-
-    WRITE_FILENAME(fnametmp,
-                   "%s.%d.%ld.tmp",
-                   outputFITSname,
-                   (int) getpid(),
-                   (long) self_id);
-    DEBUG_TRACEPOINT("temp name : %s\n", fnametmp);
-
-    // extended filename to pass instructions to FITSIO
-    // For example, FITSIOext = [compress R 1,1,10000]
-    char fnametmpext[STRINGMAXLEN_FILENAME];
-    WRITE_FILENAME(fnametmpext,
-                   "%s%s",
-                   fnametmp,
-                   FITSIOext
-                  );
-
-    IMGID imgin = mkIMGID_from_name(inputimname);
-    resolveIMGID(&imgin, ERRMODE_WARN);
-    if(imgin.ID == -1)
-    {
-        PRINT_WARNING("Image %s does not exist in memory - cannot save to FITS",
-                      inputimname);
-        DEBUG_TRACE_FEXIT();
-        return RETURN_SUCCESS;
-    }
-
-    // data types
-    uint8_t datatype       = imgin.md->datatype;
-    char *datainptr = (char *) imgin.im->array.raw;
-
-    // default
-    int     bitpix = FLOAT_IMG;
-
-    switch( outputbitpix )
-    {
-    case 8:
-        bitpix = BYTE_IMG;
-        DEBUG_TRACEPOINT("    output data type: BYTE_IMG\n");
-        break;
-    case 10:
-        bitpix = SBYTE_IMG;
-        DEBUG_TRACEPOINT("    output data type: SBYTE_IMG\n");
-        break;
-
-    case 16:
-        bitpix = SHORT_IMG;
-        DEBUG_TRACEPOINT("    output data type: SHORT_IMG\n");
-        break;
-    case 20:
-        bitpix = USHORT_IMG;
-        DEBUG_TRACEPOINT("    output data type: USHORT_IMG\n");
-        break;
-
-    case 32:
-        bitpix = LONG_IMG;
-        DEBUG_TRACEPOINT("    output data type: LONG_IMG\n");
-        break;
-    case 40:
-        bitpix = ULONG_IMG;
-        DEBUG_TRACEPOINT("    output data type: ULONG_IMG\n");
-        break;
-
-    case 64:
-        bitpix = LONGLONG_IMG;
-        DEBUG_TRACEPOINT("    output data type: LONGLONG_IMG\n");
-        break;
-    case 80:
-        bitpix = ULONGLONG_IMG;
-        DEBUG_TRACEPOINT("    output data type: ULONGLONG_IMG\n");
-        break;
-
-    case -32:
-        bitpix = FLOAT_IMG;
-        DEBUG_TRACEPOINT("    output data type: FLOAT_IMG\n");
-        break;
-    case -64:
-        bitpix = DOUBLE_IMG;
-        DEBUG_TRACEPOINT("    output data type: DOUBLE_IMG\n");
-        break;
-    }
-
-    if(outputbitpix == 0)
-    {
-        // match input
-        switch(datatype)
-        {
-
-        case _DATATYPE_INT8:
-            bitpix = SBYTE_IMG;
-            break;
-
-        case _DATATYPE_UINT8:
-            bitpix = BYTE_IMG;
-            break;
-
-
-        case _DATATYPE_INT16:
-            bitpix = SHORT_IMG;
-            break;
-
-        case _DATATYPE_UINT16:
-            bitpix = USHORT_IMG;
-            break;
-
-        case _DATATYPE_INT32:
-            bitpix = LONG_IMG;
-            break;
-
-        case _DATATYPE_UINT32:
-            bitpix = ULONG_IMG;
-            break;
-
-        case _DATATYPE_INT64:
-            bitpix = LONGLONG_IMG;
-            break;
-
-        case _DATATYPE_UINT64:
-            bitpix = ULONGLONG_IMG;
-            break;
-
-        case _DATATYPE_FLOAT:
-            bitpix = FLOAT_IMG;
-            break;
-
-
-        case _DATATYPE_DOUBLE:
-            bitpix = DOUBLE_IMG;
-            break;
-
-        default:
-            bitpix = FLOAT_IMG;
-            break;
-
-        }
-    }
-
-
-
-    DEBUG_TRACEPOINT("%d -> bitpix = %d\n", outputbitpix, bitpix);
-    fflush(stdout);
-
-    fitsfile *fptr;
-    COREMOD_iofits_data.FITSIO_status = 0;
-    DEBUG_TRACEPOINT("creating FITS file %s", fnametmpext);
-    fits_create_file(&fptr, fnametmpext, &COREMOD_iofits_data.FITSIO_status);
-    DEBUG_TRACEPOINT(" ");
-
-    if(check_FITSIO_status(__FILE__, __func__, __LINE__, 1) != 0)
-    {
-        char errstring[200];
-        if(access(fnametmp, F_OK) == 0)
-        {
-            snprintf(errstring, 200, "File already exists");
-        }
-        PRINT_ERROR("fits_create_file error %d on file %s %s",
-                    COREMOD_iofits_data.FITSIO_status,
-                    fnametmpext,
-                    errstring);
-        abort();
-    }
-
-    int  naxis = imgin.md->naxis;
-    long nelements = 1;
-    long naxesl[3];
-    for(int i = 0; i < naxis; i++)
-    {
-        naxesl[i] = (long) imgin.md->size[i];
-        nelements *= naxesl[i];
-        DEBUG_TRACEPOINT("-------------- SIZE %d = %ld\n", i, naxesl[i]);
-    }
-    if(truncate >= 0)
-    {
-        naxesl[naxis - 1] = truncate;
-        DEBUG_TRACEPOINT("-------------- TRUNCATE TO %d\n", truncate);
-    }
-
-
-    //printf(">>>>>>>> bitpix = %d\n", bitpix);
-    COREMOD_iofits_data.FITSIO_status = 0;
-    fits_create_img(fptr,
-                    bitpix,
-                    naxis,
-                    naxesl,
-                    &COREMOD_iofits_data.FITSIO_status);
-    if(check_FITSIO_status(__FILE__, __func__, __LINE__, 1) != 0)
-    {
-        PRINT_ERROR("fits_create_img error on file %s", fnametmpext);
-        EXECUTE_SYSTEM_COMMAND("rm %s", fnametmp);
-        FUNC_RETURN_FAILURE(" ");
-    }
-
 
     DEBUG_TRACEPOINT("Adding optional header");
     // HEADER
@@ -453,12 +245,12 @@ errno_t saveFITS_opt_trunc(
     // These are technical keywords that shouldn't be propagated to FITS.
 
     {
-        int NBkw  = imgin.md->NBkw;
+        int NBkw  = imgin->md->NBkw;
         int kwcnt = 0;
         DEBUG_TRACEPOINT("----------- NUMBER KW = %d ---------------\n", NBkw);
         for(int kw = 0; kw < NBkw; kw++)
         {
-            if(imgin.im->kw[kw].name[0] == '_')
+            if(imgin->im->kw[kw].name[0] == '_')
             {
                 // Skip keywords that start with a "_"
                 continue;
@@ -467,44 +259,44 @@ errno_t saveFITS_opt_trunc(
             char tmpkwvalstr[81];
             // Don't rely on the stream keyword type, but instead rely
             // On the existing type in the auxfitsheader. If any at all?
-            switch(imgin.im->kw[kw].type)
+            switch(imgin->im->kw[kw].type)
             {
             case 'L':
                 DEBUG_TRACEPOINT("writing keyword [L] %-8s= %20ld / %s\n",
-                       imgin.im->kw[kw].name,
-                       imgin.im->kw[kw].value.numl,
-                       imgin.im->kw[kw].comment);
+                       imgin->im->kw[kw].name,
+                       imgin->im->kw[kw].value.numl,
+                       imgin->im->kw[kw].comment);
                 COREMOD_iofits_data.FITSIO_status = 0;
                 fits_update_key(fptr,
                                 TLONG,
-                                imgin.im->kw[kw].name,
-                                &imgin.im->kw[kw].value.numl,
-                                imgin.im->kw[kw].comment,
+                                imgin->im->kw[kw].name,
+                                &imgin->im->kw[kw].value.numl,
+                                imgin->im->kw[kw].comment,
                                 &COREMOD_iofits_data.FITSIO_status);
                 kwcnt++;
                 break;
 
             case 'D':
                 DEBUG_TRACEPOINT("writing keyword [D] %-8s= %20g / %s\n",
-                       imgin.im->kw[kw].name,
-                       imgin.im->kw[kw].value.numf,
-                       imgin.im->kw[kw].comment);
+                       imgin->im->kw[kw].name,
+                       imgin->im->kw[kw].value.numf,
+                       imgin->im->kw[kw].comment);
                 COREMOD_iofits_data.FITSIO_status = 0;
                 fits_update_key(fptr,
                                 TDOUBLE,
-                                imgin.im->kw[kw].name,
-                                &imgin.im->kw[kw].value.numf,
-                                imgin.im->kw[kw].comment,
+                                imgin->im->kw[kw].name,
+                                &imgin->im->kw[kw].value.numf,
+                                imgin->im->kw[kw].comment,
                                 &COREMOD_iofits_data.FITSIO_status);
                 kwcnt++;
                 break;
 
             case 'S':
-                snprintf(tmpkwvalstr, 81, "'%s'", imgin.im->kw[kw].value.valstr);
+                snprintf(tmpkwvalstr, 81, "'%s'", imgin->im->kw[kw].value.valstr);
                 DEBUG_TRACEPOINT("writing keyword [S] %-8s= %20s / %s\n",
-                       imgin.im->kw[kw].name,
+                       imgin->im->kw[kw].name,
                        tmpkwvalstr,
-                       imgin.im->kw[kw].comment);
+                       imgin->im->kw[kw].comment);
                 COREMOD_iofits_data.FITSIO_status = 0;
                 // MIND THAT WE ADDED SINGLE QUOTES JUST ABOVE IN snprintf!!
                 if((strncmp("'#TRUE#'", tmpkwvalstr, 8) == 0) ||
@@ -515,9 +307,9 @@ errno_t saveFITS_opt_trunc(
                         strncmp("'#TRUE#'", tmpkwvalstr, 6) == 0;
                     fits_update_key(fptr,
                                     TLOGICAL,
-                                    imgin.im->kw[kw].name,
+                                    imgin->im->kw[kw].name,
                                     &tmpval_is_true,
-                                    imgin.im->kw[kw].comment,
+                                    imgin->im->kw[kw].comment,
                                     &COREMOD_iofits_data.FITSIO_status);
                 }
                 else
@@ -525,9 +317,9 @@ errno_t saveFITS_opt_trunc(
                     // Normal string
                     fits_update_key(fptr,
                                     TSTRING,
-                                    imgin.im->kw[kw].name,
-                                    imgin.im->kw[kw].value.valstr,
-                                    imgin.im->kw[kw].comment,
+                                    imgin->im->kw[kw].name,
+                                    imgin->im->kw[kw].value.valstr,
+                                    imgin->im->kw[kw].comment,
                                     &COREMOD_iofits_data.FITSIO_status);
                 }
                 kwcnt++;
@@ -540,7 +332,7 @@ errno_t saveFITS_opt_trunc(
             if(check_FITSIO_status(__FILE__, __func__, __LINE__, 1) != 0)
             {
                 PRINT_ERROR("fits_write_record error on keyword %s",
-                            imgin.im->kw[kw].name);
+                            imgin->im->kw[kw].name);
                 abort();
             }
         }
@@ -609,6 +401,260 @@ errno_t saveFITS_opt_trunc(
         }
     }
 
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+/**
+ * @brief Write FITS file - wrapper kept for backwards compatibility before introducing
+ * optional input image truncation
+ *
+ * @param inputimname       input image name
+ * @param truncate          truncate input image to truncate first slices - -1 to ignore
+ * @param outputFITSname    output FITS file name
+ * @param outputbitpix      bitpix of output image. 0 if match input
+ * @param importheaderfile  optional FITS file from which to read keywords
+ * @param kwarray           optional keyword array. Set to NULL if unused
+ * @param kwarraysize       number of keywords in optional keyword array. Set to 0 if unused.
+ * @param FITSIOext         extension to pass instructions to FITSIO
+ * @return errno_t
+ */
+errno_t saveFITS_opt_trunc(
+    const char *__restrict inputimname,
+    int truncate,
+    const char *__restrict outputFITSname,
+    int outputbitpix,
+    const char *__restrict importheaderfile,
+    IMAGE_KEYWORD *kwarray,
+    int            kwarraysize,
+    const char *__restrict FITSIOext
+)
+{
+
+
+    DEBUG_TRACE_FSTART();
+    DEBUG_TRACEPOINT("Saving image %s to file %s, bitpix = %d, slice truncation %d\n",
+           inputimname,
+           outputFITSname,
+           outputbitpix,
+           truncate);
+
+    COREMOD_iofits_data.FITSIO_status = 0;
+
+    // get PID to include in file name, so that file name is unique
+    pthread_t self_id = pthread_self();
+
+    char fnametmp[STRINGMAXLEN_FILENAME];
+
+    DEBUG_TRACEPOINT(">> saving %s to %s\n", inputimname, outputFITSname);
+    /*
+        WRITE_FILENAME(fnametmp,
+                       "_savefits_atomic_%s_%d_%ld.tmp.fits",
+                       inputimname,
+                       (int) getpid(),
+                       (long) self_id);
+    */
+
+    WRITE_FILENAME(fnametmp,
+                   "%s.%d.%ld.tmp",
+                   outputFITSname,
+                   (int) getpid(),
+                   (long) self_id);
+    DEBUG_TRACEPOINT("temp name : %s\n", fnametmp);
+
+    // extended filename to pass instructions to FITSIO
+    // For example, FITSIOext = [compress R 1,1,10000]
+    char fnametmpext[STRINGMAXLEN_FILENAME];
+    WRITE_FILENAME(fnametmpext,
+                   "%s%s",
+                   fnametmp,
+                   FITSIOext
+                  );
+
+    IMGID imgin = mkIMGID_from_name(inputimname);
+    resolveIMGID(&imgin, ERRMODE_WARN);
+    if(imgin.ID == -1)
+    {
+        PRINT_WARNING("Image %s does not exist in memory - cannot save to FITS",
+                      inputimname);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+
+    // data types
+    uint8_t datatype       = imgin.md->datatype;
+    char *datainptr = (char *) imgin.im->array.raw;
+
+    // default
+    int     bitpix = FLOAT_IMG;
+
+    switch( outputbitpix )
+    {
+    case 8:
+        bitpix = BYTE_IMG;
+        DEBUG_TRACEPOINT("    output data type: BYTE_IMG\n");
+        break;
+    case 10:
+        bitpix = SBYTE_IMG;
+        DEBUG_TRACEPOINT("    output data type: SBYTE_IMG\n");
+        break;
+
+    case 16:
+        bitpix = SHORT_IMG;
+        DEBUG_TRACEPOINT("    output data type: SHORT_IMG\n");
+        break;
+    case 20:
+        bitpix = USHORT_IMG;
+        DEBUG_TRACEPOINT("    output data type: USHORT_IMG\n");
+        break;
+
+    case 32:
+        bitpix = LONG_IMG;
+        DEBUG_TRACEPOINT("    output data type: LONG_IMG\n");
+        break;
+    case 40:
+        bitpix = ULONG_IMG;
+        DEBUG_TRACEPOINT("    output data type: ULONG_IMG\n");
+        break;
+
+    case 64:
+        bitpix = LONGLONG_IMG;
+        DEBUG_TRACEPOINT("    output data type: LONGLONG_IMG\n");
+        break;
+    case 80:
+        bitpix = ULONGLONG_IMG;
+        DEBUG_TRACEPOINT("    output data type: ULONGLONG_IMG\n");
+        break;
+
+    case -32:
+        bitpix = FLOAT_IMG;
+        DEBUG_TRACEPOINT("    output data type: FLOAT_IMG\n");
+        break;
+    case -64:
+        bitpix = DOUBLE_IMG;
+        DEBUG_TRACEPOINT("    output data type: DOUBLE_IMG\n");
+        break;
+    }
+
+    if(outputbitpix == 0)
+    {
+        // match input
+        switch(datatype)
+        {
+
+        case _DATATYPE_INT8:
+            bitpix = SBYTE_IMG;
+            break;
+
+        case _DATATYPE_UINT8:
+            bitpix = BYTE_IMG;
+            break;
+
+
+        case _DATATYPE_INT16:
+            bitpix = SHORT_IMG;
+            break;
+
+        case _DATATYPE_UINT16:
+            bitpix = USHORT_IMG;
+            break;
+
+        case _DATATYPE_INT32:
+            bitpix = LONG_IMG;
+            break;
+
+        case _DATATYPE_UINT32:
+            bitpix = ULONG_IMG;
+            break;
+
+        case _DATATYPE_INT64:
+            bitpix = LONGLONG_IMG;
+            break;
+
+        case _DATATYPE_UINT64:
+            bitpix = ULONGLONG_IMG;
+            break;
+
+        case _DATATYPE_FLOAT:
+            bitpix = FLOAT_IMG;
+            break;
+
+
+        case _DATATYPE_DOUBLE:
+            bitpix = DOUBLE_IMG;
+            break;
+
+        default:
+            bitpix = FLOAT_IMG;
+            break;
+
+        }
+    }
+
+
+
+    DEBUG_TRACEPOINT("%d -> bitpix = %d\n", outputbitpix, bitpix);
+    fflush(stdout);
+
+    fitsfile *fptr;
+    COREMOD_iofits_data.FITSIO_status = 0;
+    DEBUG_TRACEPOINT("creating FITS file %s", fnametmpext);
+    fits_create_file(&fptr, fnametmpext, &COREMOD_iofits_data.FITSIO_status);
+    DEBUG_TRACEPOINT(" ");
+
+    if(check_FITSIO_status(__FILE__, __func__, __LINE__, 1) != 0)
+    {
+        char errstring[200];
+        if(access(fnametmp, F_OK) == 0)
+        {
+            snprintf(errstring, 200, "File already exists");
+        }
+        PRINT_ERROR("fits_create_file error %d on file %s %s",
+                    COREMOD_iofits_data.FITSIO_status,
+                    fnametmpext,
+                    errstring);
+        abort();
+    }
+
+    int  naxis = imgin.md->naxis;
+    long nelements = 1;
+    long naxesl[3];
+    for(int i = 0; i < naxis; i++)
+    {
+        naxesl[i] = (long) imgin.md->size[i];
+        nelements *= naxesl[i];
+        DEBUG_TRACEPOINT("-------------- SIZE %d = %ld\n", i, naxesl[i]);
+    }
+    if(truncate >= 0)
+    {
+        naxesl[naxis - 1] = truncate;
+        DEBUG_TRACEPOINT("-------------- TRUNCATE TO %d\n", truncate);
+    }
+
+
+    //printf(">>>>>>>> bitpix = %d\n", bitpix);
+    COREMOD_iofits_data.FITSIO_status = 0;
+    fits_create_img(fptr,
+                    bitpix,
+                    naxis,
+                    naxesl,
+                    &COREMOD_iofits_data.FITSIO_status);
+    if(check_FITSIO_status(__FILE__, __func__, __LINE__, 1) != 0)
+    {
+        PRINT_ERROR("fits_create_img error on file %s", fnametmpext);
+        EXECUTE_SYSTEM_COMMAND("rm %s", fnametmp);
+        FUNC_RETURN_FAILURE(" ");
+    }
+
+
+    FUNC_CHECK_RETURN(saveFITS_write_keywords(fptr,
+                      &imgin,
+                      importheaderfile,
+                      kwarray,
+                      kwarraysize));
+
     // default (for floats, signed)
     float bscaleval = 1.0;
     float bzeroval  = 0.0;
@@ -814,7 +860,21 @@ static errno_t compute_function()
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_START
 
-    saveFITS(inimname, outfname, *outbitpix, inheader, NULL, 0);
+    if((*NBthread > 0) && (*outbitpix == 0))
+    {
+        saveFITS_parallel(inimname,
+                          -1,
+                          outfname,
+                          inheader,
+                          NULL,
+                          0,
+                          "",
+                          *NBthread);
+    }
+    else
+    {
+        saveFITS(inimname, outfname, *outbitpix, inheader, NULL, 0);
+    }
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
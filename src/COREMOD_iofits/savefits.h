@@ -5,10 +5,18 @@
 #ifndef MILK_COREMOD_IOFITS_SAVEFITS_H
 #define MILK_COREMOD_IOFITS_SAVEFITS_H
 
+#include <fitsio.h>
+
 //errno_t savefits_addCLIcmd();
 
 errno_t CLIADDCMD_COREMOD_iofits__saveFITS();
 
+errno_t saveFITS_write_keywords(fitsfile *fptr,
+                                IMGID    *imgin,
+                                const char *__restrict importheaderfile,
+                                IMAGE_KEYWORD *kwarray,
+                                int            kwarraysize);
+
 errno_t saveFITS(const char *__restrict inputimname,
                  const char *__restrict outputFITSname,
                  int outputbitpix,
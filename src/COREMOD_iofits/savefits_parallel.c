@@ -0,0 +1,1113 @@
+/**
+ * @file    savefits_parallel.c
+ * @brief   multithreaded FITS writer
+ *
+ * Alternative to saveFITS_opt_trunc for large cubes. The image is split
+ * in jobs processed by a pool of worker threads, and job outputs are
+ * written in order by the calling thread:
+ *
+ *   uncompressed : jobs are contiguous chunks, converted to FITS byte
+ *                  order, written with large write() calls instead of
+ *                  cfitsio buffered I/O
+ *   compressed   : jobs are tiles, FITS tiled image convention (binary
+ *                  table extension, one compressed tile per row)
+ *
+ * Header keywords are the same as saveFITS_opt_trunc: cards are produced
+ * by saveFITS_write_keywords in a cfitsio memory file, and copied.
+ *
+ * Compression, selected by FITSIOext "[compress <type> <tile>]" as for
+ * cfitsio, for integer types :
+ *   R, RICE : RICE_1, up to 32 bit, requires cfitsio RICE encoder
+ *             (fits_rcomp, declared in fitsio2.h, USE_FITS_RCOMP)
+ *   G, GZIP : GZIP_1, requires zlib (USE_ZLIB)
+ * Tile sizes default to one image row. Other cases, including float
+ * types, are handed to saveFITS_opt_trunc.
+ *
+ * The number of jobs in flight is bounded, so that memory use does not
+ * scale with image size.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "CommandLineInterface/CLIcore.h"
+
+#ifdef USE_FITS_RCOMP
+// not part of public cfitsio API, detected at configure time
+#include <fitsio2.h>
+#endif
+
+// Handle old fitsios
+#ifndef ULONGLONG_IMG
+#define ULONGLONG_IMG (80)
+#endif
+
+#include "COREMOD_iofits_common.h"
+#include "check_fitsio_status.h"
+#include "savefits.h"
+#include "savefits_parallel.h"
+
+extern COREMOD_IOFITS_DATA COREMOD_iofits_data;
+
+// uncompressed job size [byte]
+#define SAVEFITSPAR_CHUNKSIZE (4 * 1024 * 1024)
+
+// write buffer size [byte]
+#define SAVEFITSPAR_WRITESIZE (16 * 1024 * 1024)
+
+// max jobs in flight per worker
+#define SAVEFITSPAR_WINDOW 16
+
+#define SAVEFITSPAR_CODEC_NONE 0
+#define SAVEFITSPAR_CODEC_RICE 1
+#define SAVEFITSPAR_CODEC_GZIP 2
+
+#define SAVEFITSPAR_RICE_BLOCKSIZE 32
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SAVEFITSPAR_BSWAP16(x) (x)
+#define SAVEFITSPAR_BSWAP32(x) (x)
+#define SAVEFITSPAR_BSWAP64(x) (x)
+#else
+#define SAVEFITSPAR_BSWAP16(x) __builtin_bswap16(x)
+#define SAVEFITSPAR_BSWAP32(x) __builtin_bswap32(x)
+#define SAVEFITSPAR_BSWAP64(x) __builtin_bswap64(x)
+#endif
+
+typedef struct
+{
+    // input
+    const char *src;
+    int         typesize;
+    uint64_t    signmask; // sign bit flipped for types with BZERO
+    int         codec;
+    long        naxes[3]; // 1 for missing axes
+    long        tile[3];
+    long        ntile[3];
+    long        nelem;
+
+    long NBjob;
+    long chunkelem; // uncompressed: elements per job
+    long jobrawmax; // max job input [byte]
+    long joboutmax; // max job output [byte]
+
+    // job output slots, job j in slot j % NBslot
+    long   NBslot;
+    char **slotbuf;
+    long  *slotlen; // output size, -1 on error
+    int   *slotdone;
+
+    long jobnext;    // next job to be taken by a worker
+    long jobwritten; // jobs written
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} SAVEFITSPAR;
+
+/**
+ * @brief FITS representation of image datatype
+ *
+ * Unsigned integer types other than uint8, and int8, are stored as the
+ * FITS signed type with offset BZERO, which amounts to flipping the sign
+ * bit.
+ *
+ * @return 0 if OK, 1 if datatype not supported
+ */
+static int savefitspar_fitstype(uint8_t   datatype,
+                                int      *imgtype,
+                                int      *bitpix,
+                                uint64_t *signmask,
+                                char     *bzero,
+                                int      *isint)
+{
+    *signmask = 0;
+    *isint    = 1;
+    bzero[0]  = '\0';
+
+    switch(datatype)
+    {
+        case _DATATYPE_UINT8:
+            *imgtype = BYTE_IMG;
+            *bitpix  = 8;
+            break;
+        case _DATATYPE_INT8:
+            *imgtype  = SBYTE_IMG;
+            *bitpix   = 8;
+            *signmask = 0x80;
+            strcpy(bzero, "-128");
+            break;
+        case _DATATYPE_UINT16:
+            *imgtype  = USHORT_IMG;
+            *bitpix   = 16;
+            *signmask = 0x8000;
+            strcpy(bzero, "32768");
+            break;
+        case _DATATYPE_INT16:
+            *imgtype = SHORT_IMG;
+            *bitpix  = 16;
+            break;
+        case _DATATYPE_UINT32:
+            *imgtype  = ULONG_IMG;
+            *bitpix   = 32;
+            *signmask = 0x80000000;
+            strcpy(bzero, "2147483648");
+            break;
+        case _DATATYPE_INT32:
+            *imgtype = LONG_IMG;
+            *bitpix  = 32;
+            break;
+        case _DATATYPE_UINT64:
+            *imgtype  = ULONGLONG_IMG;
+            *bitpix   = 64;
+            *signmask = 0x8000000000000000;
+            strcpy(bzero, "9223372036854775808");
+            break;
+        case _DATATYPE_INT64:
+            *imgtype = LONGLONG_IMG;
+            *bitpix  = 64;
+            break;
+        case _DATATYPE_FLOAT:
+            *imgtype = FLOAT_IMG;
+            *bitpix  = -32;
+            *isint   = 0;
+            break;
+        case _DATATYPE_DOUBLE:
+            *imgtype = DOUBLE_IMG;
+            *bitpix  = -64;
+            *isint   = 0;
+            break;
+        default:
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Convert elements to FITS representation
+ *
+ * @param bigendian  1 for FITS byte order, 0 for native (Rice input)
+ */
+static void savefitspar_convert(char       *dst,
+                                const char *src,
+                                long        nelem,
+                                int         typesize,
+                                uint64_t    signmask,
+                                int         bigendian)
+{
+    switch(typesize)
+    {
+        case 1:
+        {
+            uint8_t m = (uint8_t) signmask;
+            for(long i = 0; i < nelem; i++)
+            {
+                dst[i] = src[i] ^ m;
+            }
+        }
+        break;
+        case 2:
+        {
+            uint16_t        m = (uint16_t) signmask;
+            uint16_t       *d = (uint16_t *) dst;
+            const uint16_t *s = (const uint16_t *) src;
+            if(bigendian)
+            {
+                for(long i = 0; i < nelem; i++)
+                {
+                    d[i] = SAVEFITSPAR_BSWAP16((uint16_t)(s[i] ^ m));
+                }
+            }
+            else
+            {
+                for(long i = 0; i < nelem; i++)
+                {
+                    d[i] = s[i] ^ m;
+                }
+            }
+        }
+        break;
+        case 4:
+        {
+            uint32_t        m = (uint32_t) signmask;
+            uint32_t       *d = (uint32_t *) dst;
+            const uint32_t *s = (const uint32_t *) src;
+            if(bigendian)
+            {
+                for(long i = 0; i < nelem; i++)
+                {
+                    d[i] = SAVEFITSPAR_BSWAP32(s[i] ^ m);
+                }
+            }
+            else
+            {
+                for(long i = 0; i < nelem; i++)
+                {
+                    d[i] = s[i] ^ m;
+                }
+            }
+        }
+        break;
+        case 8:
+        {
+            uint64_t       *d = (uint64_t *) dst;
+            const uint64_t *s = (const uint64_t *) src;
+            if(bigendian)
+            {
+                for(long i = 0; i < nelem; i++)
+                {
+                    d[i] = SAVEFITSPAR_BSWAP64(s[i] ^ signmask);
+                }
+            }
+            else
+            {
+                for(long i = 0; i < nelem; i++)
+                {
+                    d[i] = s[i] ^ signmask;
+                }
+            }
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Process job into output buffer
+ *
+ * @param scratch  tile buffer, jobrawmax byte
+ * @return output size, -1 on error
+ */
+static long savefitspar_job(SAVEFITSPAR *sfp, long job, char *out, char *scratch)
+{
+    int ts = sfp->typesize;
+
+    if(sfp->codec == SAVEFITSPAR_CODEC_NONE)
+    {
+        long e0 = job * sfp->chunkelem;
+        long ne = sfp->chunkelem;
+        if(e0 + ne > sfp->nelem)
+        {
+            ne = sfp->nelem - e0;
+        }
+        savefitspar_convert(out,
+                            sfp->src + e0 * ts,
+                            ne,
+                            ts,
+                            sfp->signmask,
+                            1);
+        return ne * ts;
+    }
+
+    // tile origin and size
+    long i0 = job % sfp->ntile[0];
+    long i1 = (job / sfp->ntile[0]) % sfp->ntile[1];
+    long i2 = job / (sfp->ntile[0] * sfp->ntile[1]);
+    long o[3];
+    long n[3];
+    o[0] = i0 * sfp->tile[0];
+    o[1] = i1 * sfp->tile[1];
+    o[2] = i2 * sfp->tile[2];
+    for(int a = 0; a < 3; a++)
+    {
+        n[a] = sfp->tile[a];
+        if(o[a] + n[a] > sfp->naxes[a])
+        {
+            n[a] = sfp->naxes[a] - o[a];
+        }
+    }
+
+    int  bigendian = (sfp->codec == SAVEFITSPAR_CODEC_GZIP);
+    long k         = 0;
+    for(long z = o[2]; z < o[2] + n[2]; z++)
+    {
+        for(long y = o[1]; y < o[1] + n[1]; y++)
+        {
+            long e = (z * sfp->naxes[1] + y) * sfp->naxes[0] + o[0];
+            savefitspar_convert(scratch + k * ts,
+                                sfp->src + e * ts,
+                                n[0],
+                                ts,
+                                sfp->signmask,
+                                bigendian);
+            k += n[0];
+        }
+    }
+
+    long len = -1;
+#ifdef USE_FITS_RCOMP
+    if(sfp->codec == SAVEFITSPAR_CODEC_RICE)
+    {
+        unsigned char *c = (unsigned char *) out;
+        switch(ts)
+        {
+            case 1:
+                len = fits_rcomp_byte((signed char *) scratch,
+                                      k,
+                                      c,
+                                      sfp->joboutmax,
+                                      SAVEFITSPAR_RICE_BLOCKSIZE);
+                break;
+            case 2:
+                len = fits_rcomp_short((short *) scratch,
+                                       k,
+                                       c,
+                                       sfp->joboutmax,
+                                       SAVEFITSPAR_RICE_BLOCKSIZE);
+                break;
+            case 4:
+                len = fits_rcomp((int *) scratch,
+                                 k,
+                                 c,
+                                 sfp->joboutmax,
+                                 SAVEFITSPAR_RICE_BLOCKSIZE);
+                break;
+        }
+    }
+#endif
+#ifdef USE_ZLIB
+    if(sfp->codec == SAVEFITSPAR_CODEC_GZIP)
+    {
+        // gzip wrapper (windowBits + 16), as expected by cfitsio
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if(deflateInit2(&zs, 1, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) ==
+                Z_OK)
+        {
+            zs.next_in   = (Bytef *) scratch;
+            zs.avail_in  = k * ts;
+            zs.next_out  = (Bytef *) out;
+            zs.avail_out = sfp->joboutmax;
+            if(deflate(&zs, Z_FINISH) == Z_STREAM_END)
+            {
+                len = zs.total_out;
+            }
+            deflateEnd(&zs);
+        }
+    }
+#endif
+
+    return (len > 0) ? len : -1;
+}
+
+static void *savefitspar_worker(void *ptr)
+{
+    SAVEFITSPAR *sfp = (SAVEFITSPAR *) ptr;
+
+    char *scratch = NULL;
+    if(sfp->codec != SAVEFITSPAR_CODEC_NONE)
+    {
+        scratch = (char *) malloc(sfp->jobrawmax);
+        if(scratch == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+    }
+
+    pthread_mutex_lock(&sfp->lock);
+    for(;;)
+    {
+        while((sfp->jobnext < sfp->NBjob) &&
+                (sfp->jobnext >= sfp->jobwritten + sfp->NBslot))
+        {
+            pthread_cond_wait(&sfp->cond, &sfp->lock);
+        }
+        if(sfp->jobnext >= sfp->NBjob)
+        {
+            break;
+        }
+        long job  = sfp->jobnext;
+        long slot = job % sfp->NBslot;
+        sfp->jobnext++;
+        pthread_mutex_unlock(&sfp->lock);
+
+        long len = savefitspar_job(sfp, job, sfp->slotbuf[slot], scratch);
+
+        pthread_mutex_lock(&sfp->lock);
+        sfp->slotlen[slot]  = len;
+        sfp->slotdone[slot] = 1;
+        pthread_cond_broadcast(&sfp->cond);
+    }
+    pthread_mutex_unlock(&sfp->lock);
+
+    free(scratch);
+
+    return NULL;
+}
+
+// header card, value right-justified unless string
+static void savefitspar_card(char       *card,
+                             const char *name,
+                             const char *value,
+                             const char *comment)
+{
+    char buf[256];
+    int  len = snprintf(buf,
+                        256,
+                        (value[0] == '\'') ? "%-8s= %-20s / %s"
+                        : "%-8s= %20s / %s",
+                        name,
+                        value,
+                        comment);
+    if(len > 80)
+    {
+        len = 80;
+    }
+    memset(card, ' ', 80);
+    memcpy(card, buf, len);
+}
+
+// append card to header
+#define SAVEFITSPAR_CARD(hdr, nbcard, name, comment, ...)                      \
+    do                                                                         \
+    {                                                                          \
+        char value[72];                                                        \
+        snprintf(value, 72, __VA_ARGS__);                                      \
+        savefitspar_card((hdr) + 80 * (nbcard), name, value, comment);         \
+        (nbcard)++;                                                            \
+    } while (0)
+
+// true if card is a structural keyword, written by this writer
+static int savefitspar_structcard(const char *card)
+{
+    const char *key[] = {"SIMPLE  ",
+                         "BITPIX  ",
+                         "NAXIS",
+                         "EXTEND  ",
+                         "BSCALE  ",
+                         "BZERO   ",
+                         "PCOUNT  ",
+                         "GCOUNT  ",
+                         "XTENSION",
+                         "END     ",
+                         NULL
+                        };
+    for(int i = 0; key[i] != NULL; i++)
+    {
+        if(strncmp(card, key[i], strlen(key[i])) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Keyword cards of image, as written by saveFITS_opt_trunc
+ *
+ * @return cards, 80 byte each, to be freed by caller
+ */
+static char *savefitspar_keycards(IMGID      *imgin,
+                                  int         imgtype,
+                                  int         naxis,
+                                  long       *naxesl,
+                                  const char *importheaderfile,
+                                  IMAGE_KEYWORD *kwarray,
+                                  int         kwarraysize,
+                                  int        *NBcard)
+{
+    fitsfile *fptr;
+    char     *header = NULL;
+    int       nkeys  = 0;
+
+    *NBcard = 0;
+
+    COREMOD_iofits_data.FITSIO_status = 0;
+    fits_create_file(&fptr, "mem://", &COREMOD_iofits_data.FITSIO_status);
+    if(check_FITSIO_status(__FILE__, __func__, __LINE__, 1) != 0)
+    {
+        return NULL;
+    }
+    fits_create_img(fptr,
+                    imgtype,
+                    naxis,
+                    naxesl,
+                    &COREMOD_iofits_data.FITSIO_status);
+    saveFITS_write_keywords(fptr,
+                            imgin,
+                            importheaderfile,
+                            kwarray,
+                            kwarraysize);
+    COREMOD_iofits_data.FITSIO_status = 0;
+    fits_write_date(fptr, &COREMOD_iofits_data.FITSIO_status);
+    fits_hdr2str(fptr,
+                 0,
+                 NULL,
+                 0,
+                 &header,
+                 &nkeys,
+                 &COREMOD_iofits_data.FITSIO_status);
+    if(check_FITSIO_status(__FILE__, __func__, __LINE__, 1) != 0)
+    {
+        int status = 0;
+        fits_close_file(fptr, &status);
+        return NULL;
+    }
+
+    char *cards = (char *) malloc(80 * (nkeys + 1));
+    if(cards == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    long hlen = strlen(header);
+    for(long c = 0; c + 80 <= hlen; c += 80)
+    {
+        if(savefitspar_structcard(header + c) == 0)
+        {
+            memcpy(cards + 80 * (*NBcard), header + c, 80);
+            (*NBcard)++;
+        }
+    }
+
+    COREMOD_iofits_data.FITSIO_status = 0;
+    fits_free_memory(header, &COREMOD_iofits_data.FITSIO_status);
+    fits_close_file(fptr, &COREMOD_iofits_data.FITSIO_status);
+
+    return cards;
+}
+
+// write all, return 0 if OK
+static int savefitspar_pwrite(int fd, const char *buf, long nbyte, long offset)
+{
+    while(nbyte > 0)
+    {
+        ssize_t n = pwrite(fd, buf, nbyte, offset);
+        if(n <= 0)
+        {
+            return 1;
+        }
+        buf += n;
+        nbyte -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write FITS file using worker threads
+ *
+ * Output bitpix matches input image.
+ *
+ * @param inputimname       input image name
+ * @param truncate          truncate input image to truncate first slices - -1 to ignore
+ * @param outputFITSname    output FITS file name
+ * @param importheaderfile  optional FITS file from which to read keywords
+ * @param kwarray           optional keyword array. Set to NULL if unused
+ * @param kwarraysize       number of keywords in optional keyword array. Set to 0 if unused.
+ * @param FITSIOext         "" or compression, "[compress <type> <tile>]"
+ * @param NBthread          number of worker threads, 0 to use saveFITS_opt_trunc
+ * @return errno_t
+ */
+errno_t saveFITS_parallel(
+    const char *__restrict inputimname,
+    int truncate,
+    const char *__restrict outputFITSname,
+    const char *__restrict importheaderfile,
+    IMAGE_KEYWORD *kwarray,
+    int            kwarraysize,
+    const char *__restrict FITSIOext,
+    int NBthread
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(inputimname);
+    resolveIMGID(&imgin, ERRMODE_WARN);
+    if(imgin.ID == -1)
+    {
+        PRINT_WARNING("Image %s does not exist in memory - cannot save to FITS",
+                      inputimname);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+
+    int      imgtype;
+    int      bitpix;
+    uint64_t signmask;
+    char     bzero[24];
+    int      isint;
+    int      supported = (NBthread > 0);
+    if(savefitspar_fitstype(imgin.md->datatype,
+                            &imgtype,
+                            &bitpix,
+                            &signmask,
+                            bzero,
+                            &isint) != 0)
+    {
+        supported = 0;
+    }
+
+    SAVEFITSPAR sfp;
+    memset(&sfp, 0, sizeof(sfp));
+    sfp.src      = (const char *) imgin.im->array.raw;
+    sfp.typesize = ImageStreamIO_typesize(imgin.md->datatype);
+    sfp.signmask = signmask;
+
+    int  naxis = imgin.md->naxis;
+    long naxesl[3];
+    sfp.nelem = 1;
+    for(int a = 0; a < 3; a++)
+    {
+        sfp.naxes[a] = (a < naxis) ? imgin.md->size[a] : 1;
+        if((a == naxis - 1) && (truncate >= 0) &&
+                (truncate < sfp.naxes[a]))
+        {
+            sfp.naxes[a] = truncate;
+        }
+        naxesl[a] = sfp.naxes[a];
+        sfp.nelem *= sfp.naxes[a];
+    }
+
+    // compression
+    sfp.codec = SAVEFITSPAR_CODEC_NONE;
+    if(supported && (FITSIOext[0] != '\0'))
+    {
+        char ctype[16];
+        char ctile[64] = "";
+        if(sscanf(FITSIOext, "[compress %15s %63[^]]", ctype, ctile) < 1)
+        {
+            // sscanf leaves "]" on ctype if there is no tile
+            supported = 0;
+        }
+        else
+        {
+            char *c = strchr(ctype, ']');
+            if(c != NULL)
+            {
+                *c = '\0';
+            }
+#ifdef USE_FITS_RCOMP
+            if((strcmp(ctype, "R") == 0) || (strcmp(ctype, "RICE") == 0))
+            {
+                sfp.codec = SAVEFITSPAR_CODEC_RICE;
+                if(sfp.typesize > 4)
+                {
+                    supported = 0;
+                }
+            }
+#endif
+#ifdef USE_ZLIB
+            if((strcmp(ctype, "G") == 0) || (strcmp(ctype, "GZIP") == 0))
+            {
+                sfp.codec = SAVEFITSPAR_CODEC_GZIP;
+            }
+#endif
+            if(sfp.codec == SAVEFITSPAR_CODEC_NONE)
+            {
+                // other codecs, or encoder not available : use cfitsio
+                supported = 0;
+            }
+            if(isint == 0)
+            {
+                // cfitsio quantizes floating point tiles
+                supported = 0;
+            }
+        }
+
+        // tile, default one row
+        sfp.tile[0] = sfp.naxes[0];
+        sfp.tile[1] = 1;
+        sfp.tile[2] = 1;
+        sscanf(ctile, "%ld,%ld,%ld", &sfp.tile[0], &sfp.tile[1], &sfp.tile[2]);
+        for(int a = 0; a < 3; a++)
+        {
+            if((sfp.tile[a] < 1) || (sfp.tile[a] > sfp.naxes[a]))
+            {
+                sfp.tile[a] = sfp.naxes[a];
+            }
+            sfp.ntile[a] = (sfp.naxes[a] + sfp.tile[a] - 1) / sfp.tile[a];
+        }
+    }
+
+    if(!supported)
+    {
+        FUNC_CHECK_RETURN(saveFITS_opt_trunc(inputimname,
+                                             truncate,
+                                             outputFITSname,
+                                             0,
+                                             importheaderfile,
+                                             kwarray,
+                                             kwarraysize,
+                                             FITSIOext));
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+
+    // jobs
+    if(sfp.codec == SAVEFITSPAR_CODEC_NONE)
+    {
+        sfp.chunkelem = SAVEFITSPAR_CHUNKSIZE / sfp.typesize;
+        sfp.NBjob     = (sfp.nelem + sfp.chunkelem - 1) / sfp.chunkelem;
+        sfp.jobrawmax = sfp.chunkelem * sfp.typesize;
+        sfp.joboutmax = sfp.jobrawmax;
+    }
+    else
+    {
+        sfp.NBjob     = sfp.ntile[0] * sfp.ntile[1] * sfp.ntile[2];
+        sfp.jobrawmax = sfp.tile[0] * sfp.tile[1] * sfp.tile[2] * sfp.typesize;
+        // worst case expansion
+        sfp.joboutmax = sfp.jobrawmax + sfp.jobrawmax / 8 + 1024;
+    }
+    if(NBthread > sfp.NBjob)
+    {
+        NBthread = sfp.NBjob;
+    }
+    sfp.NBslot   = NBthread * SAVEFITSPAR_WINDOW;
+    sfp.slotbuf  = (char **) malloc(sizeof(char *) * sfp.NBslot);
+    sfp.slotlen  = (long *) malloc(sizeof(long) * sfp.NBslot);
+    sfp.slotdone = (int *) calloc(sfp.NBslot, sizeof(int));
+    if((sfp.slotbuf == NULL) || (sfp.slotlen == NULL) ||
+            (sfp.slotdone == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    for(long s = 0; s < sfp.NBslot; s++)
+    {
+        sfp.slotbuf[s] = (char *) malloc(sfp.joboutmax);
+        if(sfp.slotbuf[s] == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+    }
+
+    // header cards
+    int   NBkeycard = 0;
+    char *keycards  = savefitspar_keycards(&imgin,
+                                           imgtype,
+                                           naxis,
+                                           naxesl,
+                                           importheaderfile,
+                                           kwarray,
+                                           kwarraysize,
+                                           &NBkeycard);
+    if(keycards == NULL)
+    {
+        NBkeycard = 0;
+    }
+
+    long  hdrsizemax = ((NBkeycard + 64) * 80 / 2880 + 1) * 2880;
+    char *hdr        = (char *) malloc(hdrsizemax);
+    if(hdr == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    // descriptors, compressed
+    uint32_t *desc = NULL;
+    if(sfp.codec != SAVEFITSPAR_CODEC_NONE)
+    {
+        desc = (uint32_t *) malloc(sizeof(uint32_t) * 2 * sfp.NBjob);
+        if(desc == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+    }
+
+    char fnametmp[STRINGMAXLEN_FILENAME];
+    WRITE_FILENAME(fnametmp,
+                   "%s.%d.%ld.tmp",
+                   outputFITSname,
+                   (int) getpid(),
+                   (long) pthread_self());
+
+    int fd = open(fnametmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1)
+    {
+        for(long s = 0; s < sfp.NBslot; s++)
+        {
+            free(sfp.slotbuf[s]);
+        }
+        free(sfp.slotbuf);
+        free(sfp.slotlen);
+        free(sfp.slotdone);
+        free(desc);
+        free(hdr);
+        free(keycards);
+        FUNC_RETURN_FAILURE("cannot create file %s", fnametmp);
+    }
+
+    int writeerr = 0;
+
+    // primary HDU of compressed file, empty
+    long hduoffset = 0;
+    if(sfp.codec != SAVEFITSPAR_CODEC_NONE)
+    {
+        int nbcard = 0;
+        memset(hdr, ' ', 2880);
+        SAVEFITSPAR_CARD(hdr, nbcard, "SIMPLE", "file conforms to FITS standard", "T");
+        SAVEFITSPAR_CARD(hdr, nbcard, "BITPIX", "number of bits per data pixel", "8");
+        SAVEFITSPAR_CARD(hdr, nbcard, "NAXIS", "number of data axes", "0");
+        SAVEFITSPAR_CARD(hdr, nbcard, "EXTEND", "FITS dataset may contain extensions", "T");
+        memcpy(hdr + 80 * nbcard, "END", 3);
+        hduoffset = 2880;
+        if(savefitspar_pwrite(fd, hdr, 2880, 0) != 0)
+        {
+            PRINT_ERROR("write error on %s", fnametmp);
+            writeerr = 1;
+        }
+    }
+
+    // header size, written once data size is known
+    long hdrsize   = 0;
+    long heapsize  = 0;
+    long heapmax   = 0;
+    int  joberr    = 0;
+    for(int pass = 0; pass < 2; pass++)
+    {
+        int nbcard = 0;
+        memset(hdr, ' ', hdrsizemax);
+        if(sfp.codec == SAVEFITSPAR_CODEC_NONE)
+        {
+            SAVEFITSPAR_CARD(hdr, nbcard, "SIMPLE", "file conforms to FITS standard", "T");
+            SAVEFITSPAR_CARD(hdr, nbcard, "BITPIX", "number of bits per data pixel", "%d", bitpix);
+            SAVEFITSPAR_CARD(hdr, nbcard, "NAXIS", "number of data axes", "%d", naxis);
+            for(int a = 0; a < naxis; a++)
+            {
+                char name[16];
+                snprintf(name, 16, "NAXIS%d", a + 1);
+                SAVEFITSPAR_CARD(hdr, nbcard, name, "length of data axis", "%ld", sfp.naxes[a]);
+            }
+            SAVEFITSPAR_CARD(hdr, nbcard, "EXTEND", "FITS dataset may contain extensions", "T");
+        }
+        else
+        {
+            SAVEFITSPAR_CARD(hdr, nbcard, "XTENSION", "binary table extension", "'BINTABLE'");
+            SAVEFITSPAR_CARD(hdr, nbcard, "BITPIX", "8-bit bytes", "8");
+            SAVEFITSPAR_CARD(hdr, nbcard, "NAXIS", "2-dimensional binary table", "2");
+            SAVEFITSPAR_CARD(hdr, nbcard, "NAXIS1", "width of table in bytes", "8");
+            SAVEFITSPAR_CARD(hdr, nbcard, "NAXIS2", "number of rows in table", "%ld", sfp.NBjob);
+            SAVEFITSPAR_CARD(hdr, nbcard, "PCOUNT", "size of special data area", "%ld", heapsize);
+            SAVEFITSPAR_CARD(hdr, nbcard, "GCOUNT", "one data group", "1");
+            SAVEFITSPAR_CARD(hdr, nbcard, "TFIELDS", "number of fields in each row", "1");
+            SAVEFITSPAR_CARD(hdr, nbcard, "TTYPE1", "label for field 1", "'COMPRESSED_DATA'");
+            SAVEFITSPAR_CARD(hdr, nbcard, "TFORM1", "data format of field: variable length array", "'1PB(%ld)'", heapmax);
+            SAVEFITSPAR_CARD(hdr, nbcard, "ZIMAGE", "extension contains compressed image", "T");
+            SAVEFITSPAR_CARD(hdr, nbcard, "ZBITPIX", "data type of original image", "%d", bitpix);
+            SAVEFITSPAR_CARD(hdr, nbcard, "ZNAXIS", "dimension of original image", "%d", naxis);
+            for(int a = 0; a < naxis; a++)
+            {
+                char name[16];
+                snprintf(name, 16, "ZNAXIS%d", a + 1);
+                SAVEFITSPAR_CARD(hdr, nbcard, name, "length of original image axis", "%ld", sfp.naxes[a]);
+            }
+            for(int a = 0; a < naxis; a++)
+            {
+                char name[16];
+                snprintf(name, 16, "ZTILE%d", a + 1);
+                SAVEFITSPAR_CARD(hdr, nbcard, name, "size of tiles to be compressed", "%ld", sfp.tile[a]);
+            }
+            if(sfp.codec == SAVEFITSPAR_CODEC_RICE)
+            {
+                SAVEFITSPAR_CARD(hdr, nbcard, "ZCMPTYPE", "compression algorithm", "'RICE_1'");
+                SAVEFITSPAR_CARD(hdr, nbcard, "ZNAME1", "compression block size", "'BLOCKSIZE'");
+                SAVEFITSPAR_CARD(hdr, nbcard, "ZVAL1", "pixels per block", "%d", SAVEFITSPAR_RICE_BLOCKSIZE);
+                SAVEFITSPAR_CARD(hdr, nbcard, "ZNAME2", "bytes per pixel (1, 2, 4, or 8)", "'BYTEPIX'");
+                SAVEFITSPAR_CARD(hdr, nbcard, "ZVAL2", "bytes per pixel (1, 2, 4, or 8)", "%d", sfp.typesize);
+            }
+            else
+            {
+                SAVEFITSPAR_CARD(hdr, nbcard, "ZCMPTYPE", "compression algorithm", "'GZIP_1'");
+            }
+        }
+        memcpy(hdr + 80 * nbcard, keycards, 80 * NBkeycard);
+        nbcard += NBkeycard;
+        if(bzero[0] != '\0')
+        {
+            SAVEFITSPAR_CARD(hdr, nbcard, "BZERO", "offset data range to that of unsigned", "%s", bzero);
+            SAVEFITSPAR_CARD(hdr, nbcard, "BSCALE", "default scaling factor", "1");
+        }
+        memcpy(hdr + 80 * nbcard, "END", 3);
+        nbcard++;
+        hdrsize = (80 * nbcard + 2879) / 2880 * 2880;
+
+        if(pass == 1)
+        {
+            if(savefitspar_pwrite(fd, hdr, hdrsize, hduoffset) != 0)
+            {
+                writeerr = 1;
+            }
+            break;
+        }
+
+        // data, written sequentially after header and table
+        long tablesize = (desc != NULL) ? 8 * sfp.NBjob : 0;
+        if(lseek(fd, hduoffset + hdrsize + tablesize, SEEK_SET) == -1)
+        {
+            writeerr = 1;
+        }
+
+        pthread_mutex_init(&sfp.lock, NULL);
+        pthread_cond_init(&sfp.cond, NULL);
+        pthread_t *thread = (pthread_t *) malloc(sizeof(pthread_t) * NBthread);
+        if(thread == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+        for(int t = 0; t < NBthread; t++)
+        {
+            if(pthread_create(&thread[t], NULL, savefitspar_worker, &sfp) != 0)
+            {
+                PRINT_ERROR("cannot create worker thread");
+                abort();
+            }
+        }
+
+        char *wbuf  = (char *) malloc(SAVEFITSPAR_WRITESIZE);
+        long  wfill = 0;
+        if(wbuf == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+        for(long job = 0; job < sfp.NBjob; job++)
+        {
+            long slot = job % sfp.NBslot;
+
+            pthread_mutex_lock(&sfp.lock);
+            while(sfp.slotdone[slot] == 0)
+            {
+                pthread_cond_wait(&sfp.cond, &sfp.lock);
+            }
+            pthread_mutex_unlock(&sfp.lock);
+
+            long len = sfp.slotlen[slot];
+            if(len < 0)
+            {
+                joberr = 1;
+                len    = 0;
+            }
+            if(desc != NULL)
+            {
+                desc[2 * job]     = SAVEFITSPAR_BSWAP32((uint32_t) len);
+                desc[2 * job + 1] = SAVEFITSPAR_BSWAP32((uint32_t) heapsize);
+                if(len > heapmax)
+                {
+                    heapmax = len;
+                }
+            }
+            heapsize += len;
+
+            // small outputs are grouped in write buffer
+            if(wfill + len > SAVEFITSPAR_WRITESIZE)
+            {
+                if(write(fd, wbuf, wfill) != wfill)
+                {
+                    writeerr = 1;
+                }
+                wfill = 0;
+            }
+            if(len >= SAVEFITSPAR_WRITESIZE)
+            {
+                if(write(fd, sfp.slotbuf[slot], len) != len)
+                {
+                    writeerr = 1;
+                }
+            }
+            else
+            {
+                memcpy(wbuf + wfill, sfp.slotbuf[slot], len);
+                wfill += len;
+            }
+
+            pthread_mutex_lock(&sfp.lock);
+            sfp.slotdone[slot] = 0;
+            sfp.jobwritten++;
+            pthread_cond_broadcast(&sfp.cond);
+            pthread_mutex_unlock(&sfp.lock);
+        }
+        if(wfill > 0)
+        {
+            if(write(fd, wbuf, wfill) != wfill)
+            {
+                writeerr = 1;
+            }
+        }
+        free(wbuf);
+
+        for(int t = 0; t < NBthread; t++)
+        {
+            pthread_join(thread[t], NULL);
+        }
+        free(thread);
+        pthread_cond_destroy(&sfp.cond);
+        pthread_mutex_destroy(&sfp.lock);
+
+        if((desc != NULL) && (heapsize > 0x7FFFFFFF))
+        {
+            // 32-bit descriptors
+            joberr = 1;
+        }
+
+        // table, then padding of data unit
+        long datasize = tablesize + heapsize;
+        if(desc != NULL)
+        {
+            if(savefitspar_pwrite(fd,
+                                  (char *) desc,
+                                  tablesize,
+                                  hduoffset + hdrsize) != 0)
+            {
+                writeerr = 1;
+            }
+        }
+        if(ftruncate(fd, hduoffset + hdrsize + (datasize + 2879) / 2880 * 2880) !=
+                0)
+        {
+            writeerr = 1;
+        }
+    }
+    close(fd);
+
+    for(long s = 0; s < sfp.NBslot; s++)
+    {
+        free(sfp.slotbuf[s]);
+    }
+    free(sfp.slotbuf);
+    free(sfp.slotlen);
+    free(sfp.slotdone);
+    free(desc);
+    free(hdr);
+    free(keycards);
+
+    if(joberr)
+    {
+        // fall back to cfitsio
+        PRINT_WARNING("parallel FITS writer failed on %s, using cfitsio",
+                      outputFITSname);
+        unlink(fnametmp);
+        FUNC_CHECK_RETURN(saveFITS_opt_trunc(inputimname,
+                                             truncate,
+                                             outputFITSname,
+                                             0,
+                                             importheaderfile,
+                                             kwarray,
+                                             kwarraysize,
+                                             FITSIOext));
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+    if(writeerr)
+    {
+        unlink(fnametmp);
+        FUNC_RETURN_FAILURE("write error on file %s", fnametmp);
+    }
+
+    if(rename(fnametmp, outputFITSname) != 0)
+    {
+        FUNC_RETURN_FAILURE("cannot rename %s to %s", fnametmp, outputFITSname);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
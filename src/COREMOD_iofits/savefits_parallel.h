@@ -0,0 +1,17 @@
+/**
+ * @file    savefits_parallel.h
+ */
+
+#ifndef MILK_COREMOD_IOFITS_SAVEFITS_PARALLEL_H
+#define MILK_COREMOD_IOFITS_SAVEFITS_PARALLEL_H
+
+errno_t saveFITS_parallel(const char *__restrict inputimname,
+                          int truncate,
+                          const char *__restrict outputFITSname,
+                          const char *__restrict importheaderfile,
+                          IMAGE_KEYWORD *kwarray,
+                          int            kwarraysize,
+                          const char *__restrict FITSIOext,
+                          int NBthread);
+
+#endif
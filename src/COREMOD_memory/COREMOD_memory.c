@@ -77,13 +77,22 @@
 #include "stream_copy.h"
 #include "stream_delay.h"
 #include "stream_merge.h"
+#include "stream_tile.h"
+#include "stream_netmux_rx.h"
+#include "stream_netmux_tx.h"
+#include "stream_netbench.h"
+#include "logshmim_multi.h"
+#include "logshmim_query.h"
+#include "logshmim_replay.h"
 #include "stream_diff.h"
 #include "stream_halfimdiff.h"
 #include "stream_monitorlimits.h"
 #include "stream_paste.h"
 #include "stream_pixmapdecode.h"
 #include "stream_poke.h"
+#include "stream_proctrace.h"
 #include "stream_sem.h"
+#include "stream_stats.h"
 #include "stream_updateloop.h"
 
 #include "variable_ID.h"
@@ -158,17 +167,23 @@ static errno_t init_module_CLI()
     saveall_addCLIcmd();
     stream__TCP_addCLIcmd();
     stream__UDP_addCLIcmd();
+    CLIADDCMD_COREMOD_memory__stream_netmux_tx();
+    CLIADDCMD_COREMOD_memory__stream_netmux_rx();
+    CLIADDCMD_COREMOD_memory__stream_netbench();
     stream_pixmapdecode_addCLIcmd();
 
     CLIADDCMD_COREMOD_memory__stream_copy();
     CLIADDCMD_COREMOD_memory__stream_merge();
+    CLIADDCMD_COREMOD_memory__stream_tile();
     CLIADDCMD_COREMOD_memory__stream_poke();
+    CLIADDCMD_COREMOD_memory__stream_proctrace();
 
-    stream_diff_addCLIcmd();
+    CLIADDCMD_COREMOD_memory__stream_diff();
     stream_paste_addCLIcmd();
-    stream_halfimdiff_addCLIcmd();
+    CLIADDCMD_COREMOD_memory__stream_halfimdiff();
 
     CLIADDCMD_streamaverage();
+    CLIADDCMD_COREMOD_memory__stream_stats();
     stream_monitorlimits_addCLIcmd();
 
     // DATA LOGGING
@@ -176,6 +191,9 @@ static errno_t init_module_CLI()
 
     //CLIADDCMD_COREMOD_memory__shmimlog(); -- find deletion commit.
     CLIADDCMD_COREMOD_MEMORY__logshmim();
+    CLIADDCMD_COREMOD_MEMORY__logshmim_multi();
+    CLIADDCMD_COREMOD_MEMORY__logshmim_query();
+    CLIADDCMD_COREMOD_MEMORY__logshmim_replay();
 
     // add atexit functions here
 
@@ -52,6 +52,7 @@
 #include "COREMOD_memory/image_mk_complex_from_amph.h"
 #include "COREMOD_memory/image_mk_complex_from_reim.h"
 #include "COREMOD_memory/image_mk_reim_from_complex.h"
+#include "COREMOD_memory/image_mmap.h"
 #include "COREMOD_memory/image_set_counters.h"
 #include "COREMOD_memory/list_image.h"
 #include "COREMOD_memory/list_variable.h"
@@ -64,6 +65,7 @@
 #include "COREMOD_memory/stream_diff.h"
 #include "COREMOD_memory/stream_halfimdiff.h"
 #include "COREMOD_memory/stream_paste.h"
+#include "COREMOD_memory/stream_tile.h"
 #include "COREMOD_memory/stream_pixmapdecode.h"
 #include "COREMOD_memory/stream_poke.h"
 #include "COREMOD_memory/stream_sem.h"
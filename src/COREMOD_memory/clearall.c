@@ -66,6 +66,7 @@ errno_t clearall()
         {
             data.fpsarray[fpsindex].parray = NULL;
         }
+        data.fpsarray[fpsindex].pindexhash = NULL;
         if(data.fpsarray[fpsindex].md != NULL)
         {
             data.fpsarray[fpsindex].md = NULL;
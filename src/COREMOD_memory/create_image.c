@@ -50,6 +50,7 @@ errno_t create_image_ID(
                                shared,
                                NBkw,
                                CBsize);
+        image_ID_index_add(ID);
     }
     else
     {
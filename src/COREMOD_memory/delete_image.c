@@ -8,6 +8,7 @@
 
 #include "CommandLineInterface/CLIcore.h"
 #include "image_ID.h"
+#include "image_mmap.h"
 #include "list_image.h"
 
 // Forward declaration(s)
@@ -135,7 +136,9 @@ errno_t delete_image(
     }
     else
     {
+        image_ID_index_remove(ID);
         data.image[ID].used = 0;
+        image_ID_index_freeslot(ID);
         img->ID = -1;
 
         if(data.image[ID].md[0].shared == 1)
@@ -187,59 +190,67 @@ errno_t delete_image(
         }
         else
         {
-            if(data.image[ID].md[0].datatype == _DATATYPE_UINT8)
+            if(image_mmap_release(ID) == 1)
             {
-                if(data.image[ID].array.UI8 == NULL)
-                {
-                    FUNC_RETURN_FAILURE("data array pointer is null");
-                }
-                free(data.image[ID].array.UI8);
-                data.image[ID].array.UI8 = NULL;
+                // array was a file mapping
+                data.image[ID].array.raw = NULL;
             }
-            if(data.image[ID].md[0].datatype == _DATATYPE_INT32)
+            else
             {
-                if(data.image[ID].array.SI32 == NULL)
+                if(data.image[ID].md[0].datatype == _DATATYPE_UINT8)
                 {
-                    FUNC_RETURN_FAILURE("data array pointer is null");
+                    if(data.image[ID].array.UI8 == NULL)
+                    {
+                        FUNC_RETURN_FAILURE("data array pointer is null");
+                    }
+                    free(data.image[ID].array.UI8);
+                    data.image[ID].array.UI8 = NULL;
                 }
-                free(data.image[ID].array.SI32);
-                data.image[ID].array.SI32 = NULL;
-            }
-            if(data.image[ID].md[0].datatype == _DATATYPE_FLOAT)
-            {
-                if(data.image[ID].array.F == NULL)
+                if(data.image[ID].md[0].datatype == _DATATYPE_INT32)
                 {
-                    FUNC_RETURN_FAILURE("data array pointer is null");
+                    if(data.image[ID].array.SI32 == NULL)
+                    {
+                        FUNC_RETURN_FAILURE("data array pointer is null");
+                    }
+                    free(data.image[ID].array.SI32);
+                    data.image[ID].array.SI32 = NULL;
                 }
-                free(data.image[ID].array.F);
-                data.image[ID].array.F = NULL;
-            }
-            if(data.image[ID].md[0].datatype == _DATATYPE_DOUBLE)
-            {
-                if(data.image[ID].array.D == NULL)
+                if(data.image[ID].md[0].datatype == _DATATYPE_FLOAT)
                 {
-                    FUNC_RETURN_FAILURE("data array pointer is null");
+                    if(data.image[ID].array.F == NULL)
+                    {
+                        FUNC_RETURN_FAILURE("data array pointer is null");
+                    }
+                    free(data.image[ID].array.F);
+                    data.image[ID].array.F = NULL;
                 }
-                free(data.image[ID].array.D);
-                data.image[ID].array.D = NULL;
-            }
-            if(data.image[ID].md[0].datatype == _DATATYPE_COMPLEX_FLOAT)
-            {
-                if(data.image[ID].array.CF == NULL)
+                if(data.image[ID].md[0].datatype == _DATATYPE_DOUBLE)
                 {
-                    FUNC_RETURN_FAILURE("data array pointer is null");
+                    if(data.image[ID].array.D == NULL)
+                    {
+                        FUNC_RETURN_FAILURE("data array pointer is null");
+                    }
+                    free(data.image[ID].array.D);
+                    data.image[ID].array.D = NULL;
                 }
-                free(data.image[ID].array.CF);
-                data.image[ID].array.CF = NULL;
-            }
-            if(data.image[ID].md[0].datatype == _DATATYPE_COMPLEX_DOUBLE)
-            {
-                if(data.image[ID].array.CD == NULL)
+                if(data.image[ID].md[0].datatype == _DATATYPE_COMPLEX_FLOAT)
+                {
+                    if(data.image[ID].array.CF == NULL)
+                    {
+                        FUNC_RETURN_FAILURE("data array pointer is null");
+                    }
+                    free(data.image[ID].array.CF);
+                    data.image[ID].array.CF = NULL;
+                }
+                if(data.image[ID].md[0].datatype == _DATATYPE_COMPLEX_DOUBLE)
                 {
-                    FUNC_RETURN_FAILURE("data array pointer is null");
+                    if(data.image[ID].array.CD == NULL)
+                    {
+                        FUNC_RETURN_FAILURE("data array pointer is null");
+                    }
+                    free(data.image[ID].array.CD);
+                    data.image[ID].array.CD = NULL;
                 }
-                free(data.image[ID].array.CD);
-                data.image[ID].array.CD = NULL;
             }
 
             if(data.image[ID].md == NULL)
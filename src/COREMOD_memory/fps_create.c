@@ -86,8 +86,16 @@ errno_t function_parameter_struct_create(
     printf("Creating file %s, holding NBparamMAX = %d\n", SM_fname, NBparamMAX);
     fflush(stdout);
 
+    // parameter hash index size: power of 2, at most half full
+    long NBparamHASH = 64;
+    while(NBparamHASH < 2 * NBparamMAX)
+    {
+        NBparamHASH *= 2;
+    }
+
     sharedsize = sizeof(FUNCTION_PARAMETER_STRUCT_MD);
     sharedsize += sizeof(FUNCTION_PARAMETER) * NBparamMAX;
+    sharedsize += sizeof(int32_t) * NBparamHASH;
 
     SM_fd = open(SM_fname, O_RDWR | O_CREAT | O_TRUNC, (mode_t) 0600);
     if(SM_fd == -1)
@@ -147,6 +155,14 @@ errno_t function_parameter_struct_create(
     fps.md->NBparamMAX = NBparamMAX;
 
     memset(fps.parray, 0, NBparamMAX * sizeof(*fps.parray));
+
+    mapv += sizeof(FUNCTION_PARAMETER) * NBparamMAX;
+    fps.pindexhash      = (int32_t *) mapv;
+    fps.md->NBparamHASH = NBparamHASH;
+    for(long k = 0; k < NBparamHASH; k++)
+    {
+        fps.pindexhash[k] = FPS_PINDEXHASH_EMPTY;
+    }
     /*
     for(index = 0; index < NBparamMAX; index++)
     {
@@ -228,6 +244,7 @@ errno_t function_parameter_struct_create(
     fps.cmdset.procinfo_loopcntMax_ptr = NULL;
     fps.cmdset.triggerdelayptr = NULL;
     fps.cmdset.triggertimeoutptr = NULL;
+    fps.cmdset.triggerspinnsptr = NULL;
 
     munmap(fps.md, sharedsize);
 
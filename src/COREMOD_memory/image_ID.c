@@ -1,41 +1,267 @@
 /**
  * @file    image_ID.c
  * @brief   find image ID(s) from name
+ *
+ * Image names are indexed in a hash table (open addressing, linear
+ * probing) mapping name to ID, and unused IDs are kept in a stack, so
+ * that name lookup and ID allocation do not scan data.image.
+ *
+ * The index must be kept consistent with data.image:
+ * - image_ID_index_add() once a new image has its name
+ * - image_ID_index_remove() before an image is renamed or released
+ * - image_ID_index_freeslot() once an image slot is released
+ *
+ * The index is (re)built from data.image on first use, whenever
+ * data.NB_MAX_IMAGE changes, and when too many entries are deleted.
+ *
+ * Images are looked up from several threads (stream receive, logger
+ * writers), so lookups take the imageIDindex critical section used by
+ * index updates. A rebuild fills new tables and swaps them in within the
+ * critical section, then frees the old ones.
  */
 
 #include "CommandLineInterface/CLIcore.h"
 
-/* ID number corresponding to a name */
-imageID image_ID(const char *name)
+#define IMAGEIDINDEX_EMPTY   -1
+#define IMAGEIDINDEX_DELETED -2
+
+// name -> ID hash table, size is a power of 2
+static imageID *imIDindex         = NULL;
+static long     imIDindex_size    = 0;
+static long     imIDindex_nbdel   = 0;
+static long     imIDindex_NBimage = 0; // data.NB_MAX_IMAGE at last rebuild
+
+// stack of unused IDs
+// entries may be stale (ID taken as preferredID), they are checked on pop
+static imageID *imIDfree         = NULL;
+static uint8_t *imIDfree_instack = NULL;
+static long     imIDfree_nb      = 0;
+
+// FNV-1a hash
+static inline uint64_t image_ID_hash(const char *name)
+{
+    uint64_t h = 14695981039346656037ULL;
+    while(*name != '\0')
+    {
+        h ^= (uint8_t) *name;
+        h *= 1099511628211ULL;
+        name++;
+    }
+    return h;
+}
+
+/**
+ * @brief Insert image in hash table
+ *
+ * @return 1 if a deleted entry was reused, 0 otherwise
+ */
+static int image_ID_index_insert(imageID *table, long size, imageID ID)
+{
+    long mask = size - 1;
+    long k    = (long)(image_ID_hash(data.image[ID].name) & mask);
+
+    while(table[k] >= 0)
+    {
+        if(table[k] == ID)
+        {
+            return 0;
+        }
+        k = (k + 1) & mask;
+    }
+    int reused = (table[k] == IMAGEIDINDEX_DELETED);
+    table[k]   = ID;
+
+    return reused;
+}
+
+static void image_ID_freeslot_push(imageID ID)
+{
+    if(imIDfree_instack[ID] == 0)
+    {
+        imIDfree[imIDfree_nb] = ID;
+        imIDfree_nb++;
+        imIDfree_instack[ID] = 1;
+    }
+}
+
+/**
+ * @brief Build new index and free ID stack from data.image, swap them in
+ *
+ * Called within imageIDindex critical section
+ */
+static void image_ID_index_build()
+{
+    long size = 64;
+    while(size < 2 * data.NB_MAX_IMAGE)
+    {
+        size *= 2;
+    }
+
+    imageID *index   = (imageID *) malloc(sizeof(imageID) * size);
+    imageID *freeID  = (imageID *) malloc(sizeof(imageID) * data.NB_MAX_IMAGE);
+    uint8_t *instack = (uint8_t *) calloc(data.NB_MAX_IMAGE, sizeof(uint8_t));
+    if((index == NULL) || (freeID == NULL) || (instack == NULL))
+    {
+        PRINT_ERROR("malloc() error");
+        abort();
+    }
+
+    for(long k = 0; k < size; k++)
+    {
+        index[k] = IMAGEIDINDEX_EMPTY;
+    }
+
+    // push in decreasing order, so that lowest IDs are used first
+    long nbfree = 0;
+    for(imageID ID = data.NB_MAX_IMAGE - 1; ID >= 0; ID--)
+    {
+        if(data.image[ID].used == 1)
+        {
+            image_ID_index_insert(index, size, ID);
+        }
+        else
+        {
+            freeID[nbfree] = ID;
+            nbfree++;
+            instack[ID] = 1;
+        }
+    }
+
+    imageID *indexold   = imIDindex;
+    imageID *freeIDold  = imIDfree;
+    uint8_t *instackold = imIDfree_instack;
+
+    imIDindex         = index;
+    imIDindex_size    = size;
+    imIDindex_nbdel   = 0;
+    imIDindex_NBimage = data.NB_MAX_IMAGE;
+    imIDfree          = freeID;
+    imIDfree_instack  = instack;
+    imIDfree_nb       = nbfree;
+
+    free(indexold);
+    free(freeIDold);
+    free(instackold);
+}
+
+/**
+ * @brief (Re)build image name index and free ID stack from data.image
+ */
+errno_t image_ID_index_rebuild()
 {
     DEBUG_TRACE_FSTART();
 
-    imageID i;
-    int     loopOK;
-    imageID tmpID = 0;
+#ifdef _OPENMP
+    #pragma omp critical (imageIDindex)
+    {
+#endif
+        image_ID_index_build();
+#ifdef _OPENMP
+    }
+#endif
 
-    i      = 0;
-    loopOK = 1;
-    while(loopOK == 1)
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+// called within imageIDindex critical section
+static inline void image_ID_index_check()
+{
+    if(imIDindex_NBimage != data.NB_MAX_IMAGE)
     {
-        if(data.image[i].used == 1)
+        image_ID_index_build();
+    }
+}
+
+/**
+ * @brief Add image to name index
+ *
+ * To be called once data.image[ID].name is set
+ */
+errno_t image_ID_index_add(imageID ID)
+{
+#ifdef _OPENMP
+    #pragma omp critical (imageIDindex)
+    {
+#endif
+        image_ID_index_check();
+        imIDindex_nbdel -= image_ID_index_insert(imIDindex, imIDindex_size, ID);
+#ifdef _OPENMP
+    }
+#endif
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Remove image from name index
+ *
+ * To be called before data.image[ID].name is changed or image released
+ */
+errno_t image_ID_index_remove(imageID ID)
+{
+#ifdef _OPENMP
+    #pragma omp critical (imageIDindex)
+    {
+#endif
+        image_ID_index_check();
+
+        long mask = imIDindex_size - 1;
+        long k    = (long)(image_ID_hash(data.image[ID].name) & mask);
+
+        while(imIDindex[k] != IMAGEIDINDEX_EMPTY)
         {
-            if((strncmp(name, data.image[i].name, strlen(name)) == 0) &&
-                    (data.image[i].name[strlen(name)] == '\0'))
+            if(imIDindex[k] == ID)
             {
-                loopOK = 0;
-                tmpID  = i;
-                clock_gettime(CLOCK_MILK,
-                              &data.image[i].md[0].lastaccesstime);
+                imIDindex[k] = IMAGEIDINDEX_DELETED;
+                imIDindex_nbdel++;
+                break;
             }
+            k = (k + 1) & mask;
         }
-        i++;
 
-        if(i == data.NB_MAX_IMAGE)
+        // too many deleted entries lengthen probe sequences
+        if(imIDindex_nbdel > imIDindex_size / 4)
         {
-            loopOK = 0;
-            tmpID  = -1;
+            image_ID_index_build();
         }
+#ifdef _OPENMP
+    }
+#endif
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Return released image ID to free ID stack
+ *
+ * To be called once data.image[ID].used is set to 0
+ */
+errno_t image_ID_index_freeslot(imageID ID)
+{
+#ifdef _OPENMP
+    #pragma omp critical (imageIDindex)
+    {
+#endif
+        image_ID_index_check();
+        image_ID_freeslot_push(ID);
+#ifdef _OPENMP
+    }
+#endif
+
+    return RETURN_SUCCESS;
+}
+
+/* ID number corresponding to a name */
+imageID image_ID(const char *name)
+{
+    DEBUG_TRACE_FSTART();
+
+    imageID tmpID = image_ID_noaccessupdate(name);
+
+    if(tmpID != -1)
+    {
+        clock_gettime(CLOCK_MILK, &data.image[tmpID].md[0].lastaccesstime);
     }
 
     DEBUG_TRACEPOINT("FOUT %s -> %ld", name, tmpID);
@@ -48,31 +274,34 @@ imageID image_ID_noaccessupdate(const char *name)
 {
     DEBUG_TRACE_FSTART();
 
-    imageID i;
-    imageID tmpID = 0;
-    int     loopOK;
+    imageID tmpID = -1;
 
-    i      = 0;
-    loopOK = 1;
-    while(loopOK == 1)
+#ifdef _OPENMP
+    #pragma omp critical (imageIDindex)
     {
-        if(data.image[i].used == 1)
+#endif
+        image_ID_index_check();
+
+        long mask = imIDindex_size - 1;
+        long k    = (long)(image_ID_hash(name) & mask);
+
+        while(imIDindex[k] != IMAGEIDINDEX_EMPTY)
         {
-            if((strncmp(name, data.image[i].name, strlen(name)) == 0) &&
-                    (data.image[i].name[strlen(name)] == '\0'))
+            imageID ID = imIDindex[k];
+            if(ID >= 0)
             {
-                loopOK = 0;
-                tmpID  = i;
+                if((data.image[ID].used == 1) &&
+                        (strcmp(name, data.image[ID].name) == 0))
+                {
+                    tmpID = ID;
+                    break;
+                }
             }
+            k = (k + 1) & mask;
         }
-        i++;
-
-        if(i == data.NB_MAX_IMAGE)
-        {
-            loopOK = 0;
-            tmpID  = -1;
-        }
+#ifdef _OPENMP
     }
+#endif
 
     DEBUG_TRACE_FEXIT();
     return tmpID;
@@ -85,38 +314,50 @@ imageID next_avail_image_ID(
 {
     DEBUG_TRACE_FSTART();
 
-    imageID i;
     imageID ID = -1;
 
-    if ( (preferredID > -1)
-            && (preferredID<data.NB_MAX_IMAGE)
-            && (data.image[preferredID].used == 0) )
-    {
-        ID = preferredID;
-        data.image[ID].used = 1;
-    }
-    else
+#ifdef _OPENMP
+    #pragma omp critical (imageIDindex)
     {
+#endif
+        image_ID_index_check();
 
-
-#ifdef _OPENMP
-        #pragma omp critical
+        if((preferredID > -1)
+                && (preferredID < data.NB_MAX_IMAGE)
+                && (data.image[preferredID].used == 0))
         {
-#endif
-            for(i = 0; i < data.NB_MAX_IMAGE; i++)
+            // left in free ID stack, skipped when popped
+            ID = preferredID;
+            data.image[ID].used = 1;
+        }
+        else
+        {
+            while((ID == -1) && (imIDfree_nb > 0))
+            {
+                imIDfree_nb--;
+                imageID IDfree = imIDfree[imIDfree_nb];
+                imIDfree_instack[IDfree] = 0;
+                if(data.image[IDfree].used == 0)
+                {
+                    ID                  = IDfree;
+                    data.image[ID].used = 1;
+                }
+            }
+
+            // IDs released without image_ID_index_freeslot()
+            for(imageID i = 0; (ID == -1) && (i < data.NB_MAX_IMAGE); i++)
             {
                 if(data.image[i].used == 0)
                 {
                     ID                  = i;
                     data.image[ID].used = 1;
-                    break;
                 }
             }
-#ifdef _OPENMP
         }
+#ifdef _OPENMP
+    }
 #endif
 
-    }
     if(ID == -1)
     {
         printf("ERROR: ran out of image IDs - cannot allocate new ID\n");
@@ -2,6 +2,14 @@
  * @file    image_ID.h
  */
 
+errno_t image_ID_index_rebuild();
+
+errno_t image_ID_index_add(imageID ID);
+
+errno_t image_ID_index_remove(imageID ID);
+
+errno_t image_ID_index_freeslot(imageID ID);
+
 imageID image_ID(const char *name);
 
 imageID image_ID_noaccessupdate(const char *name);
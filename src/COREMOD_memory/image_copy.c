@@ -259,7 +259,12 @@ imageID chname_image_ID(
     if((image_ID(new_name) == -1) && (variable_ID(new_name) == -1))
     {
         ID = image_ID(ID_name);
-        strcpy(data.image[ID].name, new_name);
+        if(ID != -1)
+        {
+            image_ID_index_remove(ID);
+            strcpy(data.image[ID].name, new_name);
+            image_ID_index_add(ID);
+        }
         //      if ( Debug > 0 ) { printf("change image name %s -> %s\n",ID_name,new_name);}
     }
     else
@@ -0,0 +1,107 @@
+/**
+ * @file    image_mmap.c
+ * @brief   local images with file-mapped data array
+ *
+ * A local image data array may be replaced by a memory mapping (for
+ * example a FITS file data unit, see load_fits). Mappings are recorded
+ * here so that delete_image_ID unmaps the array instead of freeing it.
+ */
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+typedef struct
+{
+    imageID ID;
+    int64_t createcnt;
+    void   *addr;
+    size_t  length;
+} IMAGE_MMAP_ENTRY;
+
+static IMAGE_MMAP_ENTRY *mmaplist  = NULL;
+static long              NBmmap    = 0;
+static long              NBmmapmax = 0;
+static pthread_mutex_t   mmaplock  = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Replace local image data array by memory mapping
+ *
+ * The array allocated at image creation is freed.
+ * Mapping addr/length is unmapped when the image is deleted.
+ *
+ * @param ID      local image
+ * @param addr    mapping address, as returned by mmap
+ * @param length  mapping length
+ * @param array   data array, within mapping
+ */
+errno_t image_mmap_attach(imageID ID, void *addr, size_t length, void *array)
+{
+    DEBUG_TRACE_FSTART();
+
+    if(data.image[ID].md[0].shared == 1)
+    {
+        FUNC_RETURN_FAILURE("image %s is shared, cannot map array",
+                            data.image[ID].name);
+    }
+
+    pthread_mutex_lock(&mmaplock);
+    if(NBmmap == NBmmapmax)
+    {
+        long              NBmax = (NBmmapmax == 0) ? 16 : 2 * NBmmapmax;
+        IMAGE_MMAP_ENTRY *list  = (IMAGE_MMAP_ENTRY *) realloc(
+                                      mmaplist,
+                                      sizeof(IMAGE_MMAP_ENTRY) * NBmax);
+        if(list == NULL)
+        {
+            pthread_mutex_unlock(&mmaplock);
+            PRINT_ERROR("realloc error");
+            abort();
+        }
+        mmaplist  = list;
+        NBmmapmax = NBmax;
+    }
+    mmaplist[NBmmap].ID        = ID;
+    mmaplist[NBmmap].createcnt = data.image[ID].createcnt;
+    mmaplist[NBmmap].addr      = addr;
+    mmaplist[NBmmap].length    = length;
+    NBmmap++;
+    pthread_mutex_unlock(&mmaplock);
+
+    free(data.image[ID].array.raw);
+    data.image[ID].array.raw = array;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Unmap image data array if file-mapped
+ *
+ * @return 1 if array was unmapped, 0 if array is not a mapping
+ */
+int image_mmap_release(imageID ID)
+{
+    int released = 0;
+
+    pthread_mutex_lock(&mmaplock);
+    for(long i = 0; i < NBmmap; i++)
+    {
+        if((mmaplist[i].ID == ID) &&
+                (mmaplist[i].createcnt == data.image[ID].createcnt))
+        {
+            if(munmap(mmaplist[i].addr, mmaplist[i].length) == -1)
+            {
+                perror("Error un-mmapping image array");
+            }
+            mmaplist[i] = mmaplist[NBmmap - 1];
+            NBmmap--;
+            released = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mmaplock);
+
+    return released;
+}
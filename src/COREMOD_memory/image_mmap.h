@@ -0,0 +1,12 @@
+/**
+ * @file    image_mmap.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_IMAGE_MMAP_H
+#define MILK_COREMOD_MEMORY_IMAGE_MMAP_H
+
+errno_t image_mmap_attach(imageID ID, void *addr, size_t length, void *array);
+
+int image_mmap_release(imageID ID);
+
+#endif
@@ -26,6 +26,8 @@
 #include "delete_image.h"
 #include "image_ID.h"
 #include "list_image.h"
+#include "logshmim_directio.h"
+#include "logshmim_timing.h"
 #include "read_shmim.h"
 #include "stream_sem.h"
 
@@ -34,6 +36,9 @@
 #define likely(x)   __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
+// min interval between processinfo status messages [s]
+#define LOGSHMIM_MSGDT 0.5
+
 static long tret = 0; // thread return value
 
 
@@ -104,6 +109,37 @@ static uint32_t *writerRTprio;
 static long fpi_writerRTprio;
 
 
+// direct I/O mode
+static int64_t *directIO;
+static long     fpi_directIO = -1;
+
+static uint32_t *ringMB;
+static long      fpi_ringMB = -1;
+
+// frames not logged, direct I/O ring buffer full
+static uint64_t *dropcnt;
+static long      fpi_dropcnt = -1;
+
+// input frames missed by logger loop
+static uint64_t *misscnt;
+static long      fpi_misscnt = -1;
+
+// direct I/O ring buffer fill fraction
+static float *ringfill;
+static long   fpi_ringfill = -1;
+
+// timing files
+static int64_t *asciitiming;
+static long     fpi_asciitiming = -1;
+
+static int64_t *bintiming;
+static long     fpi_bintiming = -1;
+
+// FITS writer threads, 0 for cfitsio
+static uint32_t *writerNBthread;
+static long      fpi_writerNBthread = -1;
+
+
 
 
 
@@ -244,6 +280,78 @@ static CLICMDARGDEF farg[] =
         (void **) &writerRTprio,
         &fpi_writerRTprio
     },
+    {
+        CLIARG_ONOFF,
+        ".directIO",
+        "direct I/O mode, no log buffer streams",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &directIO,
+        &fpi_directIO
+    },
+    {
+        CLIARG_UINT32,
+        ".ringMB",
+        "direct I/O ring buffer size [MB]",
+        "1024",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &ringMB,
+        &fpi_ringMB
+    },
+    {
+        CLIARG_UINT64,
+        ".dropcnt",
+        "frames dropped, ring buffer full (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &dropcnt,
+        &fpi_dropcnt
+    },
+    {
+        CLIARG_UINT64,
+        ".misscnt",
+        "input frames missed (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &misscnt,
+        &fpi_misscnt
+    },
+    {
+        CLIARG_FLOAT32,
+        ".ringfill",
+        "ring buffer fill fraction (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &ringfill,
+        &fpi_ringfill
+    },
+    {
+        CLIARG_ONOFF,
+        ".asciitiming",
+        "write ASCII timing file",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &asciitiming,
+        &fpi_asciitiming
+    },
+    {
+        CLIARG_ONOFF,
+        ".bintiming",
+        "write binary timing file and catalog entry",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &bintiming,
+        &fpi_bintiming
+    },
+    {
+        CLIARG_UINT32,
+        ".writerNBthread",
+        "FITS writer threads, 0: cfitsio",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &writerNBthread,
+        &fpi_writerNBthread
+    },
 };
 
 
@@ -265,6 +373,10 @@ static errno_t customCONFsetup()
         data.fpsptr->parray[fpi_compressON].fpflag |= FPFLAG_WRITERUN;
 
         data.fpsptr->parray[fpi_writerRTprio].fpflag |= FPFLAG_WRITERUN;
+
+        data.fpsptr->parray[fpi_asciitiming].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_bintiming].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_writerNBthread].fpflag |= FPFLAG_WRITERUN;
     }
 
     return RETURN_SUCCESS;
@@ -291,6 +403,18 @@ static CLICMDDATA CLIcmddata =
 // detailed help
 static errno_t help_function()
 {
+    printf("Log stream to FITS cubes, with ASCII timing file\n");
+    printf("Default mode: frames are copied to log buffer streams\n");
+    printf("  <sname>_logbuff0/1, written by cfitsio in a thread\n");
+    printf("Direct I/O mode (.directIO): frames are copied to a ring\n");
+    printf("  buffer and appended to the FITS file with O_DIRECT\n");
+    printf("  No compression, aux FITS header not included\n");
+    printf("  Frames skipped by the logger loop are recovered from the\n");
+    printf("  input stream if it is a rolling buffer (naxis = 3)\n");
+    printf("Binary timing file (.bintiming): <cube>.tim, fixed-size\n");
+    printf("  records, and cube appended to catalog <dirname>/<sname>.logcat\n");
+    printf("  Use streamlogquery to extract a time or cnt0 range\n");
+
     return RETURN_SUCCESS;
 }
 
@@ -357,109 +481,13 @@ static void *save_telemetry_fits_function(
 
 
     // Add custom keywords
-    int            NBcustomKW = 9;
+    int            NBcustomKW = LOGSHMIM_NBTIMEKW;
     IMAGE_KEYWORD *imkwarray =
         (IMAGE_KEYWORD *) malloc(sizeof(IMAGE_KEYWORD) * NBcustomKW);
 
-
-    // UT time
-
-    strcpy(imkwarray->name, "UT");
-    imkwarray->type = 'S';
-
-
-    strcpy(imkwarray->value.valstr,
-           timedouble_to_UTC_timeofdaystring(
-               0.5 * tmsg->arraytime[0] +
-               0.5 * tmsg->arraytime[tmsg->cubesize - 1]));
-    strcpy(imkwarray->comment, "HH:MM:SS.SS typical UTC at exposure");
-
-
-    strcpy(imkwarray[1].name, "UT-STR");
-    imkwarray[1].type = 'S';
-    strcpy(imkwarray[1].value.valstr,
-           timedouble_to_UTC_timeofdaystring(tmsg->arraytime[0]));
-    strcpy(imkwarray[1].comment, "HH:MM:SS.SS UTC at exposure start");
-
-    strcpy(imkwarray[2].name, "UT-END");
-    imkwarray[2].type = 'S';
-    strcpy(
-        imkwarray[2].value.valstr,
-        timedouble_to_UTC_timeofdaystring(tmsg->arraytime[tmsg->cubesize - 1]));
-    strcpy(imkwarray[2].comment, "HH:MM:SS.SS UTC at exposure end");
-
-    // Modified Julian Date (MJD)
-
-
-    strcpy(imkwarray[3].name, "MJD");
-    imkwarray[3].type = 'D';
-    imkwarray[3].value.numf =
-        (0.5 * tmsg->arraytime[0] + 0.5 * tmsg->arraytime[tmsg->cubesize - 1]) /
-        86400.0 +
-        40587.0;
-    strcpy(imkwarray[3].comment, "Modified Julian Day at exposure");
-
-
-    strcpy(imkwarray[4].name, "MJD-STR");
-    imkwarray[4].type       = 'D';
-    imkwarray[4].value.numf = tmsg->arraytime[0] / 86400.0 + 40587.0;
-    strcpy(imkwarray[4].comment, "Modified Julian Day at exposure start");
-
-    strcpy(imkwarray[5].name, "MJD-END");
-    imkwarray[5].type = 'D';
-    imkwarray[5].value.numf =
-        (tmsg->arraytime[tmsg->cubesize - 1] / 86400.0) + 40587.0;
-    strcpy(imkwarray[5].comment, "Modified Julian Day at exposure end");
-
-    // Local time
-
-    // get time zone
-    //char tm_zone[] = "HST";
-    //double tm_utcoff = -36000; // HST = UTC - 10; Positive east of UTC.
-
-
-    // Causes a race condition with gettime in other thread, which result in occasional HST filenames...
-    //time_t t = time(NULL);
-    // OVERRIDE localtime to HST
-    //putenv("TZ=Pacific/Honolulu");
-    //struct tm lt = *localtime(&t);
-    //printf("TIMEZONE TIMEZONE %s\n", lt.tm_zone);
-    //putenv("TZ=");
-    //printf("TIMEZONE TIMEZONE %s\n", lt.tm_zone);
-
-
-    // printf("Offset to GMT is %lds.\n", lt.tm_gmtoff);
-    // printf("The time zone is '%s'.\n", lt.tm_zone);
-
-
-    sprintf(imkwarray[6].name, "%s", TZ_MILK_STR);
-    imkwarray[6].type = 'S';
-    strcpy(imkwarray[6].value.valstr,
-           timedouble_to_UTC_timeofdaystring(
-               (0.5 * tmsg->arraytime[0] +
-                0.5 * tmsg->arraytime[tmsg->cubesize - 1]) +
-               TZ_MILK_UTC_OFF));
-    sprintf(imkwarray[6].comment,
-            "HH:MM:SS.SS typical %s at exposure",
-            TZ_MILK_STR);
-
-    sprintf(imkwarray[7].name, "%s-STR", TZ_MILK_STR);
-    imkwarray[7].type = 'S';
-    strcpy(
-        imkwarray[7].value.valstr,
-        timedouble_to_UTC_timeofdaystring(tmsg->arraytime[0] + TZ_MILK_UTC_OFF));
-    sprintf(imkwarray[7].comment,
-            "HH:MM:SS.SS typical %s at exposure start",
-            TZ_MILK_STR);
-
-    sprintf(imkwarray[8].name, "%s-END", TZ_MILK_STR);
-    imkwarray[8].type = 'S';
-    strcpy(imkwarray[8].value.valstr,
-           timedouble_to_UTC_timeofdaystring(
-               tmsg->arraytime[tmsg->cubesize - 1] + TZ_MILK_UTC_OFF));
-    sprintf(imkwarray[8].comment,
-            "HH:MM:SS.SS typical %s at exposure end",
-            TZ_MILK_STR);
+    logshmim_timing_keywords(imkwarray,
+                             tmsg->arraytime[0],
+                             tmsg->arraytime[tmsg->cubesize - 1]);
 
 
 
@@ -467,14 +495,28 @@ static void *save_telemetry_fits_function(
     printf(">>>>>>>> [%5d] tmsg->iname  = \"%s\"\n", __LINE__, tmsg->iname);
 
 
-    saveFITS_opt_trunc(tmsg->iname,
-                       tmsg->partial ? tmsg->cubesize : -1,
-                       tmsg->fname,
-                       0,
-                       tmsg->fname_auxFITSheader,
-                       imkwarray,
-                       NBcustomKW,
-                       tmsg->compress_string);
+    if(tmsg->NBthread > 0)
+    {
+        saveFITS_parallel(tmsg->iname,
+                          tmsg->partial ? tmsg->cubesize : -1,
+                          tmsg->fname,
+                          tmsg->fname_auxFITSheader,
+                          imkwarray,
+                          NBcustomKW,
+                          tmsg->compress_string,
+                          tmsg->NBthread);
+    }
+    else
+    {
+        saveFITS_opt_trunc(tmsg->iname,
+                           tmsg->partial ? tmsg->cubesize : -1,
+                           tmsg->fname,
+                           0,
+                           tmsg->fname_auxFITSheader,
+                           imkwarray,
+                           NBcustomKW,
+                           tmsg->compress_string);
+    }
 
 
     free(imkwarray);
@@ -482,55 +524,35 @@ static void *save_telemetry_fits_function(
 
     if(tmsg->saveascii == 1)
     {
-        FILE *fp;
-
-        if((fp = fopen(tmsg->fnameascii, "w")) == NULL)
+        if(logshmim_timing_save_ascii(tmsg->fnameascii,
+                                      tmsg->cubesize,
+                                      tmsg->arrayindex,
+                                      tmsg->arraycnt0,
+                                      tmsg->arraycnt1,
+                                      tmsg->arraytime,
+                                      tmsg->arrayaqtime) != RETURN_SUCCESS)
         {
-            printf("ERROR: cannot create file \"%s\"\n", tmsg->fnameascii);
             exit(0);
         }
+    }
 
-        fprintf(fp, "# Telemetry stream timing data \n");
-        fprintf(fp,
-                "# File written by function %s in file %s\n",
-                __FUNCTION__,
-                __FILE__);
-        fprintf(fp, "# \n");
-        fprintf(fp, "# col1 : datacube frame index\n");
-        fprintf(fp, "# col2 : Main index\n");
-        fprintf(fp, "# col3 : Time since cube origin (logging)\n");
-        fprintf(fp, "# col4 : Absolute time (logging)\n");
-        fprintf(fp, "# col5 : Absolute time (acquisition)\n");
-        fprintf(fp, "# col6 : stream cnt0 index\n");
-        fprintf(fp, "# col7 : stream cnt1 index\n");
-        fprintf(fp, "# \n");
-
-        double t0; // time reference
-        t0 = tmsg->arraytime[0];
-        for(long k = 0; k < tmsg->cubesize; k++)
+    if(tmsg->savebintiming == 1)
+    {
+        if(logshmim_timing_save_binary(tmsg->fnametiming,
+                                       tmsg->cubesize,
+                                       tmsg->arrayindex,
+                                       tmsg->arraycnt0,
+                                       tmsg->arraycnt1,
+                                       tmsg->arraytime,
+                                       tmsg->arrayaqtime) == RETURN_SUCCESS)
         {
-            //fprintf(fp, "%6ld   %10lu  %10lu   %15.9lf\n", k, tmsg->arraycnt0[k], tmsg->arraycnt1[k], tmsg->arraytime[k]);
-
-            // entries are:
-            // - index within cube
-            // - loop index (if applicable)
-            // - time since cube start
-            // - time (absolute)
-            // - cnt0
-            // - cnt1
-
-            fprintf(
-                fp,
-                "%10ld  %10lu  %15.9lf   %20.9lf  %17.6lf   %10ld   %10ld\n",
-                k,
-                tmsg->arrayindex[k],
-                tmsg->arraytime[k] - t0,
-                tmsg->arraytime[k],
-                tmsg->arrayaqtime[k],
-                tmsg->arraycnt0[k],
-                tmsg->arraycnt1[k]);
+            logshmim_catalog_append(tmsg->fnamecatalog,
+                                    tmsg->fname,
+                                    tmsg->fnametiming,
+                                    tmsg->cubesize,
+                                    tmsg->arraycnt0,
+                                    tmsg->arraytime);
         }
-        fclose(fp);
     }
 
 
@@ -588,29 +610,53 @@ static errno_t compute_function()
     int buffindex = 0;
 
 
+    // Direct I/O mode: frames are copied to ring buffer, no log buffers
+    //
+    LOGDIO *ldio = NULL;
+    if((*directIO) == 1)
+    {
+        ldio = (LOGDIO *) malloc(sizeof(LOGDIO));
+        if(ldio == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+        if(logdio_init(ldio,
+                       datatype,
+                       xsize,
+                       ysize,
+                       (long)(*ringMB) * 1024 * 1024,
+                       (*writerRTprio)) != RETURN_SUCCESS)
+        {
+            free(ldio);
+            free(tmsg);
+            FUNC_RETURN_FAILURE("cannot start direct I/O writer");
+        }
+    }
+
+
     // Create 2 log buffers
     //
     IMGID imgbuff0;
+    IMGID imgbuff1;
+    if(ldio == NULL)
     {
         char name[STRINGMAXLEN_STREAMNAME];
         WRITE_IMAGENAME(name, "%s_logbuff0", streamname);
         imgbuff0 =
             stream_connect_create_3D(name, xsize, ysize, zsize, datatype);
-    }
-    IMGID imgbuff1;
-    {
-        char name[STRINGMAXLEN_STREAMNAME];
+
         WRITE_IMAGENAME(name, "%s_logbuff1", streamname);
         imgbuff1 =
             stream_connect_create_3D(name, xsize, ysize, zsize, datatype);
-    }
-
 
-    list_image_ID();
+        list_image_ID();
+    }
 
 
 
     // copy keywords
+    if(ldio == NULL)
     {
         printf("Cppying %d keywords\n", inimg.md->NBkw);
         if( inimg.md->NBkw > 0 )
@@ -660,6 +706,12 @@ static errno_t compute_function()
     char ASCIITIMEffilename[STRINGMAXLEN_FULLFILENAME];
     strcpy(ASCIITIMEffilename,"null");
 
+    char BINTIMEffilename[STRINGMAXLEN_FULLFILENAME];
+    strcpy(BINTIMEffilename,"null");
+
+    char CATALOGffilename[STRINGMAXLEN_FULLFILENAME];
+    strcpy(CATALOGffilename,"null");
+
 
 
     // array are zsize * 2 long to hold double buffer
@@ -683,6 +735,12 @@ static errno_t compute_function()
 
     uint64_t lastcnt0 = 0;
     int IsNewFrame = 0;
+    uint64_t nbnewframe = 1; // input frames since last iteration
+    uint64_t nbcarry    = 0; // frames left in rolling buffer at end of cube
+    double   tstatusmsg = 0.0; // last status message time
+
+    *dropcnt = 0;
+    *misscnt = 0;
 
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
@@ -694,7 +752,10 @@ static errno_t compute_function()
         }
         else
         {
-            if( lastcnt0 != inimg.md->cnt0)
+            uint64_t cnt0now = inimg.md->cnt0;
+            uint64_t cnt1now = inimg.md->cnt1;
+
+            if( lastcnt0 != cnt0now)
             {
                 // new frame has arrived
                 IsNewFrame = 1;
@@ -702,7 +763,16 @@ static errno_t compute_function()
               //  printf("<<<<<<<<<<<<<<<<<<<< RECEIVED NEW FRAME %ld >>>>>>>>>>>>>>>>\n", inimg.md->cnt0);
               //  fflush(stdout);
 
-                lastcnt0 = inimg.md->cnt0;
+                nbnewframe = 1;
+                if((lastcnt0 != 0) && (cnt0now > lastcnt0))
+                {
+                    nbnewframe = cnt0now - lastcnt0;
+                }
+                lastcnt0 = cnt0now;
+
+                // not logged at end of previous cube
+                nbnewframe += nbcarry;
+                nbcarry = 0;
             }
             else
             {
@@ -719,6 +789,8 @@ static errno_t compute_function()
                     lastcube = 0;
                     (*framecnt) = 0;
                     (*filecnt) = 0;
+                    (*dropcnt) = 0;
+                    (*misscnt) = 0;
                 }
 
 
@@ -788,89 +860,219 @@ static errno_t compute_function()
                             printf("    [%5d] ASCIITIMEffilename = %s\n", __LINE__, ASCIITIMEffilename);
                         }
 
+                        WRITE_FULLFILENAME(BINTIMEffilename,
+                                           "%s/%s_%02d:%02d:%02ld.%09ld.tim",
+                                           savedirname,
+                                           streamname,
+                                           uttimeStart->tm_hour,
+                                           uttimeStart->tm_min,
+                                           timenowStart.tv_sec % 60,
+                                           timenowStart.tv_nsec);
+
+                        WRITE_FULLFILENAME(CATALOGffilename,
+                                           "%s/%s.logcat",
+                                           savedirname,
+                                           streamname);
+
+                        if(VERBOSE > 0)
+                        {
+                            printf("    [%5d] BINTIMEffilename   = %s\n", __LINE__, BINTIMEffilename);
+                            printf("    [%5d] CATALOGffilename   = %s\n", __LINE__, CATALOGffilename);
+                        }
+
                         printf("================= CONSTRUCT FILE NAMES ===================================\n");
                         fflush(stdout);
                     }
 
 
-                    // timing buffer index
+                    if(ldio != NULL)
                     {
-                        long tindex = (*frameindex) + buffindex*(*cubesize);
+                        // if input is a rolling buffer, frames missed since
+                        // last iteration are still available in it, except
+                        // for the oldest slice that may be overwritten
+                        uint64_t NBslice = 1;
+                        if(inimg.md->naxis == 3)
+                        {
+                            NBslice = inimg.md->size[2];
+                        }
+                        uint64_t nblog = nbnewframe;
+                        if(nblog > NBslice - 1)
                         {
-                            array_cnt0[tindex] = inimg.md->cnt0;
-                            array_cnt1[tindex] = inimg.md->cnt1;
+                            nblog = NBslice - 1;
+                        }
+                        if(nblog < 1)
+                        {
+                            nblog = 1;
+                        }
+                        (*misscnt) += nbnewframe - nblog;
 
-                            // get current time
-                            struct timespec timenow;
-                            clock_gettime(CLOCK_MILK, &timenow);
-                            array_time[tindex] = timenow.tv_sec + 1.0e-9 * timenow.tv_nsec;
+                        // oldest frames fill current cube, newest are
+                        // logged in next cube if still in rolling buffer
+                        uint64_t nbnext = 0;
+                        if(nblog > (*cubesize) - (*frameindex))
+                        {
+                            nbnext = nblog - ((*cubesize) - (*frameindex));
+                            nblog  = (*cubesize) - (*frameindex);
+                        }
+
+                        if(((*frameindex) == 0) &&
+                                (logdio_cube_open(ldio,
+                                                  FITSffilename,
+                                                  (*asciitiming) ? ASCIITIMEffilename : "",
+                                                  (*bintiming) ? BINTIMEffilename : "",
+                                                  (*bintiming) ? CATALOGffilename : "",
+                                                  (*cubesize),
+                                                  inimg.im->kw,
+                                                  inimg.md->NBkw) != 0))
+                        {
+                            // previous cubes still being written
+                            (*dropcnt) += nblog;
+                            nblog = 0;
+                        }
+
+                        struct timespec timenow;
+                        clock_gettime(CLOCK_MILK, &timenow);
+                        double tnow = timenow.tv_sec + 1.0e-9 * timenow.tv_nsec;
+
+                        double aqtime = 0.0;
+                        if(aqtimekwi != -1)
+                        {
+                            aqtime = 1.0e-6 * inimg.im->kw[aqtimekwi].value.numl;
+                        }
+
+                        long framesize = typesize * xsize * ysize;
+
+                        // oldest first
+                        for(uint64_t k = nblog + nbnext; k > nbnext; k--)
+                        {
+                            uint64_t slice = 0;
+                            if(inimg.md->naxis == 3)
+                            {
+                                slice = (cnt1now + NBslice - (k - 1)) % NBslice;
+                            }
 
-                            if(aqtimekwi != -1)
+                            if(logdio_frame(ldio,
+                                            (char *) inimg.im->array.raw +
+                                            framesize * slice,
+                                            cnt0now - (k - 1),
+                                            slice,
+                                            tnow,
+                                            (k == 1) ? aqtime : 0.0) == 0)
                             {
-                                array_aqtime[tindex] =
-                                    1.0e-6 * inimg.im->kw[aqtimekwi].value.numl;
+                                (*frameindex) ++;
+                                (*framecnt) ++;
                             }
                             else
                             {
-                                array_aqtime[tindex] = 0.0;
+                                (*dropcnt) ++;
                             }
                         }
+
+                        nbcarry = nbnext;
+
+                        if(tnow - tstatusmsg > LOGSHMIM_MSGDT)
+                        {
+                            tstatusmsg = tnow;
+                            processinfo_WriteMessage_fmt(
+                                processinfo,
+                                "ring %3.0f%% file %lu frameindex %lu drop %lu",
+                                100.0 * logdio_ringfill(ldio),
+                                (*filecnt),
+                                (*frameindex),
+                                (*dropcnt));
+                        }
                     }
+                    else
+                    {
+                        // timing buffer index
+                        {
+                            long tindex = (*frameindex) + buffindex*(*cubesize);
+                            {
+                                array_cnt0[tindex] = inimg.md->cnt0;
+                                array_cnt1[tindex] = inimg.md->cnt1;
+
+                                // get current time
+                                struct timespec timenow;
+                                clock_gettime(CLOCK_MILK, &timenow);
+                                array_time[tindex] = timenow.tv_sec + 1.0e-9 * timenow.tv_nsec;
+
+                                if(aqtimekwi != -1)
+                                {
+                                    array_aqtime[tindex] =
+                                        1.0e-6 * inimg.im->kw[aqtimekwi].value.numl;
+                                }
+                                else
+                                {
+                                    array_aqtime[tindex] = 0.0;
+                                }
+                            }
+                        }
 
 
-                    // copy frame to buffer
+                        // copy frame to buffer
 
-                    {
+                        {
 
-                       // printf("[[copy frame %ld to frame %ld of buffer %d]]\n", inimg.md->cnt0, (*frameindex), buffindex);
-                       // fflush(stdout);
+                           // printf("[[copy frame %ld to frame %ld of buffer %d]]\n", inimg.md->cnt0, (*frameindex), buffindex);
+                           // fflush(stdout);
 
 
-                        long framesize = typesize * xsize * ysize;
+                            long framesize = typesize * xsize * ysize;
 
-                        char *ptr0_0; // source image data
-                        char *ptr0;   // source image data, after offset
+                            char *ptr0_0; // source image data
+                            char *ptr0;   // source image data, after offset
 
-                        ptr0_0 = (char *) inimg.im->array.raw;
-                        if( inimg.md->naxis == 3)
-                        {
-                            // this is a rolling buffer
-                            ptr0 = ptr0_0 + framesize * inimg.md->cnt1;
-                        }
-                        else
-                        {
-                            ptr0 = ptr0_0;
-                        }
+                            ptr0_0 = (char *) inimg.im->array.raw;
+                            if( inimg.md->naxis == 3)
+                            {
+                                // this is a rolling buffer
+                                ptr0 = ptr0_0 + framesize * inimg.md->cnt1;
+                            }
+                            else
+                            {
+                                ptr0 = ptr0_0;
+                            }
 
 
-                        char *ptr1_0; // destination image data
-                        char *ptr1;   // destination image data, after offset
-                        if(buffindex == 0 )
-                        {
-                            ptr1_0 = (char *) imgbuff0.im->array.raw;
-                        }
-                        else
-                        {
-                            ptr1_0 = (char *) imgbuff1.im->array.raw;
-                        }
-                        ptr1 = ptr1_0 + framesize * (*frameindex);
+                            char *ptr1_0; // destination image data
+                            char *ptr1;   // destination image data, after offset
+                            if(buffindex == 0 )
+                            {
+                                ptr1_0 = (char *) imgbuff0.im->array.raw;
+                            }
+                            else
+                            {
+                                ptr1_0 = (char *) imgbuff1.im->array.raw;
+                            }
+                            ptr1 = ptr1_0 + framesize * (*frameindex);
 
 
-                        memcpy((void *) ptr1, (void *) ptr0, framesize);
-                    }
+                            memcpy((void *) ptr1, (void *) ptr0, framesize);
+                        }
+
 
 
 
+                        (*misscnt) += nbnewframe - 1;
 
-                    processinfo_WriteMessage_fmt(
-                        processinfo,
-                        "buff %d file %lu frameindex %lu",
-                        buffindex,
-                        (*filecnt),
-                        (*frameindex));
+                        {
+                            double tnow =
+                                array_time[(*frameindex) + buffindex * (*cubesize)];
+                            if(tnow - tstatusmsg > LOGSHMIM_MSGDT)
+                            {
+                                tstatusmsg = tnow;
+                                processinfo_WriteMessage_fmt(
+                                    processinfo,
+                                    "buff %d file %lu frameindex %lu",
+                                    buffindex,
+                                    (*filecnt),
+                                    (*frameindex));
+                            }
+                        }
 
-                    (*frameindex) ++;
-                    (*framecnt) ++;
+                        (*frameindex) ++;
+                        (*framecnt) ++;
+                    }
                 }
                 else
                 {
@@ -918,7 +1120,13 @@ static errno_t compute_function()
 
         if(SaveCube == 1)
         {
-            if((*frameindex) > 0)
+            if(ldio != NULL)
+            {
+                // writer thread completes file, no wait
+                logdio_cube_close(ldio);
+                (*savetime) = ldio->savetime;
+            }
+            else if((*frameindex) > 0)
             {
                 // Saving buffer to filesystem
                 //
@@ -953,7 +1161,11 @@ static errno_t compute_function()
                     //
                     strcpy(tmsg->fname, FITSffilename);
                     strcpy(tmsg->fnameascii, ASCIITIMEffilename);
-                    tmsg->saveascii = 1;
+                    strcpy(tmsg->fnametiming, BINTIMEffilename);
+                    strcpy(tmsg->fnamecatalog, CATALOGffilename);
+                    tmsg->saveascii = (*asciitiming);
+                    tmsg->savebintiming = (*bintiming);
+                    tmsg->NBthread = (*writerNBthread);
                     tmsg->cubesize = (*frameindex);
 
                     if((*frameindex) != (*cubesize))
@@ -1071,13 +1283,16 @@ static errno_t compute_function()
 
             // report buffer is ready
             //
-            if(buffindex == 0 )
-            {
-                processinfo_update_output_stream(processinfo, imgbuff0.ID);
-            }
-            else
+            if(ldio == NULL)
             {
-                processinfo_update_output_stream(processinfo, imgbuff1.ID);
+                if(buffindex == 0 )
+                {
+                    processinfo_update_output_stream(processinfo, imgbuff0.ID);
+                }
+                else
+                {
+                    processinfo_update_output_stream(processinfo, imgbuff1.ID);
+                }
             }
 
 
@@ -1103,11 +1318,23 @@ static errno_t compute_function()
         }
 
 
+        if(ldio != NULL)
+        {
+            (*ringfill) = logdio_ringfill(ldio);
+        }
+
         saveON_last = (*saveON);
 
     }
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
+    if(ldio != NULL)
+    {
+        // complete current cube
+        logdio_free(ldio);
+        free(ldio);
+    }
+
     free(array_time);
     free(array_aqtime);
     free(array_cnt0);
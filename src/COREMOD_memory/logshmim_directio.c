@@ -0,0 +1,1021 @@
+/**
+ * @file    logshmim_directio.c
+ * @brief   direct I/O writer for streamFITSlog
+ *
+ * Frames are copied once, from the input stream into a ring of aligned
+ * blocks, converted to FITS byte order on the way. A writer thread appends
+ * full blocks to the cube file with O_DIRECT, bypassing the page cache.
+ *
+ * Cube file layout:
+ *
+ *   FITS header, LOGDIO_HDRSIZE byte, padded with blank cards
+ *   frames
+ *
+ * The header size is a multiple of both the FITS block size and
+ * LOGDIO_ALIGN, so that data blocks are written at aligned offsets. The
+ * file is preallocated for a full cube when opened. On close, the header
+ * is rewritten with the actual number of frames (NAXIS3) and timing
+ * keywords, and the file is truncated to its FITS size.
+ *
+ * The logger loop never waits on the writer: if the ring, or the set of
+ * cubes being written, is full, the frame is not logged and the caller
+ * counts it as dropped.
+ *
+ * Several LOGDIO may share a pool of writer threads (LOGDIO_POOL) instead
+ * of each running its own. A pool writer picks the pending LOGDIO of
+ * highest priority, ties going to the fullest ring, and writes up to
+ * LOGDIO_POOL_BATCH of its blocks before picking again.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "logshmim_directio.h"
+#include "logshmim_timing.h"
+
+// max block size, ring is split in at least 4 blocks
+#define LOGDIO_BLOCKSIZE (8 * 1024 * 1024)
+
+// blocks written by a pool writer before it reschedules
+#define LOGDIO_POOL_BATCH 4
+
+#define LOGDIO_ROUNDUP(n, m) ((((n) + (m) - 1) / (m)) * (m))
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LOGDIO_BSWAP16(x) (x)
+#define LOGDIO_BSWAP32(x) (x)
+#define LOGDIO_BSWAP64(x) (x)
+#else
+#define LOGDIO_BSWAP16(x) __builtin_bswap16(x)
+#define LOGDIO_BSWAP32(x) __builtin_bswap32(x)
+#define LOGDIO_BSWAP64(x) __builtin_bswap64(x)
+#endif
+
+/**
+ * @brief FITS BITPIX and BZERO of stream datatype
+ *
+ * Unsigned integer types other than uint8, and int8, are stored as the
+ * FITS signed type with offset BZERO, which amounts to flipping the sign
+ * bit.
+ */
+static errno_t logdio_fitstype(LOGDIO *ldio)
+{
+    DEBUG_TRACE_FSTART();
+
+    ldio->signmask = 0;
+    ldio->bzero[0] = '\0';
+
+    switch(ldio->datatype)
+    {
+        case _DATATYPE_UINT8:
+            ldio->bitpix = 8;
+            break;
+        case _DATATYPE_INT8:
+            ldio->bitpix   = 8;
+            ldio->signmask = 0x80;
+            strcpy(ldio->bzero, "-128");
+            break;
+        case _DATATYPE_UINT16:
+            ldio->bitpix   = 16;
+            ldio->signmask = 0x8000;
+            strcpy(ldio->bzero, "32768");
+            break;
+        case _DATATYPE_INT16:
+            ldio->bitpix = 16;
+            break;
+        case _DATATYPE_UINT32:
+            ldio->bitpix   = 32;
+            ldio->signmask = 0x80000000;
+            strcpy(ldio->bzero, "2147483648");
+            break;
+        case _DATATYPE_INT32:
+            ldio->bitpix = 32;
+            break;
+        case _DATATYPE_UINT64:
+            ldio->bitpix   = 64;
+            ldio->signmask = 0x8000000000000000;
+            strcpy(ldio->bzero, "9223372036854775808");
+            break;
+        case _DATATYPE_INT64:
+            ldio->bitpix = 64;
+            break;
+        case _DATATYPE_FLOAT:
+            ldio->bitpix = -32;
+            break;
+        case _DATATYPE_DOUBLE:
+            ldio->bitpix = -64;
+            break;
+        default:
+            FUNC_RETURN_FAILURE("datatype %d not supported",
+                                (int) ldio->datatype);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Copy pixels, converting to FITS (big endian) representation
+ */
+static void logdio_copy(LOGDIO *ldio, char *dst, const char *src, long nbyte)
+{
+    long nelem = nbyte / ldio->typesize;
+
+    switch(ldio->typesize)
+    {
+        case 1:
+            if(ldio->signmask == 0)
+            {
+                memcpy(dst, src, nbyte);
+            }
+            else
+            {
+                const uint8_t *s = (const uint8_t *) src;
+                uint8_t       *d = (uint8_t *) dst;
+                for(long ii = 0; ii < nelem; ii++)
+                {
+                    d[ii] = s[ii] ^ 0x80;
+                }
+            }
+            break;
+
+        case 2:
+        {
+            const uint16_t *s = (const uint16_t *) src;
+            uint16_t       *d = (uint16_t *) dst;
+            uint16_t        m = (uint16_t) ldio->signmask;
+            for(long ii = 0; ii < nelem; ii++)
+            {
+                d[ii] = LOGDIO_BSWAP16((uint16_t)(s[ii] ^ m));
+            }
+        }
+        break;
+
+        case 4:
+        {
+            const uint32_t *s = (const uint32_t *) src;
+            uint32_t       *d = (uint32_t *) dst;
+            uint32_t        m = (uint32_t) ldio->signmask;
+            for(long ii = 0; ii < nelem; ii++)
+            {
+                d[ii] = LOGDIO_BSWAP32(s[ii] ^ m);
+            }
+        }
+        break;
+
+        case 8:
+        {
+            const uint64_t *s = (const uint64_t *) src;
+            uint64_t       *d = (uint64_t *) dst;
+            uint64_t        m = ldio->signmask;
+            for(long ii = 0; ii < nelem; ii++)
+            {
+                d[ii] = LOGDIO_BSWAP64(s[ii] ^ m);
+            }
+        }
+        break;
+    }
+}
+
+// write 80-char header card, no terminating null
+static void logdio_card(char       *card,
+                        const char *name,
+                        const char *value,
+                        const char *comment)
+{
+    char buf[256];
+    int  len;
+
+    if(strlen(name) <= 8)
+    {
+        // fixed format: strings start in column 11, others end in column 30
+        len = snprintf(buf,
+                       256,
+                       (value[0] == '\'') ? "%-8s= %-20s / %s" : "%-8s= %20s / %s",
+                       name,
+                       value,
+                       comment);
+    }
+    else
+    {
+        len = snprintf(buf, 256, "HIERARCH %s = %s / %s", name, value, comment);
+    }
+    if(len > 80)
+    {
+        len = 80;
+    }
+    memset(card, ' ', 80);
+    memcpy(card, buf, len);
+}
+
+// header card from stream keyword, return 0 if keyword type not supported
+static int logdio_kwcard(char *card, IMAGE_KEYWORD *kw)
+{
+    char name[KEYWORD_MAX_STRING + 1];
+    char value[KEYWORD_MAX_STRING + 8];
+    char comment[KEYWORD_MAX_COMMENT + 1];
+
+    snprintf(name, KEYWORD_MAX_STRING + 1, "%s", kw->name);
+    snprintf(comment, KEYWORD_MAX_COMMENT + 1, "%s", kw->comment);
+
+    switch(kw->type)
+    {
+        case 'L':
+            snprintf(value, sizeof(value), "%ld", (long) kw->value.numl);
+            break;
+
+        case 'D':
+            snprintf(value, sizeof(value), "%#.15G", kw->value.numf);
+            break;
+
+        case 'S':
+        {
+            char str[KEYWORD_MAX_STRING + 1];
+            snprintf(str, KEYWORD_MAX_STRING + 1, "%s", kw->value.valstr);
+            for(char *c = str; *c != '\0'; c++)
+            {
+                if(*c == '\'')
+                {
+                    *c = '"';
+                }
+            }
+            snprintf(value, sizeof(value), "'%-8s'", str);
+        }
+        break;
+
+        default:
+            return 0;
+    }
+
+    logdio_card(card, name, value, comment);
+    return 1;
+}
+
+/**
+ * @brief Write cube FITS header
+ *
+ * If final is set, NAXIS3 is the number of frames written and timing
+ * keywords are added, otherwise NAXIS3 is the cube size.
+ */
+static void logdio_header(LOGDIO *ldio, LOGDIO_CUBE *cube, int final)
+{
+    char *hdr      = cube->hdr;
+    int   NBcardmax = LOGDIO_HDRSIZE / 80 - 1; // last card is END
+    int   NBcard    = 0;
+    char  value[32];
+
+    memset(hdr, ' ', LOGDIO_HDRSIZE);
+
+    logdio_card(hdr, "SIMPLE", "T", "conforms to FITS standard");
+    NBcard++;
+
+    snprintf(value, 32, "%d", ldio->bitpix);
+    logdio_card(hdr + 80 * NBcard++, "BITPIX", value, "array data type");
+    logdio_card(hdr + 80 * NBcard++, "NAXIS", "3", "number of array dimensions");
+    snprintf(value, 32, "%u", ldio->xsize);
+    logdio_card(hdr + 80 * NBcard++, "NAXIS1", value, "");
+    snprintf(value, 32, "%u", ldio->ysize);
+    logdio_card(hdr + 80 * NBcard++, "NAXIS2", value, "");
+    snprintf(value,
+             32,
+             "%ld",
+             (final == 1) ? cube->NBframe : cube->NBframemax);
+    logdio_card(hdr + 80 * NBcard++, "NAXIS3", value, "");
+    if(ldio->bzero[0] != '\0')
+    {
+        logdio_card(hdr + 80 * NBcard++,
+                    "BZERO",
+                    ldio->bzero,
+                    "offset data range to that of unsigned");
+        logdio_card(hdr + 80 * NBcard++, "BSCALE", "1", "default scaling factor");
+    }
+
+    if((final == 1) && (cube->NBframe > 0))
+    {
+        IMAGE_KEYWORD imkwarray[LOGSHMIM_NBTIMEKW];
+        int           NBtimekw =
+            logshmim_timing_keywords(imkwarray,
+                                     cube->arraytime[0],
+                                     cube->arraytime[cube->NBframe - 1]);
+        for(int kwi = 0; kwi < NBtimekw; kwi++)
+        {
+            NBcard += logdio_kwcard(hdr + 80 * NBcard, &imkwarray[kwi]);
+        }
+    }
+
+    for(int kwi = 0; (kwi < cube->NBkw) && (NBcard < NBcardmax); kwi++)
+    {
+        NBcard += logdio_kwcard(hdr + 80 * NBcard, &cube->kw[kwi]);
+    }
+
+    memcpy(hdr + 80 * NBcardmax, "END", 3);
+}
+
+static int logdio_pwrite(int fd, const char *buf, long nbyte, long offset)
+{
+    while(nbyte > 0)
+    {
+        ssize_t ws = pwrite(fd, buf, nbyte, offset);
+        if(ws < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buf += ws;
+        nbyte -= ws;
+        offset += ws;
+    }
+    return 0;
+}
+
+static void logdio_file_open(LOGDIO *ldio, LOGDIO_CUBE *cube)
+{
+    cube->offset = 0;
+
+    cube->fd =
+        open(cube->fname, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if((cube->fd == -1) && (errno == EINVAL))
+    {
+        // filesystem without O_DIRECT support (tmpfs)
+        cube->fd = open(cube->fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if(cube->fd == -1)
+    {
+        PRINT_ERROR("cannot create file %s", cube->fname);
+        ldio->nbwriteerr++;
+        return;
+    }
+
+    // preallocate full cube, ignore error if not supported
+    fallocate(cube->fd,
+              0,
+              0,
+              LOGDIO_HDRSIZE +
+              LOGDIO_ROUNDUP(cube->NBframemax * ldio->framesize, LOGDIO_ALIGN));
+
+    logdio_header(ldio, cube, 0);
+    if(logdio_pwrite(cube->fd, cube->hdr, LOGDIO_HDRSIZE, 0) != 0)
+    {
+        ldio->nbwriteerr++;
+    }
+}
+
+static void logdio_file_close(LOGDIO *ldio, LOGDIO_CUBE *cube)
+{
+    if(cube->fd != -1)
+    {
+        logdio_header(ldio, cube, 1);
+        if(logdio_pwrite(cube->fd, cube->hdr, LOGDIO_HDRSIZE, 0) != 0)
+        {
+            ldio->nbwriteerr++;
+        }
+        if(ftruncate(cube->fd,
+                     LOGDIO_HDRSIZE +
+                     LOGDIO_ROUNDUP(cube->NBframe * ldio->framesize, 2880)) !=
+                0)
+        {
+            ldio->nbwriteerr++;
+        }
+        close(cube->fd);
+        cube->fd = -1;
+    }
+
+    if(cube->fnameascii[0] != '\0')
+    {
+        logshmim_timing_save_ascii(cube->fnameascii,
+                                   cube->NBframe,
+                                   cube->arraycnt0,
+                                   cube->arraycnt0,
+                                   cube->arraycnt1,
+                                   cube->arraytime,
+                                   cube->arrayaqtime);
+    }
+
+    if((cube->fnametiming[0] != '\0') &&
+            (logshmim_timing_save_binary(cube->fnametiming,
+                                         cube->NBframe,
+                                         cube->arraycnt0,
+                                         cube->arraycnt0,
+                                         cube->arraycnt1,
+                                         cube->arraytime,
+                                         cube->arrayaqtime) == RETURN_SUCCESS) &&
+            (cube->fnamecatalog[0] != '\0'))
+    {
+        logshmim_catalog_append(cube->fnamecatalog,
+                                cube->fname,
+                                cube->fnametiming,
+                                cube->NBframe,
+                                cube->arraycnt0,
+                                cube->arraytime);
+    }
+
+    struct timespec tend;
+    clock_gettime(CLOCK_MILK, &tend);
+    ldio->savetime = 1.0 * (tend.tv_sec - cube->tclose.tv_sec) +
+                     1.0e-9 * (tend.tv_nsec - cube->tclose.tv_nsec);
+}
+
+// set writer thread real-time priority
+static void logdio_setRTprio(int RTprio)
+{
+    struct sched_param schedpar;
+    schedpar.sched_priority = RTprio;
+    if(seteuid(data.euid) != 0)  //This goes up to maximum privileges
+    {
+        PRINT_ERROR("seteuid error");
+    }
+    sched_setscheduler(0, SCHED_FIFO, &schedpar);
+    if(seteuid(data.ruid) != 0)  //Go back to normal privileges
+    {
+        PRINT_ERROR("seteuid error");
+    }
+}
+
+/**
+ * @brief Write next block
+ *
+ * @return 0 if no block pending, 1 otherwise
+ */
+static int logdio_write_block(LOGDIO *ldio)
+{
+    uint64_t blockcnt = __atomic_load_n(&ldio->blockcnt, __ATOMIC_ACQUIRE);
+    if(ldio->blockdone == blockcnt)
+    {
+        return 0;
+    }
+
+    long          b    = ldio->blockdone % ldio->NBblock;
+    LOGDIO_BLOCK *blk  = &ldio->block[b];
+    LOGDIO_CUBE  *cube = &ldio->cube[blk->cube % LOGDIO_NBCUBE];
+
+    if(blk->first == 1)
+    {
+        logdio_file_open(ldio, cube);
+    }
+    if(cube->fd != -1)
+    {
+        if(logdio_pwrite(cube->fd,
+                         ldio->ring + b * ldio->blocksize,
+                         LOGDIO_ROUNDUP(blk->len, LOGDIO_ALIGN),
+                         LOGDIO_HDRSIZE + cube->offset) != 0)
+        {
+            ldio->nbwriteerr++;
+        }
+    }
+    cube->offset += blk->len;
+
+    if(blk->last == 1)
+    {
+        logdio_file_close(ldio, cube);
+        __atomic_store_n(&ldio->cubedone,
+                         ldio->cubedone + 1,
+                         __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ldio->blockdone,
+                     ldio->blockdone + 1,
+                     __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/**
+ * @brief Writer thread, writes blocks in order until stopped
+ */
+static void *logdio_writer(void *ptr)
+{
+    LOGDIO *ldio = (LOGDIO *) ptr;
+
+    logdio_setRTprio(ldio->writerRTprio);
+
+    for(;;)
+    {
+        while((sem_wait(&ldio->semblock) == -1) && (errno == EINTR))
+        {
+        }
+
+        if((logdio_write_block(ldio) == 0) &&
+                (__atomic_load_n(&ldio->stop, __ATOMIC_ACQUIRE) == 1))
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// pending LOGDIO to be served next, NULL if none, pool lock held
+static LOGDIO *logdio_pool_select(LOGDIO_POOL *pool)
+{
+    LOGDIO *sel     = NULL;
+    long    selpend = 0;
+
+    for(int i = 0; i < pool->NBldio; i++)
+    {
+        LOGDIO *ldio = pool->ldio[i];
+        if(ldio->busy == 1)
+        {
+            continue;
+        }
+        long pend = __atomic_load_n(&ldio->blockcnt, __ATOMIC_ACQUIRE) -
+                    ldio->blockdone;
+        if(pend == 0)
+        {
+            continue;
+        }
+        // compare fill fractions, pend / NBblock
+        if((sel == NULL) || (ldio->prio > sel->prio) ||
+                ((ldio->prio == sel->prio) &&
+                 (pend * sel->NBblock > selpend * ldio->NBblock)))
+        {
+            sel     = ldio;
+            selpend = pend;
+        }
+    }
+
+    return sel;
+}
+
+/**
+ * @brief Pool writer thread, serves pool LOGDIO until stopped
+ */
+static void *logdio_pool_writer(void *ptr)
+{
+    LOGDIO_POOL *pool = (LOGDIO_POOL *) ptr;
+
+    logdio_setRTprio(pool->writerRTprio);
+
+    pthread_mutex_lock(&pool->lock);
+    for(;;)
+    {
+        LOGDIO *ldio = logdio_pool_select(pool);
+        if(ldio == NULL)
+        {
+            if(pool->stop == 1)
+            {
+                break;
+            }
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+
+        ldio->busy = 1;
+        pthread_mutex_unlock(&pool->lock);
+
+        for(int b = 0; b < LOGDIO_POOL_BATCH; b++)
+        {
+            if(logdio_write_block(ldio) == 0)
+            {
+                break;
+            }
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        ldio->busy = 0;
+        // remaining blocks may have been skipped by other writers
+        pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Start pool of writer threads
+ */
+errno_t logdio_pool_init(LOGDIO_POOL *pool, int NBwriter, int writerRTprio)
+{
+    DEBUG_TRACE_FSTART();
+
+    memset(pool, 0, sizeof(LOGDIO_POOL));
+    pool->NBwriter     = NBwriter;
+    pool->writerRTprio = writerRTprio;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    pool->thread = (pthread_t *) malloc(sizeof(pthread_t) * NBwriter);
+    if(pool->thread == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    for(int w = 0; w < NBwriter; w++)
+    {
+        if(pthread_create(&pool->thread[w], NULL, logdio_pool_writer, pool) !=
+                0)
+        {
+            pool->NBwriter = w;
+            logdio_pool_free(pool);
+            FUNC_RETURN_FAILURE("cannot create writer thread");
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Write all pending blocks, stop writer threads
+ *
+ * Cubes should be closed first, pool LOGDIO are then freed with
+ * logdio_free.
+ */
+errno_t logdio_pool_free(LOGDIO_POOL *pool)
+{
+    DEBUG_TRACE_FSTART();
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(int w = 0; w < pool->NBwriter; w++)
+    {
+        pthread_join(pool->thread[w], NULL);
+    }
+    free(pool->thread);
+    pool->thread = NULL;
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+// allocate ring buffer and cubes
+static errno_t logdio_alloc(LOGDIO  *ldio,
+                            uint8_t  datatype,
+                            uint32_t xsize,
+                            uint32_t ysize,
+                            long     ringsize)
+{
+    DEBUG_TRACE_FSTART();
+
+    memset(ldio, 0, sizeof(LOGDIO));
+    ldio->datatype = datatype;
+    FUNC_CHECK_RETURN(logdio_fitstype(ldio));
+    ldio->typesize  = ImageStreamIO_typesize(datatype);
+    ldio->xsize     = xsize;
+    ldio->ysize     = ysize;
+    ldio->framesize = (long) ldio->typesize * xsize * ysize;
+
+    ldio->blocksize = (ringsize / 4) / LOGDIO_ALIGN * LOGDIO_ALIGN;
+    if(ldio->blocksize > LOGDIO_BLOCKSIZE)
+    {
+        ldio->blocksize = LOGDIO_BLOCKSIZE;
+    }
+    if(ldio->blocksize < LOGDIO_ALIGN)
+    {
+        ldio->blocksize = LOGDIO_ALIGN;
+    }
+    ldio->NBblock = ringsize / ldio->blocksize;
+    if(ldio->NBblock < 4)
+    {
+        ldio->NBblock = 4;
+    }
+
+    if(posix_memalign((void **) &ldio->ring,
+                      LOGDIO_ALIGN,
+                      ldio->blocksize * ldio->NBblock) != 0)
+    {
+        FUNC_RETURN_FAILURE("cannot allocate %ld byte ring buffer",
+                            ldio->blocksize * ldio->NBblock);
+    }
+    // fault pages in now rather than in the logging loop
+    memset(ldio->ring, 0, ldio->blocksize * ldio->NBblock);
+
+    ldio->block = (LOGDIO_BLOCK *) calloc(ldio->NBblock, sizeof(LOGDIO_BLOCK));
+    if(ldio->block == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    for(int c = 0; c < LOGDIO_NBCUBE; c++)
+    {
+        ldio->cube[c].fd = -1;
+        if(posix_memalign((void **) &ldio->cube[c].hdr,
+                          LOGDIO_ALIGN,
+                          LOGDIO_HDRSIZE) != 0)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+    }
+
+    printf("direct I/O ring buffer: %ld blocks x %ld byte\n",
+           ldio->NBblock,
+           ldio->blocksize);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Allocate ring buffer and start writer thread
+ *
+ * @param ringsize  ring buffer size [byte]
+ */
+errno_t logdio_init(LOGDIO  *ldio,
+                    uint8_t  datatype,
+                    uint32_t xsize,
+                    uint32_t ysize,
+                    long     ringsize,
+                    int      writerRTprio)
+{
+    DEBUG_TRACE_FSTART();
+
+    FUNC_CHECK_RETURN(logdio_alloc(ldio, datatype, xsize, ysize, ringsize));
+    ldio->writerRTprio = writerRTprio;
+
+    sem_init(&ldio->semblock, 0, 0);
+    if(pthread_create(&ldio->thread, NULL, logdio_writer, ldio) != 0)
+    {
+        FUNC_RETURN_FAILURE("cannot create writer thread");
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Allocate ring buffer, written by pool writers
+ *
+ * @param prio  scheduling priority within pool, higher first
+ */
+errno_t logdio_init_pool(LOGDIO      *ldio,
+                         uint8_t      datatype,
+                         uint32_t     xsize,
+                         uint32_t     ysize,
+                         long         ringsize,
+                         LOGDIO_POOL *pool,
+                         int          prio)
+{
+    DEBUG_TRACE_FSTART();
+
+    FUNC_CHECK_RETURN(logdio_alloc(ldio, datatype, xsize, ysize, ringsize));
+    ldio->pool = pool;
+    ldio->prio = prio;
+
+    pthread_mutex_lock(&pool->lock);
+    if(pool->NBldio == LOGDIO_POOL_NBMAX)
+    {
+        pthread_mutex_unlock(&pool->lock);
+        FUNC_RETURN_FAILURE("writer pool full, max %d", LOGDIO_POOL_NBMAX);
+    }
+    pool->ldio[pool->NBldio] = ldio;
+    pool->NBldio++;
+    pthread_mutex_unlock(&pool->lock);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Start new cube
+ *
+ * Stream keywords are copied to the cube header.
+ *
+ * @return 0 if OK, 1 if all cubes are being written
+ */
+int logdio_cube_open(LOGDIO        *ldio,
+                     const char    *fname,
+                     const char    *fnameascii,
+                     const char    *fnametiming,
+                     const char    *fnamecatalog,
+                     long           NBframemax,
+                     IMAGE_KEYWORD *kw,
+                     int            NBkw)
+{
+    if(ldio->cubeopen == 1)
+    {
+        logdio_cube_close(ldio);
+    }
+
+    if(ldio->cubecnt >=
+            __atomic_load_n(&ldio->cubedone, __ATOMIC_ACQUIRE) + LOGDIO_NBCUBE)
+    {
+        return 1;
+    }
+
+    LOGDIO_CUBE *cube = &ldio->cube[ldio->cubecnt % LOGDIO_NBCUBE];
+
+    strncpy(cube->fname, fname, STRINGMAXLEN_FULLFILENAME - 1);
+    strncpy(cube->fnameascii, fnameascii, STRINGMAXLEN_FULLFILENAME - 1);
+    strncpy(cube->fnametiming, fnametiming, STRINGMAXLEN_FULLFILENAME - 1);
+    strncpy(cube->fnamecatalog, fnamecatalog, STRINGMAXLEN_FULLFILENAME - 1);
+
+    if(NBframemax > cube->NBframealloc)
+    {
+        cube->arraycnt0 =
+            (uint64_t *) realloc(cube->arraycnt0, sizeof(uint64_t) * NBframemax);
+        cube->arraycnt1 =
+            (uint64_t *) realloc(cube->arraycnt1, sizeof(uint64_t) * NBframemax);
+        cube->arraytime =
+            (double *) realloc(cube->arraytime, sizeof(double) * NBframemax);
+        cube->arrayaqtime =
+            (double *) realloc(cube->arrayaqtime, sizeof(double) * NBframemax);
+        if((cube->arraycnt0 == NULL) || (cube->arraycnt1 == NULL) ||
+                (cube->arraytime == NULL) || (cube->arrayaqtime == NULL))
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+        cube->NBframealloc = NBframemax;
+    }
+    cube->NBframemax = NBframemax;
+    cube->NBframe    = 0;
+
+    cube->kw =
+        (IMAGE_KEYWORD *) realloc(cube->kw, sizeof(IMAGE_KEYWORD) * (NBkw + 1));
+    if(cube->kw == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    memcpy(cube->kw, kw, sizeof(IMAGE_KEYWORD) * NBkw);
+    cube->NBkw = NBkw;
+
+    ldio->cubecnt++;
+    ldio->cubeopen   = 1;
+    ldio->blockfirst = 1;
+
+    return 0;
+}
+
+// hand current block to writer
+static void logdio_block_handover(LOGDIO *ldio, int last)
+{
+    long          b   = ldio->blockcnt % ldio->NBblock;
+    LOGDIO_BLOCK *blk = &ldio->block[b];
+
+    if(last == 1)
+    {
+        // zero padding up to aligned size
+        memset(ldio->ring + b * ldio->blocksize + ldio->blockfill,
+               0,
+               LOGDIO_ROUNDUP(ldio->blockfill, LOGDIO_ALIGN) - ldio->blockfill);
+    }
+
+    blk->len   = ldio->blockfill;
+    blk->cube  = ldio->cubecnt - 1;
+    blk->first = ldio->blockfirst;
+    blk->last  = last;
+
+    ldio->blockfirst = 0;
+    ldio->blockfill  = 0;
+    __atomic_store_n(&ldio->blockcnt, ldio->blockcnt + 1, __ATOMIC_RELEASE);
+    if(ldio->pool != NULL)
+    {
+        pthread_mutex_lock(&ldio->pool->lock);
+        pthread_cond_signal(&ldio->pool->cond);
+        pthread_mutex_unlock(&ldio->pool->lock);
+    }
+    else
+    {
+        sem_post(&ldio->semblock);
+    }
+}
+
+/**
+ * @brief Append frame to current cube
+ *
+ * @return 0 if OK, 1 if frame could not be logged (ring buffer full)
+ */
+int logdio_frame(LOGDIO     *ldio,
+                 const char *src,
+                 uint64_t    cnt0,
+                 uint64_t    cnt1,
+                 double      time,
+                 double      aqtime)
+{
+    if(ldio->cubeopen == 0)
+    {
+        return 1;
+    }
+    LOGDIO_CUBE *cube = &ldio->cube[(ldio->cubecnt - 1) % LOGDIO_NBCUBE];
+    if(cube->NBframe >= cube->NBframemax)
+    {
+        return 1;
+    }
+
+    // last block needed must not be in use by writer
+    uint64_t blockdone = __atomic_load_n(&ldio->blockdone, __ATOMIC_ACQUIRE);
+    uint64_t pos       = ldio->blockcnt * ldio->blocksize + ldio->blockfill;
+    if((pos + ldio->framesize - 1) / ldio->blocksize >=
+            blockdone + ldio->NBblock)
+    {
+        return 1;
+    }
+
+    long nbyte = ldio->framesize;
+    while(nbyte > 0)
+    {
+        if(ldio->blockfill == ldio->blocksize)
+        {
+            logdio_block_handover(ldio, 0);
+        }
+        long n = ldio->blocksize - ldio->blockfill;
+        if(n > nbyte)
+        {
+            n = nbyte;
+        }
+        logdio_copy(ldio,
+                    ldio->ring +
+                    (ldio->blockcnt % ldio->NBblock) * ldio->blocksize +
+                    ldio->blockfill,
+                    src,
+                    n);
+        ldio->blockfill += n;
+        src += n;
+        nbyte -= n;
+    }
+
+    cube->arraycnt0[cube->NBframe]   = cnt0;
+    cube->arraycnt1[cube->NBframe]   = cnt1;
+    cube->arraytime[cube->NBframe]   = time;
+    cube->arrayaqtime[cube->NBframe] = aqtime;
+    cube->NBframe++;
+
+    return 0;
+}
+
+/**
+ * @brief Close current cube, writer completes file asynchronously
+ */
+errno_t logdio_cube_close(LOGDIO *ldio)
+{
+    if(ldio->cubeopen == 0)
+    {
+        return RETURN_SUCCESS;
+    }
+    ldio->cubeopen = 0;
+
+    LOGDIO_CUBE *cube = &ldio->cube[(ldio->cubecnt - 1) % LOGDIO_NBCUBE];
+    if(cube->NBframe == 0)
+    {
+        // nothing handed to writer, release cube
+        ldio->cubecnt--;
+        return RETURN_SUCCESS;
+    }
+
+    clock_gettime(CLOCK_MILK, &cube->tclose);
+    logdio_block_handover(ldio, 1);
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Fraction of ring buffer waiting to be written
+ */
+float logdio_ringfill(LOGDIO *ldio)
+{
+    uint64_t blockdone = __atomic_load_n(&ldio->blockdone, __ATOMIC_ACQUIRE);
+    return 1.0 * (ldio->blockcnt - blockdone) / ldio->NBblock;
+}
+
+/**
+ * @brief Close current cube, wait for writer to complete, free
+ *
+ * Pool LOGDIO are freed after logdio_pool_free.
+ */
+errno_t logdio_free(LOGDIO *ldio)
+{
+    DEBUG_TRACE_FSTART();
+
+    logdio_cube_close(ldio);
+
+    if(ldio->pool == NULL)
+    {
+        __atomic_store_n(&ldio->stop, 1, __ATOMIC_RELEASE);
+        sem_post(&ldio->semblock);
+        pthread_join(ldio->thread, NULL);
+        sem_destroy(&ldio->semblock);
+    }
+
+    for(int c = 0; c < LOGDIO_NBCUBE; c++)
+    {
+        free(ldio->cube[c].hdr);
+        free(ldio->cube[c].kw);
+        free(ldio->cube[c].arraycnt0);
+        free(ldio->cube[c].arraycnt1);
+        free(ldio->cube[c].arraytime);
+        free(ldio->cube[c].arrayaqtime);
+    }
+    free(ldio->block);
+    free(ldio->ring);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file    logshmim_directio.h
+ */
+
+#ifndef CLICORE_MEMORY_LOGSHMIM_DIRECTIO_H
+#define CLICORE_MEMORY_LOGSHMIM_DIRECTIO_H
+
+#include "shmimlog_types.h"
+
+errno_t logdio_init(LOGDIO  *ldio,
+                    uint8_t  datatype,
+                    uint32_t xsize,
+                    uint32_t ysize,
+                    long     ringsize,
+                    int      writerRTprio);
+
+errno_t logdio_init_pool(LOGDIO      *ldio,
+                         uint8_t      datatype,
+                         uint32_t     xsize,
+                         uint32_t     ysize,
+                         long         ringsize,
+                         LOGDIO_POOL *pool,
+                         int          prio);
+
+errno_t logdio_pool_init(LOGDIO_POOL *pool, int NBwriter, int writerRTprio);
+
+errno_t logdio_pool_free(LOGDIO_POOL *pool);
+
+int logdio_cube_open(LOGDIO        *ldio,
+                     const char    *fname,
+                     const char    *fnameascii,
+                     const char    *fnametiming,
+                     const char    *fnamecatalog,
+                     long           NBframemax,
+                     IMAGE_KEYWORD *kw,
+                     int            NBkw);
+
+int logdio_frame(LOGDIO     *ldio,
+                 const char *src,
+                 uint64_t    cnt0,
+                 uint64_t    cnt1,
+                 double      time,
+                 double      aqtime);
+
+errno_t logdio_cube_close(LOGDIO *ldio);
+
+float logdio_ringfill(LOGDIO *ldio);
+
+errno_t logdio_free(LOGDIO *ldio);
+
+#endif
@@ -0,0 +1,728 @@
+/**
+ * @file    logshmim_multi.c
+ * @brief   log several streams to FITS cubes, shared writer pool
+ *
+ * One logger process for N streams, instead of one streamFITSlog process
+ * per stream:
+ *
+ *   logger loop  : polls cnt0 of each stream, copies new frames to the
+ *                  stream direct I/O ring buffer (see logshmim_directio.c)
+ *   writer pool  : .NBwriter threads write ring buffer blocks of all
+ *                  streams, higher stream priority first
+ *
+ * Each stream has its own ring buffer, so that a stream with a full
+ * ring drops frames without blocking the others.
+ *
+ * Stream list file, one stream per line :
+ *
+ *   <streamname> [priority [cubesize]]
+ *
+ * Lines starting with # are ignored. Default priority is 0, default
+ * cubesize is .cubesize.
+ *
+ * With .cubedt > 0, cubes of all streams are closed on the same
+ * boundaries, multiples of .cubedt in unix time, and the first cube of
+ * each stream in an interval is named after the interval start time, so
+ * that cubes covering the same time window have the same name. A cube
+ * filled before the boundary is followed by a new cube named after its
+ * start time.
+ *
+ * File names, timing files and catalog are the same as streamFITSlog.
+ */
+
+#include <math.h>
+#include <time.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "logshmim_directio.h"
+
+// max number of streams
+#define LOGMULTI_NBSTREAMMAX LOGDIO_POOL_NBMAX
+
+typedef struct
+{
+    char     sname[STRINGMAXLEN_STREAMNAME];
+    int      prio;
+    uint64_t cubesize;
+
+    IMGID    img;
+    int      aqtimekwi; // _MAQTIME keyword index, -1 if none
+    uint64_t lastcnt0;
+
+    LOGDIO   ldio;
+    int      cubeopen;
+    uint64_t frameindex; // frame index within cube
+    int64_t  period;     // last interval for which a cube was named
+
+    uint64_t framecnt;
+    uint64_t filecnt;
+    uint64_t dropcnt;
+    uint64_t misscnt;
+} LOGMULTI_STREAM;
+
+static char *streamlistfname;
+
+static char *savedirname;
+
+static int64_t *saveON;
+static long     fpi_saveON = -1;
+
+static uint64_t *cubesize;
+static long      fpi_cubesize = -1;
+
+static double *cubedt;
+static long    fpi_cubedt = -1;
+
+static uint32_t *NBwriter;
+static long      fpi_NBwriter = -1;
+
+static uint32_t *ringMB;
+static long      fpi_ringMB = -1;
+
+static uint32_t *writerRTprio;
+static long      fpi_writerRTprio = -1;
+
+static uint32_t *pollus;
+static long      fpi_pollus = -1;
+
+static int64_t *asciitiming;
+static long     fpi_asciitiming = -1;
+
+static int64_t *bintiming;
+static long     fpi_bintiming = -1;
+
+static uint64_t *NBstream;
+static long      fpi_NBstream = -1;
+
+static uint64_t *framecnt;
+static long      fpi_framecnt = -1;
+
+static uint64_t *filecnt;
+static long      fpi_filecnt = -1;
+
+static uint64_t *dropcnt;
+static long      fpi_dropcnt = -1;
+
+static uint64_t *misscnt;
+static long      fpi_misscnt = -1;
+
+static float *ringfill;
+static long   fpi_ringfill = -1;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STR,
+        ".streamlist",
+        "stream list file",
+        "streamlog.conf",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &streamlistfname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".dirname",
+        "log directory",
+        "/mnt/datalog/",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &savedirname,
+        NULL
+    },
+    {
+        CLIARG_ONOFF,
+        ".saveON",
+        "toggle save on/off",
+        "0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &saveON,
+        &fpi_saveON
+    },
+    {
+        CLIARG_UINT64,
+        ".cubesize",
+        "default max number of frames per cube",
+        "10000",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &cubesize,
+        &fpi_cubesize
+    },
+    {
+        CLIARG_FLOAT64,
+        ".cubedt",
+        "aligned cube rollover interval [s], 0 if none",
+        "10",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &cubedt,
+        &fpi_cubedt
+    },
+    {
+        CLIARG_UINT32,
+        ".NBwriter",
+        "number of writer threads",
+        "4",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &NBwriter,
+        &fpi_NBwriter
+    },
+    {
+        CLIARG_UINT32,
+        ".ringMB",
+        "ring buffer size per stream [MB]",
+        "256",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &ringMB,
+        &fpi_ringMB
+    },
+    {
+        CLIARG_UINT32,
+        ".writerRTprio",
+        "writer real-time priority",
+        "10",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &writerRTprio,
+        &fpi_writerRTprio
+    },
+    {
+        CLIARG_UINT32,
+        ".pollus",
+        "stream poll interval [us]",
+        "10",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &pollus,
+        &fpi_pollus
+    },
+    {
+        CLIARG_ONOFF,
+        ".asciitiming",
+        "write ASCII timing file",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &asciitiming,
+        &fpi_asciitiming
+    },
+    {
+        CLIARG_ONOFF,
+        ".bintiming",
+        "write binary timing file and catalog entry",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &bintiming,
+        &fpi_bintiming
+    },
+    {
+        CLIARG_UINT64,
+        ".NBstream",
+        "number of streams logged (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBstream,
+        &fpi_NBstream
+    },
+    {
+        CLIARG_UINT64,
+        ".framecnt",
+        "frames logged, all streams (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &framecnt,
+        &fpi_framecnt
+    },
+    {
+        CLIARG_UINT64,
+        ".filecnt",
+        "cubes written, all streams (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &filecnt,
+        &fpi_filecnt
+    },
+    {
+        CLIARG_UINT64,
+        ".dropcnt",
+        "frames dropped, ring buffer full (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &dropcnt,
+        &fpi_dropcnt
+    },
+    {
+        CLIARG_UINT64,
+        ".misscnt",
+        "input frames missed (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &misscnt,
+        &fpi_misscnt
+    },
+    {
+        CLIARG_FLOAT32,
+        ".ringfill",
+        "max ring buffer fill fraction (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &ringfill,
+        &fpi_ringfill
+    }
+};
+
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        // can toggle while running
+        data.fpsptr->parray[fpi_saveON].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_cubedt].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_pollus].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_asciitiming].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_bintiming].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t customCONFcheck()
+{
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamFITSlogmulti",
+    "log streams to FITS files, shared writer pool",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Log several streams to FITS cubes from a single process\n");
+    printf("Stream list file, one stream per line:\n");
+    printf("  <streamname> [priority [cubesize]]\n");
+    printf("Frames are written in direct I/O mode (see streamFITSlog)\n");
+    printf("  by a pool of .NBwriter threads, higher priority first\n");
+    printf("With .cubedt > 0, cubes of all streams roll over together\n");
+    printf("  at multiples of .cubedt [s] in unix time\n");
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Read stream list file
+ *
+ * @return number of streams, -1 on error
+ */
+static long logmulti_readlist(const char      *fname,
+                              LOGMULTI_STREAM *st,
+                              uint64_t         cubesizedefault)
+{
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL)
+    {
+        PRINT_ERROR("cannot open stream list \"%s\"", fname);
+        return -1;
+    }
+
+    long NB = 0;
+    char line[STRINGMAXLEN_DEFAULT];
+    while(fgets(line, STRINGMAXLEN_DEFAULT, fp) != NULL)
+    {
+        char          sname[STRINGMAXLEN_STREAMNAME];
+        int           prio  = 0;
+        unsigned long csize = cubesizedefault;
+
+        if(line[0] == '#')
+        {
+            continue;
+        }
+        int n = sscanf(line, "%99s %d %lu", sname, &prio, &csize);
+        if(n < 1)
+        {
+            continue;
+        }
+        if(NB == LOGMULTI_NBSTREAMMAX)
+        {
+            PRINT_WARNING("max %d streams, ignoring %s",
+                          LOGMULTI_NBSTREAMMAX,
+                          sname);
+            continue;
+        }
+
+        memset(&st[NB], 0, sizeof(LOGMULTI_STREAM));
+        strncpy(st[NB].sname, sname, STRINGMAXLEN_STREAMNAME - 1);
+        st[NB].prio     = prio;
+        st[NB].cubesize = (csize > 0) ? csize : cubesizedefault;
+        st[NB].period   = -1;
+        NB++;
+    }
+    fclose(fp);
+
+    return NB;
+}
+
+// file names of cube starting at time tname
+static void logmulti_cube_open(LOGMULTI_STREAM *st, double tname)
+{
+    time_t    tsec = (time_t) tname;
+    long      tns  = (long)((tname - tsec) * 1.0e9 + 0.5);
+    struct tm uttime;
+    if(tns > 999999999)
+    {
+        tns = 999999999;
+    }
+    gmtime_r(&tsec, &uttime);
+
+    char fname[STRINGMAXLEN_FULLFILENAME];
+    char fnameascii[STRINGMAXLEN_FULLFILENAME];
+    char fnametiming[STRINGMAXLEN_FULLFILENAME];
+    char fnamecatalog[STRINGMAXLEN_FULLFILENAME];
+
+    WRITE_FULLFILENAME(fname,
+                       "%s/%s_%02d:%02d:%02ld.%09ld.fits",
+                       savedirname,
+                       st->sname,
+                       uttime.tm_hour,
+                       uttime.tm_min,
+                       (long) tsec % 60,
+                       tns);
+    WRITE_FULLFILENAME(fnameascii,
+                       "%s/%s_%02d:%02d:%02ld.%09ld.txt",
+                       savedirname,
+                       st->sname,
+                       uttime.tm_hour,
+                       uttime.tm_min,
+                       (long) tsec % 60,
+                       tns);
+    WRITE_FULLFILENAME(fnametiming,
+                       "%s/%s_%02d:%02d:%02ld.%09ld.tim",
+                       savedirname,
+                       st->sname,
+                       uttime.tm_hour,
+                       uttime.tm_min,
+                       (long) tsec % 60,
+                       tns);
+    WRITE_FULLFILENAME(fnamecatalog, "%s/%s.logcat", savedirname, st->sname);
+
+    if(logdio_cube_open(&st->ldio,
+                        fname,
+                        (*asciitiming) ? fnameascii : "",
+                        (*bintiming) ? fnametiming : "",
+                        (*bintiming) ? fnamecatalog : "",
+                        st->cubesize,
+                        st->img.im->kw,
+                        st->img.md->NBkw) == 0)
+    {
+        st->cubeopen   = 1;
+        st->frameindex = 0;
+    }
+}
+
+static void logmulti_cube_close(LOGMULTI_STREAM *st)
+{
+    if(st->cubeopen == 1)
+    {
+        logdio_cube_close(&st->ldio);
+        st->cubeopen = 0;
+        if(st->frameindex > 0)
+        {
+            st->filecnt++;
+        }
+    }
+}
+
+/**
+ * @brief Log new frames of stream
+ *
+ * @param tcube  interval start time, -1 if cubes are not aligned
+ */
+static void logmulti_stream_update(LOGMULTI_STREAM *st,
+                                   double           tnow,
+                                   int64_t          period,
+                                   double           tcube)
+{
+    uint64_t cnt0now = st->img.md->cnt0;
+    uint64_t cnt1now = st->img.md->cnt1;
+
+    if(cnt0now == st->lastcnt0)
+    {
+        return;
+    }
+    uint64_t nbnewframe = 1;
+    if((st->lastcnt0 != 0) && (cnt0now > st->lastcnt0))
+    {
+        nbnewframe = cnt0now - st->lastcnt0;
+    }
+    st->lastcnt0 = cnt0now;
+
+    if((*saveON) == 0)
+    {
+        return;
+    }
+
+    // if input is a rolling buffer, frames missed since last iteration are
+    // still available in it, except for the oldest slice that may be
+    // overwritten
+    uint64_t NBslice = 1;
+    if(st->img.md->naxis == 3)
+    {
+        NBslice = st->img.md->size[2];
+    }
+    uint64_t nblog = nbnewframe;
+    if(nblog > NBslice - 1)
+    {
+        nblog = NBslice - 1;
+    }
+    if(nblog < 1)
+    {
+        nblog = 1;
+    }
+    st->misscnt += nbnewframe - nblog;
+
+    double aqtime = 0.0;
+    if(st->aqtimekwi != -1)
+    {
+        aqtime = 1.0e-6 * st->img.im->kw[st->aqtimekwi].value.numl;
+    }
+
+    // oldest first
+    for(uint64_t k = nblog; k > 0; k--)
+    {
+        if((st->cubeopen == 1) && (st->frameindex == st->cubesize))
+        {
+            logmulti_cube_close(st);
+        }
+        if(st->cubeopen == 0)
+        {
+            // first cube of interval named after interval start
+            if((tcube >= 0.0) && (st->period != period))
+            {
+                logmulti_cube_open(st, tcube);
+            }
+            else
+            {
+                logmulti_cube_open(st, tnow);
+            }
+            st->period = period;
+        }
+        if(st->cubeopen == 0)
+        {
+            // previous cubes still being written
+            st->dropcnt += k;
+            break;
+        }
+
+        uint64_t slice = 0;
+        if(st->img.md->naxis == 3)
+        {
+            slice = (cnt1now + NBslice - (k - 1)) % NBslice;
+        }
+
+        if(logdio_frame(&st->ldio,
+                        (char *) st->img.im->array.raw +
+                        st->ldio.framesize * slice,
+                        cnt0now - (k - 1),
+                        slice,
+                        tnow,
+                        (k == 1) ? aqtime : 0.0) == 0)
+        {
+            st->frameindex++;
+            st->framecnt++;
+        }
+        else
+        {
+            st->dropcnt++;
+        }
+    }
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    LOGMULTI_STREAM *st = (LOGMULTI_STREAM *) malloc(
+                              sizeof(LOGMULTI_STREAM) * LOGMULTI_NBSTREAMMAX);
+    if(st == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    long NBst = logmulti_readlist(streamlistfname, st, *cubesize);
+    if(NBst < 1)
+    {
+        free(st);
+        FUNC_RETURN_FAILURE("no stream to log in \"%s\"", streamlistfname);
+    }
+
+    LOGDIO_POOL pool;
+    if(logdio_pool_init(&pool, (*NBwriter > 0) ? *NBwriter : 1,
+                        *writerRTprio) != RETURN_SUCCESS)
+    {
+        free(st);
+        FUNC_RETURN_FAILURE("cannot start writer pool");
+    }
+
+    // connect to streams
+    long NBinit = 0;
+    for(long s = 0; s < NBst; s++)
+    {
+        st[s].img = mkIMGID_from_name(st[s].sname);
+        if(resolveIMGID(&st[s].img, ERRMODE_WARN) == -1)
+        {
+            break;
+        }
+
+        st[s].aqtimekwi = -1;
+        for(int kwi = 0; kwi < st[s].img.md->NBkw; kwi++)
+        {
+            if(strcmp(st[s].img.im->kw[kwi].name, "_MAQTIME") == 0)
+            {
+                st[s].aqtimekwi = kwi;
+            }
+        }
+
+        if(logdio_init_pool(&st[s].ldio,
+                            st[s].img.md->datatype,
+                            st[s].img.md->size[0],
+                            st[s].img.md->size[1],
+                            (long)(*ringMB) * 1024 * 1024,
+                            &pool,
+                            st[s].prio) != RETURN_SUCCESS)
+        {
+            break;
+        }
+        NBinit++;
+
+        printf("stream %-32s  prio %3d  cubesize %lu\n",
+               st[s].sname,
+               st[s].prio,
+               (unsigned long) st[s].cubesize);
+    }
+    if(NBinit < NBst)
+    {
+        char sname[STRINGMAXLEN_STREAMNAME];
+        strcpy(sname, st[NBinit].sname);
+
+        logdio_pool_free(&pool);
+        for(long s = 0; s < NBinit; s++)
+        {
+            logdio_free(&st[s].ldio);
+        }
+        free(st);
+        FUNC_RETURN_FAILURE("cannot set up logging of stream %s", sname);
+    }
+
+    *NBstream = NBst;
+    *framecnt = 0;
+    *filecnt  = 0;
+    *dropcnt  = 0;
+    *misscnt  = 0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    if(processinfo != NULL)
+    {
+        // streams are polled
+        processinfo_waitoninputstream_init(processinfo,
+                                           -1,
+                                           PROCESSINFO_TRIGGERMODE_IMMEDIATE,
+                                           -1);
+    }
+
+    int64_t lastperiod = -1;
+    double  tcube      = -1.0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        struct timespec timenow;
+        clock_gettime(CLOCK_MILK, &timenow);
+        double tnow = timenow.tv_sec + 1.0e-9 * timenow.tv_nsec;
+
+        // aligned rollover
+        int64_t period = 0;
+        tcube          = -1.0;
+        if((*cubedt) > 0.0)
+        {
+            period = (int64_t) floor(tnow / (*cubedt));
+            tcube  = period * (*cubedt);
+        }
+        if(((*saveON) == 0) || (period != lastperiod))
+        {
+            for(long s = 0; s < NBst; s++)
+            {
+                logmulti_cube_close(&st[s]);
+            }
+        }
+        lastperiod = period;
+
+        uint64_t fcnt = 0;
+        uint64_t dcnt = 0;
+        uint64_t mcnt = 0;
+        uint64_t ncnt = 0;
+        float    fill = 0.0;
+        for(long s = 0; s < NBst; s++)
+        {
+            logmulti_stream_update(&st[s], tnow, period, tcube);
+
+            fcnt += st[s].framecnt;
+            dcnt += st[s].dropcnt;
+            mcnt += st[s].misscnt;
+            ncnt += st[s].filecnt;
+            float f = logdio_ringfill(&st[s].ldio);
+            if(f > fill)
+            {
+                fill = f;
+            }
+        }
+        *framecnt = fcnt;
+        *dropcnt  = dcnt;
+        *misscnt  = mcnt;
+        *filecnt  = ncnt;
+        *ringfill = fill;
+
+        if(processinfo != NULL)
+        {
+            processinfo_WriteMessage_fmt(
+                processinfo,
+                "%ld streams ring %3.0f%% file %lu drop %lu",
+                NBst,
+                100.0 * fill,
+                (unsigned long) ncnt,
+                (unsigned long) dcnt);
+        }
+
+        if((*pollus) > 0)
+        {
+            usleep(*pollus);
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    for(long s = 0; s < NBst; s++)
+    {
+        logmulti_cube_close(&st[s]);
+    }
+    // writers complete pending cubes
+    logdio_pool_free(&pool);
+    for(long s = 0; s < NBst; s++)
+    {
+        logdio_free(&st[s].ldio);
+    }
+    free(st);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_MEMORY__logshmim_multi()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
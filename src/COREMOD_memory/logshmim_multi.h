@@ -0,0 +1,10 @@
+/**
+ * @file    logshmim_multi.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_LOGSHMIM_MULTI_H
+#define MILK_COREMOD_MEMORY_LOGSHMIM_MULTI_H
+
+errno_t CLIADDCMD_COREMOD_MEMORY__logshmim_multi();
+
+#endif // MILK_COREMOD_MEMORY_LOGSHMIM_MULTI_H
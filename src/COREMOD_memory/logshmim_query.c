@@ -0,0 +1,415 @@
+/**
+ * @file    logshmim_query.c
+ * @brief   extract time or cnt0 range from streamFITSlog cubes
+ *
+ * Reads catalog <dirname>/<sname>.logcat written by streamFITSlog, selects
+ * cubes overlapping the requested range, and locates frames within each
+ * cube from its binary timing file. Selected frames are read with cfitsio
+ * image sections, so that only the requested slices are loaded, and
+ * concatenated in a 3D image.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+#include "COREMOD_iofits/COREMOD_iofits.h"
+
+#include "create_image.h"
+#include "delete_image.h"
+#include "image_ID.h"
+#include "logshmim_timing.h"
+
+static char *savedirname;
+static char *streamname;
+static char *querykey;
+
+static double *qstart;
+static long    fpi_qstart;
+
+static double *qend;
+static long    fpi_qend;
+
+static char *outimname;
+static char *outtimfname;
+
+static uint64_t *NBframeout;
+static long      fpi_NBframeout;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STR,
+        ".dirname",
+        "log directory",
+        "/mnt/datalog/",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &savedirname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".sname",
+        "logged stream name",
+        "im1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &streamname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".key",
+        "selection key, time or cnt0",
+        "time",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &querykey,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".start",
+        "range start, included",
+        "0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &qstart,
+        &fpi_qstart
+    },
+    {
+        CLIARG_FLOAT64,
+        ".end",
+        "range end, included",
+        "0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &qend,
+        &fpi_qend
+    },
+    {
+        CLIARG_STR,
+        ".outimname",
+        "output image, NULL to list cubes only",
+        "NULL",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outtimfname",
+        "output binary timing file, NULL if none",
+        "NULL",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &outtimfname,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".NBframe",
+        "number of frames selected (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBframeout,
+        &fpi_NBframeout
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamlogquery",
+    "extract time or cnt0 range from stream log",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Extract frames logged by streamFITSlog in a time or cnt0 range\n");
+    printf("Requires binary timing files (streamFITSlog .bintiming)\n");
+    printf("  catalog  : <dirname>/<sname>.logcat\n");
+    printf("  .key time: .start and .end are unix time [s]\n");
+    printf("  .key cnt0: .start and .end are input stream cnt0\n");
+    printf("Frames are concatenated across cubes in output 3D image\n");
+
+    return RETURN_SUCCESS;
+}
+
+// frames selected in a cube
+typedef struct
+{
+    LOGSHMIM_CATALOG_ENTRY  entry;
+    LOGSHMIM_TIMING_RECORD *rec;
+    long                    k0; // first frame
+    long                    k1; // last frame
+} LOGQUERY_SEGMENT;
+
+static double logquery_key(LOGSHMIM_TIMING_RECORD *rec, int keycnt0)
+{
+    return keycnt0 ? (double) rec->cnt0 : rec->time;
+}
+
+static int logquery_segment_compare(const void *a, const void *b)
+{
+    const LOGQUERY_SEGMENT *sa = (const LOGQUERY_SEGMENT *) a;
+    const LOGQUERY_SEGMENT *sb = (const LOGQUERY_SEGMENT *) b;
+
+    double ta = sa->rec[sa->k0].time;
+    double tb = sb->rec[sb->k0].time;
+
+    return (ta > tb) - (ta < tb);
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    int keycnt0 = 0;
+    if(strcmp(querykey, "cnt0") == 0)
+    {
+        keycnt0 = 1;
+    }
+    else if(strcmp(querykey, "time") != 0)
+    {
+        FUNC_RETURN_FAILURE("unknown key %s, should be time or cnt0",
+                            querykey);
+    }
+
+    errno_t ret = RETURN_SUCCESS;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_START
+
+    char fnamecatalog[STRINGMAXLEN_FULLFILENAME];
+    WRITE_FULLFILENAME(fnamecatalog,
+                       "%s/%s.logcat",
+                       savedirname,
+                       streamname);
+
+    long                    NBentry = 0;
+    LOGSHMIM_CATALOG_ENTRY *entry =
+        logshmim_catalog_load(fnamecatalog, &NBentry);
+
+    LOGQUERY_SEGMENT *seg = NULL;
+    long              NBseg = 0;
+    if(NBentry > 0)
+    {
+        seg = (LOGQUERY_SEGMENT *) malloc(sizeof(LOGQUERY_SEGMENT) * NBentry);
+        if(seg == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+    }
+
+    // select cubes from catalog, then frames from timing file
+    uint64_t NBframe = 0;
+    for(long i = 0; i < NBentry; i++)
+    {
+        double estart = keycnt0 ? (double) entry[i].cnt0start : entry[i].tstart;
+        double eend   = keycnt0 ? (double) entry[i].cnt0end : entry[i].tend;
+        if((entry[i].NBframe == 0) || (eend < *qstart) || (estart > *qend))
+        {
+            continue;
+        }
+
+        char fnametiming[STRINGMAXLEN_FULLFILENAME];
+        WRITE_FULLFILENAME(fnametiming,
+                           "%s/%s",
+                           savedirname,
+                           entry[i].fnametiming);
+
+        long                    NBrec = 0;
+        LOGSHMIM_TIMING_RECORD *rec =
+            logshmim_timing_load_binary(fnametiming, &NBrec);
+        if(rec == NULL)
+        {
+            continue;
+        }
+
+        long k0 = -1;
+        long k1 = -1;
+        for(long k = 0; k < NBrec; k++)
+        {
+            double v = logquery_key(&rec[k], keycnt0);
+            if((v >= *qstart) && (v <= *qend))
+            {
+                if(k0 == -1)
+                {
+                    k0 = k;
+                }
+                k1 = k;
+            }
+        }
+        if(k0 == -1)
+        {
+            free(rec);
+            continue;
+        }
+
+        seg[NBseg].entry = entry[i];
+        seg[NBseg].rec   = rec;
+        seg[NBseg].k0    = k0;
+        seg[NBseg].k1    = k1;
+        NBframe += k1 - k0 + 1;
+        NBseg++;
+    }
+
+    // catalog is in completion order, cubes may complete out of order
+    if(NBseg > 1)
+    {
+        qsort(seg, NBseg, sizeof(LOGQUERY_SEGMENT), logquery_segment_compare);
+    }
+
+    printf("%ld cube(s), %lu frame(s) selected\n",
+           NBseg,
+           (unsigned long) NBframe);
+    for(long s = 0; s < NBseg; s++)
+    {
+        printf("  %s  frames %5ld - %5ld  time %.6f - %.6f\n",
+               seg[s].entry.fname,
+               seg[s].k0,
+               seg[s].k1,
+               seg[s].rec[seg[s].k0].time,
+               seg[s].rec[seg[s].k1].time);
+    }
+    *NBframeout = NBframe;
+
+    if((strcmp(outimname, "NULL") != 0) && (NBframe > 0))
+    {
+        imageID   IDout     = -1;
+        uint64_t  framesize = 0;
+        uint64_t  kout      = 0;
+        uint32_t  size[3];
+        uint8_t   datatype = 0;
+        char      tmpimname[STRINGMAXLEN_IMAGE_NAME];
+        WRITE_IMAGENAME(tmpimname, "_%s_logquery", outimname);
+
+        for(long s = 0; (s < NBseg) && (ret == RETURN_SUCCESS); s++)
+        {
+            // image section, only selected slices are read
+            char fname[STRINGMAXLEN_FULLFILENAME];
+            WRITE_FULLFILENAME(fname,
+                               "%s/%s[*,*,%ld:%ld]",
+                               savedirname,
+                               seg[s].entry.fname,
+                               seg[s].k0 + 1,
+                               seg[s].k1 + 1);
+
+            imageID IDin = -1;
+            load_fits(fname, tmpimname, LOADFITS_ERRMODE_WARNING, &IDin);
+            if(IDin == -1)
+            {
+                PRINT_ERROR("cannot load %s", fname);
+                ret = RETURN_FAILURE;
+                break;
+            }
+
+            IMAGE_METADATA *md = data.image[IDin].md;
+            if(IDout == -1)
+            {
+                size[0]  = md->size[0];
+                size[1]  = (md->naxis > 1) ? md->size[1] : 1;
+                size[2]  = NBframe;
+                datatype = md->datatype;
+                framesize =
+                    (uint64_t) ImageStreamIO_typesize(datatype) * size[0] * size[1];
+
+                create_image_ID(outimname,
+                                3,
+                                size,
+                                datatype,
+                                data.SHARED_DFT,
+                                NB_KEYWNODE_MAX,
+                                0,
+                                &IDout);
+            }
+
+            uint64_t nbf = seg[s].k1 - seg[s].k0 + 1;
+            if((md->datatype != datatype) ||
+                    ((uint64_t) md->nelement * ImageStreamIO_typesize(datatype) !=
+                     nbf * framesize))
+            {
+                PRINT_ERROR("%s : size or type mismatch", fname);
+                delete_image_ID(tmpimname, DELETE_IMAGE_ERRMODE_WARNING);
+                ret = RETURN_FAILURE;
+                break;
+            }
+
+            memcpy((char *) data.image[IDout].array.raw + kout * framesize,
+                   data.image[IDin].array.raw,
+                   nbf * framesize);
+            kout += nbf;
+
+            delete_image_ID(tmpimname, DELETE_IMAGE_ERRMODE_WARNING);
+        }
+
+        if(IDout != -1)
+        {
+            processinfo_update_output_stream(processinfo, IDout);
+        }
+    }
+
+    if((ret == RETURN_SUCCESS) && (strcmp(outtimfname, "NULL") != 0))
+    {
+        // timing of selected frames, same order as output image
+        uint64_t *arrayindex = (uint64_t *) malloc(sizeof(uint64_t) * (NBframe + 1));
+        uint64_t *arraycnt0  = (uint64_t *) malloc(sizeof(uint64_t) * (NBframe + 1));
+        uint64_t *arraycnt1  = (uint64_t *) malloc(sizeof(uint64_t) * (NBframe + 1));
+        double   *arraytime  = (double *) malloc(sizeof(double) * (NBframe + 1));
+        double   *arrayaqtime = (double *) malloc(sizeof(double) * (NBframe + 1));
+        if((arrayindex == NULL) || (arraycnt0 == NULL) || (arraycnt1 == NULL) ||
+                (arraytime == NULL) || (arrayaqtime == NULL))
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+
+        uint64_t kout = 0;
+        for(long s = 0; s < NBseg; s++)
+        {
+            for(long k = seg[s].k0; k <= seg[s].k1; k++)
+            {
+                arrayindex[kout]  = seg[s].rec[k].index;
+                arraycnt0[kout]   = seg[s].rec[k].cnt0;
+                arraycnt1[kout]   = seg[s].rec[k].cnt1;
+                arraytime[kout]   = seg[s].rec[k].time;
+                arrayaqtime[kout] = seg[s].rec[k].aqtime;
+                kout++;
+            }
+        }
+        ret = logshmim_timing_save_binary(outtimfname,
+                                          NBframe,
+                                          arrayindex,
+                                          arraycnt0,
+                                          arraycnt1,
+                                          arraytime,
+                                          arrayaqtime);
+
+        free(arrayindex);
+        free(arraycnt0);
+        free(arraycnt1);
+        free(arraytime);
+        free(arrayaqtime);
+    }
+
+    for(long s = 0; s < NBseg; s++)
+    {
+        free(seg[s].rec);
+    }
+    free(seg);
+    free(entry);
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    if(ret != RETURN_SUCCESS)
+    {
+        FUNC_RETURN_FAILURE("stream log query failed");
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_MEMORY__logshmim_query()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
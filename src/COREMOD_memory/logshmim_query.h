@@ -0,0 +1,10 @@
+/**
+ * @file    logshmim_query.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_LOGSHMIM_QUERY_H
+#define MILK_COREMOD_MEMORY_LOGSHMIM_QUERY_H
+
+errno_t CLIADDCMD_COREMOD_MEMORY__logshmim_query();
+
+#endif // MILK_COREMOD_MEMORY_LOGSHMIM_QUERY_H
@@ -0,0 +1,1209 @@
+/**
+ * @file    logshmim_replay.c
+ * @brief   replay stream logged by streamFITSlog with original timing
+ *
+ * Cubes and timing are located from catalog <dirname>/<sname>.logcat and
+ * binary timing files when available, otherwise from the ASCII timing
+ * files <sname>_HH:MM:SS.NNNNNNNNN.txt found in dirname.
+ *
+ * Uncompressed cubes are memory-mapped, with read-ahead (madvise) of the
+ * next .readahead frames, and each frame is converted from the mapping
+ * directly into the output stream. The next cube is opened while the
+ * last .readahead frames of the current cube are played. Compressed or
+ * scaled cubes are loaded in memory with cfitsio instead.
+ *
+ * Frame k is published at absolute time (clock_nanosleep TIMER_ABSTIME)
+ *   treplay + (t[k] - t[0]) / speed
+ * where treplay is the replay start and t the acquisition time (logging
+ * time if unavailable). Gaps longer than .maxgap between frames are
+ * reduced to .maxgap. With .speed 0, frames are published as fast as
+ * possible. Changing .speed restarts the schedule from the current frame.
+ *
+ * cnt0 and cnt1 of the output are set to their logged values, and cube
+ * FITS keywords are written to the output stream keywords at the start
+ * of each cube.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "CommandLineInterface/timeutils.h"
+#include "COREMOD_iofits/COREMOD_iofits.h"
+
+#include "create_image.h"
+#include "delete_image.h"
+#include "image_ID.h"
+#include "logshmim_timing.h"
+
+static char *savedirname;
+static char *streamname;
+static char *outsname;
+
+static double *tstart;
+static double *tend;
+
+static double *speed;
+static long    fpi_speed = -1;
+
+static double *maxgap;
+
+static int64_t *useaqtime;
+
+static int64_t *loopON;
+static long     fpi_loopON = -1;
+
+static int64_t *restorecnt;
+static int64_t *restorekw;
+
+static uint64_t *readahead;
+
+static double *latethrus;
+
+static uint64_t *framecnt;
+static double   *errmean;
+static double   *errrms;
+static double   *errmax;
+static uint64_t *NBlate;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STR,
+        ".dirname",
+        "log directory",
+        "/mnt/datalog/",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &savedirname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".sname",
+        "logged stream name",
+        "im1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &streamname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outsname",
+        "output stream, NULL for logged stream name",
+        "NULL",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outsname,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".tstart",
+        "logging time range start [s], 0 for all",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &tstart,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".tend",
+        "logging time range end [s], 0 for all",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &tend,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".speed",
+        "replay speed factor, 0 for free running",
+        "1.0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &speed,
+        &fpi_speed
+    },
+    {
+        CLIARG_FLOAT64,
+        ".maxgap",
+        "max interval between frames [s], 0 if no limit",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &maxgap,
+        NULL
+    },
+    {
+        CLIARG_ONOFF,
+        ".aqtime",
+        "use acquisition time (logging time if OFF)",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &useaqtime,
+        NULL
+    },
+    {
+        CLIARG_ONOFF,
+        ".loop",
+        "restart at end",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &loopON,
+        &fpi_loopON
+    },
+    {
+        CLIARG_ONOFF,
+        ".restorecnt",
+        "set output cnt0 and cnt1 to logged values",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &restorecnt,
+        NULL
+    },
+    {
+        CLIARG_ONOFF,
+        ".restorekw",
+        "write cube keywords to output",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &restorekw,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".readahead",
+        "read-ahead [frames]",
+        "64",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &readahead,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".latethrus",
+        "frame late threshold [us]",
+        "100.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &latethrus,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".cnt",
+        "frames published (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &framecnt,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".err.mean",
+        "mean publication time error [us] (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &errmean,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".err.rms",
+        "RMS publication time error [us] (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &errrms,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".err.max",
+        "max publication time error [us] (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &errmax,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".err.NBlate",
+        "frames later than .latethrus (output)",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBlate,
+        NULL
+    }
+};
+
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_speed].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_loopON].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t customCONFcheck()
+{
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamlogreplay",
+    "replay stream log with original timing",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Replay frames logged by streamFITSlog to a stream\n");
+    printf("  catalog  : <dirname>/<sname>.logcat, binary timing files\n");
+    printf("  otherwise: <dirname>/<sname>_*.txt ASCII timing files\n");
+    printf("Frame intervals are reproduced, divided by .speed\n");
+    printf("Publication time error relative to schedule is reported in\n");
+    printf("  .err.mean, .err.rms, .err.max [us]\n");
+
+    return RETURN_SUCCESS;
+}
+
+// frames selected in a cube
+typedef struct
+{
+    char                    fname[STRINGMAXLEN_FULLFILENAME];
+    LOGSHMIM_TIMING_RECORD *rec;
+    long                    k0; // first frame
+    long                    k1; // last frame
+} LOGREPLAY_SEGMENT;
+
+// open cube
+typedef struct
+{
+    int      isopen;
+    char     tmpimname[STRINGMAXLEN_IMAGE_NAME];
+    char    *map;    // file mapping, NULL if loaded
+    size_t   maplen;
+    char    *mdata;  // data unit within mapping
+    imageID  IDload; // loaded cube if not mapped
+    uint8_t  datatype;
+    int      typesize;
+    uint64_t signmask;
+    uint32_t size[2];
+    long     NBslice;
+    long     kahead; // read-ahead issued up to this frame
+
+    IMAGE_KEYWORD *kw;
+    int            NBkw;
+} LOGREPLAY_CUBE;
+
+static int logreplay_segment_compare(const void *a, const void *b)
+{
+    const LOGREPLAY_SEGMENT *sa = (const LOGREPLAY_SEGMENT *) a;
+    const LOGREPLAY_SEGMENT *sb = (const LOGREPLAY_SEGMENT *) b;
+
+    double ta = sa->rec[sa->k0].time;
+    double tb = sb->rec[sb->k0].time;
+
+    return (ta > tb) - (ta < tb);
+}
+
+/**
+ * @brief Select frames of cube within time range
+ *
+ * @return 1 if frames selected, 0 otherwise (rec is freed)
+ */
+static int logreplay_segment_select(LOGREPLAY_SEGMENT      *seg,
+                                    const char             *fname,
+                                    LOGSHMIM_TIMING_RECORD *rec,
+                                    long                    NBrec)
+{
+    long k0 = -1;
+    long k1 = -1;
+    for(long k = 0; k < NBrec; k++)
+    {
+        if(((*tend) <= (*tstart)) ||
+                ((rec[k].time >= (*tstart)) && (rec[k].time <= (*tend))))
+        {
+            if(k0 == -1)
+            {
+                k0 = k;
+            }
+            k1 = k;
+        }
+    }
+    if(k0 == -1)
+    {
+        free(rec);
+        return 0;
+    }
+
+    strncpy(seg->fname, fname, STRINGMAXLEN_FULLFILENAME - 1);
+    seg->rec = rec;
+    seg->k0  = k0;
+    seg->k1  = k1;
+    return 1;
+}
+
+/**
+ * @brief List cubes and frames to replay, sorted by time
+ *
+ * @return segments, to be freed by caller, NULL if none
+ */
+static LOGREPLAY_SEGMENT *logreplay_segments(long *NBseg)
+{
+    LOGREPLAY_SEGMENT *seg = NULL;
+    long               NB  = 0;
+
+    *NBseg = 0;
+
+    char fnamecatalog[STRINGMAXLEN_FULLFILENAME];
+    WRITE_FULLFILENAME(fnamecatalog,
+                       "%s/%s.logcat",
+                       savedirname,
+                       streamname);
+
+    if(access(fnamecatalog, R_OK) == 0)
+    {
+        long                    NBentry = 0;
+        LOGSHMIM_CATALOG_ENTRY *entry =
+            logshmim_catalog_load(fnamecatalog, &NBentry);
+
+        if(NBentry > 0)
+        {
+            seg = (LOGREPLAY_SEGMENT *) malloc(sizeof(LOGREPLAY_SEGMENT) *
+                                               NBentry);
+            if(seg == NULL)
+            {
+                PRINT_ERROR("malloc error");
+                abort();
+            }
+        }
+        for(long i = 0; i < NBentry; i++)
+        {
+            if((entry[i].NBframe == 0) ||
+                    (((*tend) > (*tstart)) &&
+                     ((entry[i].tend < (*tstart)) || (entry[i].tstart > (*tend)))))
+            {
+                continue;
+            }
+
+            char fname[STRINGMAXLEN_FULLFILENAME];
+            char fnametiming[STRINGMAXLEN_FULLFILENAME];
+            WRITE_FULLFILENAME(fname, "%s/%s", savedirname, entry[i].fname);
+            WRITE_FULLFILENAME(fnametiming,
+                               "%s/%s",
+                               savedirname,
+                               entry[i].fnametiming);
+
+            long                    NBrec = 0;
+            LOGSHMIM_TIMING_RECORD *rec =
+                logshmim_timing_load_binary(fnametiming, &NBrec);
+            if(rec == NULL)
+            {
+                continue;
+            }
+            NB += logreplay_segment_select(&seg[NB], fname, rec, NBrec);
+        }
+        free(entry);
+    }
+    else
+    {
+        char pattern[STRINGMAXLEN_FULLFILENAME];
+        WRITE_FULLFILENAME(pattern,
+                           "%s/%s_[0-9][0-9]:[0-9][0-9]:[0-9][0-9].*.txt",
+                           savedirname,
+                           streamname);
+
+        glob_t gl;
+        if(glob(pattern, 0, NULL, &gl) == 0)
+        {
+            seg = (LOGREPLAY_SEGMENT *) malloc(sizeof(LOGREPLAY_SEGMENT) *
+                                               gl.gl_pathc);
+            if(seg == NULL)
+            {
+                PRINT_ERROR("malloc error");
+                abort();
+            }
+            for(size_t i = 0; i < gl.gl_pathc; i++)
+            {
+                // cube has same name, .fits extension
+                char   fname[STRINGMAXLEN_FULLFILENAME];
+                size_t len = strlen(gl.gl_pathv[i]) - strlen(".txt");
+                WRITE_FULLFILENAME(fname,
+                                   "%.*s.fits",
+                                   (int) len,
+                                   gl.gl_pathv[i]);
+                if(access(fname, R_OK) != 0)
+                {
+                    continue;
+                }
+
+                long                    NBrec = 0;
+                LOGSHMIM_TIMING_RECORD *rec =
+                    logshmim_timing_load_ascii(gl.gl_pathv[i], &NBrec);
+                if(rec == NULL)
+                {
+                    continue;
+                }
+                NB += logreplay_segment_select(&seg[NB], fname, rec, NBrec);
+            }
+        }
+        globfree(&gl);
+    }
+
+    // catalog is in completion order, file names wrap at midnight
+    if(NB > 1)
+    {
+        qsort(seg, NB, sizeof(LOGREPLAY_SEGMENT), logreplay_segment_compare);
+    }
+    if(NB == 0)
+    {
+        free(seg);
+        seg = NULL;
+    }
+
+    *NBseg = NB;
+    return seg;
+}
+
+/**
+ * @brief Image datatype of FITS data unit
+ *
+ * Same datatype as load_fits, so that mapped and loaded cubes match :
+ * BITPIX 8 -> float, 16 -> uint16, 32 -> int32, 64 -> int64,
+ * -32 -> float, -64 -> double.
+ *
+ * @return 1 if data unit can be converted from file mapping, 0 if it
+ *         must be loaded with load_fits
+ */
+static int logreplay_datatype(int       bitpix,
+                              double    bscale,
+                              double    bzero,
+                              uint8_t  *datatype,
+                              int      *typesize,
+                              uint64_t *signmask)
+{
+    // BZERO of data units stored in datatype representation
+    double mapbzero = 0.0;
+
+    *signmask = 0;
+    switch(bitpix)
+    {
+        case 8:
+            // converted to float by load_fits
+            *datatype = _DATATYPE_FLOAT;
+            *typesize = 4;
+            return 0;
+        case 16:
+            *datatype = _DATATYPE_UINT16;
+            *typesize = 2;
+            *signmask = 0x8000;
+            mapbzero  = 32768.0;
+            break;
+        case 32:
+            *datatype = _DATATYPE_INT32;
+            *typesize = 4;
+            break;
+        case 64:
+            *datatype = _DATATYPE_INT64;
+            *typesize = 8;
+            break;
+        case -32:
+            *datatype = _DATATYPE_FLOAT;
+            *typesize = 4;
+            break;
+        case -64:
+            *datatype = _DATATYPE_DOUBLE;
+            *typesize = 8;
+            break;
+        default:
+            return 0;
+    }
+
+    return ((bscale == 1.0) && (bzero == mapbzero));
+}
+
+/**
+ * @brief Read cube keywords
+ *
+ * Structural and compression keywords are skipped. Value type is
+ * inferred as in load_fits.
+ */
+static void logreplay_cube_keywords(LOGREPLAY_CUBE *cube, fitsfile *fptr)
+{
+    // keywords to ignore
+    const char *keywordignore[] = {"SIMPLE",
+                                   "XTENSION",
+                                   "BITPIX",
+                                   "EXTEND",
+                                   "PCOUNT",
+                                   "GCOUNT",
+                                   "TFIELDS",
+                                   "COMMENT",
+                                   "HISTORY",
+                                   "DATE",
+                                   "BSCALE",
+                                   "BZERO",
+                                   0
+                                  };
+
+    int status    = 0;
+    int nbFITSkey = 0;
+    fits_get_hdrspace(fptr, &nbFITSkey, NULL, &status);
+    if((status != 0) || (nbFITSkey == 0))
+    {
+        return;
+    }
+
+    cube->kw = (IMAGE_KEYWORD *) calloc(nbFITSkey, sizeof(IMAGE_KEYWORD));
+    if(cube->kw == NULL)
+    {
+        PRINT_ERROR("calloc error");
+        abort();
+    }
+
+    for(int kwnum = 0; kwnum < nbFITSkey; kwnum++)
+    {
+        char keyname[FLEN_KEYWORD];
+        char kwvaluestr[FLEN_VALUE];
+        char kwcomment[FLEN_COMMENT];
+
+        status = 0;
+        fits_read_keyn(fptr, kwnum + 1, keyname, kwvaluestr, kwcomment, &status);
+        if((status != 0) || (strlen(kwvaluestr) == 0) ||
+                (strlen(keyname) > KEYWORD_MAX_STRING - 1))
+        {
+            continue;
+        }
+
+        int kwignore = 0;
+        for(int ki = 0; keywordignore[ki]; ki++)
+        {
+            if(strcmp(keywordignore[ki], keyname) == 0)
+            {
+                kwignore = 1;
+                break;
+            }
+        }
+        if((strncmp(keyname, "NAXIS", 5) == 0) ||
+                (strncmp(keyname, "TTYPE", 5) == 0) ||
+                (strncmp(keyname, "TFORM", 5) == 0) || (keyname[0] == 'Z'))
+        {
+            kwignore = 1;
+        }
+        if(kwignore == 1)
+        {
+            continue;
+        }
+
+        IMAGE_KEYWORD *kw = &cube->kw[cube->NBkw];
+        strncpy(kw->name, keyname, KEYWORD_MAX_STRING - 1);
+        strncpy(kw->comment, kwcomment, KEYWORD_MAX_COMMENT - 1);
+
+        char *tailstr;
+        long  kwlongval = strtol(kwvaluestr, &tailstr, 10);
+        if(strlen(tailstr) == 0)
+        {
+            kw->type       = 'L';
+            kw->value.numl = kwlongval;
+        }
+        else
+        {
+            double kwdoubleval = strtod(kwvaluestr, &tailstr);
+            if(strlen(tailstr) == 0)
+            {
+                kw->type       = 'D';
+                kw->value.numf = kwdoubleval;
+            }
+            else
+            {
+                // remove quotes and trailing blanks
+                char *str = kwvaluestr;
+                if(str[0] == '\'')
+                {
+                    str++;
+                }
+                size_t len = strlen(str);
+                if((len > 0) && (str[len - 1] == '\''))
+                {
+                    len--;
+                }
+                while((len > 0) && (str[len - 1] == ' '))
+                {
+                    len--;
+                }
+                str[len] = '\0';
+
+                kw->type = 'S';
+                strncpy(kw->value.valstr, str, KEYWORD_MAX_STRING - 1);
+            }
+        }
+        cube->NBkw++;
+    }
+}
+
+/**
+ * @brief Issue read-ahead of frames following frame k
+ */
+static void logreplay_cube_readahead(LOGREPLAY_CUBE *cube,
+                                     long            k,
+                                     long            NBahead)
+{
+    if((cube->map == NULL) || (k + NBahead / 2 < cube->kahead) ||
+            (cube->kahead >= cube->NBslice))
+    {
+        return;
+    }
+
+    size_t framesize = (size_t) cube->typesize * cube->size[0] * cube->size[1];
+    long   kend      = cube->kahead + NBahead;
+    if(kend > cube->NBslice)
+    {
+        kend = cube->NBslice;
+    }
+
+    long  pagesize = sysconf(_SC_PAGESIZE);
+    char *p0       = cube->mdata + framesize * cube->kahead;
+    char *p1       = cube->mdata + framesize * kend;
+    char *pa       = cube->map + ((p0 - cube->map) / pagesize) * pagesize;
+
+    madvise(pa, p1 - pa, MADV_WILLNEED);
+    cube->kahead = kend;
+}
+
+static void logreplay_cube_close(LOGREPLAY_CUBE *cube)
+{
+    if(cube->isopen == 0)
+    {
+        return;
+    }
+    if(cube->map != NULL)
+    {
+        munmap(cube->map, cube->maplen);
+    }
+    if(cube->IDload != -1)
+    {
+        delete_image_ID(cube->tmpimname, DELETE_IMAGE_ERRMODE_WARNING);
+    }
+    free(cube->kw);
+
+    cube->isopen = 0;
+    cube->map    = NULL;
+    cube->IDload = -1;
+    cube->kw     = NULL;
+    cube->NBkw   = 0;
+}
+
+/**
+ * @brief Open cube, map or load data unit
+ *
+ * Read-ahead starts at frame kstart.
+ */
+static errno_t logreplay_cube_open(LOGREPLAY_CUBE *cube,
+                                   const char     *fname,
+                                   long            kstart,
+                                   long            NBahead)
+{
+    DEBUG_TRACE_FSTART();
+
+    fitsfile *fptr   = NULL;
+    int       status = 0;
+
+    cube->map    = NULL;
+    cube->IDload = -1;
+    cube->kw     = NULL;
+    cube->NBkw   = 0;
+
+    fits_open_file(&fptr, fname, READONLY, &status);
+    if(status != 0)
+    {
+        FUNC_RETURN_FAILURE("cannot open %s", fname);
+    }
+
+    int  bitpix = 0;
+    int  naxis  = 0;
+    long naxes[3] = {1, 1, 1};
+    fits_get_img_type(fptr, &bitpix, &status);
+    fits_get_img_dim(fptr, &naxis, &status);
+    fits_get_img_size(fptr, 3, naxes, &status);
+
+    double bscale = 1.0;
+    double bzero  = 0.0;
+    {
+        int kstatus = 0;
+        fits_read_key(fptr, TDOUBLE, "BSCALE", &bscale, NULL, &kstatus);
+        kstatus = 0;
+        fits_read_key(fptr, TDOUBLE, "BZERO", &bzero, NULL, &kstatus);
+    }
+
+    int      iscomp = fits_is_compressed_image(fptr, &status);
+    LONGLONG headstart;
+    LONGLONG datastart;
+    LONGLONG dataend;
+    fits_get_hduaddrll(fptr, &headstart, &datastart, &dataend, &status);
+
+    logreplay_cube_keywords(cube, fptr);
+
+    {
+        int cstatus = 0;
+        fits_close_file(fptr, &cstatus);
+    }
+    if((status != 0) || (naxis < 2) || (naxis > 3))
+    {
+        free(cube->kw);
+        cube->kw = NULL;
+        FUNC_RETURN_FAILURE("%s : not a 2D or 3D image", fname);
+    }
+
+    cube->size[0] = naxes[0];
+    cube->size[1] = naxes[1];
+    cube->NBslice = (naxis == 3) ? naxes[2] : 1;
+
+    int mappable = logreplay_datatype(bitpix,
+                                      bscale,
+                                      bzero,
+                                      &cube->datatype,
+                                      &cube->typesize,
+                                      &cube->signmask) &&
+                   (iscomp == 0);
+
+    if(mappable)
+    {
+        size_t datasize = (size_t) cube->typesize * cube->size[0] *
+                          cube->size[1] * cube->NBslice;
+
+        int fd = open(fname, O_RDONLY);
+        if(fd != -1)
+        {
+            struct stat st;
+            char        card[8];
+            // HDU is at the offsets cfitsio reports, in the file itself
+            if((fstat(fd, &st) == 0) &&
+                    ((off_t)(datastart + datasize) <= st.st_size) &&
+                    (pread(fd, card, 8, headstart) == 8) &&
+                    ((strncmp(card, "SIMPLE  ", 8) == 0) ||
+                     (strncmp(card, "XTENSION", 8) == 0)))
+            {
+                long  pagesize = sysconf(_SC_PAGESIZE);
+                off_t mapstart = (datastart / pagesize) * pagesize;
+                cube->maplen   = (size_t)(datastart - mapstart) + datasize;
+                cube->map      = (char *) mmap(NULL,
+                                               cube->maplen,
+                                               PROT_READ,
+                                               MAP_PRIVATE,
+                                               fd,
+                                               mapstart);
+                if(cube->map == MAP_FAILED)
+                {
+                    cube->map = NULL;
+                }
+                else
+                {
+                    cube->mdata = cube->map + (datastart - mapstart);
+                    madvise(cube->map, cube->maplen, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+        }
+    }
+
+    if(cube->map == NULL)
+    {
+        load_fits_opt(fname,
+                      cube->tmpimname,
+                      LOADFITS_ERRMODE_WARNING,
+                      LOADFITS_MAPMODE_COPY,
+                      &cube->IDload);
+        if(cube->IDload == -1)
+        {
+            free(cube->kw);
+            cube->kw = NULL;
+            FUNC_RETURN_FAILURE("cannot load %s", fname);
+        }
+        cube->datatype = data.image[cube->IDload].md->datatype;
+        cube->typesize = ImageStreamIO_typesize(cube->datatype);
+        cube->signmask = 0;
+    }
+
+    cube->kahead = kstart;
+    logreplay_cube_readahead(cube, kstart, NBahead);
+    cube->isopen = 1;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Write frame k of cube to dst, native representation
+ */
+static void logreplay_cube_frame(LOGREPLAY_CUBE *cube,
+                                 long            k,
+                                 void           *dst,
+                                 long            NBahead)
+{
+    long   nelem     = (long) cube->size[0] * cube->size[1];
+    size_t framesize = (size_t) cube->typesize * nelem;
+
+    if(cube->map != NULL)
+    {
+        loadfits_convert(dst,
+                         cube->mdata + framesize * k,
+                         nelem,
+                         cube->typesize,
+                         cube->signmask);
+        logreplay_cube_readahead(cube, k, NBahead);
+    }
+    else
+    {
+        memcpy(dst,
+               (char *) data.image[cube->IDload].array.raw + framesize * k,
+               framesize);
+    }
+}
+
+/**
+ * @brief Write cube keywords to stream
+ *
+ * Keywords already in stream are updated, others take free slots.
+ */
+static void logreplay_kw_restore(IMGID *img, LOGREPLAY_CUBE *cube)
+{
+    for(int i = 0; i < cube->NBkw; i++)
+    {
+        int kwo = -1;
+        for(int j = 0; j < img->md->NBkw; j++)
+        {
+            if(img->im->kw[j].type == 'N')
+            {
+                if(kwo == -1)
+                {
+                    kwo = j;
+                }
+                continue;
+            }
+            if(strcmp(img->im->kw[j].name, cube->kw[i].name) == 0)
+            {
+                kwo = j;
+                break;
+            }
+        }
+        if(kwo != -1)
+        {
+            img->im->kw[kwo] = cube->kw[i];
+        }
+    }
+}
+
+static int logreplay_cube_check(IMGID *img, LOGREPLAY_CUBE *cube)
+{
+    uint32_t ysize = (img->md->naxis > 1) ? img->md->size[1] : 1;
+
+    return ((img->md->datatype == cube->datatype) &&
+            (img->md->size[0] == cube->size[0]) && (ysize == cube->size[1]));
+}
+
+static void logreplay_timespec_add(struct timespec *t, double dt)
+{
+    double sec = floor(dt);
+    t->tv_sec += (time_t) sec;
+    t->tv_nsec += (long)((dt - sec) * 1.0e9);
+    while(t->tv_nsec >= 1000000000L)
+    {
+        t->tv_nsec -= 1000000000L;
+        t->tv_sec++;
+    }
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    long               NBseg = 0;
+    LOGREPLAY_SEGMENT *seg   = logreplay_segments(&NBseg);
+    if(seg == NULL)
+    {
+        FUNC_RETURN_FAILURE("no logged frame found for %s in %s",
+                            streamname,
+                            savedirname);
+    }
+
+    uint64_t NBframe = 0;
+    for(long s = 0; s < NBseg; s++)
+    {
+        NBframe += seg[s].k1 - seg[s].k0 + 1;
+    }
+    printf("%ld cube(s), %lu frame(s) to replay\n",
+           NBseg,
+           (unsigned long) NBframe);
+
+    const char *oname = outsname;
+    if(strcmp(outsname, "NULL") == 0)
+    {
+        oname = streamname;
+    }
+
+    // current and next cube
+    LOGREPLAY_CUBE cube[2];
+    memset(cube, 0, sizeof(cube));
+    for(int c = 0; c < 2; c++)
+    {
+        cube[c].IDload = -1;
+        WRITE_IMAGENAME(cube[c].tmpimname, "_%s_replay%d", oname, c);
+    }
+    long NBahead = (*readahead > 0) ? (long)(*readahead) : 1;
+
+    if(logreplay_cube_open(&cube[0], seg[0].fname, seg[0].k0, NBahead) !=
+            RETURN_SUCCESS)
+    {
+        for(long s = 0; s < NBseg; s++)
+        {
+            free(seg[s].rec);
+        }
+        free(seg);
+        FUNC_RETURN_FAILURE("cannot open first cube");
+    }
+
+    IMGID imgout = mkIMGID_from_name(oname);
+    if(resolveIMGID(&imgout, ERRMODE_WARN) == -1)
+    {
+        imageID ID;
+        create_image_ID(oname,
+                        2,
+                        cube[0].size,
+                        cube[0].datatype,
+                        1,
+                        NB_KEYWNODE_MAX,
+                        0,
+                        &ID);
+        imgout = makesetIMGID(oname, ID);
+    }
+    if(!logreplay_cube_check(&imgout, &cube[0]))
+    {
+        logreplay_cube_close(&cube[0]);
+        for(long s = 0; s < NBseg; s++)
+        {
+            free(seg[s].rec);
+        }
+        free(seg);
+        FUNC_RETURN_FAILURE("stream %s exists, size or type does not match log",
+                            oname);
+    }
+
+    *framecnt = 0;
+    *errmean  = 0.0;
+    *errrms   = 0.0;
+    *errmax   = 0.0;
+    *NBlate   = 0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    if(processinfo != NULL)
+    {
+        // timing is set by replay schedule
+        processinfo_waitoninputstream_init(processinfo,
+                                           -1,
+                                           PROCESSINFO_TRIGGERMODE_IMMEDIATE,
+                                           -1);
+    }
+
+    int  cc       = 0; // current cube index in cube[]
+    long s        = 0;
+    long k        = seg[0].k0;
+    int  newcube  = 1;
+    int  newstart = 1;
+    int  nextfail = 0;
+
+    struct timespec tref;            // replay start
+    double          tlog0     = 0.0; // log time of first frame
+    double          tlogprev  = 0.0;
+    double          tgap      = 0.0; // removed gaps
+    double          speedprev = *speed;
+
+    double   errsum  = 0.0;
+    double   errsum2 = 0.0;
+    uint64_t errcnt  = 0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        LOGSHMIM_TIMING_RECORD *rec  = &seg[s].rec[k];
+        double                  tlog = rec->time;
+        if((*useaqtime) && (rec->aqtime > 0.0))
+        {
+            tlog = rec->aqtime;
+        }
+
+        if((*speed) != speedprev)
+        {
+            // schedule restarts from current frame at new speed
+            speedprev = *speed;
+            newstart  = 1;
+        }
+        if(newstart == 1)
+        {
+            clock_gettime(CLOCK_MILK, &tref);
+            tlog0    = tlog;
+            tlogprev = tlog;
+            tgap     = 0.0;
+            newstart = 0;
+        }
+        double dt = tlog - tlogprev;
+        if(dt < 0.0)
+        {
+            tgap += dt;
+        }
+        else if(((*maxgap) > 0.0) && (dt > (*maxgap)))
+        {
+            tgap += dt - (*maxgap);
+        }
+        tlogprev = tlog;
+
+        struct timespec tdeadline = tref;
+        if((*speed) > 0.0)
+        {
+            logreplay_timespec_add(&tdeadline, (tlog - tlog0 - tgap) / (*speed));
+            while(clock_nanosleep(CLOCK_MILK, TIMER_ABSTIME, &tdeadline, NULL) ==
+                    EINTR)
+            {
+            }
+        }
+
+        imgout.md->write = 1;
+        logreplay_cube_frame(&cube[cc],
+                             k,
+                             imgout.im->array.raw,
+                             NBahead);
+        if((newcube == 1) && (*restorekw))
+        {
+            logreplay_kw_restore(&imgout, &cube[cc]);
+        }
+        newcube = 0;
+        if(*restorecnt)
+        {
+            // cnt0 is incremented on update
+            imgout.md->cnt0 = rec->cnt0 - 1;
+            imgout.md->cnt1 = rec->cnt1;
+        }
+        processinfo_update_output_stream(processinfo, imgout.ID);
+
+        if((*speed) > 0.0)
+        {
+            struct timespec tnow;
+            clock_gettime(CLOCK_MILK, &tnow);
+            double err = 1.0e6 * (tnow.tv_sec - tdeadline.tv_sec) +
+                         1.0e-3 * (tnow.tv_nsec - tdeadline.tv_nsec);
+            errsum += err;
+            errsum2 += err * err;
+            errcnt++;
+            if(err > *errmax)
+            {
+                *errmax = err;
+            }
+            if(err > *latethrus)
+            {
+                (*NBlate)++;
+            }
+            *errmean = errsum / errcnt;
+            *errrms  = sqrt(errsum2 / errcnt);
+        }
+        (*framecnt)++;
+
+        // next frame, next cube is opened ahead of cube change
+        k++;
+        long sn = s + 1;
+        if((sn == NBseg) && (*loopON))
+        {
+            sn = 0;
+        }
+        int cn = 1 - cc;
+        if((cube[cn].isopen == 0) && (nextfail == 0) && (sn < NBseg) &&
+                (seg[s].k1 - k < NBahead))
+        {
+            if(logreplay_cube_open(&cube[cn], seg[sn].fname, seg[sn].k0, NBahead) !=
+                    RETURN_SUCCESS)
+            {
+                nextfail = 1;
+            }
+        }
+
+        if(k > seg[s].k1)
+        {
+            logreplay_cube_close(&cube[cc]);
+            cc      = cn;
+            newcube = 1;
+
+            if(sn == NBseg)
+            {
+                processloopOK = 0;
+            }
+            else if((cube[cc].isopen == 0) ||
+                    (!logreplay_cube_check(&imgout, &cube[cc])))
+            {
+                PRINT_ERROR("cube %s cannot be replayed", seg[sn].fname);
+                processloopOK = 0;
+            }
+            else
+            {
+                if(sn <= s)
+                {
+                    // loop restart
+                    newstart = 1;
+                }
+                s = sn;
+                k = seg[s].k0;
+            }
+
+            if(processinfo != NULL)
+            {
+                processinfo_WriteMessage_fmt(
+                    processinfo,
+                    "%lu frames err %.1f +- %.1f us max %.1f",
+                    (unsigned long) *framecnt,
+                    *errmean,
+                    *errrms,
+                    *errmax);
+            }
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    printf("%lu frame(s) replayed\n", (unsigned long) *framecnt);
+    if(errcnt > 0)
+    {
+        printf("publication time error [us] : mean %.1f  rms %.1f  max %.1f\n",
+               *errmean,
+               *errrms,
+               *errmax);
+        printf("%lu frame(s) later than %.1f us\n",
+               (unsigned long) *NBlate,
+               *latethrus);
+    }
+
+    logreplay_cube_close(&cube[0]);
+    logreplay_cube_close(&cube[1]);
+    for(long i = 0; i < NBseg; i++)
+    {
+        free(seg[i].rec);
+    }
+    free(seg);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_MEMORY__logshmim_replay()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
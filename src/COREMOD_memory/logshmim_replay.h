@@ -0,0 +1,10 @@
+/**
+ * @file    logshmim_replay.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_LOGSHMIM_REPLAY_H
+#define MILK_COREMOD_MEMORY_LOGSHMIM_REPLAY_H
+
+errno_t CLIADDCMD_COREMOD_MEMORY__logshmim_replay();
+
+#endif // MILK_COREMOD_MEMORY_LOGSHMIM_REPLAY_H
@@ -0,0 +1,489 @@
+/**
+ * @file    logshmim_timing.c
+ * @brief   timing keywords, timing files and catalog of logged telemetry
+ *
+ * Shared by the FITS writer thread and the direct I/O writer of
+ * streamFITSlog, and by streamlogquery and streamlogreplay.
+ *
+ * For each cube, timing is written as:
+ *   ASCII file  : one line per frame, human readable
+ *   binary file : fixed-size records, see LOGSHMIM_TIMING_RECORD
+ *
+ * Each completed cube is appended to the stream catalog, so that a time
+ * or cnt0 range can be located without reading timing files.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "CommandLineInterface/timeutils.h"
+
+#include "logshmim_timing.h"
+
+/**
+ * @brief Fill UT, MJD and local time keywords of cube
+ *
+ * tstart and tend are the times of the first and last frame of the cube
+ * [s since epoch]. imkwarray must hold LOGSHMIM_NBTIMEKW keywords.
+ *
+ * @return number of keywords written
+ */
+int logshmim_timing_keywords(IMAGE_KEYWORD *imkwarray,
+                             double         tstart,
+                             double         tend)
+{
+    // UT time
+
+    strcpy(imkwarray->name, "UT");
+    imkwarray->type = 'S';
+
+
+    strcpy(imkwarray->value.valstr,
+           timedouble_to_UTC_timeofdaystring(0.5 * tstart + 0.5 * tend));
+    strcpy(imkwarray->comment, "HH:MM:SS.SS typical UTC at exposure");
+
+
+    strcpy(imkwarray[1].name, "UT-STR");
+    imkwarray[1].type = 'S';
+    strcpy(imkwarray[1].value.valstr, timedouble_to_UTC_timeofdaystring(tstart));
+    strcpy(imkwarray[1].comment, "HH:MM:SS.SS UTC at exposure start");
+
+    strcpy(imkwarray[2].name, "UT-END");
+    imkwarray[2].type = 'S';
+    strcpy(imkwarray[2].value.valstr, timedouble_to_UTC_timeofdaystring(tend));
+    strcpy(imkwarray[2].comment, "HH:MM:SS.SS UTC at exposure end");
+
+    // Modified Julian Date (MJD)
+
+
+    strcpy(imkwarray[3].name, "MJD");
+    imkwarray[3].type       = 'D';
+    imkwarray[3].value.numf = (0.5 * tstart + 0.5 * tend) / 86400.0 + 40587.0;
+    strcpy(imkwarray[3].comment, "Modified Julian Day at exposure");
+
+
+    strcpy(imkwarray[4].name, "MJD-STR");
+    imkwarray[4].type       = 'D';
+    imkwarray[4].value.numf = tstart / 86400.0 + 40587.0;
+    strcpy(imkwarray[4].comment, "Modified Julian Day at exposure start");
+
+    strcpy(imkwarray[5].name, "MJD-END");
+    imkwarray[5].type       = 'D';
+    imkwarray[5].value.numf = (tend / 86400.0) + 40587.0;
+    strcpy(imkwarray[5].comment, "Modified Julian Day at exposure end");
+
+    // Local time
+
+    // get time zone
+    //char tm_zone[] = "HST";
+    //double tm_utcoff = -36000; // HST = UTC - 10; Positive east of UTC.
+    // Causes a race condition with gettime in other thread, which result in occasional HST filenames...
+    //time_t t = time(NULL);
+    // OVERRIDE localtime to HST
+    //putenv("TZ=Pacific/Honolulu");
+    //struct tm lt = *localtime(&t);
+    //printf("TIMEZONE TIMEZONE %s\n", lt.tm_zone);
+    //putenv("TZ=");
+    //printf("TIMEZONE TIMEZONE %s\n", lt.tm_zone);
+
+
+    // printf("Offset to GMT is %lds.\n", lt.tm_gmtoff);
+    // printf("The time zone is '%s'.\n", lt.tm_zone);
+
+
+    sprintf(imkwarray[6].name, "%s", TZ_MILK_STR);
+    imkwarray[6].type = 'S';
+    strcpy(imkwarray[6].value.valstr,
+           timedouble_to_UTC_timeofdaystring((0.5 * tstart + 0.5 * tend) +
+                   TZ_MILK_UTC_OFF));
+    sprintf(imkwarray[6].comment,
+            "HH:MM:SS.SS typical %s at exposure",
+            TZ_MILK_STR);
+
+    sprintf(imkwarray[7].name, "%s-STR", TZ_MILK_STR);
+    imkwarray[7].type = 'S';
+    strcpy(imkwarray[7].value.valstr,
+           timedouble_to_UTC_timeofdaystring(tstart + TZ_MILK_UTC_OFF));
+    sprintf(imkwarray[7].comment,
+            "HH:MM:SS.SS typical %s at exposure start",
+            TZ_MILK_STR);
+
+    sprintf(imkwarray[8].name, "%s-END", TZ_MILK_STR);
+    imkwarray[8].type = 'S';
+    strcpy(imkwarray[8].value.valstr,
+           timedouble_to_UTC_timeofdaystring(tend + TZ_MILK_UTC_OFF));
+    sprintf(imkwarray[8].comment,
+            "HH:MM:SS.SS typical %s at exposure end",
+            TZ_MILK_STR);
+
+    return LOGSHMIM_NBTIMEKW;
+}
+
+/**
+ * @brief Write ASCII timing file of cube, one line per frame
+ */
+errno_t logshmim_timing_save_ascii(const char *fname,
+                                   long        NBframe,
+                                   uint64_t   *arrayindex,
+                                   uint64_t   *arraycnt0,
+                                   uint64_t   *arraycnt1,
+                                   double     *arraytime,
+                                   double     *arrayaqtime)
+{
+    DEBUG_TRACE_FSTART();
+
+    FILE *fp;
+
+    if((fp = fopen(fname, "w")) == NULL)
+    {
+        FUNC_RETURN_FAILURE("cannot create file \"%s\"", fname);
+    }
+
+    fprintf(fp, "# Telemetry stream timing data \n");
+    fprintf(fp,
+            "# File written by function %s in file %s\n",
+            __FUNCTION__,
+            __FILE__);
+    fprintf(fp, "# \n");
+    fprintf(fp, "# col1 : datacube frame index\n");
+    fprintf(fp, "# col2 : Main index\n");
+    fprintf(fp, "# col3 : Time since cube origin (logging)\n");
+    fprintf(fp, "# col4 : Absolute time (logging)\n");
+    fprintf(fp, "# col5 : Absolute time (acquisition)\n");
+    fprintf(fp, "# col6 : stream cnt0 index\n");
+    fprintf(fp, "# col7 : stream cnt1 index\n");
+    fprintf(fp, "# \n");
+
+    double t0; // time reference
+    t0 = arraytime[0];
+    for(long k = 0; k < NBframe; k++)
+    {
+        // entries are:
+        // - index within cube
+        // - loop index (if applicable)
+        // - time since cube start
+        // - time (absolute)
+        // - cnt0
+        // - cnt1
+
+        fprintf(fp,
+                "%10ld  %10lu  %15.9lf   %20.9lf  %17.6lf   %10ld   %10ld\n",
+                k,
+                arrayindex[k],
+                arraytime[k] - t0,
+                arraytime[k],
+                arrayaqtime[k],
+                arraycnt0[k],
+                arraycnt1[k]);
+    }
+    fclose(fp);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Write binary timing file of cube
+ */
+errno_t logshmim_timing_save_binary(const char *fname,
+                                    long        NBframe,
+                                    uint64_t   *arrayindex,
+                                    uint64_t   *arraycnt0,
+                                    uint64_t   *arraycnt1,
+                                    double     *arraytime,
+                                    double     *arrayaqtime)
+{
+    DEBUG_TRACE_FSTART();
+
+    LOGSHMIM_TIMING_HEADER hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LOGSHMIM_TIMING_MAGIC, 8);
+    hdr.NBframe = NBframe;
+    hdr.recsize = sizeof(LOGSHMIM_TIMING_RECORD);
+
+    LOGSHMIM_TIMING_RECORD *rec = (LOGSHMIM_TIMING_RECORD *) malloc(
+                                      sizeof(LOGSHMIM_TIMING_RECORD) * NBframe);
+    if(rec == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    for(long k = 0; k < NBframe; k++)
+    {
+        rec[k].index  = arrayindex[k];
+        rec[k].cnt0   = arraycnt0[k];
+        rec[k].cnt1   = arraycnt1[k];
+        rec[k].time   = arraytime[k];
+        rec[k].aqtime = arrayaqtime[k];
+    }
+
+    FILE *fp = fopen(fname, "w");
+    if(fp == NULL)
+    {
+        free(rec);
+        FUNC_RETURN_FAILURE("cannot create file \"%s\"", fname);
+    }
+    if((fwrite(&hdr, sizeof(hdr), 1, fp) != 1) ||
+            (fwrite(rec, sizeof(LOGSHMIM_TIMING_RECORD), NBframe, fp) !=
+             (size_t) NBframe))
+    {
+        fclose(fp);
+        free(rec);
+        FUNC_RETURN_FAILURE("write error on \"%s\"", fname);
+    }
+    fclose(fp);
+    free(rec);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Load binary timing file
+ *
+ * @return records, to be freed by caller, NULL on error
+ */
+LOGSHMIM_TIMING_RECORD *logshmim_timing_load_binary(const char *fname,
+        long       *NBframe)
+{
+    LOGSHMIM_TIMING_HEADER  hdr;
+    LOGSHMIM_TIMING_RECORD *rec = NULL;
+
+    *NBframe = 0;
+
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL)
+    {
+        PRINT_WARNING("cannot open file \"%s\"", fname);
+        return NULL;
+    }
+
+    if((fread(&hdr, sizeof(hdr), 1, fp) != 1) ||
+            (memcmp(hdr.magic, LOGSHMIM_TIMING_MAGIC, 8) != 0) ||
+            (hdr.recsize != sizeof(LOGSHMIM_TIMING_RECORD)))
+    {
+        PRINT_WARNING("\"%s\" is not a timing file", fname);
+        fclose(fp);
+        return NULL;
+    }
+
+    rec = (LOGSHMIM_TIMING_RECORD *) malloc(sizeof(LOGSHMIM_TIMING_RECORD) *
+                                            (hdr.NBframe + 1));
+    if(rec == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    if(fread(rec, sizeof(LOGSHMIM_TIMING_RECORD), hdr.NBframe, fp) !=
+            hdr.NBframe)
+    {
+        PRINT_WARNING("\"%s\" truncated", fname);
+        fclose(fp);
+        free(rec);
+        return NULL;
+    }
+    fclose(fp);
+
+    *NBframe = hdr.NBframe;
+    return rec;
+}
+
+/**
+ * @brief Load ASCII timing file, see logshmim_timing_save_ascii()
+ *
+ * @return records, to be freed by caller, NULL on error
+ */
+LOGSHMIM_TIMING_RECORD *logshmim_timing_load_ascii(const char *fname,
+        long       *NBframe)
+{
+    *NBframe = 0;
+
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL)
+    {
+        PRINT_WARNING("cannot open file \"%s\"", fname);
+        return NULL;
+    }
+
+    long                    NBalloc = 1000;
+    long                    NB      = 0;
+    LOGSHMIM_TIMING_RECORD *rec     = (LOGSHMIM_TIMING_RECORD *) malloc(
+                                          sizeof(LOGSHMIM_TIMING_RECORD) * NBalloc);
+    if(rec == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    char line[STRINGMAXLEN_DEFAULT];
+    while(fgets(line, STRINGMAXLEN_DEFAULT, fp) != NULL)
+    {
+        if(line[0] == '#')
+        {
+            continue;
+        }
+
+        long          k;
+        unsigned long index;
+        double        trel;
+        long          cnt0;
+        long          cnt1;
+        if(NB == NBalloc)
+        {
+            NBalloc *= 2;
+            rec = (LOGSHMIM_TIMING_RECORD *) realloc(
+                      rec,
+                      sizeof(LOGSHMIM_TIMING_RECORD) * NBalloc);
+            if(rec == NULL)
+            {
+                PRINT_ERROR("realloc error");
+                abort();
+            }
+        }
+        if(sscanf(line,
+                  "%ld %lu %lf %lf %lf %ld %ld",
+                  &k,
+                  &index,
+                  &trel,
+                  &rec[NB].time,
+                  &rec[NB].aqtime,
+                  &cnt0,
+                  &cnt1) != 7)
+        {
+            continue;
+        }
+        rec[NB].index = index;
+        rec[NB].cnt0  = cnt0;
+        rec[NB].cnt1  = cnt1;
+        NB++;
+    }
+    fclose(fp);
+
+    if(NB == 0)
+    {
+        PRINT_WARNING("\"%s\" has no timing entry", fname);
+        free(rec);
+        return NULL;
+    }
+
+    *NBframe = NB;
+    return rec;
+}
+
+// file name without directory
+static const char *logshmim_basename(const char *fname)
+{
+    const char *c = strrchr(fname, '/');
+    return (c == NULL) ? fname : c + 1;
+}
+
+/**
+ * @brief Append cube to stream catalog
+ *
+ * File names are stored relative to the catalog, which is in the same
+ * directory as the cubes.
+ */
+errno_t logshmim_catalog_append(const char *fnamecatalog,
+                                const char *fname,
+                                const char *fnametiming,
+                                long        NBframe,
+                                uint64_t   *arraycnt0,
+                                double     *arraytime)
+{
+    DEBUG_TRACE_FSTART();
+
+    LOGSHMIM_CATALOG_ENTRY entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.magic = LOGSHMIM_CATALOG_MAGIC;
+    strncpy(entry.fname,
+            logshmim_basename(fname),
+            LOGSHMIM_CATALOG_FNAMELEN - 1);
+    strncpy(entry.fnametiming,
+            logshmim_basename(fnametiming),
+            LOGSHMIM_CATALOG_FNAMELEN - 1);
+    entry.NBframe = NBframe;
+    if(NBframe > 0)
+    {
+        entry.cnt0start = arraycnt0[0];
+        entry.cnt0end   = arraycnt0[NBframe - 1];
+        entry.tstart    = arraytime[0];
+        entry.tend      = arraytime[NBframe - 1];
+    }
+
+    // single write with O_APPEND, entries are not interleaved
+    int fd = open(fnamecatalog, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(fd == -1)
+    {
+        FUNC_RETURN_FAILURE("cannot open catalog \"%s\"", fnamecatalog);
+    }
+    if(write(fd, &entry, sizeof(entry)) != (ssize_t) sizeof(entry))
+    {
+        close(fd);
+        FUNC_RETURN_FAILURE("write error on catalog \"%s\"", fnamecatalog);
+    }
+    close(fd);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Read stream catalog
+ *
+ * @return entries, to be freed by caller, NULL if none
+ */
+LOGSHMIM_CATALOG_ENTRY *logshmim_catalog_load(const char *fname,
+                                              long       *NBentry)
+{
+    LOGSHMIM_CATALOG_ENTRY *entry = NULL;
+
+    *NBentry = 0;
+
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL)
+    {
+        PRINT_WARNING("cannot open catalog \"%s\"", fname);
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fileno(fp), &st) != 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    // trailing partial entry, if any, is being written
+    long NBmax = st.st_size / sizeof(LOGSHMIM_CATALOG_ENTRY);
+    if(NBmax == 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    entry = (LOGSHMIM_CATALOG_ENTRY *) malloc(sizeof(LOGSHMIM_CATALOG_ENTRY) *
+            NBmax);
+    if(entry == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    long n = fread(entry, sizeof(LOGSHMIM_CATALOG_ENTRY), NBmax, fp);
+    fclose(fp);
+
+    long NB = 0;
+    for(long i = 0; i < n; i++)
+    {
+        if(entry[i].magic == LOGSHMIM_CATALOG_MAGIC)
+        {
+            entry[NB] = entry[i];
+            NB++;
+        }
+    }
+
+    *NBentry = NB;
+    return entry;
+}
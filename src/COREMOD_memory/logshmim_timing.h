@@ -0,0 +1,49 @@
+/**
+ * @file    logshmim_timing.h
+ */
+
+#ifndef CLICORE_MEMORY_LOGSHMIM_TIMING_H
+#define CLICORE_MEMORY_LOGSHMIM_TIMING_H
+
+#include "shmimlog_types.h"
+
+// number of keywords written by logshmim_timing_keywords()
+#define LOGSHMIM_NBTIMEKW 9
+
+int logshmim_timing_keywords(IMAGE_KEYWORD *imkwarray,
+                             double         tstart,
+                             double         tend);
+
+errno_t logshmim_timing_save_ascii(const char *fname,
+                                   long        NBframe,
+                                   uint64_t   *arrayindex,
+                                   uint64_t   *arraycnt0,
+                                   uint64_t   *arraycnt1,
+                                   double     *arraytime,
+                                   double     *arrayaqtime);
+
+errno_t logshmim_timing_save_binary(const char *fname,
+                                    long        NBframe,
+                                    uint64_t   *arrayindex,
+                                    uint64_t   *arraycnt0,
+                                    uint64_t   *arraycnt1,
+                                    double     *arraytime,
+                                    double     *arrayaqtime);
+
+LOGSHMIM_TIMING_RECORD *logshmim_timing_load_binary(const char *fname,
+        long       *NBframe);
+
+LOGSHMIM_TIMING_RECORD *logshmim_timing_load_ascii(const char *fname,
+        long       *NBframe);
+
+errno_t logshmim_catalog_append(const char *fnamecatalog,
+                                const char *fname,
+                                const char *fnametiming,
+                                long        NBframe,
+                                uint64_t   *arraycnt0,
+                                double     *arraytime);
+
+LOGSHMIM_CATALOG_ENTRY *logshmim_catalog_load(const char *fname,
+                                              long       *NBentry);
+
+#endif
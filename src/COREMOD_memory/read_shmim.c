@@ -66,10 +66,13 @@ IMGID read_sharedmem_img(
             {
                 printf("read shared mem image failed -> ID = -1\n");
                 fflush(stdout);
+                data.image[img.ID].used = 0;
+                image_ID_index_freeslot(img.ID);
                 img.ID = -1;
             }
             else
             {
+                image_ID_index_add(img.ID);
                 img.im = &data.image[img.ID];
                 img.md = &data.image[img.ID].md[0];
                 strcpy(img.name, sname);
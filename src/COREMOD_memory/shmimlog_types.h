@@ -7,6 +7,8 @@
 #ifndef CLICORE_MEMORY_LOGSHMIM_TYPES_H
 #define CLICORE_MEMORY_LOGSHMIM_TYPES_H
 
+#include <pthread.h>
+#include <semaphore.h>
 
 typedef struct
 {
@@ -17,17 +19,21 @@ typedef struct
 
     float timespan; // measured execution time for saving
     int writerRTprio; // writer real-time priority
+    int NBthread;     // FITS writer threads, 0 for cfitsio
 
 
     int saveascii;
     // 0 : Not saving ascii
     // 1 : Saving ascii: arraycnt0, arraycnt1, arraytime
     // 2 : ???
+    int savebintiming; // 1 : binary timing file and catalog entry
     char compress_string[200];
 
     char fname_auxFITSheader[STRINGMAXLEN_FULLFILENAME];
 
     char      fnameascii[STRINGMAXLEN_FULLFILENAME]; // name of frame to be saved
+    char      fnametiming[STRINGMAXLEN_FULLFILENAME];  // binary timing file
+    char      fnamecatalog[STRINGMAXLEN_FULLFILENAME]; // stream log catalog
     uint64_t *arrayindex;
     uint64_t *arraycnt0;
     uint64_t *arraycnt1;
@@ -38,5 +44,164 @@ typedef struct
 
 
 
+// binary timing file, see logshmim_timing.c
+// LOGSHMIM_TIMING_HEADER followed by NBframe LOGSHMIM_TIMING_RECORD
+
+#define LOGSHMIM_TIMING_MAGIC "MILKTIM1"
+
+typedef struct
+{
+    char     magic[8];
+    uint64_t NBframe;
+    uint32_t recsize; // sizeof(LOGSHMIM_TIMING_RECORD)
+    uint32_t reserved;
+} LOGSHMIM_TIMING_HEADER;
+
+typedef struct
+{
+    uint64_t index;  // main index
+    uint64_t cnt0;   // stream cnt0
+    uint64_t cnt1;   // stream cnt1
+    double   time;   // logging time
+    double   aqtime; // acquisition time
+} LOGSHMIM_TIMING_RECORD;
+
+
+// stream log catalog <dirname>/<streamname>.logcat
+// one LOGSHMIM_CATALOG_ENTRY appended per cube, once files are complete
+
+#define LOGSHMIM_CATALOG_MAGIC    0x4D4C4354
+#define LOGSHMIM_CATALOG_FNAMELEN 200
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t reserved;
+    char     fname[LOGSHMIM_CATALOG_FNAMELEN];       // cube, relative to catalog
+    char     fnametiming[LOGSHMIM_CATALOG_FNAMELEN]; // binary timing file
+    uint64_t NBframe;
+    uint64_t cnt0start;
+    uint64_t cnt0end;
+    double   tstart; // logging time of first frame
+    double   tend;   // logging time of last frame
+} LOGSHMIM_CATALOG_ENTRY;
+
+
+
+// direct I/O logging, see logshmim_directio.c
+
+// file offset and size alignment for O_DIRECT
+#define LOGDIO_ALIGN 4096
+
+// FITS header size, multiple of 2880 and LOGDIO_ALIGN
+#define LOGDIO_HDRSIZE 184320
+
+// max number of cubes being written
+#define LOGDIO_NBCUBE 4
+
+// max number of LOGDIO sharing a writer pool
+#define LOGDIO_POOL_NBMAX 128
+
+typedef struct LOGDIO_POOL LOGDIO_POOL;
+
+typedef struct
+{
+    // timing and catalog files are not written if name is empty
+    char fname[STRINGMAXLEN_FULLFILENAME];
+    char fnameascii[STRINGMAXLEN_FULLFILENAME];
+    char fnametiming[STRINGMAXLEN_FULLFILENAME];
+    char fnamecatalog[STRINGMAXLEN_FULLFILENAME];
+
+    // stream keywords at cube start
+    int            NBkw;
+    IMAGE_KEYWORD *kw;
+
+    long      NBframemax;   // max frames in cube
+    long      NBframealloc; // allocated size of timing arrays
+    long      NBframe;      // frames in cube
+    uint64_t *arraycnt0;
+    uint64_t *arraycnt1;
+    double   *arraytime;
+    double   *arrayaqtime;
+
+    char *hdr; // FITS header, LOGDIO_HDRSIZE byte, aligned
+
+    // writer thread
+    int             fd;
+    long            offset;  // data bytes written
+    struct timespec tclose;  // time cube was closed by logger
+} LOGDIO_CUBE;
+
+typedef struct
+{
+    long     len;   // data bytes in block
+    uint64_t cube;  // cube index
+    int      first; // first block of cube
+    int      last;  // last block of cube
+} LOGDIO_BLOCK;
+
+typedef struct
+{
+    uint8_t  datatype;
+    int      typesize;
+    uint64_t signmask; // sign bit flipped for unsigned integer types
+    int      bitpix;
+    char     bzero[24]; // empty if none
+    uint32_t xsize;
+    uint32_t ysize;
+    long     framesize;
+
+    // ring of NBblock blocks of blocksize byte
+    char         *ring;
+    long          blocksize;
+    long          NBblock;
+    LOGDIO_BLOCK *block;
+
+    // producer (logger loop)
+    long     blockfill; // bytes in current block
+    int      blockfirst;
+    int      cubeopen;
+    uint64_t blockcnt; // blocks handed to writer
+    uint64_t cubecnt;  // cubes opened
+
+    // consumer (writer thread)
+    uint64_t blockdone; // blocks written
+    uint64_t cubedone;  // cubes completed
+    uint64_t nbwriteerr;
+    float    savetime;  // last cube close to file complete [s]
+
+    LOGDIO_CUBE cube[LOGDIO_NBCUBE];
+
+    sem_t     semblock; // posted for each block handed to writer
+    pthread_t thread;
+    int       writerRTprio;
+    int       stop;
+
+    // shared writer pool, NULL if own writer thread
+    LOGDIO_POOL *pool;
+    int          prio; // pool scheduling priority, higher first
+    int          busy; // blocks being written by a pool writer
+} LOGDIO;
+
+// writer threads shared by several LOGDIO
+// a LOGDIO is served by one writer at a time, so that its blocks are
+// written in order
+struct LOGDIO_POOL
+{
+    int        NBwriter;
+    pthread_t *thread;
+    int        writerRTprio;
+
+    pthread_mutex_t lock; // protects ldio, NBldio, busy flags and stop
+    pthread_cond_t  cond; // signaled when blocks are handed over
+
+    int     NBldio;
+    LOGDIO *ldio[LOGDIO_POOL_NBMAX];
+
+    int stop;
+};
+
+
+
 
 #endif
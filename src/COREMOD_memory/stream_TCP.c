@@ -6,7 +6,15 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sched.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define TCP_HAVE_ZEROCOPY
+#endif
 
 #include "CommandLineInterface/CLIcore.h"
 #include "create_image.h"
@@ -14,17 +22,428 @@
 #include "image_ID.h"
 #include "list_image.h"
 #include "read_shmim.h"
+#include "stream_netcodec.h"
 #include "stream_sem.h"
+#include "stream_TCP.h"
 
 // set to 1 if transfering keywords
 static int TCPTRANSFERKW = 1;
 
+// smaller frames are sent with copy, MSG_ZEROCOPY setup costs more
+#define TCP_ZEROCOPY_MINSIZE 16384
+
 typedef struct
 {
     long cnt0;
     long cnt1;
 } TCP_BUFFER_METADATA;
 
+// frame header, NETWTRANSFER_MODE_DIRECT
+#define TCP_FRAMEHEADER_MAGIC 0x6D696C6B
+
+// receiver keeps copy of frame as reference for next delta encoding
+#define TCP_FRAMEFLAG_REF 0x01
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t cnt1; // slice
+    uint64_t cnt0;
+    uint32_t codec;   // NETCODEC_ encoding of pixel data
+    uint32_t flags;
+    uint64_t encsize; // encoded pixel data size
+} TCP_FRAMEHEADER;
+
+// frame encoding buffers
+typedef struct
+{
+    char *enc[2]; // encoded frame, two buffers to keep best encoding
+    char *ref;    // previous frame
+    char *cur;    // current frame, copied once from stream, next reference
+    char *work;
+    int   refvalid;
+} TCP_CODECBUFF;
+
+static void TCP_codecbuff_alloc(TCP_CODECBUFF *cbuff, long framesize)
+{
+    cbuff->enc[0]   = (char *) malloc(framesize);
+    cbuff->enc[1]   = (char *) malloc(framesize);
+    cbuff->ref      = (char *) malloc(framesize);
+    cbuff->cur      = (char *) malloc(framesize);
+    cbuff->work     = (char *) malloc(framesize);
+    cbuff->refvalid = 0;
+    if((cbuff->enc[0] == NULL) || (cbuff->enc[1] == NULL) ||
+            (cbuff->ref == NULL) || (cbuff->cur == NULL) ||
+            (cbuff->work == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+}
+
+static void TCP_codecbuff_free(TCP_CODECBUFF *cbuff)
+{
+    free(cbuff->enc[0]);
+    free(cbuff->enc[1]);
+    free(cbuff->ref);
+    free(cbuff->cur);
+    free(cbuff->work);
+    memset(cbuff, 0, sizeof(TCP_CODECBUFF));
+}
+
+/**
+ * @brief Encode frame with smallest of encodings selected by mode
+ *
+ * payload and payloadsize point to raw frame if no encoding is smaller
+ *
+ * @return NETCODEC_ encoding
+ */
+static int TCP_frame_encode(int            mode,
+                            TCP_CODECBUFF *cbuff,
+                            char          *frame,
+                            long           nelem,
+                            int            typesize,
+                            char         **payload,
+                            long          *payloadsize)
+{
+    int codeclist[3];
+    int NBcodec = 0;
+
+    // cheapest first, so that they bound the output size of others
+    if((mode & NETWTRANSFER_MODE_CODEC_SPARSE) && cbuff->refvalid)
+    {
+        codeclist[NBcodec++] = NETCODEC_SPARSE;
+    }
+    if((mode & NETWTRANSFER_MODE_CODEC_XOR) && cbuff->refvalid)
+    {
+        codeclist[NBcodec++] = NETCODEC_XORRLE;
+    }
+    if(mode & NETWTRANSFER_MODE_CODEC_RLE)
+    {
+        codeclist[NBcodec++] = NETCODEC_SHUFFLERLE;
+    }
+
+    int  codec   = NETCODEC_RAW;
+    long size    = nelem * typesize;
+    int  ibuff   = 0;
+    *payload     = frame;
+    *payloadsize = size;
+
+    for(int i = 0; i < NBcodec; i++)
+    {
+        long encsize = netcodec_encode(codeclist[i],
+                                       frame,
+                                       cbuff->ref,
+                                       nelem,
+                                       typesize,
+                                       cbuff->enc[ibuff],
+                                       size - 1,
+                                       cbuff->work);
+        if(encsize >= 0)
+        {
+            codec        = codeclist[i];
+            size         = encsize;
+            *payload     = cbuff->enc[ibuff];
+            *payloadsize = encsize;
+            ibuff        = 1 - ibuff;
+        }
+    }
+
+    return codec;
+}
+
+/**
+ * @brief Send all iovec content, resuming after partial sends
+ *
+ * iov is modified. If nbcall is not NULL, it is incremented for each
+ * successful sendmsg call.
+ *
+ * @return number of bytes sent, -1 on error
+ */
+static ssize_t TCP_sendmsg_all(int           fd,
+                               struct iovec *iov,
+                               int           iovcnt,
+                               int           flags,
+                               uint32_t     *nbcall)
+{
+    ssize_t totsent = 0;
+
+    while(iovcnt > 0)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t rs = sendmsg(fd, &msg, flags);
+        if(rs < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if(nbcall != NULL)
+        {
+            (*nbcall)++;
+        }
+        totsent += rs;
+
+        // skip sent bytes
+        while((iovcnt > 0) && ((size_t) rs >= iov->iov_len))
+        {
+            rs -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0)
+        {
+            iov->iov_base = (char *) iov->iov_base + rs;
+            iov->iov_len -= rs;
+        }
+    }
+
+    return totsent;
+}
+
+#ifdef TCP_HAVE_ZEROCOPY
+/**
+ * @brief Wait until MSG_ZEROCOPY sends are completed
+ *
+ * The kernel numbers MSG_ZEROCOPY sendmsg calls from 0, and reports
+ * completed ranges on the socket error queue. Waits until zcdone, the
+ * number of completed calls, reaches zcseq, the number of calls.
+ *
+ * @return 0 if completed, -1 on socket error or 2 sec timeout
+ */
+static int TCP_zerocopy_wait(int fd, uint32_t zcseq, uint32_t *zcdone)
+{
+    while(*zcdone != zcseq)
+    {
+        // error queue readiness is reported as POLLERR
+        struct pollfd pfd;
+        pfd.fd      = fd;
+        pfd.events  = 0;
+        pfd.revents = 0;
+
+        int pr = poll(&pfd, 1, 2000);
+        if(pr < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if(pr == 0)
+        {
+            return -1;
+        }
+
+        int NBnotif = 0;
+        while(1)
+        {
+            char          control[100];
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control    = control;
+            msg.msg_controllen = sizeof(control);
+
+            if(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            {
+                break;
+            }
+            for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL;
+                    cm = CMSG_NXTHDR(&msg, cm))
+            {
+                struct sock_extended_err *serr =
+                    (struct sock_extended_err *) CMSG_DATA(cm);
+                if((serr->ee_errno == 0) &&
+                        (serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY))
+                {
+                    // calls ee_info to ee_data completed, in order
+                    *zcdone = serr->ee_data + 1;
+                    NBnotif++;
+                }
+            }
+        }
+        if(NBnotif == 0)
+        {
+            // POLLERR without notification : socket error
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Send iovec content, entry zcindex with MSG_ZEROCOPY
+ *
+ * Other entries (header, metadata, keywords) are small and rewritten
+ * every frame, so they are copied. Returns once the kernel has released
+ * the zero-copy pages, so that the slice is not read after return.
+ *
+ * @return number of bytes sent, -1 on error
+ */
+static ssize_t TCP_sendmsg_zerocopy(int           fd,
+                                    struct iovec *iov,
+                                    int           iovcnt,
+                                    int           zcindex,
+                                    uint32_t     *zcseq,
+                                    uint32_t     *zcdone)
+{
+    ssize_t totsent = 0;
+
+    for(int i = 0; i < iovcnt; i++)
+    {
+        int       flags  = (i < iovcnt - 1) ? MSG_MORE : 0;
+        uint32_t *nbcall = NULL;
+        if(i == zcindex)
+        {
+            flags |= MSG_ZEROCOPY;
+            nbcall = zcseq;
+        }
+        ssize_t rs = TCP_sendmsg_all(fd, &iov[i], 1, flags, nbcall);
+        if(rs < 0)
+        {
+            return -1;
+        }
+        totsent += rs;
+    }
+
+    if(TCP_zerocopy_wait(fd, *zcseq, zcdone) != 0)
+    {
+        return -1;
+    }
+
+    return totsent;
+}
+#endif
+
+/**
+ * @brief Receive frame header, then pixel data and keywords in place
+ *
+ * @return number of bytes received, 0 if connection closed, -1 on error
+ */
+static ssize_t TCP_recv_direct(int              fd,
+                               TCP_FRAMEHEADER *framehdr,
+                               char            *ptr0,
+                               long             framesize,
+                               int              typesize,
+                               long             NBslices,
+                               char            *kwptr,
+                               long             kwsize,
+                               TCP_CODECBUFF   *cbuff)
+{
+    ssize_t rs = recv(fd, framehdr, sizeof(TCP_FRAMEHEADER), MSG_WAITALL);
+    if(rs <= 0)
+    {
+        return rs;
+    }
+    if((rs != sizeof(TCP_FRAMEHEADER)) ||
+            (framehdr->magic != TCP_FRAMEHEADER_MAGIC) ||
+            (framehdr->cnt1 >= NBslices))
+    {
+        PRINT_ERROR("invalid frame header - is transmitter in direct mode ?");
+        return -1;
+    }
+
+    char *ptrslice = ptr0 + framesize * framehdr->cnt1;
+
+    if((framehdr->codec != NETCODEC_RAW) ||
+            (framehdr->flags & TCP_FRAMEFLAG_REF))
+    {
+        if(cbuff->work == NULL)
+        {
+            TCP_codecbuff_alloc(cbuff, framesize);
+        }
+    }
+    if((framehdr->codec == NETCODEC_RAW) &&
+            (framehdr->encsize != (uint64_t) framesize))
+    {
+        PRINT_ERROR("invalid frame size %ld", (long) framehdr->encsize);
+        return -1;
+    }
+    if(framehdr->encsize > (uint64_t) framesize)
+    {
+        PRINT_ERROR("invalid encoded frame size %ld", (long) framehdr->encsize);
+        return -1;
+    }
+    if(((framehdr->codec == NETCODEC_XORRLE) ||
+            (framehdr->codec == NETCODEC_SPARSE)) &&
+            (cbuff->refvalid == 0))
+    {
+        PRINT_ERROR("delta encoded frame without reference frame");
+        return -1;
+    }
+
+    // raw pixel data received in place, encoded data in buffer
+    struct iovec iov[2];
+    int          iovcnt = 0;
+    if(framehdr->codec == NETCODEC_RAW)
+    {
+        iov[iovcnt].iov_base = ptrslice;
+    }
+    else
+    {
+        iov[iovcnt].iov_base = cbuff->enc[0];
+    }
+    iov[iovcnt].iov_len = framehdr->encsize;
+    iovcnt++;
+    if(kwsize > 0)
+    {
+        iov[iovcnt].iov_base = kwptr;
+        iov[iovcnt].iov_len  = kwsize;
+        iovcnt++;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = iovcnt;
+
+    // unchanged SPARSE frame without keywords : nothing follows header
+    ssize_t rs1 = 0;
+    if(framehdr->encsize + kwsize > 0)
+    {
+        rs1 = recvmsg(fd, &msg, MSG_WAITALL);
+        if(rs1 <= 0)
+        {
+            return rs1;
+        }
+    }
+    if(rs1 != (ssize_t)(framehdr->encsize + kwsize))
+    {
+        return -1;
+    }
+
+    if(framehdr->codec != NETCODEC_RAW)
+    {
+        if(netcodec_decode(framehdr->codec,
+                           cbuff->enc[0],
+                           framehdr->encsize,
+                           cbuff->ref,
+                           framesize / typesize,
+                           typesize,
+                           ptrslice,
+                           cbuff->work) != RETURN_SUCCESS)
+        {
+            PRINT_ERROR("cannot decode %s frame",
+                        netcodec_name(framehdr->codec));
+            return -1;
+        }
+    }
+    if(framehdr->flags & TCP_FRAMEFLAG_REF)
+    {
+        memcpy(cbuff->ref, ptrslice, framesize);
+        cbuff->refvalid = 1;
+    }
+
+    return rs + rs1;
+}
+
 // ==========================================
 // Forward declaration(s)
 // ==========================================
@@ -42,6 +461,11 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(const char *IDname,
 imageID
 COREMOD_MEMORY_image_NETWORKreceive(int port, int mode, int RT_priority);
 
+imageID COREMOD_MEMORY_image_NETWORKreceive_ready(int      port,
+        int      mode,
+        int      RT_priority,
+        imageID *IDready);
+
 // ==========================================
 // Command line interface wrapper function(s)
 // ==========================================
@@ -119,7 +543,7 @@ errno_t stream__TCP_addCLIcmd()
                        __FILE__,
                        COREMOD_MEMORY_image_NETWORKtransmit__cli,
                        "transmit image over network",
-                       "<image> <IP addr> <port [long]> <sync mode [int]>",
+                       "<image> <IP addr> <port [long]> <mode flags [int]>",
                        "imnetwtransmit im1 127.0.0.1 0 8888 0",
                        "long COREMOD_MEMORY_image_NETWORKtransmit(const char "
                        "*IDname, const char *IPaddr, int port, int mode)");
@@ -127,9 +551,9 @@ errno_t stream__TCP_addCLIcmd()
     RegisterCLIcommand("imnetwreceive",
                        __FILE__,
                        COREMOD_MEMORY_image_NETWORKreceive__cli,
-                       "receive image(s) over network. mode=1 uses counter "
-                       "instead of semaphore",
-                       "<port [long]> <mode [int]> <RT priority>",
+                       "receive image(s) over network. mode flag 2 receives "
+                       "in place (direct mode)",
+                       "<port [long]> <mode flags [int]> <RT priority>",
                        "imnetwreceive 8887 0 80",
                        "long COREMOD_MEMORY_image_NETWORKreceive(int port, int "
                        "mode, int RT_priority)");
@@ -238,7 +662,17 @@ errno_t COREMOD_MEMORY_testfunction_semaphore(const char *IDname,
 }
 
 /** continuously transmits 2D image through TCP link
- * mode = 1, force counter to be used for synchronization, ignore semaphores if they exist
+ *
+ * Pixel data, frame metadata and keywords are sent from the stream with a
+ * single scatter-gather sendmsg, without staging copy.
+ *
+ * mode flags (see stream_TCP.h):
+ * NETWTRANSFER_MODE_COUNTERSYNC : force counter to be used for synchronization, ignore semaphores if they exist
+ * NETWTRANSFER_MODE_DIRECT      : send frame header first, receiver must also use this flag
+ * NETWTRANSFER_MODE_MSGZEROCOPY : send pixel data with MSG_ZEROCOPY if
+ *                                 available, for rolling buffer (3D) streams
+ *                                 and frames >= TCP_ZEROCOPY_MINSIZE
+ * NETWTRANSFER_MODE_CODEC_*     : encode frames (implies direct mode)
  */
 
 imageID COREMOD_MEMORY_image_NETWORKtransmit(
@@ -266,9 +700,25 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(
     int             NBslices;
 
     TCP_BUFFER_METADATA *frame_md;
+    TCP_FRAMEHEADER      framehdr;
+    TCP_CODECBUFF        cbuff;
     long                 framesize1; // pixel data + metadata
     long  framesizeall; // total frame size : pixel data + metadata + kw
-    char *buff;         // transmit buffer
+    long  framesizesent;
+    int   sendflags = 0;
+    uint32_t zcseq  = 0; // MSG_ZEROCOPY calls
+    uint32_t zcdone = 0; // MSG_ZEROCOPY calls completed
+
+    // statistics, encoded frames
+    long long rawbytes  = 0;
+    long long wirebytes = 0;
+
+    memset(&cbuff, 0, sizeof(TCP_CODECBUFF));
+    memset(&framehdr, 0, sizeof(TCP_FRAMEHEADER));
+    if(mode & NETWTRANSFER_MODE_CODECMASK)
+    {
+        mode |= NETWTRANSFER_MODE_DIRECT;
+    }
 
     int semtrig = 6; // TODO - scan for available sem
     // IMPORTANT: do not use semtrig 0
@@ -334,6 +784,29 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(
         loopOK = 0;
     }
 
+    if(mode & NETWTRANSFER_MODE_MSGZEROCOPY)
+    {
+#ifdef TCP_HAVE_ZEROCOPY
+        if(setsockopt(fds_client,
+                      SOL_SOCKET,
+                      SO_ZEROCOPY,
+                      (char *) &flag,
+                      sizeof(flag)) == 0)
+        {
+            sendflags = MSG_ZEROCOPY;
+        }
+        else
+        {
+            perror("setsockopt SO_ZEROCOPY");
+        }
+#endif
+        if(sendflags == 0)
+        {
+            processinfo_WriteMessage(processinfo,
+                                     "MSG_ZEROCOPY unavailable, copying");
+        }
+    }
+
     if(loopOK == 1)
     {
         memset((char *) &sock_server, 0, sizeof(sock_server));
@@ -420,18 +893,34 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(
                 framesize1 + img_p->md[0].NBkw * sizeof(IMAGE_KEYWORD);
         }
 
-        buff = (char *) malloc(sizeof(char) * framesizeall);
+        if(mode & NETWTRANSFER_MODE_DIRECT)
+        {
+            framesizeall += sizeof(TCP_FRAMEHEADER) - sizeof(TCP_BUFFER_METADATA);
+        }
 
-        printf("transfer buffer size = %ld\n", framesizeall);
+        if(mode & NETWTRANSFER_MODE_CODECMASK)
+        {
+            TCP_codecbuff_alloc(&cbuff, framesize);
+        }
+
+        printf("transfer frame size = %ld\n", framesizeall);
         fflush(stdout);
 
+        if((sendflags != 0) && (NBslices == 1))
+        {
+            // producer rewrites the slice while it is sent
+            processinfo_WriteMessage(processinfo,
+                                     "2D stream, MSG_ZEROCOPY disabled");
+            sendflags = 0;
+        }
+
         oldslice = 0;
         //sockOK = 1;
         printf("sem = %d\n", img_p->md[0].sem);
         fflush(stdout);
     }
 
-    if((img_p->md[0].sem == 0) || (mode == 1))
+    if((img_p->md[0].sem == 0) || (mode & NETWTRANSFER_MODE_COUNTERSYNC))
     {
         processinfo_WriteMessage(processinfo, "sync using counter");
         UseSem = 0;
@@ -528,19 +1017,123 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(
                     ptr0 +
                     framesize *
                     slice; //img_p->md[0].cnt1; // frame that was just written
-                memcpy(buff, ptr1, framesize);
-                memcpy(buff + framesize, frame_md, sizeof(TCP_BUFFER_METADATA));
 
+                // scatter-gather send straight from stream
+                struct iovec iov[3];
+                int          iovcnt     = 0;
+                int          zcindex    = -1; // iov entry sent zero-copy
+                int          sendflags1 = sendflags;
+                if(framesize < TCP_ZEROCOPY_MINSIZE)
+                {
+                    sendflags1 = 0;
+                }
+                framesizesent           = framesizeall;
+                if(mode & NETWTRANSFER_MODE_DIRECT)
+                {
+                    char *payload     = ptr1;
+                    long  payloadsize = framesize;
+
+                    framehdr.codec = NETCODEC_RAW;
+                    framehdr.flags = 0;
+                    if(mode & NETWTRANSFER_MODE_CODECMASK)
+                    {
+                        // single read of stream slice, so that encoded
+                        // frame and next reference are the same data
+                        memcpy(cbuff.cur, ptr1, framesize);
+                        framehdr.codec = TCP_frame_encode(
+                                             mode,
+                                             &cbuff,
+                                             cbuff.cur,
+                                             framesize / ImageStreamIO_typesize(
+                                                 img_p->md[0].datatype),
+                                             ImageStreamIO_typesize(
+                                                 img_p->md[0].datatype),
+                                             &payload,
+                                             &payloadsize);
+                        if(mode & (NETWTRANSFER_MODE_CODEC_XOR |
+                                   NETWTRANSFER_MODE_CODEC_SPARSE))
+                        {
+                            framehdr.flags |= TCP_FRAMEFLAG_REF;
+                        }
+                        // codec buffers are reused next frame
+                        sendflags1 = 0;
+                        rawbytes += framesize;
+                        wirebytes += payloadsize;
+                    }
+                    framehdr.magic   = TCP_FRAMEHEADER_MAGIC;
+                    framehdr.cnt1    = slice;
+                    framehdr.cnt0    = frame_md[0].cnt0;
+                    framehdr.encsize = payloadsize;
+                    framesizesent += payloadsize - framesize;
+
+                    iov[iovcnt].iov_base    = &framehdr;
+                    iov[iovcnt].iov_len     = sizeof(TCP_FRAMEHEADER);
+                    iovcnt++;
+                    if(sendflags1 != 0)
+                    {
+                        zcindex = iovcnt;
+                    }
+                    iov[iovcnt].iov_base    = payload;
+                    iov[iovcnt].iov_len     = payloadsize;
+                    iovcnt++;
+                }
+                else
+                {
+                    if(sendflags1 != 0)
+                    {
+                        zcindex = iovcnt;
+                    }
+                    iov[iovcnt].iov_base    = ptr1;
+                    iov[iovcnt].iov_len     = framesize;
+                    iovcnt++;
+                    iov[iovcnt].iov_base    = frame_md;
+                    iov[iovcnt].iov_len     = sizeof(TCP_BUFFER_METADATA);
+                    iovcnt++;
+                }
                 if(TCPTRANSFERKW == 1)
                 {
-                    memcpy(buff + framesize1,
-                           (char *) img_p->kw,
-                           img_p->md[0].NBkw * sizeof(IMAGE_KEYWORD));
+                    iov[iovcnt].iov_base = (char *) img_p->kw;
+                    iov[iovcnt].iov_len =
+                        img_p->md[0].NBkw * sizeof(IMAGE_KEYWORD);
+                    iovcnt++;
                 }
 
-                rs = send(fds_client, buff, framesizeall, 0);
+#ifdef TCP_HAVE_ZEROCOPY
+                if(zcindex >= 0)
+                {
+                    rs = TCP_sendmsg_zerocopy(fds_client,
+                                              iov,
+                                              iovcnt,
+                                              zcindex,
+                                              &zcseq,
+                                              &zcdone);
+                }
+                else
+#endif
+                {
+                    rs = TCP_sendmsg_all(fds_client, iov, iovcnt, 0, NULL);
+                }
 
-                if(rs != framesizeall)
+                if(framehdr.flags & TCP_FRAMEFLAG_REF)
+                {
+                    // frame sent becomes reference
+                    char *tmpptr   = cbuff.ref;
+                    cbuff.ref      = cbuff.cur;
+                    cbuff.cur      = tmpptr;
+                    cbuff.refvalid = 1;
+                }
+
+                if((rawbytes > 0) && (processinfo->loopcnt % 1000 == 0))
+                {
+                    char msgstring[200];
+                    snprintf(msgstring,
+                             200,
+                             "encoded %.1f%% of raw size",
+                             100.0 * wirebytes / rawbytes);
+                    processinfo_WriteMessage(processinfo, msgstring);
+                }
+
+                if(rs != framesizesent)
                 {
                     perror("socket send error ");
                     snprintf(errmsg,
@@ -550,7 +1143,7 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(
                              "expected %ld  %ld  %ld",
                              rs,
                              (long) framesize,
-                             (long) framesizeall,
+                             (long) framesizesent,
                              (long) sizeof(TCP_BUFFER_METADATA));
                     printf("%s\n", errmsg);
                     fflush(stdout);
@@ -576,24 +1169,45 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(
     // ==================================
     processinfo_cleanExit(processinfo);
 
-    free(buff);
-
     close(fds_client);
     printf("port %d closed\n", port);
     fflush(stdout);
 
     free(frame_md);
+    TCP_codecbuff_free(&cbuff);
 
     return ID;
 }
 
 /** continuously receives 2D image through TCP link
- * mode = 1, force counter to be used for synchronization, ignore semaphores if they exist
+ *
+ * mode flags (see stream_TCP.h):
+ * NETWTRANSFER_MODE_DIRECT : receive pixel data and keywords directly in
+ *                            destination stream slice, transmitter must
+ *                            also use this flag. Encoded frames are
+ *                            decoded according to frame header.
  */
 
-imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
-        __attribute__((unused)) int mode,
+imageID COREMOD_MEMORY_image_NETWORKreceive(int port,
+        int mode,
         int RT_priority)
+{
+    return COREMOD_MEMORY_image_NETWORKreceive_ready(port,
+            mode,
+            RT_priority,
+            NULL);
+}
+
+/** receives as COREMOD_MEMORY_image_NETWORKreceive
+ *
+ * If IDready is not NULL, the stream ID is stored (release) into *IDready
+ * once the stream is created, so that a thread calling this function can
+ * signal readiness to the caller's thread.
+ */
+imageID COREMOD_MEMORY_image_NETWORKreceive_ready(int      port,
+        int      mode,
+        int      RT_priority,
+        imageID *IDready)
 {
     struct sockaddr_in sock_server;
     struct sockaddr_in sock_client;
@@ -627,6 +1241,9 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
     long                 framesize1;    // pixel data + metadata
     long                 framesizefull; // pixel data + metadata + kw
     char                *buff;          // buffer
+    TCP_CODECBUFF        cbuff;         // frame decoding, allocated if needed
+
+    memset(&cbuff, 0, sizeof(TCP_CODECBUFF));
 
     //size_t flushsize;
     char *socket_flush_buff;
@@ -817,8 +1434,6 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
         ID = read_sharedmem_image(imgmd[0].name);
     }
 
-    img_p = &data.image[ID];
-
     list_image_ID();
 
     if(ID == -1)
@@ -827,6 +1442,8 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
     }
     else
     {
+        img_p = &data.image[ID];
+
         OKim = 1;
         if(imgmd[0].naxis != img_p->md[0].naxis)
         {
@@ -844,6 +1461,10 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
         {
             OKim = 0;
         }
+        if((TCPTRANSFERKW == 1) && (imgmd[0].NBkw != img_p->md[0].NBkw))
+        {
+            OKim = 0;
+        }
 
         if(OKim == 0)
         {
@@ -856,10 +1477,6 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
     if(TCPTRANSFERKW == 1)
     {
         nbkw = imgmd[0].NBkw;
-        if(imgmd[0].NBkw != img_p->md[0].NBkw)
-        {
-            OKim = 0;
-        }
     }
 
     if(OKim == 0)
@@ -882,6 +1499,7 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
     {
         printf("REUSING EXISTING IMAGE %s\n", imgmd[0].name);
     }
+    img_p = &data.image[ID];
 
     xsize    = img_p->md[0].size[0];
     ysize    = img_p->md[0].size[1];
@@ -907,6 +1525,10 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
 
     ptr0 = (char *) img_p->array.raw;
 
+    if(IDready != NULL)
+    {
+        __atomic_store_n(IDready, ID, __ATOMIC_RELEASE);
+    }
 
     if(data.processinfo == 1)
     {
@@ -943,7 +1565,15 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
         framesizefull = framesize1 + nbkw * sizeof(IMAGE_KEYWORD);
     }
 
-    buff = (char *) malloc(sizeof(char) * framesizefull);
+    if(mode & NETWTRANSFER_MODE_DIRECT)
+    {
+        // pixel data and keywords received in place, buff holds header
+        buff = (char *) malloc(sizeof(TCP_FRAMEHEADER));
+    }
+    else
+    {
+        buff = (char *) malloc(sizeof(char) * framesizefull);
+    }
 
     frame_md = (TCP_BUFFER_METADATA *)(buff + framesize);
 
@@ -966,6 +1596,8 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
     long monitorloopindex = 0;
     long cnt0previous     = 0;
 
+    socket_flush_buff = NULL;
+    if(!(mode & NETWTRANSFER_MODE_DIRECT))
     {
         // Finally, just before we start, flush the TCP receive buffer. BUT we need to flush an integer number of frames, that's important,
         // or we end up losing sync.
@@ -1007,7 +1639,25 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
             }
         }
 
-        if((recvsize = recv(fds_client, buff, framesizefull, MSG_WAITALL)) < 0)
+        if(mode & NETWTRANSFER_MODE_DIRECT)
+        {
+            recvsize = TCP_recv_direct(fds_client,
+                                       (TCP_FRAMEHEADER *) buff,
+                                       ptr0,
+                                       framesize,
+                                       ImageStreamIO_typesize(
+                                           img_p->md[0].datatype),
+                                       NBslices,
+                                       (char *) img_p->kw,
+                                       nbkw * sizeof(IMAGE_KEYWORD),
+                                       &cbuff);
+            if(recvsize < 0)
+            {
+                printf("ERROR recv()\n");
+                socketOpen = 0;
+            }
+        }
+        else if((recvsize = recv(fds_client, buff, framesizefull, MSG_WAITALL)) < 0)
         {
             printf("ERROR recv()\n");
             socketOpen = 0;
@@ -1029,38 +1679,57 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
 
         if(socketOpen == 1)
         {
-            frame_md = (TCP_BUFFER_METADATA *)(buff + framesize);
-
-            img_p->md[0].cnt1 = frame_md[0].cnt1;
+            long framecnt0;
+            long framecnt1;
 
-            // copy pixel data
-            if(NBslices > 1)
+            if(mode & NETWTRANSFER_MODE_DIRECT)
             {
-                memcpy(ptr0 + framesize * frame_md[0].cnt1, buff, framesize);
+                // pixel data and keywords already received in place
+                TCP_FRAMEHEADER *framehdr = (TCP_FRAMEHEADER *) buff;
+
+                framecnt0 = framehdr->cnt0;
+                framecnt1 = framehdr->cnt1;
+
+                img_p->md[0].cnt1 = framecnt1;
             }
             else
             {
-                memcpy(ptr0, buff, framesize);
-            }
+                frame_md = (TCP_BUFFER_METADATA *)(buff + framesize);
 
-            if(TCPTRANSFERKW == 1)
-            {
-                // copy kw
-                memcpy(img_p->kw,
-                       (IMAGE_KEYWORD *)(buff + framesize1),
-                       nbkw * sizeof(IMAGE_KEYWORD));
+                framecnt0 = frame_md[0].cnt0;
+                framecnt1 = frame_md[0].cnt1;
+
+                img_p->md[0].cnt1 = frame_md[0].cnt1;
+
+                // copy pixel data
+                if(NBslices > 1)
+                {
+                    memcpy(ptr0 + framesize * frame_md[0].cnt1, buff, framesize);
+                }
+                else
+                {
+                    memcpy(ptr0, buff, framesize);
+                }
+
+                if(TCPTRANSFERKW == 1)
+                {
+                    // copy kw
+                    memcpy(img_p->kw,
+                           (IMAGE_KEYWORD *)(buff + framesize1),
+                           nbkw * sizeof(IMAGE_KEYWORD));
+                }
             }
 
-            frameincr = (long) frame_md[0].cnt0 - cnt0previous;
+            frameincr = framecnt0 - cnt0previous;
             if(frameincr > 1)
             {
                 printf("Skipped %ld frame(s) at index %ld %ld\n",
                        frameincr - 1,
-                       (long)(frame_md[0].cnt0),
-                       (long)(frame_md[0].cnt1));
+                       framecnt0,
+                       framecnt1);
             }
 
-            cnt0previous = frame_md[0].cnt0;
+            cnt0previous = framecnt0;
 
             if(monitorindex == monitorinterval)
             {
@@ -1068,12 +1737,12 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
                     "[%5ld]  input %20ld (+ %8ld) output %20ld (+ "
                     "%8ld)\n",
                     monitorloopindex,
-                    frame_md[0].cnt0,
-                    frame_md[0].cnt0 - minputcnt,
+                    framecnt0,
+                    framecnt0 - minputcnt,
                     img_p->md[0].cnt0,
                     img_p->md[0].cnt0 - moutputcnt);
 
-                minputcnt  = frame_md[0].cnt0;
+                minputcnt  = framecnt0;
                 moutputcnt = img_p->md[0].cnt0;
 
                 monitorloopindex++;
@@ -1161,6 +1830,7 @@ imageID COREMOD_MEMORY_image_NETWORKreceive(int                         port,
 
     free(socket_flush_buff);
     free(buff);
+    TCP_codecbuff_free(&cbuff);
 
     close(fds_client);
 
@@ -5,6 +5,24 @@
 #ifndef _STREAM_TCP_H
 #define _STREAM_TCP_H
 
+// network transfer mode flags
+// counter synchronization, ignore semaphores
+#define NETWTRANSFER_MODE_COUNTERSYNC 0x01
+// frame header sent before pixel data, so that receiver can write directly
+// into destination slice. Must be set on both ends
+#define NETWTRANSFER_MODE_DIRECT 0x02
+// transmit with MSG_ZEROCOPY
+// pixel data is read by the kernel after send returns, so stream slice
+// should not be rewritten until transmitted (circular buffer)
+#define NETWTRANSFER_MODE_MSGZEROCOPY 0x04
+// frame encodings tried by transmitter, see stream_netcodec.h
+// smallest encoding is sent, raw if none pays off
+// imply NETWTRANSFER_MODE_DIRECT, receiver decodes according to frame header
+#define NETWTRANSFER_MODE_CODEC_RLE    0x10 // byte shuffle + run-length
+#define NETWTRANSFER_MODE_CODEC_XOR    0x20 // XOR delta + byte shuffle + run-length
+#define NETWTRANSFER_MODE_CODEC_SPARSE 0x40 // changed pixels
+#define NETWTRANSFER_MODE_CODECMASK    0x70
+
 errno_t stream__TCP_addCLIcmd();
 
 errno_t COREMOD_MEMORY_testfunction_semaphore(const char *IDname,
@@ -20,4 +38,9 @@ imageID COREMOD_MEMORY_image_NETWORKtransmit(const char *IDname,
 imageID
 COREMOD_MEMORY_image_NETWORKreceive(int port, int mode, int RT_priority);
 
+imageID COREMOD_MEMORY_image_NETWORKreceive_ready(int      port,
+        int      mode,
+        int      RT_priority,
+        imageID *IDready);
+
 #endif
@@ -1,12 +1,26 @@
 /**
- * @file    stream_TCP.c
- * @brief   TCP stream transfer
+ * @file    stream_UDP.c
+ * @brief   UDP stream transfer
+ *
+ * Each frame (metadata, pixel data, keywords) is split into data
+ * datagrams of at most DGRAM_CHUNK_SIZE bytes, optionally followed by XOR
+ * parity datagrams. Every datagram starts with a UDP_DGRAMHEADER carrying
+ * the frame sequence number and datagram index.
+ *
+ * The receiver assembles frames in a window of frame buffers, so that
+ * datagrams of consecutive frames may be interleaved or reordered. A
+ * frame is written to the stream and posted only once complete, directly
+ * or after parity recovery, and only if no newer frame has been posted.
  */
 
+#define _GNU_SOURCE // sendmmsg, recvmmsg
+
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sched.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "CommandLineInterface/CLIcore.h"
 #include "create_image.h"
@@ -15,6 +29,8 @@
 #include "list_image.h"
 #include "read_shmim.h"
 #include "stream_sem.h"
+#include "stream_TCP.h"
+#include "stream_UDP.h"
 
 // set to 1 if transfering keywords
 static int TCPTRANSFERKW = 1;
@@ -22,6 +38,397 @@ static int MULTIGRAM_MAGIC = 0x3E; // Random magic to start datagrams with.
 static int DGRAM_CHUNK_SIZE = 62 *
                               1024; // Max payload per datagram, just shy of the maximum 65507 bytes
 
+// Max number of datagrams per sendmmsg / recvmmsg call
+#define UDP_MMSG_BATCH 64
+
+// default receiver reorder window [frames]
+#define UDP_WINDOW_DEFAULT 4
+
+#define UDP_DGRAM_DATA   0
+#define UDP_DGRAM_PARITY 1
+
+typedef struct
+{
+    uint64_t seq;       // frame sequence number
+    uint32_t framesize; // frame size [byte]
+    uint16_t NBdata;    // number of data datagrams in frame
+    uint16_t index;     // data datagram index, or parity group index
+    uint16_t NBgroup;   // number of parity groups, 0 if no FEC
+    uint8_t  magic;
+    uint8_t  type;      // UDP_DGRAM_DATA or UDP_DGRAM_PARITY
+    uint32_t reserved;
+} UDP_DGRAMHEADER;
+
+// Frame is the concatenation of segments (metadata, pixel data, keywords)
+// which are sent through iovecs
+#define UDP_NBSEGMENT 3
+
+typedef struct
+{
+    char *ptr;
+    long  size;
+} UDP_SEGMENT;
+
+// iovecs per datagram : header + up to UDP_NBSEGMENT segments
+#define UDP_DGRAM_NBIOV (1 + UDP_NBSEGMENT)
+
+/**
+ * @brief Fill iovecs pointing to frame bytes [offset, offset+len[
+ *
+ * @return number of iovecs written
+ */
+static int UDP_iov_fill(struct iovec *iov,
+                        UDP_SEGMENT  *seg,
+                        long          offset,
+                        long          len)
+{
+    int iovcnt = 0;
+
+    for(int s = 0; (s < UDP_NBSEGMENT) && (len > 0); s++)
+    {
+        if(offset >= seg[s].size)
+        {
+            offset -= seg[s].size;
+            continue;
+        }
+        long l = seg[s].size - offset;
+        if(l > len)
+        {
+            l = len;
+        }
+        iov[iovcnt].iov_base = seg[s].ptr + offset;
+        iov[iovcnt].iov_len  = l;
+        iovcnt++;
+        len -= l;
+        offset = 0;
+    }
+
+    return iovcnt;
+}
+
+// payload size of data datagram k
+static inline long UDP_dgram_len(long k, long NBdata, long framesize)
+{
+    return (k == NBdata - 1) ? framesize - k * DGRAM_CHUNK_SIZE
+           : DGRAM_CHUNK_SIZE;
+}
+
+// payload size of parity datagram g : longest datagram of group
+// data datagram k belongs to group k % NBgroup
+static inline long UDP_parity_len(long g, long NBdata, long framesize)
+{
+    return UDP_dgram_len(g, NBdata, framesize);
+}
+
+static inline void UDP_xor(char *dst, const char *src, long n)
+{
+    for(long i = 0; i < n; i++)
+    {
+        dst[i] ^= src[i];
+    }
+}
+
+/**
+ * @brief Compute parity datagrams payload
+ *
+ * @param parity  NBgroup x DGRAM_CHUNK_SIZE bytes
+ */
+static void UDP_parity_compute(UDP_SEGMENT *seg,
+                               long         NBdata,
+                               long         framesize,
+                               int          NBgroup,
+                               char        *parity)
+{
+    memset(parity, 0, (long) NBgroup * DGRAM_CHUNK_SIZE);
+    for(long k = 0; k < NBdata; k++)
+    {
+        struct iovec iov[UDP_NBSEGMENT];
+        int          iovcnt = UDP_iov_fill(iov,
+                                           seg,
+                                           k * DGRAM_CHUNK_SIZE,
+                                           UDP_dgram_len(k, NBdata, framesize));
+        char *p = parity + (k % NBgroup) * DGRAM_CHUNK_SIZE;
+        for(int i = 0; i < iovcnt; i++)
+        {
+            UDP_xor(p, (char *) iov[i].iov_base, iov[i].iov_len);
+            p += iov[i].iov_len;
+        }
+    }
+}
+
+// receiver frame assembly buffer
+#define UDP_SLOT_FREE       0
+#define UDP_SLOT_ASSEMBLING 1
+#define UDP_SLOT_DONE       2 // posted, late or dropped
+
+typedef struct
+{
+    int      state;
+    uint64_t seq;
+    char    *buff;     // NBdata x DGRAM_CHUNK_SIZE
+    uint8_t *rcvd;     // NBdata, 1 if data datagram received or recovered
+    long     nbrcvd;
+    char    *parity;   // NBgroup x DGRAM_CHUNK_SIZE
+    uint8_t *prcvd;    // NBgroup, 1 if parity datagram received
+    long    *gmissing; // NBgroup, missing data datagrams in group
+    int      NBgroup;
+    int      recovered; // 1 if parity was used
+} UDP_FRAMESLOT;
+
+/**
+ * @brief Reset slot for new frame
+ *
+ * Buffers are allocated for the largest number of groups (one per data
+ * datagram) on first use.
+ */
+static void UDP_slot_init(UDP_FRAMESLOT *slot,
+                          uint64_t       seq,
+                          long           NBdata,
+                          int            NBgroup)
+{
+    if(slot->buff == NULL)
+    {
+        slot->buff     = (char *) malloc((long) NBdata * DGRAM_CHUNK_SIZE);
+        slot->rcvd     = (uint8_t *) malloc(NBdata);
+        slot->parity   = (char *) malloc((long) NBdata * DGRAM_CHUNK_SIZE);
+        slot->prcvd    = (uint8_t *) malloc(NBdata);
+        slot->gmissing = (long *) malloc(sizeof(long) * NBdata);
+        if((slot->buff == NULL) || (slot->rcvd == NULL) ||
+                (slot->parity == NULL) || (slot->prcvd == NULL) ||
+                (slot->gmissing == NULL))
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+    }
+
+    slot->state     = UDP_SLOT_ASSEMBLING;
+    slot->seq       = seq;
+    slot->nbrcvd    = 0;
+    slot->NBgroup   = NBgroup;
+    slot->recovered = 0;
+    memset(slot->rcvd, 0, NBdata);
+    for(int g = 0; g < NBgroup; g++)
+    {
+        slot->prcvd[g]    = 0;
+        slot->gmissing[g] = (NBdata - g + NBgroup - 1) / NBgroup;
+    }
+}
+
+static void UDP_slot_free(UDP_FRAMESLOT *slot)
+{
+    free(slot->buff);
+    free(slot->rcvd);
+    free(slot->parity);
+    free(slot->prcvd);
+    free(slot->gmissing);
+}
+
+/**
+ * @brief Recover missing data datagram of group g from parity
+ *
+ * Group must have exactly one missing datagram and its parity received.
+ */
+static void UDP_slot_recover(UDP_FRAMESLOT *slot,
+                             int            g,
+                             long           NBdata,
+                             long           framesize)
+{
+    int  NBgroup = slot->NBgroup;
+    long kmiss   = -1;
+
+    for(long k = g; k < NBdata; k += NBgroup)
+    {
+        if(slot->rcvd[k] == 0)
+        {
+            kmiss = k;
+        }
+    }
+    if(kmiss == -1)
+    {
+        return;
+    }
+
+    long  len = UDP_dgram_len(kmiss, NBdata, framesize);
+    char *dst = slot->buff + kmiss * DGRAM_CHUNK_SIZE;
+    memcpy(dst, slot->parity + (long) g * DGRAM_CHUNK_SIZE, len);
+    for(long k = g; k < NBdata; k += NBgroup)
+    {
+        if(k != kmiss)
+        {
+            long lenk = UDP_dgram_len(k, NBdata, framesize);
+            UDP_xor(dst,
+                    slot->buff + k * DGRAM_CHUNK_SIZE,
+                    (lenk < len) ? lenk : len);
+        }
+    }
+
+    slot->rcvd[kmiss] = 1;
+    slot->nbrcvd++;
+    slot->gmissing[g] = 0;
+    slot->recovered   = 1;
+}
+
+// receiver state
+typedef struct
+{
+    UDP_FRAMESLOT *slot;
+    int            NBslot;    // reorder window [frames]
+    long           framesize; // expected frame size [byte]
+    long           NBdata;    // expected number of data datagrams
+
+    int      seqvalid;    // 1 once a frame has been seen
+    uint64_t seqhigh;     // highest frame sequence number seen
+    int      postedvalid; // 1 once a frame has been posted
+    uint64_t seqposted;   // last posted frame sequence number
+
+    uint64_t udpstat[UDPSTAT_NB];
+} UDP_RXCTX;
+
+static void UDP_rx_reset(UDP_RXCTX *ctx)
+{
+    for(int s = 0; s < ctx->NBslot; s++)
+    {
+        ctx->slot[s].state = UDP_SLOT_FREE;
+    }
+    ctx->seqvalid    = 0;
+    ctx->postedvalid = 0;
+}
+
+/**
+ * @brief Process received datagram
+ *
+ * @return frame slot to be posted if datagram completes frame, NULL otherwise
+ */
+static UDP_FRAMESLOT *UDP_rx_dgram(UDP_RXCTX *ctx, char *dgram, long len)
+{
+    UDP_DGRAMHEADER *hdr = (UDP_DGRAMHEADER *) dgram;
+
+    if((len < (long) sizeof(UDP_DGRAMHEADER)) || (hdr->magic != MULTIGRAM_MAGIC))
+    {
+        return NULL;
+    }
+
+    uint64_t seq = hdr->seq;
+
+    if(ctx->seqvalid == 1)
+    {
+        if(ctx->seqhigh > seq + 16 * ctx->NBslot)
+        {
+            // transmitter restarted
+            UDP_rx_reset(ctx);
+        }
+        else if(seq + ctx->NBslot <= ctx->seqhigh)
+        {
+            // too old, outside reorder window
+            return NULL;
+        }
+    }
+    if(ctx->seqvalid == 0)
+    {
+        ctx->seqvalid = 1;
+        ctx->seqhigh  = seq;
+    }
+    else if(seq > ctx->seqhigh)
+    {
+        // frames not seen at all
+        ctx->udpstat[UDPSTAT_LOST] += seq - ctx->seqhigh - 1;
+        ctx->seqhigh = seq;
+    }
+
+    UDP_FRAMESLOT *slot = &ctx->slot[seq % ctx->NBslot];
+
+    if((slot->state == UDP_SLOT_FREE) || (slot->seq != seq))
+    {
+        if(slot->state == UDP_SLOT_ASSEMBLING)
+        {
+            // evict incomplete older frame
+            ctx->udpstat[UDPSTAT_LOST]++;
+        }
+        if((hdr->framesize != ctx->framesize) || (hdr->NBdata != ctx->NBdata) ||
+                (hdr->NBgroup > ctx->NBdata))
+        {
+            ctx->udpstat[UDPSTAT_DROPPED]++;
+            slot->state = UDP_SLOT_DONE;
+            slot->seq   = seq;
+            return NULL;
+        }
+        UDP_slot_init(slot, seq, ctx->NBdata, hdr->NBgroup);
+    }
+
+    if(slot->state == UDP_SLOT_DONE)
+    {
+        // frame already completed or dropped
+        return NULL;
+    }
+
+    char *payload = dgram + sizeof(UDP_DGRAMHEADER);
+    long  plen    = len - sizeof(UDP_DGRAMHEADER);
+    int   g       = -1; // group to be recovered, if possible
+
+    if((hdr->type == UDP_DGRAM_DATA) && (hdr->index < ctx->NBdata) &&
+            (plen == UDP_dgram_len(hdr->index, ctx->NBdata, ctx->framesize)))
+    {
+        long k = hdr->index;
+        if(slot->rcvd[k] == 1)
+        {
+            return NULL;
+        }
+        memcpy(slot->buff + k * DGRAM_CHUNK_SIZE, payload, plen);
+        slot->rcvd[k] = 1;
+        slot->nbrcvd++;
+        if(slot->NBgroup > 0)
+        {
+            g = k % slot->NBgroup;
+            slot->gmissing[g]--;
+        }
+    }
+    else if((hdr->type == UDP_DGRAM_PARITY) && (hdr->index < slot->NBgroup) &&
+            (plen == UDP_parity_len(hdr->index, ctx->NBdata, ctx->framesize)))
+    {
+        g = hdr->index;
+        if(slot->prcvd[g] == 1)
+        {
+            return NULL;
+        }
+        memcpy(slot->parity + (long) g * DGRAM_CHUNK_SIZE, payload, plen);
+        slot->prcvd[g] = 1;
+    }
+    else
+    {
+        // inconsistent with frame layout
+        ctx->udpstat[UDPSTAT_DROPPED]++;
+        slot->state = UDP_SLOT_DONE;
+        return NULL;
+    }
+
+    if((g >= 0) && (slot->gmissing[g] == 1) && (slot->prcvd[g] == 1))
+    {
+        UDP_slot_recover(slot, g, ctx->NBdata, ctx->framesize);
+    }
+
+    if(slot->nbrcvd < ctx->NBdata)
+    {
+        return NULL;
+    }
+
+    slot->state = UDP_SLOT_DONE;
+    if((ctx->postedvalid == 1) && (seq <= ctx->seqposted))
+    {
+        ctx->udpstat[UDPSTAT_LATE]++;
+        return NULL;
+    }
+
+    ctx->postedvalid = 1;
+    ctx->seqposted   = seq;
+    ctx->udpstat[UDPSTAT_RECEIVED]++;
+    if(slot->recovered == 1)
+    {
+        ctx->udpstat[UDPSTAT_RECOVERED]++;
+    }
+    return slot;
+}
+
 
 // ==========================================
 // Forward declaration(s)
@@ -30,13 +437,18 @@ static int DGRAM_CHUNK_SIZE = 62 *
 imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
         const char *IPaddr,
         int         port,
-        int         do_counter_sync,
+        int         mode,
         int         RT_priority);
 
 imageID COREMOD_MEMORY_image_NETUDPreceive(int port,
-        int do_counter_sync,
+        int mode,
         int RT_priority);
 
+imageID COREMOD_MEMORY_image_NETUDPreceive_ready(int      port,
+        int      mode,
+        int      RT_priority,
+        imageID *IDready);
+
 // ==========================================
 // Command line interface wrapper function(s)
 // ==========================================
@@ -89,34 +501,43 @@ errno_t stream__UDP_addCLIcmd()
         "imudptransmit",
         __FILE__,
         COREMOD_MEMORY_image_NETUDPtransmit__cli,
-        "transmit image over network",
-        "<image> <IP addr> <port [long]> <do_counter_sync [int]>",
-        "imudptransmit im1 127.0.0.1 0 8888 0",
-        "long COREMOD_MEMORY_image_NETWORKtransmit(const char "
-        "*IDname, const char *IPaddr, int port, int do_counter_sync)");
+        "transmit image over network. mode bit 0: counter sync, bits 8-15: "
+        "FEC group size",
+        "<image> <IP addr> <port [long]> <mode [int]> <RT priority>",
+        "imudptransmit im1 127.0.0.1 8888 2560 80",
+        "long COREMOD_MEMORY_image_NETUDPtransmit(const char "
+        "*IDname, const char *IPaddr, int port, int mode, int RT_priority)");
 
     RegisterCLIcommand(
         "imudpreceive",
         __FILE__,
         COREMOD_MEMORY_image_NETUDPreceive__cli,
-        "receive image(s) over network. do_counter_sync=1 uses counter "
-        "instead of semaphore",
-        "<port [long]> <do_counter_sync [int]> <RT priority>",
-        "imupdreceive 8887 0 80",
-        "long COREMOD_MEMORY_image_NETWORKreceive(int port, int "
-        "do_counter_sync, int RT_priority)");
+        "receive image(s) over network. mode bits 16-23: reorder window "
+        "[frames]",
+        "<port [long]> <mode [int]> <RT priority>",
+        "imudpreceive 8888 0 80",
+        "long COREMOD_MEMORY_image_NETUDPreceive(int port, int "
+        "mode, int RT_priority)");
 
     return RETURN_SUCCESS;
 }
 
-/** continuously transmits 2D image through TCP link
- * do_counter_sync = 1, force counter to be used for synchronization, ignore semaphores if they exist
+/** continuously transmits 2D image through UDP link
+ *
+ * Datagrams point directly to stream slice and keywords (scatter-gather),
+ * and are sent in batches with sendmmsg. With FEC, slice and keywords are
+ * first copied to a send buffer, so that parity and data datagrams are
+ * computed from the same frame.
+ *
+ * mode : see stream_UDP.h
+ * NETWTRANSFER_MODE_COUNTERSYNC, force counter to be used for synchronization, ignore semaphores if they exist
+ * NETWTRANSFER_MODE_UDPFEC(n), send one parity datagram per n data datagrams
  */
 
 imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
         const char *IPaddr,
         int         port,
-        int         do_counter_sync,
+        int         mode,
         int         RT_priority)
 {
     imageID            ID;
@@ -131,7 +552,7 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
     char              *ptr_img_data; // source
     char              *ptr_img_data_slice; // source - offset by slice
     int                res; // Return status for socket ops
-    int                byte_sock_count;
+    long               byte_sock_count;
 
     struct timespec ts;
     long            scnt;
@@ -143,16 +564,20 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
     long            framesize1; // pixel data + metadata
     long            framesizeall; // total frame size : pixel data + metadata + kw
 
-    char           *buff; // socket-side buffer (magic and metadata at beginning)
-    char           *ptr_buff_metadata; // socket-side buffer at metadata offset
-    char           *ptr_buff_data; // socket-side buffer at data offset
-    char           *ptr_buff_keywords; // socket-side buffer at keyword offset
+    IMAGE_METADATA  mdsnap; // metadata sent with frame
+    UDP_SEGMENT     seg[UDP_NBSEGMENT];
 
     // Datagrams
-    long            n_udp_dgrams;
-    long            last_dgram_chunk;
-    char           *ptr_this_dgram;
-    long            this_dgram_size;
+    long             n_udp_dgrams;   // data datagrams
+    int              n_fec_groups;   // parity datagrams
+    long             n_dgrams_all;
+    long             this_dgram_size;
+    uint64_t         frameseq   = 0;
+    struct mmsghdr  *dgram_msg  = NULL;
+    struct iovec    *dgram_iov  = NULL;
+    UDP_DGRAMHEADER *dgram_hdr  = NULL;
+    char            *parity     = NULL;
+    char            *framesnap  = NULL; // slice + keywords copy, FEC only
 
 
     int semtrig = 6; // TODO - scan for available sem
@@ -258,18 +683,69 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
         }
 
         // Prepare segmentation into 62k datagrams
-        n_udp_dgrams = framesizeall / DGRAM_CHUNK_SIZE + 1;
-        last_dgram_chunk = framesizeall % DGRAM_CHUNK_SIZE;
+        n_udp_dgrams = (framesizeall + DGRAM_CHUNK_SIZE - 1) / DGRAM_CHUNK_SIZE;
 
-        // Prepare transmit buffer - add two bytes for the magic + dgram number
-        buff = (char *) malloc(sizeof(char) * framesizeall);
-        ptr_buff_metadata = buff + 2;
-        ptr_buff_data = ptr_buff_metadata + sizeof(IMAGE_METADATA);
-        ptr_buff_keywords = ptr_buff_data + framesize;
+        // Interleaved parity groups of at most fecgroup datagrams
+        int fecgroup = NETWTRANSFER_MODE_UDPFECGROUP(mode);
+        n_fec_groups = 0;
+        if(fecgroup > 0)
+        {
+            n_fec_groups = (n_udp_dgrams + fecgroup - 1) / fecgroup;
+        }
+        n_dgrams_all = n_udp_dgrams + n_fec_groups;
+
+        // Datagrams are sent in place from metadata copy, stream slice and
+        // keywords, prefixed by header
+        seg[0].ptr  = (char *) &mdsnap;
+        seg[0].size = sizeof(IMAGE_METADATA);
+        seg[1].ptr  = ptr_img_data;
+        seg[1].size = framesize;
+        seg[2].ptr  = (char *) data.image[ID].kw;
+        seg[2].size = framesizeall - framesize1;
+
+        dgram_msg =
+            (struct mmsghdr *) calloc(n_dgrams_all, sizeof(struct mmsghdr));
+        dgram_iov = (struct iovec *) malloc(sizeof(struct iovec) *
+                                            UDP_DGRAM_NBIOV * n_dgrams_all);
+        dgram_hdr = (UDP_DGRAMHEADER *) calloc(n_dgrams_all,
+                                               sizeof(UDP_DGRAMHEADER));
+        if(n_fec_groups > 0)
+        {
+            parity = (char *) malloc((long) n_fec_groups * DGRAM_CHUNK_SIZE);
+            framesnap = (char *) malloc(framesizeall - sizeof(IMAGE_METADATA));
+        }
+        if((dgram_msg == NULL) || (dgram_iov == NULL) || (dgram_hdr == NULL) ||
+                ((n_fec_groups > 0) &&
+                 ((parity == NULL) || (framesnap == NULL))))
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+        for(long dgram = 0; dgram < n_dgrams_all; ++dgram)
+        {
+            dgram_hdr[dgram].magic     = MULTIGRAM_MAGIC;
+            dgram_hdr[dgram].framesize = framesizeall;
+            dgram_hdr[dgram].NBdata    = n_udp_dgrams;
+            dgram_hdr[dgram].NBgroup   = n_fec_groups;
+            if(dgram < n_udp_dgrams)
+            {
+                dgram_hdr[dgram].type  = UDP_DGRAM_DATA;
+                dgram_hdr[dgram].index = dgram;
+            }
+            else
+            {
+                dgram_hdr[dgram].type  = UDP_DGRAM_PARITY;
+                dgram_hdr[dgram].index = dgram - n_udp_dgrams;
+            }
+            dgram_msg[dgram].msg_hdr.msg_name    = &sock_server;
+            dgram_msg[dgram].msg_hdr.msg_namelen = sizeof(sock_server);
+        }
 
 
-        printf("Transfer buffer size = %ld\n", framesizeall);
-        printf("Using %ld UDP datagrams\n", n_udp_dgrams);
+        printf("Transfer frame size = %ld\n", framesizeall);
+        printf("Using %ld UDP datagrams + %d parity\n",
+               n_udp_dgrams,
+               n_fec_groups);
         fflush(stdout);
 
         oldslice = 0;
@@ -278,7 +754,8 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
         fflush(stdout);
     }
 
-    if((data.image[ID].md[0].sem == 0) || (do_counter_sync == 1))
+    if((data.image[ID].md[0].sem == 0) ||
+            (mode & NETWTRANSFER_MODE_COUNTERSYNC))
     {
         processinfo_WriteMessage(processinfo, "sync using counter");
         use_sem = 0;
@@ -367,49 +844,115 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
                     slice = 0;
                 }
 
-                // Fill up the transmission buffer
-                memcpy(ptr_buff_metadata, &data.image[ID].md[0], sizeof(IMAGE_METADATA));
+                // Metadata copy, slice index matching data sent
+                memcpy(&mdsnap, &data.image[ID].md[0], sizeof(IMAGE_METADATA));
+                mdsnap.cnt1 = slice;
 
                 ptr_img_data_slice = ptr_img_data + framesize * slice;
-                memcpy(ptr_buff_data, ptr_img_data_slice, framesize);
-
-                if(TCPTRANSFERKW == 1)
+                seg[1].ptr         = ptr_img_data_slice;
+                if(framesnap != NULL)
                 {
-                    memcpy(ptr_buff_keywords,
+                    // single read of stream, parity and data must match
+                    memcpy(framesnap, ptr_img_data_slice, framesize);
+                    memcpy(framesnap + framesize,
                            (char *) data.image[ID].kw,
-                           data.image[ID].md[0].NBkw * sizeof(IMAGE_KEYWORD));
+                           seg[2].size);
+                    seg[1].ptr = framesnap;
+                    seg[2].ptr = framesnap + framesize;
+                }
+
+                // Point datagrams to frame segments
+                for(long dgram = 0; dgram < n_udp_dgrams; ++dgram)
+                {
+                    this_dgram_size =
+                        UDP_dgram_len(dgram, n_udp_dgrams, framesizeall);
+
+                    struct iovec *iov = &dgram_iov[UDP_DGRAM_NBIOV * dgram];
+                    iov[0].iov_base   = &dgram_hdr[dgram];
+                    iov[0].iov_len    = sizeof(UDP_DGRAMHEADER);
+                    int iovcnt        = 1 + UDP_iov_fill(&iov[1],
+                                                         seg,
+                                                         dgram * DGRAM_CHUNK_SIZE,
+                                                         this_dgram_size);
+
+                    dgram_msg[dgram].msg_hdr.msg_iov    = iov;
+                    dgram_msg[dgram].msg_hdr.msg_iovlen = iovcnt;
+                }
+
+                // Parity datagrams, sent after data datagrams
+                if(n_fec_groups > 0)
+                {
+                    UDP_parity_compute(seg,
+                                       n_udp_dgrams,
+                                       framesizeall,
+                                       n_fec_groups,
+                                       parity);
+                }
+                for(int g = 0; g < n_fec_groups; g++)
+                {
+                    long          dgram = n_udp_dgrams + g;
+                    struct iovec *iov   = &dgram_iov[UDP_DGRAM_NBIOV * dgram];
+                    iov[0].iov_base     = &dgram_hdr[dgram];
+                    iov[0].iov_len      = sizeof(UDP_DGRAMHEADER);
+                    iov[1].iov_base     = parity + (long) g * DGRAM_CHUNK_SIZE;
+                    iov[1].iov_len =
+                        UDP_parity_len(g, n_udp_dgrams, framesizeall);
+
+                    dgram_msg[dgram].msg_hdr.msg_iov    = iov;
+                    dgram_msg[dgram].msg_hdr.msg_iovlen = 2;
+                }
+
+                for(long dgram = 0; dgram < n_dgrams_all; ++dgram)
+                {
+                    dgram_hdr[dgram].seq = frameseq;
                 }
+                frameseq++;
 
-                // Send the datagrams
+                // Send the datagrams, in batches
                 byte_sock_count = 0;
-                ptr_this_dgram = ptr_buff_metadata - 2;
-                for(int dgram = 0; dgram < n_udp_dgrams; ++dgram)
+                long byte_expected = 0;
+                for(long dgram = 0; dgram < n_dgrams_all; ++dgram)
+                {
+                    for(size_t i = 0; i < dgram_msg[dgram].msg_hdr.msg_iovlen; i++)
+                    {
+                        byte_expected +=
+                            dgram_msg[dgram].msg_hdr.msg_iov[i].iov_len;
+                    }
+                }
+                long dgramsent  = 0;
+                while(dgramsent < n_dgrams_all)
                 {
-                    this_dgram_size = dgram == n_udp_dgrams - 1 ? last_dgram_chunk + 2 :
-                                      DGRAM_CHUNK_SIZE + 2;
-                    // Using the extra 2 bytes at the beginning for the first dgram
-                    // Overwriting the 2 last bytes of previous dgrams for subsequent ones
-                    ptr_this_dgram[0] = MULTIGRAM_MAGIC;
-                    ptr_this_dgram[1] = dgram;
-
-                    //printf("This dgram id: %d, size: %ld\n", dgram, this_dgram_size);
-                    res = sendto(fds_client, ptr_this_dgram, this_dgram_size, 0,
-                                 (const struct sockaddr *)&sock_server, sizeof(sock_server));
-                    byte_sock_count += res;
-
-                    ptr_this_dgram += DGRAM_CHUNK_SIZE; // Shift by 62k
+                    int nbdgram = n_dgrams_all - dgramsent;
+                    if(nbdgram > UDP_MMSG_BATCH)
+                    {
+                        nbdgram = UDP_MMSG_BATCH;
+                    }
+                    res = sendmmsg(fds_client, &dgram_msg[dgramsent], nbdgram, 0);
+                    if(res < 1)
+                    {
+                        if((res == -1) && (errno == EINTR))
+                        {
+                            continue;
+                        }
+                        break;
+                    }
+                    for(int i = 0; i < res; i++)
+                    {
+                        byte_sock_count += dgram_msg[dgramsent + i].msg_len;
+                    }
+                    dgramsent += res;
                 }
 
-                if(byte_sock_count != framesizeall + 2 * n_udp_dgrams)
+                if(byte_sock_count != byte_expected)
                 {
                     perror("socket send error ");
                     snprintf(errmsg,
                              200,
                              "ERROR: send() sent a different "
-                             "number of bytes (%d) than "
+                             "number of bytes (%ld) than "
                              "expected %ld",
                              byte_sock_count,
-                             framesizeall + 2 * n_udp_dgrams);
+                             byte_expected);
                     printf("%s\n", errmsg);
                     fflush(stdout);
                     processinfo_WriteMessage(processinfo, errmsg);
@@ -434,7 +977,11 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
     // ==================================
     processinfo_cleanExit(processinfo);
 
-    free(buff);
+    free(dgram_msg);
+    free(dgram_iov);
+    free(dgram_hdr);
+    free(parity);
+    free(framesnap);
 
     close(fds_client);
     printf("port %d closed\n", port);
@@ -443,25 +990,48 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
     return ID;
 }
 
-/** continuously receives 2D image through TCP link
- * do_counter_sync = 1, force counter to be used for synchronization, ignore semaphores if they exist
+/** continuously receives 2D image through UDP link
+ *
+ * Datagrams are received in batches with recvmmsg, and assembled in a
+ * window of frame buffers (see UDP_rx_dgram). Complete frames are copied
+ * to the stream and posted, so that a partially received frame is never
+ * visible in the stream.
+ *
+ * Frame counters (see stream_UDP.h) are published once per second in
+ * stream <name>_udpstat and in the processinfo status message.
+ *
+ * mode : see stream_UDP.h
+ * NETWTRANSFER_MODE_UDPWINDOW(n), reorder window of n frames
  */
 
 imageID COREMOD_MEMORY_image_NETUDPreceive(
     int port,
-    __attribute__((unused)) int do_counter_sync,
+    int mode,
     int RT_priority)
+{
+    return COREMOD_MEMORY_image_NETUDPreceive_ready(port,
+            mode,
+            RT_priority,
+            NULL);
+}
+
+/** receives as COREMOD_MEMORY_image_NETUDPreceive
+ *
+ * If IDready is not NULL, the stream ID is stored (release) into *IDready
+ * once the stream and its _udpstat stream are created.
+ */
+imageID COREMOD_MEMORY_image_NETUDPreceive_ready(int      port,
+        int      mode,
+        int      RT_priority,
+        imageID *IDready)
 {
     struct sockaddr_in sock_server;
     struct sockaddr_in sock_client;
     int                fds_server;
-    //int                fds_client;
     socklen_t          slen_client = (socklen_t) sizeof(sock_client);
 
     int  flag = 1;
     long recvsize;
-    //int  result;
-    //int  MAXPENDING = 5;
 
     IMAGE_METADATA *imgmd;
     IMAGE_METADATA *imgmd_remote;
@@ -472,19 +1042,14 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
 
     char           *ptr_dest_data_root; // Dest ISIO data buffer
     char           *ptr_dest_data_sliceroot; // Dest ISIO data buffer
-//    char           *ptr_dest_data_current; // Dest ISIO data buffer
 
-    char           *ptr_buff_metadata; // socket-side buffer at metadata offset
-    char           *ptr_buff_data; // socket-side buffer at data offset
-    char           *ptr_buff_keywords; // socket-side buffer at keyword offset
+    // datagram buffers, header + payload
+    long            dgram_bufsize = sizeof(UDP_DGRAMHEADER) + DGRAM_CHUNK_SIZE;
+    char           *buff_udp;
+    struct mmsghdr  dgram_msg[UDP_MMSG_BATCH];
+    struct iovec    dgram_iov[UDP_MMSG_BATCH];
 
-    char           *buff; // socket-side complete buffer
-    char           *buff_udp; // socket-side datagram buffer
-    buff_udp = (char *) malloc(sizeof(char) * DGRAM_CHUNK_SIZE + 2);
-
-    // Datagrams
-    long            n_udp_dgrams;
-    long            last_dgram_chunk;
+    UDP_RXCTX       rxctx;
 
     long            NBslices;
     int             socketOpen = 1; // 0 if socket is closed
@@ -494,6 +1059,12 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
     int             axis;
 
     imgmd = (IMAGE_METADATA *) malloc(sizeof(IMAGE_METADATA));
+    buff_udp = (char *) malloc(dgram_bufsize * UDP_MMSG_BATCH);
+    if((imgmd == NULL) || (buff_udp == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
 
     long                 framesize1;    // pixel data + metadata
     long                 framesizefull; // pixel data + metadata + kw
@@ -612,13 +1183,13 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
         exit(0);
     }
 
-    // Try and receive only the metadata
+    // Try and receive only the metadata, from the first datagram of a frame
     // May have to go through several datagrams...
     int MAX_DATAGRAM_WAIT = 300;
     for(int n_dgram_wait = 0; n_dgram_wait < MAX_DATAGRAM_WAIT; ++n_dgram_wait)
     {
         recvsize =
-            recvfrom(fds_server, buff_udp, sizeof(IMAGE_METADATA) + 2, 0,
+            recvfrom(fds_server, buff_udp, dgram_bufsize, 0,
                      (struct sockaddr *)&sock_client, &slen_client);
         if(recvsize < 0 || n_dgram_wait == MAX_DATAGRAM_WAIT - 1)
         {
@@ -639,12 +1210,13 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
             exit(0);
         }
 
-        // printf("Init phase: recvsize = %ld, buff_udp[0] = %d, buff_udp[1] = %d\n", recvsize, buff_udp[0], buff_udp[1]);
-
-        // If this is a first datagram, we're having the metadata here:
-        if(buff_udp[0] == MULTIGRAM_MAGIC && buff_udp[1] == 0)
+        UDP_DGRAMHEADER *hdr = (UDP_DGRAMHEADER *) buff_udp;
+        if((recvsize >= (long)(sizeof(UDP_DGRAMHEADER) + sizeof(IMAGE_METADATA))) &&
+                (hdr->magic == MULTIGRAM_MAGIC) && (hdr->type == UDP_DGRAM_DATA) &&
+                (hdr->index == 0))
         {
-            memcpy(imgmd, buff_udp + 2, sizeof(IMAGE_METADATA));
+            memcpy(imgmd, buff_udp + sizeof(UDP_DGRAMHEADER),
+                   sizeof(IMAGE_METADATA));
             break;
         }
     }
@@ -691,6 +1263,11 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
         {
             OKim = 0;
         }
+        if((TCPTRANSFERKW == 1) &&
+                (imgmd[0].NBkw != data.image[ID].md[0].NBkw))
+        {
+            OKim = 0;
+        }
 
         if(OKim == 0)
         {
@@ -703,10 +1280,6 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
     if(TCPTRANSFERKW == 1)
     {
         nbkw = imgmd[0].NBkw;
-        if(imgmd[0].NBkw != data.image[ID].md[0].NBkw)
-        {
-            OKim = 0;
-        }
     }
 
     if(OKim == 0)
@@ -782,16 +1355,75 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
         framesizefull = framesize1 + nbkw * sizeof(IMAGE_KEYWORD);
     }
 
+    // Frame assembly
+    memset(&rxctx, 0, sizeof(UDP_RXCTX));
+    rxctx.NBslot = NETWTRANSFER_MODE_UDPWINDOWSIZE(mode);
+    if(rxctx.NBslot == 0)
+    {
+        rxctx.NBslot = UDP_WINDOW_DEFAULT;
+    }
+    rxctx.slot =
+        (UDP_FRAMESLOT *) calloc(rxctx.NBslot, sizeof(UDP_FRAMESLOT));
+    if(rxctx.slot == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    rxctx.framesize = framesizefull;
+    rxctx.NBdata = (framesizefull + DGRAM_CHUNK_SIZE - 1) / DGRAM_CHUNK_SIZE;
+    printf("Frame: %ld UDP datagrams, reorder window %d frames\n",
+           rxctx.NBdata,
+           rxctx.NBslot);
+
+    for(int i = 0; i < UDP_MMSG_BATCH; i++)
+    {
+        dgram_iov[i].iov_base = buff_udp + i * dgram_bufsize;
+        dgram_iov[i].iov_len  = dgram_bufsize;
+        memset(&dgram_msg[i], 0, sizeof(struct mmsghdr));
+        dgram_msg[i].msg_hdr.msg_iov    = &dgram_iov[i];
+        dgram_msg[i].msg_hdr.msg_iovlen = 1;
+    }
 
+    // Room for the reorder window in socket buffer
+    {
+        long rcvbufl = (long) rxctx.NBslot * (rxctx.NBdata + 1) * dgram_bufsize;
+        int  rcvbuf  = (rcvbufl > (1L << 30)) ? (1 << 30) : (int) rcvbufl;
+        setsockopt(fds_server, SOL_SOCKET, SO_RCVBUF, (char *) &rcvbuf,
+                   sizeof(rcvbuf));
+    }
 
-    // TODO
-    buff = (char *) malloc(sizeof(char) * framesizefull);
-    ptr_buff_metadata = buff;
-    ptr_buff_data = ptr_buff_metadata + sizeof(IMAGE_METADATA);
-    ptr_buff_keywords = ptr_buff_data + framesize;
+    // Wake up periodically to publish counters and process signals
+    {
+        struct timeval tv;
+        tv.tv_sec  = 1;
+        tv.tv_usec = 0;
+        setsockopt(fds_server, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv,
+                   sizeof(tv));
+    }
 
-    n_udp_dgrams = framesizefull / DGRAM_CHUNK_SIZE + 1;
-    last_dgram_chunk = framesizefull % DGRAM_CHUNK_SIZE;
+    // Frame counters stream
+    imageID IDstat;
+    {
+        char     statname[STRINGMAXLEN_IMAGE_NAME];
+        uint32_t statsize[1] = {UDPSTAT_NB};
+        WRITE_IMAGENAME(statname, "%s_udpstat", imgmd[0].name);
+        create_image_ID(statname,
+                        1,
+                        statsize,
+                        _DATATYPE_UINT64,
+                        1,
+                        0,
+                        0,
+                        &IDstat);
+    }
+    if(IDready != NULL)
+    {
+        __atomic_store_n(IDready, ID, __ATOMIC_RELEASE);
+    }
+    uint64_t        udpstat_published[UDPSTAT_NB];
+    struct timespec tpublish;
+    memset(udpstat_published, 0, sizeof(udpstat_published));
+    clock_gettime(CLOCK_MILK, &tpublish);
 
     if(data.processinfo == 1)
     {
@@ -812,11 +1444,6 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
     long monitorloopindex = 0;
     long cnt0previous     = 0;
 
-    long first_dgram_bytes = n_udp_dgrams == 1 ? last_dgram_chunk + 2 :
-                             DGRAM_CHUNK_SIZE + 2;
-    long this_dgram_bytes;
-    int abort_frame;
-
 
     while(loopOK == 1)
     {
@@ -838,49 +1465,50 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
             }
         }
 
-        // Resync to a 0-zth datagram if necessary
-        abort_frame = 0;
-        for(int n_dgram_wait = 0; n_dgram_wait < MAX_DATAGRAM_WAIT; ++n_dgram_wait)
+        int nbrecv = recvmmsg(fds_server,
+                              dgram_msg,
+                              UDP_MMSG_BATCH,
+                              MSG_WAITFORONE,
+                              NULL);
+        if(nbrecv < 0)
         {
-            recvsize = recvfrom(fds_server, buff_udp, first_dgram_bytes, 0,
-                                (struct sockaddr *)&sock_client, &slen_client);
-            if(recvsize < 0 || n_dgram_wait == MAX_DATAGRAM_WAIT - 1)
+            nbrecv = 0;
+            if((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
             {
-                printf("ERROR recvfrom`()\n");
+                printf("ERROR recvmmsg()\n");
                 socketOpen = 0;
-                break;
-            }
-
-            if(buff_udp[0] == MULTIGRAM_MAGIC && buff_udp[1] == 0)
-            {
-                memcpy(buff, buff_udp + 2, first_dgram_bytes - 2);
-                break;
             }
         }
 
-
-
         if((data.processinfo == 1) && (processinfo->MeasureTiming == 1))
         {
             processinfo_exec_start(processinfo);
         }
 
-        if(recvsize == 0)
+        for(int i = 0; i < nbrecv; i++)
         {
-            socketOpen = 0;
-        }
+            if(dgram_msg[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                continue;
+            }
 
-        if(socketOpen == 1)
-        {
-            // We already have the first datagram.
+            UDP_FRAMESLOT *slot = UDP_rx_dgram(&rxctx,
+                                               buff_udp + i * dgram_bufsize,
+                                               dgram_msg[i].msg_len);
+            if(slot == NULL)
+            {
+                continue;
+            }
 
-            // Weak copy although we now have all the metadata in buff
-            imgmd_remote = (IMAGE_METADATA *)(ptr_buff_metadata);
+            // complete frame: metadata, pixel data, keywords
+            imgmd_remote = (IMAGE_METADATA *) slot->buff;
 
-            data.image[ID].md[0].cnt1 =
-                imgmd_remote[0].cnt1; // For multi-slice only, really.
+            if((NBslices > 1) && (imgmd_remote[0].cnt1 >= (uint64_t) NBslices))
+            {
+                imgmd_remote[0].cnt1 = 0;
+            }
 
-            // copy pixel data. Watch that cnt1 == cnt0 for unsliced data, so need to ignore
+            // Watch that cnt1 == cnt0 for unsliced data, so need to ignore
             if(NBslices == 1)
             {
                 ptr_dest_data_sliceroot = ptr_dest_data_root;
@@ -890,43 +1518,15 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
                 ptr_dest_data_sliceroot = ptr_dest_data_root + framesize * imgmd_remote[0].cnt1;
             }
 
-            // Acquire and copy subsequent datagrams
-            for(int k_dgram = 1; k_dgram < n_udp_dgrams ; ++k_dgram)
-            {
-                this_dgram_bytes = k_dgram == n_udp_dgrams - 1 ? last_dgram_chunk :
-                                   DGRAM_CHUNK_SIZE;
-                recvsize = recvfrom(fds_server, buff_udp, first_dgram_bytes, 0,
-                                    (struct sockaddr *)&sock_client, &slen_client);
-
-                if(recvsize < 0)
-                {
-                    printf("ERROR recvfrom`()\n");
-                    socketOpen = 0;
-                    break;
-                }
-                if(buff_udp[0] != MULTIGRAM_MAGIC || buff_udp[1] != k_dgram)
-                {
-                    printf("UDP datagram sequence error (magic: %d, seen: %d, expected: %d)\n",
-                           buff_udp[0], buff_udp[1], k_dgram);
-                    abort_frame = 1;
-                    break;
-                }
-                memcpy(buff + k_dgram * DGRAM_CHUNK_SIZE, buff_udp + 2, this_dgram_bytes);
-            }
-        }
-        if(socketOpen == 1 && abort_frame == 0)
-        {
-
-            // Copy the data !
-            memcpy(ptr_dest_data_sliceroot, ptr_buff_data, framesize);
-
-            if(TCPTRANSFERKW == 1)
-            {
-                // copy kw
-                memcpy(data.image[ID].kw,
-                       (IMAGE_KEYWORD *)(ptr_buff_keywords),
-                       nbkw * sizeof(IMAGE_KEYWORD));
-            }
+            data.image[ID].md[0].write = 1;
+            memcpy(ptr_dest_data_sliceroot,
+                   slot->buff + sizeof(IMAGE_METADATA),
+                   framesize);
+            memcpy(data.image[ID].kw,
+                   slot->buff + framesize1,
+                   framesizefull - framesize1);
+            data.image[ID].md[0].cnt1 =
+                imgmd_remote[0].cnt1; // For multi-slice only, really.
 
             frameincr = (long) imgmd_remote[0].cnt0 - cnt0previous;
 
@@ -960,6 +1560,7 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
 
             monitorindex++;
 
+            data.image[ID].md[0].write = 0;
             data.image[ID].md[0].cnt0++;
             for(semnb = 0; semnb < data.image[ID].md[0].sem; semnb++)
             {
@@ -977,6 +1578,39 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
             }
         }
 
+        // publish frame counters
+        {
+            struct timespec tnow;
+            clock_gettime(CLOCK_MILK, &tnow);
+            if((tnow.tv_sec > tpublish.tv_sec) &&
+                    (memcmp(udpstat_published, rxctx.udpstat,
+                            sizeof(udpstat_published)) != 0))
+            {
+                tpublish = tnow;
+                memcpy(udpstat_published, rxctx.udpstat,
+                       sizeof(udpstat_published));
+
+                data.image[IDstat].md[0].write = 1;
+                memcpy(data.image[IDstat].array.UI64, rxctx.udpstat,
+                       sizeof(uint64_t) * UDPSTAT_NB);
+                ImageStreamIO_UpdateIm(&data.image[IDstat]);
+
+                if(data.processinfo == 1)
+                {
+                    char msgstring[STRINGMAXLEN_PROCESSINFO_STATUSMSG];
+                    snprintf(msgstring,
+                             STRINGMAXLEN_PROCESSINFO_STATUSMSG,
+                             "rx %lu lost %lu rec %lu late %lu drop %lu",
+                             (unsigned long) rxctx.udpstat[UDPSTAT_RECEIVED],
+                             (unsigned long) rxctx.udpstat[UDPSTAT_LOST],
+                             (unsigned long) rxctx.udpstat[UDPSTAT_RECOVERED],
+                             (unsigned long) rxctx.udpstat[UDPSTAT_LATE],
+                             (unsigned long) rxctx.udpstat[UDPSTAT_DROPPED]);
+                    processinfo_WriteMessage(processinfo, msgstring);
+                }
+            }
+        }
+
         if(socketOpen == 0)
         {
             loopOK = 0;
@@ -1039,11 +1673,13 @@ imageID COREMOD_MEMORY_image_NETUDPreceive(
         processinfo_cleanExit(processinfo);
     }
 
-    free(buff);
+    for(int s = 0; s < rxctx.NBslot; s++)
+    {
+        UDP_slot_free(&rxctx.slot[s]);
+    }
+    free(rxctx.slot);
     free(buff_udp);
 
-    //close(fds_client);
-
     printf("port %d closed\n", port);
     fflush(stdout);
 
@@ -5,6 +5,27 @@
 #ifndef _STREAM_UDP_H
 #define _STREAM_UDP_H
 
+// UDP transfer mode
+// bit 0 (NETWTRANSFER_MODE_COUNTERSYNC, see stream_TCP.h) :
+//   transmitter synchronizes on counter, ignores semaphores
+// bits 8-15 : transmitter FEC group size, 0 for no FEC
+//   one XOR parity datagram is sent for every group of n data datagrams,
+//   recovering one lost datagram per group. Groups are interleaved, so
+//   that a burst of up to (number of groups) lost datagrams is recovered
+// bits 16-23 : receiver reorder window [frames], default 4
+#define NETWTRANSFER_MODE_UDPFEC(n)      (((n) & 0xFF) << 8)
+#define NETWTRANSFER_MODE_UDPFECGROUP(m) (((m) >> 8) & 0xFF)
+#define NETWTRANSFER_MODE_UDPWINDOW(n)   (((n) & 0xFF) << 16)
+#define NETWTRANSFER_MODE_UDPWINDOWSIZE(m) (((m) >> 16) & 0xFF)
+
+// receiver frame counters, published in stream <name>_udpstat
+#define UDPSTAT_RECEIVED  0 // frames posted
+#define UDPSTAT_LOST      1 // frames not completed
+#define UDPSTAT_RECOVERED 2 // frames posted, completed using parity datagrams
+#define UDPSTAT_LATE      3 // frames completed after a newer frame was posted
+#define UDPSTAT_DROPPED   4 // frames discarded, inconsistent datagrams
+#define UDPSTAT_NB        5
+
 errno_t stream__UDP_addCLIcmd();
 
 imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
@@ -16,4 +37,9 @@ imageID COREMOD_MEMORY_image_NETUDPtransmit(const char *IDname,
 imageID
 COREMOD_MEMORY_image_NETUDPreceive(int port, int mode, int RT_priority);
 
+imageID COREMOD_MEMORY_image_NETUDPreceive_ready(int      port,
+        int      mode,
+        int      RT_priority,
+        imageID *IDready);
+
 #endif
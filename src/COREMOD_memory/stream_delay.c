@@ -1,7 +1,27 @@
 /** @file stream_delay,c
+ *
+ * Delay input stream to output stream
+ *
+ * Input frames are copied once, on arrival, into a slice of a ring of
+ * .timebuffsize frames, and their arrival time is stored in a matching
+ * timestamp ring. A release thread waits on the ring condition variable
+ * until the deadline (arrival time + .delaysec) of the oldest pending
+ * frame, then publishes it. Exit signals the condition variable, so that
+ * it does not wait for the deadline.
+ *
+ * Output has the size of the input, and the released slot is copied to
+ * it. With .option.outcube, output is a 3D circular buffer stream (xsize,
+ * ysize, timebuffsize) : the ring is the output stream itself, and a
+ * frame is published by setting cnt1 to its slice index, so there is no
+ * copy at release.
+ *
+ * The slot of the frame currently in the output is never written. If
+ * frames arrive faster than they can be held for .delaysec, the ring
+ * fills up and incoming frames are dropped (.status.overrun).
  */
 
 #include <math.h>
+#include <pthread.h>
 
 #include "CommandLineInterface/CLIcore.h"
 #include "create_image.h"
@@ -18,6 +38,9 @@ static char     *outimname;
 static float    *delaysec;
 static uint64_t *timebuffsize;
 
+static int64_t *outcube;
+static long     fpi_outcube;
+
 static int32_t *avemode;
 static long     fpi_avemode;
 
@@ -27,6 +50,7 @@ static long      fpi_timeavedtns;
 static uint64_t *statusframelag;
 static uint64_t *statuskkin;
 static uint64_t *statuskkout;
+static uint64_t *statusoverrun;
 
 static CLICMDARGDEF farg[] = {{
         CLIARG_IMG,
@@ -64,6 +88,15 @@ static CLICMDARGDEF farg[] = {{
         (void **) &timebuffsize,
         NULL
     },
+    {
+        CLIARG_ONOFF,
+        ".option.outcube",
+        "3D circular buffer output, no copy at release",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &outcube,
+        &fpi_outcube
+    },
     {
         CLIARG_INT32,
         ".option.timeavemode",
@@ -108,6 +141,15 @@ static CLICMDARGDEF farg[] = {{
         CLIARG_OUTPUT_DEFAULT,
         (void **) &statuskkout,
         NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".status.overrun",
+        "frames dropped, ring full",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &statusoverrun,
+        NULL
     }
 };
 
@@ -143,109 +185,253 @@ static CLICMDDATA CLIcmddata = {"streamdelay",
 // detailed help
 static errno_t help_function()
 {
+    printf("Delay input stream by .delaysec\n");
+    printf("Output has input size, frame is copied at release\n");
+    printf("Set .option.outcube for a circular buffer output of\n");
+    printf(".timebuffsize slices, cnt1 is the index of the last published\n");
+    printf("slice (no copy at release, 2D input only)\n");
+
     return RETURN_SUCCESS;
 }
 
 
 
 
-static errno_t streamdelay(IMGID            inimg,
-                           IMGID            outimg,
-                           IMGID            bufferimg,
-                           struct timespec *tarray,
-                           int             *warray,
-                           int             *status)
+// delay ring, one per instance
+typedef struct
 {
-    static uint64_t cnt0prev           = 0;
-    static uint64_t bufferindex_input  = 0;
-    static uint64_t bufferindex_output = 0;
+    IMGID outimg;
 
-    // get current time
-    struct timespec tnow;
-    clock_gettime(CLOCK_MILK, &tnow);
+    char    *ringbuff; // NBslot frames
+    uint64_t framesize;
+    uint64_t NBslot;
+    int      outcube;
+
+    struct timespec *tarray; // arrival time, per slot
+
+    // frame sequence numbers, slot = n % NBslot
+    uint64_t nin;  // next frame written
+    uint64_t nout; // next frame released
+    uint64_t npub; // frame in output, if pubvalid
+    int      pubvalid;
+    uint64_t overruncnt;
 
-    // update circular buffer if new frame has arrived
-    if(cnt0prev != inimg.md->cnt0)
+    int             running;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond; // CLOCK_MONOTONIC for timed wait
+    pthread_t       thread;
+} STREAMDELAY_RING;
+
+
+
+
+static void streamdelay_deadline(struct timespec *deadline,
+                                 struct timespec  tin,
+                                 double           delay)
+{
+    if(delay < 0.0)
     {
-        //printf("cnt %8ld %8ld   CIRC BUFFER UPDATE -> index %8ld / %8ld\n",
-        //       cnt0prev, inimg.md->cnt0, bufferindex_input, *timebuffsize);
-        // new input frame
+        delay = 0.0;
+    }
+    time_t sec  = (time_t) floor(delay);
+    long   nsec = (long)((delay - sec) * 1.0e9);
 
-        // update counter for next detection loop
-        cnt0prev = inimg.md->cnt0;
+    deadline->tv_sec  = tin.tv_sec + sec;
+    deadline->tv_nsec = tin.tv_nsec + nsec;
+    while(deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_nsec -= 1000000000L;
+        deadline->tv_sec++;
+    }
+}
 
-        // write current time to array
-        tarray[bufferindex_input].tv_sec  = tnow.tv_sec;
-        tarray[bufferindex_input].tv_nsec = tnow.tv_nsec;
+static int streamdelay_due(struct timespec tin,
+                           struct timespec tnow,
+                           double          delay)
+{
+    struct timespec deadline;
+    streamdelay_deadline(&deadline, tin, delay);
 
-        // copy image data to circular buffer
-        char *destptr;
-        destptr = (char *) bufferimg.im->array.raw;
-        destptr += inimg.md->imdatamemsize * bufferindex_input;
-        memcpy(destptr, inimg.im->array.raw, inimg.md->imdatamemsize);
+    if(tnow.tv_sec != deadline.tv_sec)
+    {
+        return (tnow.tv_sec > deadline.tv_sec);
+    }
+    return (tnow.tv_nsec >= deadline.tv_nsec);
+}
 
-        warray[bufferindex_input] = 0;
 
-        bufferindex_input++;
-        if(bufferindex_input == (*timebuffsize))
-        {
-            // end of circular buffer reached
-            bufferindex_input = 0;
-        }
+
+
+/**
+ * @brief Publish ring slot to output stream
+ *
+ * Cube output: slice is already in the output, only cnt1 is set.
+ * Slot is not written by streamdelay_push while it is ring->npub.
+ */
+static void streamdelay_publish(STREAMDELAY_RING *ring, uint64_t slot)
+{
+    IMGID *outimg = &ring->outimg;
+
+    outimg->md->write = 1;
+    if(ring->outcube == 0)
+    {
+        memcpy(outimg->im->array.raw,
+               ring->ringbuff + ring->framesize * slot,
+               ring->framesize);
     }
+    else
+    {
+        outimg->md->cnt1 = slot;
+    }
+    // no processinfo, it is released by main thread at loop exit
+    processinfo_update_output_stream(NULL, outimg->ID);
+}
+
 
-    // check if current time is past time array at output index + delay
-    struct timespec tdiff  = timespec_diff(tarray[bufferindex_output], tnow);
-    double          tdiffv = 1.0 * tdiff.tv_sec + 1.0e-9 * tdiff.tv_nsec;
 
-    //printf("%8ld  %8ld [%d]  tdiffv = %lf sec    %lf\n",
-    //       bufferindex_input, bufferindex_output, warray[bufferindex_output], tdiffv, (*delaysec));
-    //fflush(stdout);
 
-    int  updateflag              = 0;
-    long bufferindex_output_last = 0;
-    while((warray[bufferindex_output] == 0) && (tdiffv > (*delaysec)))
+/**
+ * @brief Wait on ring condition variable until CLOCK_MILK deadline
+ *
+ * Condition variable clock cannot be CLOCK_MILK, so the remaining time is
+ * converted to a CLOCK_MONOTONIC deadline. Returns early if signaled.
+ * Called with ring mutex locked.
+ */
+static void streamdelay_timedwait(STREAMDELAY_RING *ring,
+                                  struct timespec   deadline,
+                                  struct timespec   tnow)
+{
+    int64_t remns = (int64_t)(deadline.tv_sec - tnow.tv_sec) * 1000000000L +
+                    (deadline.tv_nsec - tnow.tv_nsec);
+
+    struct timespec twait;
+    clock_gettime(CLOCK_MONOTONIC, &twait);
+    twait.tv_sec += remns / 1000000000L;
+    twait.tv_nsec += remns % 1000000000L;
+    while(twait.tv_nsec >= 1000000000L)
     {
-        // update output frame
-        updateflag                 = 1;
-        warray[bufferindex_output] = 1;
+        twait.tv_nsec -= 1000000000L;
+        twait.tv_sec++;
+    }
 
-        bufferindex_output_last = bufferindex_output;
-        bufferindex_output++;
-        if(bufferindex_output == (*timebuffsize))
+    pthread_cond_timedwait(&ring->cond, &ring->mutex, &twait);
+}
+
+/**
+ * @brief Release thread
+ *
+ * Waits until the deadline of the oldest pending frame, then publishes
+ * the most recent frame that is due. Frames due at the same wake-up are
+ * skipped, as the output can only show one. New frames and exit signal
+ * the condition variable, after which the ring state is checked again.
+ */
+static void *streamdelay_release(void *ptr)
+{
+    STREAMDELAY_RING *ring = (STREAMDELAY_RING *) ptr;
+
+    pthread_mutex_lock(&ring->mutex);
+    while(ring->running == 1)
+    {
+        if(ring->nin == ring->nout)
         {
-            // end of circular buffer reached
-            bufferindex_output = 0;
+            pthread_cond_wait(&ring->cond, &ring->mutex);
+            continue;
         }
 
-        //printf("    advance %8ld %8ld\n", bufferindex_input, bufferindex_output);
-        tdiff  = timespec_diff(tarray[bufferindex_output], tnow);
-        tdiffv = 1.0 * tdiff.tv_sec + 1.0e-9 * tdiff.tv_nsec;
-    }
+        double          delay = *delaysec;
+        struct timespec tnow;
+        clock_gettime(CLOCK_MILK, &tnow);
 
-    if(updateflag == 1)
-    {
-        printf("     WRITE %8ld %8ld  :  %ld bytes\n",
-               bufferindex_input,
-               bufferindex_output_last,
-               (long) inimg.md->imdatamemsize);
-        // copy circular buffer frame to output
-        char *srcptr;
-        srcptr = (char *) bufferimg.im->array.raw;
-        srcptr += inimg.md->imdatamemsize * bufferindex_output_last;
-        memcpy(outimg.im->array.raw, srcptr, inimg.md->imdatamemsize);
+        if(!streamdelay_due(ring->tarray[ring->nout % ring->NBslot],
+                            tnow,
+                            delay))
+        {
+            struct timespec deadline;
+            streamdelay_deadline(&deadline,
+                                 ring->tarray[ring->nout % ring->NBslot],
+                                 delay);
+            streamdelay_timedwait(ring, deadline, tnow);
+            continue;
+        }
 
-        // frame has been processed
-        *status = 1;
+        int      release = 0;
+        uint64_t slot    = 0;
+        while((ring->nout != ring->nin) &&
+                streamdelay_due(ring->tarray[ring->nout % ring->NBslot],
+                                tnow,
+                                delay))
+        {
+            slot    = ring->nout % ring->NBslot;
+            release = 1;
+            ring->nout++;
+        }
+
+        if(release == 1)
+        {
+            // slot is reserved until next release
+            ring->npub     = ring->nout - 1;
+            ring->pubvalid = 1;
+            pthread_mutex_unlock(&ring->mutex);
+            streamdelay_publish(ring, slot);
+            pthread_mutex_lock(&ring->mutex);
+        }
     }
-    else
+    pthread_mutex_unlock(&ring->mutex);
+
+    return NULL;
+}
+
+
+
+
+/**
+ * @brief Store new input frame in ring
+ *
+ * Frame n is written in slot n % NBslot, which holds frame n - NBslot.
+ * If that frame is the current output, the new frame is dropped. If it
+ * is still pending (nothing published yet), it is dropped.
+ *
+ * @return 0 if stored, 1 if dropped
+ */
+static int streamdelay_push(STREAMDELAY_RING *ring,
+                            IMGID            *inimg,
+                            struct timespec   tin)
+{
+    pthread_mutex_lock(&ring->mutex);
+    if(ring->nin >= ring->NBslot)
     {
-        *status = 0;
+        uint64_t nprev = ring->nin - ring->NBslot;
+        if((ring->pubvalid == 1) && (ring->npub == nprev))
+        {
+            ring->overruncnt++;
+            pthread_mutex_unlock(&ring->mutex);
+            return 1;
+        }
+        if(ring->nout <= nprev)
+        {
+            ring->nout = nprev + 1;
+            ring->overruncnt++;
+        }
     }
+    uint64_t slot = ring->nin % ring->NBslot;
+    pthread_mutex_unlock(&ring->mutex);
 
-    return RETURN_SUCCESS;
+    memcpy(ring->ringbuff + ring->framesize * slot,
+           inimg->im->array.raw,
+           ring->framesize);
+
+    pthread_mutex_lock(&ring->mutex);
+    ring->tarray[slot] = tin;
+    ring->nin++;
+    pthread_cond_signal(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+
+    return 0;
 }
 
+
+
+
 static errno_t compute_function()
 {
     DEBUG_TRACE_FSTART();
@@ -253,54 +439,139 @@ static errno_t compute_function()
     IMGID inimg = mkIMGID_from_name(inimname);
     resolveIMGID(&inimg, ERRMODE_ABORT);
 
-    IMGID outimg = mkIMGID_from_name(outimname);
-    imcreatelikewiseIMGID(&outimg, &inimg);
-
-    IMGID bufferimg    = makeIMGID_3D("streamdelaybuff",
-                                      inimg.size[0],
-                                      inimg.size[1],
-                                      *timebuffsize);
-    bufferimg.datatype = inimg.datatype;
-    imcreateIMGID(&bufferimg);
-
-    struct timespec *timeinarray;
-    timeinarray =
-        (struct timespec *) malloc(sizeof(struct timespec) * (*timebuffsize));
-    // get current time
-    struct timespec tnow;
-    clock_gettime(CLOCK_MILK, &tnow);
-    for(uint64_t i = 0; i < *timebuffsize; i++)
+    uint32_t xsize = inimg.md->size[0];
+    uint32_t ysize = 1;
+    if(inimg.md->naxis > 1)
+    {
+        ysize = inimg.md->size[1];
+    }
+    if((*outcube) && (inimg.md->naxis > 2))
+    {
+        PRINT_WARNING("input %s is 3D, delaying first slice only",
+                      inimg.name);
+    }
+
+    if((*timebuffsize) < 2)
+    {
+        FUNC_RETURN_FAILURE("timebuffsize must be >= 2");
+    }
+
+    STREAMDELAY_RING ring;
+    memset(&ring, 0, sizeof(STREAMDELAY_RING));
+    ring.NBslot    = *timebuffsize;
+    ring.outcube   = (*outcube) ? 1 : 0;
+
+    if(ring.outcube == 0)
+    {
+        ring.framesize = inimg.md->imdatamemsize;
+        ring.outimg    = mkIMGID_from_name(outimname);
+        imcreatelikewiseIMGID(&ring.outimg, &inimg);
+
+        ring.ringbuff = (char *) malloc(ring.framesize * ring.NBslot);
+        if(ring.ringbuff == NULL)
+        {
+            FUNC_RETURN_FAILURE("malloc error, %lu frames",
+                                (unsigned long) ring.NBslot);
+        }
+    }
+    else
     {
-        timeinarray[i].tv_sec  = tnow.tv_sec;
-        timeinarray[i].tv_nsec = tnow.tv_nsec;
+        ring.framesize =
+            (uint64_t) ImageStreamIO_typesize(inimg.md->datatype) * xsize *
+            ysize;
+        ring.outimg =
+            makeIMGID_3D(outimname, xsize, ysize, (uint32_t) ring.NBslot);
+        ring.outimg.datatype = inimg.md->datatype;
+        ring.outimg.shared   = 1;
+        imcreateIMGID(&ring.outimg);
+
+        ring.ringbuff = (char *) ring.outimg.im->array.raw;
     }
 
-    // write array
-    // 0 if new, 1 if already sent to output
-    int *warray;
-    warray = (int *) malloc(sizeof(int) * (*timebuffsize));
-    for(uint64_t i = 0; i < *timebuffsize; i++)
+    ring.tarray =
+        (struct timespec *) malloc(sizeof(struct timespec) * ring.NBslot);
+    if(ring.tarray == NULL)
     {
-        warray[i] = 1;
+        if(ring.outcube == 0)
+        {
+            free(ring.ringbuff);
+        }
+        FUNC_RETURN_FAILURE("malloc error, %lu frames",
+                            (unsigned long) ring.NBslot);
     }
 
-    list_image_ID();
-    int status = 0;
+    *statusoverrun = 0;
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
-    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
 
-    streamdelay(inimg, outimg, bufferimg, timeinarray, warray, &status);
-    // status is 0 if no update to output, 1 otherwise
-    if(status != 0)
+    if(processinfo != NULL)
+    {
+        // wake on input semaphore, output release is done by release thread
+        processinfo_waitoninputstream_init(processinfo,
+                                           inimg.ID,
+                                           PROCESSINFO_TRIGGERMODE_SEMAPHORE,
+                                           -1);
+    }
+
+    ring.running = 1;
+    pthread_mutex_init(&ring.mutex, NULL);
+    {
+        pthread_condattr_t condattr;
+        pthread_condattr_init(&condattr);
+        pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+        pthread_cond_init(&ring.cond, &condattr);
+        pthread_condattr_destroy(&condattr);
+    }
+    if(pthread_create(&ring.thread, NULL, streamdelay_release, &ring) != 0)
     {
-        processinfo_update_output_stream(processinfo, outimg.ID);
+        PRINT_ERROR("cannot create release thread");
+        processloopOK = 0;
+        ring.running  = 0;
     }
 
+    uint64_t cnt0prev = inimg.md->cnt0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        // semaphore wait may have timed out
+        if(inimg.md->cnt0 != cnt0prev)
+        {
+            cnt0prev = inimg.md->cnt0;
+
+            struct timespec tin;
+            clock_gettime(CLOCK_MILK, &tin);
+            streamdelay_push(&ring, &inimg, tin);
+        }
+
+        pthread_mutex_lock(&ring.mutex);
+        *statusframelag = ring.nin - ring.nout;
+        *statuskkin     = ring.nin % ring.NBslot;
+        *statuskkout    = ring.nout % ring.NBslot;
+        *statusoverrun  = ring.overruncnt;
+        pthread_mutex_unlock(&ring.mutex);
+    }
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
-    free(timeinarray);
-    free(warray);
+    if(ring.running == 1)
+    {
+        pthread_mutex_lock(&ring.mutex);
+        ring.running = 0;
+        pthread_cond_signal(&ring.cond);
+        pthread_mutex_unlock(&ring.mutex);
+        pthread_join(ring.thread, NULL);
+    }
+    pthread_mutex_destroy(&ring.mutex);
+    pthread_cond_destroy(&ring.cond);
+
+    printf("streamdelay overrun %lu frames, output cnt0 %lu\n",
+           (unsigned long) ring.overruncnt,
+           (unsigned long) ring.outimg.md->cnt0);
+
+    free(ring.tarray);
+    if(ring.outcube == 0)
+    {
+        free(ring.ringbuff);
+    }
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
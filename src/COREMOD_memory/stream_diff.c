@@ -1,161 +1,240 @@
 /**
  * @file    stream_diff.c
+ * @brief   difference between two streams
+ *
+ * out = (in0 - in1) [* mask] [* scale], float output.
+ * Triggers on in0. Kernel is selected at setup from input datatype, mask
+ * and scale (see stream_diff_kernels.c), and re-selected if .scale is
+ * changed while running.
  */
 
 #include "CommandLineInterface/CLIcore.h"
 #include "create_image.h"
-#include "image_ID.h"
-#include "stream_sem.h"
 
-// ==========================================
-// forward declarations
-// ==========================================
+#include "stream_diff_kernels.h"
+
+static char *in0imname;
+static char *in1imname;
+static char *maskimname;
+static char *outimname;
 
-imageID COREMOD_MEMORY_streamDiff(const char *IDstream0_name,
-                                  const char *IDstream1_name,
-                                  const char *IDstreammask_name,
-                                  const char *IDstreamout_name,
-                                  long        semtrig);
+static int64_t *semtrig;
+static long     fpi_semtrig = -1;
 
-// ==========================================
-// command line interface wrapper functions
-// ==========================================
+static float *scale;
+static long   fpi_scale = -1;
 
-static errno_t COREMOD_MEMORY_streamDiff__cli()
+static CLICMDARGDEF farg[] =
 {
-    if(0 + CLI_checkarg(1, CLIARG_IMG) + CLI_checkarg(2, CLIARG_IMG) +
-            CLI_checkarg(3, 5) + CLI_checkarg(4, CLIARG_STR_NOT_IMG) +
-            CLI_checkarg(5, CLIARG_INT64) ==
-            0)
     {
-        COREMOD_MEMORY_streamDiff(data.cmdargtoken[1].val.string,
-                                  data.cmdargtoken[2].val.string,
-                                  data.cmdargtoken[3].val.string,
-                                  data.cmdargtoken[4].val.string,
-                                  data.cmdargtoken[5].val.numl);
-        return CLICMD_SUCCESS;
+        CLIARG_IMG,
+        ".in0_name",
+        "input stream 0, trigger",
+        "stream0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &in0imname,
+        NULL
+    },
+    {
+        CLIARG_IMG,
+        ".in1_name",
+        "input stream 1",
+        "stream1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &in1imname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".mask_name",
+        "float mask stream, null if none",
+        "null",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &maskimname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".out_name",
+        "output stream",
+        "outstream",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_INT64,
+        ".semtrig",
+        "trigger semaphore index, -1 for auto",
+        "-1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &semtrig,
+        &fpi_semtrig
+    },
+    {
+        CLIARG_FLOAT32,
+        ".scale",
+        "output scaling factor",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &scale,
+        &fpi_scale
     }
-    else
+};
+
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
     {
-        return CLICMD_INVALID_ARG;
+        data.fpsptr->parray[fpi_scale].fpflag |= FPFLAG_WRITERUN;
     }
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t customCONFcheck()
+{
+    return RETURN_SUCCESS;
 }
 
-// ==========================================
-// Register CLI command(s)
-// ==========================================
+static CLICMDDATA CLIcmddata =
+{
+    "streamdiff",
+    "compute difference between two image streams",
+    CLICMD_FIELDS_DEFAULTS
+};
 
-errno_t stream_diff_addCLIcmd()
+// detailed help
+static errno_t help_function()
 {
-    RegisterCLIcommand("streamdiff",
-                       __FILE__,
-                       COREMOD_MEMORY_streamDiff__cli,
-                       "compute difference between two image streams",
-                       "<in stream 0> <in stream 1> <out stream> <optional "
-                       "mask> <sem trigger index>",
-                       "streamdiff stream0 stream1 null outstream 3",
-                       "long COREMOD_MEMORY_streamDiff(const char "
-                       "*IDstream0_name, const char *IDstream1_name, const "
-                       "char *IDstreamout_name, long semtrig)");
+    printf("out = (in0 - in1) * mask * scale, float output\n");
+    printf("in0 and in1 have same size and datatype, any real type\n");
+    printf("mask is optional (null), float, same size\n");
+    printf("Triggers on in0\n");
 
     return RETURN_SUCCESS;
 }
 
-/**
- * ## Purpose
- *
- * Compute difference between two 2D streams\n
- * Triggers on stream0\n
- *
- */
-imageID COREMOD_MEMORY_streamDiff(const char *IDstream0_name,
-                                  const char *IDstream1_name,
-                                  const char *IDstreammask_name,
-                                  const char *IDstreamout_name,
-                                  long        semtrig)
+static errno_t compute_function()
 {
-    imageID            ID0;
-    imageID            ID1;
-    imageID            IDout;
-    uint32_t           xsize;
-    uint32_t           ysize;
-    uint64_t           xysize;
-    uint32_t          *arraysize;
-    unsigned long long cnt;
-    imageID            IDmask; // optional
-
-    ID0    = image_ID(IDstream0_name);
-    ID1    = image_ID(IDstream1_name);
-    IDmask = image_ID(IDstreammask_name);
-
-    xsize  = data.image[ID0].md[0].size[0];
-    ysize  = data.image[ID0].md[0].size[1];
-    xysize = xsize * ysize;
-
-    arraysize = (uint32_t *) malloc(sizeof(uint32_t) * 2);
-    if(arraysize == NULL)
+    DEBUG_TRACE_FSTART();
+
+    IMGID in0img = mkIMGID_from_name(in0imname);
+    resolveIMGID(&in0img, ERRMODE_ABORT);
+
+    IMGID in1img = mkIMGID_from_name(in1imname);
+    resolveIMGID(&in1img, ERRMODE_ABORT);
+
+    uint32_t xsize = in0img.md->size[0];
+    uint32_t ysize = (in0img.md->naxis > 1) ? in0img.md->size[1] : 1;
+    uint64_t nelem = (uint64_t) xsize * ysize;
+
+    if((in1img.md->datatype != in0img.md->datatype) ||
+            (in1img.md->size[0] != xsize) ||
+            (((in1img.md->naxis > 1) ? in1img.md->size[1] : 1) != ysize))
+    {
+        FUNC_RETURN_FAILURE("%s and %s differ in size or datatype",
+                            in0imname,
+                            in1imname);
+    }
+
+    float *maskarray = NULL;
+    if(strcmp(maskimname, "null") != 0)
     {
-        PRINT_ERROR("malloc error");
-        abort();
+        IMGID maskimg = mkIMGID_from_name(maskimname);
+        resolveIMGID(&maskimg, ERRMODE_ABORT);
+        if((maskimg.md->datatype != _DATATYPE_FLOAT) ||
+                (maskimg.md->nelement < nelem))
+        {
+            FUNC_RETURN_FAILURE("mask %s must be float, %lu elements",
+                                maskimname,
+                                (unsigned long) nelem);
+        }
+        maskarray = maskimg.im->array.F;
     }
-    arraysize[0] = xsize;
-    arraysize[1] = ysize;
 
-    IDout = image_ID(IDstreamout_name);
-    if(IDout == -1)
+    IMGID outimg = mkIMGID_from_name(outimname);
+    if(resolveIMGID(&outimg, ERRMODE_WARN) == -1)
     {
-        create_image_ID(IDstreamout_name,
+        uint32_t size[2];
+        size[0] = xsize;
+        size[1] = ysize;
+        create_image_ID(outimname,
                         2,
-                        arraysize,
+                        size,
                         _DATATYPE_FLOAT,
                         1,
                         0,
                         0,
-                        &IDout);
+                        &outimg.ID);
+        resolveIMGID(&outimg, ERRMODE_ABORT);
+    }
+    if((outimg.md->datatype != _DATATYPE_FLOAT) ||
+            (outimg.md->nelement < nelem))
+    {
+        FUNC_RETURN_FAILURE("output %s must be float, %lu elements",
+                            outimname,
+                            (unsigned long) nelem);
     }
 
-    free(arraysize);
+    uint8_t datatype = in0img.md->datatype;
+    int     typesize = ImageStreamIO_typesize(datatype);
 
-    while(1)
+    float             kscale = *scale;
+    STREAMDIFF_KERNEL kernel = streamdiff_kernel_select(
+                                   datatype,
+                                   streamdiff_kernel_op(maskarray != NULL, kscale));
+    if(kernel == NULL)
     {
-        // has new frame arrived ?
-        if(data.image[ID0].md[0].sem == 0)
-        {
-            while(cnt ==
-                    data.image[ID0].md[0].cnt0) // test if new frame exists
-            {
-                usleep(5);
-            }
-            cnt = data.image[ID0].md[0].cnt0;
-        }
-        else
-        {
-            sem_wait(data.image[ID0].semptr[semtrig]);
-        }
+        FUNC_RETURN_FAILURE("datatype of %s not supported", in0imname);
+    }
 
-        data.image[IDout].md[0].write = 1;
-        if(IDmask == -1)
-        {
-            for(uint64_t ii = 0; ii < xysize; ii++)
-            {
-                data.image[IDout].array.F[ii] =
-                    data.image[ID0].array.F[ii] - data.image[ID1].array.F[ii];
-            }
-        }
-        else
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    if(processinfo != NULL)
+    {
+        processinfo_waitoninputstream_init(processinfo,
+                                           in0img.ID,
+                                           PROCESSINFO_TRIGGERMODE_SEMAPHORE,
+                                           (int) *semtrig);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        if(*scale != kscale)
         {
-            for(uint64_t ii = 0; ii < xysize; ii++)
-            {
-                data.image[IDout].array.F[ii] = (data.image[ID0].array.F[ii] -
-                                                 data.image[ID1].array.F[ii]) *
-                                                data.image[IDmask].array.F[ii];
-            }
+            kscale = *scale;
+            kernel = streamdiff_kernel_select(
+                         datatype,
+                         streamdiff_kernel_op(maskarray != NULL, kscale));
         }
-        COREMOD_MEMORY_image_set_sempost_byID(IDout, -1);
-        ;
-        data.image[IDout].md[0].cnt0++;
-        data.image[IDout].md[0].write = 0;
+
+        outimg.md->write = 1;
+        streamdiff_kernel_run(kernel,
+                              typesize,
+                              in0img.im->array.raw,
+                              in1img.im->array.raw,
+                              maskarray,
+                              kscale,
+                              outimg.im->array.F,
+                              nelem);
+        processinfo_update_output_stream(processinfo, outimg.ID);
     }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
-    return IDout;
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_diff()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
 }
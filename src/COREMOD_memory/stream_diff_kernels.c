@@ -0,0 +1,167 @@
+/**
+ * @file    stream_diff_kernels.c
+ * @brief   frame difference kernels, shared by streamdiff and streamhalfdiff
+ *
+ * One kernel per (input type, operator), generated from a template so
+ * that each loop has fixed types and vectorizes. The kernel is selected
+ * once from the stream datatype and options, then called on every
+ * frame.
+ *
+ * The difference is computed in a type wide enough to be exact (int32
+ * for 8 and 16-bit input, int64 for 32 and 64-bit input), then converted
+ * to float. The 16-bit case, typical of camera streams, is a widen,
+ * subtract and convert per pixel.
+ *
+ * Frames larger than OMP_NELEMENT_LIMIT are split in contiguous chunks
+ * across OpenMP threads.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "stream_diff_kernels.h"
+
+#define OMP_NELEMENT_LIMIT 1000000
+
+#ifdef _OPENMP
+#include <omp.h>
+#define STREAMDIFFK_SIMD _Pragma("omp simd")
+#else
+#define STREAMDIFFK_SIMD
+#endif
+
+// datatype codes are used as table indices
+#define STREAMDIFFK_NBDATATYPE 16
+
+/* ------------------------------------------------------------------------- */
+/* Kernel templates                                                          */
+/* ------------------------------------------------------------------------- */
+
+#define STREAMDIFFK_DEFINE_OP(S, T, TD, OPNAME, expr)                          \
+    static void streamdiffk_##OPNAME##_##S(const void *__restrict in0,         \
+                                           const void *__restrict in1,         \
+                                           const float *__restrict mask,       \
+                                           float scale,                        \
+                                           float *__restrict out,              \
+                                           uint64_t nelem)                     \
+    {                                                                          \
+        const T *__restrict a = (const T *) in0;                               \
+        const T *__restrict b = (const T *) in1;                               \
+        (void) mask;                                                           \
+        (void) scale;                                                          \
+        STREAMDIFFK_SIMD                                                       \
+        for (uint64_t ii = 0; ii < nelem; ii++)                                \
+        {                                                                      \
+            float d = (float) ((TD) a[ii] - (TD) b[ii]);                       \
+            out[ii] = (expr);                                                  \
+        }                                                                      \
+    }
+
+#define STREAMDIFFK_DEFINE(S, T, TD, DT)                                       \
+    STREAMDIFFK_DEFINE_OP(S, T, TD, sub, d)                                    \
+    STREAMDIFFK_DEFINE_OP(S, T, TD, subscale, d * scale)                       \
+    STREAMDIFFK_DEFINE_OP(S, T, TD, submask, d * mask[ii])                     \
+    STREAMDIFFK_DEFINE_OP(S, T, TD, submaskscale, d * mask[ii] * scale)
+
+// input types : short name, type, difference type, datatype code
+#define STREAMDIFFK_FOREACH_INTYPE(M)                                          \
+    M(UI8, uint8_t, int32_t, _DATATYPE_UINT8)                                  \
+    M(SI8, int8_t, int32_t, _DATATYPE_INT8)                                    \
+    M(UI16, uint16_t, int32_t, _DATATYPE_UINT16)                               \
+    M(SI16, int16_t, int32_t, _DATATYPE_INT16)                                 \
+    M(UI32, uint32_t, int64_t, _DATATYPE_UINT32)                               \
+    M(SI32, int32_t, int64_t, _DATATYPE_INT32)                                 \
+    M(UI64, uint64_t, int64_t, _DATATYPE_UINT64)                               \
+    M(SI64, int64_t, int64_t, _DATATYPE_INT64)                                 \
+    M(F, float, float, _DATATYPE_FLOAT)                                        \
+    M(D, double, double, _DATATYPE_DOUBLE)
+
+STREAMDIFFK_FOREACH_INTYPE(STREAMDIFFK_DEFINE)
+
+// dispatch table, indexed by [input datatype][operator]
+#define STREAMDIFFK_TABLE(S, T, TD, DT)                                        \
+    [DT][STREAMDIFF_OP_SUB]          = streamdiffk_sub_##S,                    \
+    [DT][STREAMDIFF_OP_SUBSCALE]     = streamdiffk_subscale_##S,               \
+    [DT][STREAMDIFF_OP_SUBMASK]      = streamdiffk_submask_##S,                \
+    [DT][STREAMDIFF_OP_SUBMASKSCALE] = streamdiffk_submaskscale_##S,
+
+static const STREAMDIFF_KERNEL
+streamdiffk_table[STREAMDIFFK_NBDATATYPE][STREAMDIFF_NBOP] =
+{
+    STREAMDIFFK_FOREACH_INTYPE(STREAMDIFFK_TABLE)
+};
+
+/* ------------------------------------------------------------------------- */
+/* Selection and execution                                                   */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Operator for mask and scale options
+ *
+ * Scale 1 uses the operator without scaling.
+ */
+int streamdiff_kernel_op(int usemask, float scale)
+{
+    if(usemask)
+    {
+        return (scale == 1.0f) ? STREAMDIFF_OP_SUBMASK
+               : STREAMDIFF_OP_SUBMASKSCALE;
+    }
+    return (scale == 1.0f) ? STREAMDIFF_OP_SUB : STREAMDIFF_OP_SUBSCALE;
+}
+
+/**
+ * @brief Kernel for input datatype and operator
+ *
+ * @return NULL if datatype is not supported (complex)
+ */
+STREAMDIFF_KERNEL streamdiff_kernel_select(uint8_t datatype, int op)
+{
+    if((datatype >= STREAMDIFFK_NBDATATYPE) || (op < 0) ||
+            (op >= STREAMDIFF_NBOP))
+    {
+        return NULL;
+    }
+    return streamdiffk_table[datatype][op];
+}
+
+/**
+ * @brief Run kernel on nelem elements
+ *
+ * typesize is the input element size, used to offset chunks.
+ */
+void streamdiff_kernel_run(STREAMDIFF_KERNEL kernel,
+                           int               typesize,
+                           const void       *in0,
+                           const void       *in1,
+                           const float      *mask,
+                           float             scale,
+                           float            *out,
+                           uint64_t          nelem)
+{
+#ifdef _OPENMP
+    if(nelem > OMP_NELEMENT_LIMIT)
+    {
+        #pragma omp parallel
+        {
+            uint64_t nt = omp_get_num_threads();
+            uint64_t t  = omp_get_thread_num();
+            // chunks are multiples of 16 elements
+            uint64_t chunk = (((nelem + nt - 1) / nt) + 15) & ~((uint64_t) 15);
+            uint64_t i0    = t * chunk;
+            if(i0 < nelem)
+            {
+                uint64_t n = (nelem - i0 < chunk) ? nelem - i0 : chunk;
+                kernel((const char *) in0 + i0 * typesize,
+                       (const char *) in1 + i0 * typesize,
+                       (mask == NULL) ? NULL : mask + i0,
+                       scale,
+                       out + i0,
+                       n);
+            }
+        }
+        return;
+    }
+#endif
+
+    kernel(in0, in1, mask, scale, out, nelem);
+}
@@ -0,0 +1,38 @@
+/**
+ * @file    stream_diff_kernels.h
+ *
+ * Frame difference kernels, any real input type to float
+ *
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_DIFF_KERNELS_H
+#define MILK_COREMOD_MEMORY_STREAM_DIFF_KERNELS_H
+
+// operators, out = ...
+#define STREAMDIFF_OP_SUB          0 // a - b
+#define STREAMDIFF_OP_SUBSCALE     1 // (a - b) * scale
+#define STREAMDIFF_OP_SUBMASK      2 // (a - b) * mask
+#define STREAMDIFF_OP_SUBMASKSCALE 3 // (a - b) * mask * scale
+#define STREAMDIFF_NBOP            4
+
+typedef void (*STREAMDIFF_KERNEL)(const void *__restrict in0,
+                                  const void *__restrict in1,
+                                  const float *__restrict mask,
+                                  float scale,
+                                  float *__restrict out,
+                                  uint64_t nelem);
+
+int streamdiff_kernel_op(int usemask, float scale);
+
+STREAMDIFF_KERNEL streamdiff_kernel_select(uint8_t datatype, int op);
+
+void streamdiff_kernel_run(STREAMDIFF_KERNEL kernel,
+                           int               typesize,
+                           const void       *in0,
+                           const void       *in1,
+                           const float      *mask,
+                           float             scale,
+                           float            *out,
+                           uint64_t          nelem);
+
+#endif
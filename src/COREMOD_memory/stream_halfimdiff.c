@@ -1,274 +1,194 @@
 /**
  * @file stream_hlfimdiff.c
  * @brief difference between two halves of stream image
+ *
+ * out = (top half - bottom half) [* scale], float output.
+ * Input is split along the second axis. Uses the kernels of streamdiff
+ * (see stream_diff_kernels.c), selected at setup.
  */
 
 #include "CommandLineInterface/CLIcore.h"
 #include "create_image.h"
-#include "image_ID.h"
-#include "stream_sem.h"
 
-// ==========================================
-// Forward declaration(s)
-// ==========================================
+#include "stream_diff_kernels.h"
 
-imageID COREMOD_MEMORY_stream_halfimDiff(const char *IDstream_name,
-        const char *IDstreamout_name,
-        long        semtrig);
+static char *inimname;
+static char *outimname;
 
-// ==========================================
-// Command line interface wrapper function(s)
-// ==========================================
+static int64_t *semtrig;
+static long     fpi_semtrig = -1;
 
-static errno_t COREMOD_MEMORY_stream_halfimDiff__cli()
+static float *scale;
+static long   fpi_scale = -1;
+
+static CLICMDARGDEF farg[] =
 {
-    if(0 + CLI_checkarg(1, CLIARG_IMG) + CLI_checkarg(2, CLIARG_IMG) +
-            CLI_checkarg(3, CLIARG_INT64) ==
-            0)
     {
-        COREMOD_MEMORY_stream_halfimDiff(data.cmdargtoken[1].val.string,
-                                         data.cmdargtoken[2].val.string,
-                                         data.cmdargtoken[3].val.numl);
-        return CLICMD_SUCCESS;
+        CLIARG_IMG,
+        ".in_name",
+        "input stream",
+        "stream",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".out_name",
+        "output stream",
+        "outstream",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_INT64,
+        ".semtrig",
+        "trigger semaphore index, -1 for auto",
+        "-1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &semtrig,
+        &fpi_semtrig
+    },
+    {
+        CLIARG_FLOAT32,
+        ".scale",
+        "output scaling factor",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &scale,
+        &fpi_scale
     }
-    else
+};
+
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
     {
-        return CLICMD_INVALID_ARG;
+        data.fpsptr->parray[fpi_scale].fpflag |= FPFLAG_WRITERUN;
     }
-}
 
-// ==========================================
-// Register CLI command(s)
-// ==========================================
+    return RETURN_SUCCESS;
+}
 
-errno_t stream_halfimdiff_addCLIcmd()
+static errno_t customCONFcheck()
 {
-    RegisterCLIcommand(
-        "streamhalfdiff",
-        __FILE__,
-        COREMOD_MEMORY_stream_halfimDiff__cli,
-        "compute difference between two halves of an image stream",
-        "<in stream> <out stream> <sem trigger index>",
-        "streamhalfdiff stream outstream 3",
-        "long COREMOD_MEMORY_stream_halfimDiff(const char *IDstream_name, "
-        "const char *IDstreamout_name, long semtrig)");
-
     return RETURN_SUCCESS;
 }
 
-//
-// compute difference between two halves of an image stream
-// triggers on instream
-//
-imageID COREMOD_MEMORY_stream_halfimDiff(const char *IDstream_name,
-        const char *IDstreamout_name,
-        long        semtrig)
+static CLICMDDATA CLIcmddata =
 {
-    imageID            ID0;
-    imageID            IDout;
-    uint32_t           xsizein;
-    uint32_t           ysizein;
-    uint32_t           xsize;
-    uint32_t           ysize;
-    uint64_t           xysize;
-    uint32_t          *arraysize;
-    unsigned long long cnt;
-    uint8_t            datatype;
-    uint8_t            datatypeout;
+    "streamhalfdiff",
+    "compute difference between two halves of an image stream",
+    CLICMD_FIELDS_DEFAULTS
+};
 
-    ID0 = image_ID(IDstream_name);
+// detailed help
+static errno_t help_function()
+{
+    printf("out = (first half - second half) * scale, float output\n");
+    printf("Input of size (x, 2y) is split in two (x, y) halves\n");
 
-    xsizein = data.image[ID0].md[0].size[0];
-    ysizein = data.image[ID0].md[0].size[1];
-    //    xysizein = xsizein*ysizein;
+    return RETURN_SUCCESS;
+}
 
-    xsize  = xsizein;
-    ysize  = ysizein / 2;
-    xysize = xsize * ysize;
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
 
-    arraysize = (uint32_t *) malloc(sizeof(uint32_t) * 2);
-    if(arraysize == NULL)
-    {
-        PRINT_ERROR("malloc error");
-        abort();
-    }
-    arraysize[0] = xsize;
-    arraysize[1] = ysize;
+    IMGID inimg = mkIMGID_from_name(inimname);
+    resolveIMGID(&inimg, ERRMODE_ABORT);
 
-    datatype    = data.image[ID0].md[0].datatype;
-    datatypeout = _DATATYPE_FLOAT;
-    switch(datatype)
+    if(inimg.md->naxis < 2)
     {
-
-        case _DATATYPE_UINT8:
-            datatypeout = _DATATYPE_INT16;
-            break;
-
-        case _DATATYPE_UINT16:
-            datatypeout = _DATATYPE_INT32;
-            break;
-
-        case _DATATYPE_UINT32:
-            datatypeout = _DATATYPE_INT64;
-            break;
-
-        case _DATATYPE_UINT64:
-            datatypeout = _DATATYPE_INT64;
-            break;
-
-        case _DATATYPE_INT8:
-            datatypeout = _DATATYPE_INT16;
-            break;
-
-        case _DATATYPE_INT16:
-            datatypeout = _DATATYPE_INT32;
-            break;
-
-        case _DATATYPE_INT32:
-            datatypeout = _DATATYPE_INT64;
-            break;
-
-        case _DATATYPE_INT64:
-            datatypeout = _DATATYPE_INT64;
-            break;
-
-        case _DATATYPE_DOUBLE:
-            datatypeout = _DATATYPE_DOUBLE;
-            break;
+        FUNC_RETURN_FAILURE("input %s must be 2D", inimname);
     }
+    uint32_t xsize = inimg.md->size[0];
+    uint32_t ysize = inimg.md->size[1] / 2;
+    uint64_t nelem = (uint64_t) xsize * ysize;
 
-    IDout = image_ID(IDstreamout_name);
-    if(IDout == -1)
+    IMGID outimg = mkIMGID_from_name(outimname);
+    if(resolveIMGID(&outimg, ERRMODE_WARN) == -1)
     {
-        create_image_ID(IDstreamout_name,
+        uint32_t size[2];
+        size[0] = xsize;
+        size[1] = ysize;
+        create_image_ID(outimname,
                         2,
-                        arraysize,
-                        datatypeout,
+                        size,
+                        _DATATYPE_FLOAT,
                         1,
                         0,
                         0,
-                        &IDout);
+                        &outimg.ID);
+        resolveIMGID(&outimg, ERRMODE_ABORT);
     }
-
-    free(arraysize);
-
-    while(1)
+    if((outimg.md->datatype != _DATATYPE_FLOAT) ||
+            (outimg.md->nelement < nelem))
     {
-        // has new frame arrived ?
-        if(data.image[ID0].md[0].sem == 0)
-        {
-            while(cnt ==
-                    data.image[ID0].md[0].cnt0) // test if new frame exists
-            {
-                usleep(5);
-            }
-            cnt = data.image[ID0].md[0].cnt0;
-        }
-        else
-        {
-            sem_wait(data.image[ID0].semptr[semtrig]);
-        }
-
-        data.image[IDout].md[0].write = 1;
-
-        switch(datatype)
-        {
-
-            case _DATATYPE_UINT8:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI16[ii] =
-                        data.image[ID0].array.UI8[ii] -
-                        data.image[ID0].array.UI8[xysize + ii];
-                }
-                break;
+        FUNC_RETURN_FAILURE("output %s must be float, %lu elements",
+                            outimname,
+                            (unsigned long) nelem);
+    }
 
-            case _DATATYPE_UINT16:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI32[ii] =
-                        data.image[ID0].array.UI16[ii] -
-                        data.image[ID0].array.UI16[xysize + ii];
-                }
-                break;
+    uint8_t datatype = inimg.md->datatype;
+    int     typesize = ImageStreamIO_typesize(datatype);
 
-            case _DATATYPE_UINT32:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI64[ii] =
-                        data.image[ID0].array.UI32[ii] -
-                        data.image[ID0].array.UI32[xysize + ii];
-                }
-                break;
+    float             kscale = *scale;
+    STREAMDIFF_KERNEL kernel =
+        streamdiff_kernel_select(datatype, streamdiff_kernel_op(0, kscale));
+    if(kernel == NULL)
+    {
+        FUNC_RETURN_FAILURE("datatype of %s not supported", inimname);
+    }
 
-            case _DATATYPE_UINT64:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI64[ii] =
-                        data.image[ID0].array.UI64[ii] -
-                        data.image[ID0].array.UI64[xysize + ii];
-                }
-                break;
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
 
-            case _DATATYPE_INT8:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI16[ii] =
-                        data.image[ID0].array.SI8[ii] -
-                        data.image[ID0].array.SI8[xysize + ii];
-                }
-                break;
+    if(processinfo != NULL)
+    {
+        processinfo_waitoninputstream_init(processinfo,
+                                           inimg.ID,
+                                           PROCESSINFO_TRIGGERMODE_SEMAPHORE,
+                                           (int) *semtrig);
+    }
 
-            case _DATATYPE_INT16:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI32[ii] =
-                        data.image[ID0].array.SI16[ii] -
-                        data.image[ID0].array.SI16[xysize + ii];
-                }
-                break;
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        if(*scale != kscale)
+        {
+            kscale = *scale;
+            kernel = streamdiff_kernel_select(datatype,
+                                              streamdiff_kernel_op(0, kscale));
+        }
 
-            case _DATATYPE_INT32:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI64[ii] =
-                        data.image[ID0].array.SI32[ii] -
-                        data.image[ID0].array.SI32[xysize + ii];
-                }
-                break;
+        char *in0 = (char *) inimg.im->array.raw;
+
+        outimg.md->write = 1;
+        streamdiff_kernel_run(kernel,
+                              typesize,
+                              in0,
+                              in0 + nelem * typesize,
+                              NULL,
+                              kscale,
+                              outimg.im->array.F,
+                              nelem);
+        processinfo_update_output_stream(processinfo, outimg.ID);
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
-            case _DATATYPE_INT64:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.SI64[ii] =
-                        data.image[ID0].array.SI64[ii] -
-                        data.image[ID0].array.SI64[xysize + ii];
-                }
-                break;
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
 
-            case _DATATYPE_FLOAT:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.F[ii] =
-                        data.image[ID0].array.F[ii] -
-                        data.image[ID0].array.F[xysize + ii];
-                }
-                break;
+INSERT_STD_FPSCLIfunctions
 
-            case _DATATYPE_DOUBLE:
-                for(uint64_t ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.D[ii] =
-                        data.image[ID0].array.D[ii] -
-                        data.image[ID0].array.D[xysize + ii];
-                }
-                break;
-        }
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_halfimdiff()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
 
-        COREMOD_MEMORY_image_set_sempost_byID(IDout, -1);
-        data.image[IDout].md[0].cnt0++;
-        data.image[IDout].md[0].write = 0;
-    }
+    INSERT_STD_CLIREGISTERFUNC
 
-    return IDout;
+    return RETURN_SUCCESS;
 }
@@ -11,6 +11,8 @@
 #include "CommandLineInterface/CLIcore.h"
 #include "CommandLineInterface/timeutils.h"
 
+#include "stream_tile.h"
+
 //#include "image_ID.h"
 //#include "stream_sem.h"
 
@@ -77,7 +79,11 @@ static errno_t compute_function()
 
     // Open output image
     IMGID img_out = mkIMGID_from_name(stream_basename);
-    resolveIMGID(&img_out, ERRMODE_WARN);
+    if(resolveIMGID(&img_out, ERRMODE_WARN) == -1)
+    {
+        free(img_in_arr);
+        FUNC_RETURN_FAILURE("output stream %s does not exist", stream_basename);
+    }
 
     // Perform some data offset computations.
     // So that we know WHERE the memcopies should go and how big they should be.
@@ -93,9 +99,9 @@ static errno_t compute_function()
         abort();
     }
 
-    int32_t *sem_idxs = (int32_t *) malloc(n_input * sizeof(int32_t));
-    if(sem_idxs == NULL) {
-        PRINT_ERROR("malloc returns NULL pointer, size %ld", (long) (n_input * sizeof(int32_t)));
+    imageID *ID_in_arr = (imageID *) malloc(n_input * sizeof(imageID));
+    if(ID_in_arr == NULL) {
+        PRINT_ERROR("malloc returns NULL pointer, size %ld", (long) (n_input * sizeof(imageID)));
         abort();
     }
 
@@ -103,37 +109,52 @@ static errno_t compute_function()
     for(int kk = 0;  kk < n_input; ++kk)
     {
         offset_bytes[kk] = acc;
-        size_bytes[kk] = img_in_arr[kk].size[0] * ImageStreamIO_typesize(
+        // inputs are concatenated, any naxis
+        size_bytes[kk] = img_in_arr[kk].md->nelement * ImageStreamIO_typesize(
                              img_in_arr[kk].datatype);
-        acc += size_bytes[kk]; // Wildly assuming naxis=1 here.
+        acc += size_bytes[kk];
 
-        sem_idxs[kk] = ImageStreamIO_getsemwaitindex(img_in_arr[kk].im, 0);
+        ID_in_arr[kk] = img_in_arr[kk].ID;
     }
 
+    if((uint64_t) acc > img_out.md->nelement * ImageStreamIO_typesize(
+                img_out.md->datatype))
+    {
+        free(img_in_arr);
+        free(ID_in_arr);
+        free(offset_bytes);
+        free(size_bytes);
+        FUNC_RETURN_FAILURE("inputs do not fit in %s", stream_basename);
+    }
+
+    // input keywords, merged into output
+    STREAM_TILE_KWMAP *kwmap = (STREAM_TILE_KWMAP *) malloc(
+                                   img_out.md->NBkw * sizeof(STREAM_TILE_KWMAP));
+    if(kwmap == NULL) {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    long NBkwmap = stream_tile_kwmap(&img_out, img_in_arr, n_input, kwmap,
+                                     img_out.md->NBkw);
 
-    struct timespec t_spec1;
-    struct timespec t_spec2;
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
 
-    // Note - by DESIGN, this functions handles its own multi-stream sync
-    // processinfo trigger should be put in freerun mode.
-    processinfo->triggermode = PROCESSINFO_TRIGGERMODE_IMMEDIATE;
+    // Wait for all inputs to be updated, 1 sec timeout
+    // Mode and timeout are kept by INSERT_STD_PROCINFO_COMPUTEFUNC_END
+    if(processinfo != NULL)
+    {
+        processinfo->triggertimeout.tv_sec  = 1;
+        processinfo->triggertimeout.tv_nsec = 0;
+        FUNC_CHECK_RETURN(
+            processinfo_waitoninputstream_init_multi(processinfo,
+                    ID_in_arr,
+                    n_input,
+                    PROCESSINFO_TRIGGERMODE_ALL));
+    }
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
     {
-        // One sec timeout
-        milk_clock_gettime(&t_spec1);
-        t_spec2.tv_sec = t_spec1.tv_sec + 1;
-        t_spec2.tv_nsec = t_spec1.tv_nsec;
-
-
-        for(int kk = 0; kk < n_input; kk++)
-        {
-            ImageStreamIO_semtimedwait(img_in_arr[kk].im, sem_idxs[kk], &t_spec2);
-            // In case one input got ahead of the others
-            ImageStreamIO_semflush(img_in_arr[kk].im, sem_idxs[kk]);
-        }
         img_out.md->write = TRUE;
         for(int kk = 0; kk < n_input; kk++)
         {
@@ -141,8 +162,7 @@ static errno_t compute_function()
                    size_bytes[kk]);
         }
 
-
-        // What about keywords?
+        stream_tile_kwcopy(&img_out, img_in_arr, kwmap, NBkwmap);
 
         // Finito!
         processinfo_update_output_stream(processinfo, img_out.ID);
@@ -151,6 +171,10 @@ static errno_t compute_function()
 
     // Mem cleanup
     free(img_in_arr);
+    free(ID_in_arr);
+    free(offset_bytes);
+    free(size_bytes);
+    free(kwmap);
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
@@ -0,0 +1,734 @@
+/**
+ * @file    stream_netbench.c
+ * @brief   loopback benchmark of network stream transfer
+ *
+ * Measures stream_TCP / stream_UDP transfer on a single host:
+ *
+ *   transmitter (forked child process)
+ *     generator thread : writes frames to stream netbench<port> at .fps,
+ *                        each frame starting with a NETBENCH_STAMP
+ *     main thread      : imnetwtransmit / imnetwUDPtransmit to 127.0.0.1
+ *
+ *   receiver (this process)
+ *     receive thread   : imnetwreceive / imnetwUDPreceive
+ *     main thread      : polls received stream, measures latency from
+ *                        frame stamp to reception, reports periodically
+ *
+ * The source stream is created in local (non-shared) memory of the child,
+ * so that the receiver, which names its stream after the source, does not
+ * collide with it.
+ *
+ * Reported per interval and for the whole run:
+ *   throughput   : received frames and bytes per second
+ *   latency      : stamp to reception, p50, p99, p99.9, max
+ *   CPU per GB   : transmitter process and receive thread CPU time,
+ *                  excluding polling loop. Transmitter includes generator,
+ *                  negligible unless free running
+ *   loss         : source frames missing at receiver, including frames
+ *                  skipped by the transmitter, and UDP receiver counters
+ *
+ * With .duration = 0 the benchmark runs until interrupted, for soak tests.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "CommandLineInterface/processinfo/processinfo_hist.h"
+#include "create_image.h"
+#include "delete_image.h"
+#include "image_ID.h"
+#include "stream_TCP.h"
+#include "stream_UDP.h"
+
+#define NETBENCH_MAGIC 0x6E657462656E6368
+
+// written by generator at start of each frame
+typedef struct
+{
+    uint64_t seq;   // generator frame index
+    int64_t  tns;   // CLOCK_REALTIME at frame write [ns]
+    uint64_t check; // seq ^ tns ^ NETBENCH_MAGIC, detects torn reads
+} NETBENCH_STAMP;
+
+static char *proto;
+
+static uint32_t *mode;
+static long      fpi_mode;
+
+static uint32_t *framesize;
+static long      fpi_framesize;
+
+static double *fps;
+static long    fpi_fps;
+
+static double *duration;
+static long    fpi_duration;
+
+static double *reportdt;
+static long    fpi_reportdt;
+
+static uint32_t *port;
+static long      fpi_port;
+
+static uint32_t *pollus;
+static long      fpi_pollus;
+
+static char *outfname;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STR,
+        ".proto",
+        "protocol, TCP or UDP",
+        "TCP",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &proto,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".mode",
+        "transfer mode, see imnetwtransmit, imnetwUDPtransmit",
+        "0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &mode,
+        &fpi_mode
+    },
+    {
+        CLIARG_UINT32,
+        ".framesize",
+        "frame size [byte]",
+        "1048576",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &framesize,
+        &fpi_framesize
+    },
+    {
+        CLIARG_FLOAT64,
+        ".fps",
+        "frame rate [Hz], 0 for free running",
+        "1000",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &fps,
+        &fpi_fps
+    },
+    {
+        CLIARG_FLOAT64,
+        ".duration",
+        "duration [s], 0 until interrupted",
+        "10",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &duration,
+        &fpi_duration
+    },
+    {
+        CLIARG_FLOAT64,
+        ".reportdt",
+        "report interval [s]",
+        "1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &reportdt,
+        &fpi_reportdt
+    },
+    {
+        CLIARG_UINT32,
+        ".port",
+        "port",
+        "30200",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &port,
+        &fpi_port
+    },
+    {
+        CLIARG_UINT32,
+        ".pollus",
+        "receiver poll interval [us], 0 to spin",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &pollus,
+        &fpi_pollus
+    },
+    {
+        CLIARG_STR,
+        ".outfname",
+        "report file (appended), NULL if none",
+        "NULL",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outfname,
+        NULL
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "netbench", "loopback network transfer benchmark", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Transfer a synthetic stream over 127.0.0.1 and report\n");
+    printf("throughput, latency, CPU time per GB and loss\n");
+    printf("Transmitter runs in a child process, receiver in this process\n");
+    printf("Latency is measured from frame write to reception\n");
+    printf("Set .duration to 0 for soak test, stop with CTRL-C\n");
+    printf("Report columns:\n");
+    printf("  t[s] frames MB/s lat_p50 lat_p99 lat_p999 lat_max[us]\n");
+    printf("  txCPU rxCPU[s/GB] missed [lost recovered late dropped]\n");
+
+    return RETURN_SUCCESS;
+}
+
+static inline int64_t netbench_tns(struct timespec t)
+{
+    return (int64_t) t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static inline int64_t netbench_cpuns(clockid_t clk)
+{
+    struct timespec t;
+    if(clock_gettime(clk, &t) != 0)
+    {
+        return 0;
+    }
+    return netbench_tns(t);
+}
+
+typedef struct
+{
+    imageID ID;
+    double  fps;
+} NETBENCH_GENARG;
+
+/**
+ * @brief Generator thread, runs in transmitter process
+ */
+static void *netbench_generate(void *ptr)
+{
+    NETBENCH_GENARG *ga  = (NETBENCH_GENARG *) ptr;
+    IMAGE           *img = &data.image[ga->ID];
+
+    struct timespec tnext;
+    clock_gettime(CLOCK_MONOTONIC, &tnext);
+    long dtns = (ga->fps > 0.0) ? (long)(1.0e9 / ga->fps) : 0;
+
+    for(uint64_t seq = 0;; seq++)
+    {
+        if(dtns > 0)
+        {
+            tnext.tv_nsec += dtns;
+            while(tnext.tv_nsec >= 1000000000L)
+            {
+                tnext.tv_nsec -= 1000000000L;
+                tnext.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tnext, NULL);
+        }
+
+        struct timespec t;
+        clock_gettime(CLOCK_REALTIME, &t);
+
+        NETBENCH_STAMP stamp;
+        stamp.seq   = seq;
+        stamp.tns   = netbench_tns(t);
+        stamp.check = stamp.seq ^ (uint64_t) stamp.tns ^ NETBENCH_MAGIC;
+
+        img->md->write = 1;
+        memcpy(img->array.raw, &stamp, sizeof(NETBENCH_STAMP));
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        ImageStreamIO_UpdateIm(img);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Transmitter process, does not return
+ */
+static void netbench_transmit(const char *sname, int UDP)
+{
+    uint32_t size[2];
+    imageID  ID;
+
+    size[0] = *framesize;
+    size[1] = 1;
+    if(create_image_ID(sname, 2, size, _DATATYPE_UINT8, 0, 0, 0, &ID) !=
+            RETURN_SUCCESS)
+    {
+        _exit(EXIT_FAILURE);
+    }
+
+    // incompressible payload
+    {
+        uint64_t x = 0x9E3779B97F4A7C15;
+        for(uint32_t i = 0; i < *framesize; i++)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            data.image[ID].array.UI8[i] = (uint8_t) x;
+        }
+    }
+
+    NETBENCH_GENARG ga;
+    ga.ID  = ID;
+    ga.fps = *fps;
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, netbench_generate, &ga) != 0)
+    {
+        _exit(EXIT_FAILURE);
+    }
+
+    // let receiver start listening
+    usleep(500000);
+
+    if(UDP == 1)
+    {
+        COREMOD_MEMORY_image_NETUDPtransmit(sname,
+                                            "127.0.0.1",
+                                            *port,
+                                            *mode | NETWTRANSFER_MODE_COUNTERSYNC,
+                                            0);
+    }
+    else
+    {
+        COREMOD_MEMORY_image_NETWORKtransmit(sname,
+                                             "127.0.0.1",
+                                             *port,
+                                             *mode | NETWTRANSFER_MODE_COUNTERSYNC,
+                                             0);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+typedef struct
+{
+    int       UDP;
+    clockid_t cpuclock;
+    imageID   IDready; // received stream, set by receiver once created
+} NETBENCH_RXARG;
+
+static void *netbench_receive(void *ptr)
+{
+    NETBENCH_RXARG *ra = (NETBENCH_RXARG *) ptr;
+
+    pthread_getcpuclockid(pthread_self(), &ra->cpuclock);
+    if(ra->UDP == 1)
+    {
+        COREMOD_MEMORY_image_NETUDPreceive_ready(*port,
+                *mode,
+                0,
+                &ra->IDready);
+    }
+    else
+    {
+        COREMOD_MEMORY_image_NETWORKreceive_ready(*port,
+                *mode,
+                0,
+                &ra->IDready);
+    }
+
+    return NULL;
+}
+
+// counters at start of report interval, or of run
+typedef struct
+{
+    int64_t  tns;
+    uint64_t cnt0;
+    uint64_t seq;
+    int64_t  txcpuns;
+    int64_t  rxcpuns;
+    uint64_t udpstat[UDPSTAT_NB];
+} NETBENCH_MARK;
+
+static void netbench_report(FILE             *fp,
+                            double            t,
+                            NETBENCH_MARK    *m0,
+                            NETBENCH_MARK    *m1,
+                            PROCESSINFO_HIST *hist,
+                            int               UDP)
+{
+    double   dt      = 1.0e-9 * (m1->tns - m0->tns);
+    uint64_t nbframe = m1->cnt0 - m0->cnt0;
+    double   GB      = 1.0e-9 * nbframe * (*framesize);
+    long     missed  = (long)(m1->seq - m0->seq) - (long) nbframe;
+
+    char line[400];
+    int  len = snprintf(line,
+                        400,
+                        "%10.1f %10lu %9.2f %8.1f %8.1f %8.1f %8.1f %7.3f %7.3f "
+                        "%8ld",
+                        t,
+                        (unsigned long) nbframe,
+                        (dt > 0.0) ? 1.0e3 * GB / dt : 0.0,
+                        1.0e-3 * processinfo_hist_percentile(hist, 0.5),
+                        1.0e-3 * processinfo_hist_percentile(hist, 0.99),
+                        1.0e-3 * processinfo_hist_percentile(hist, 0.999),
+                        1.0e-3 * hist->maxns,
+                        (GB > 0.0) ? 1.0e-9 * (m1->txcpuns - m0->txcpuns) / GB
+                        : 0.0,
+                        (GB > 0.0) ? 1.0e-9 * (m1->rxcpuns - m0->rxcpuns) / GB
+                        : 0.0,
+                        missed);
+    if(UDP == 1)
+    {
+        snprintf(line + len,
+                 400 - len,
+                 " %8lu %8lu %8lu %8lu",
+                 (unsigned long)(m1->udpstat[UDPSTAT_LOST] -
+                                 m0->udpstat[UDPSTAT_LOST]),
+                 (unsigned long)(m1->udpstat[UDPSTAT_RECOVERED] -
+                                 m0->udpstat[UDPSTAT_RECOVERED]),
+                 (unsigned long)(m1->udpstat[UDPSTAT_LATE] -
+                                 m0->udpstat[UDPSTAT_LATE]),
+                 (unsigned long)(m1->udpstat[UDPSTAT_DROPPED] -
+                                 m0->udpstat[UDPSTAT_DROPPED]));
+    }
+
+    printf("%s\n", line);
+    fflush(stdout);
+    if(fp != NULL)
+    {
+        fprintf(fp, "%s\n", line);
+        fflush(fp);
+    }
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    int UDP = 0;
+    if(strcmp(proto, "UDP") == 0)
+    {
+        UDP = 1;
+    }
+    else if(strcmp(proto, "TCP") != 0)
+    {
+        FUNC_RETURN_FAILURE("unknown protocol %s", proto);
+    }
+    if(*framesize < sizeof(NETBENCH_STAMP))
+    {
+        FUNC_RETURN_FAILURE("frame size must be at least %ld byte",
+                            (long) sizeof(NETBENCH_STAMP));
+    }
+
+    char sname[STRINGMAXLEN_IMAGE_NAME];
+    WRITE_IMAGENAME(sname, "netbench%u", *port);
+    char statname[STRINGMAXLEN_IMAGE_NAME];
+    WRITE_IMAGENAME(statname, "%s_udpstat", sname);
+
+    // remove streams left by previous run
+    delete_image_ID(sname, DELETE_IMAGE_ERRMODE_IGNORE);
+    delete_image_ID(statname, DELETE_IMAGE_ERRMODE_IGNORE);
+
+    FILE *fp = NULL;
+    if(strcmp(outfname, "NULL") != 0)
+    {
+        fp = fopen(outfname, "a");
+        if(fp == NULL)
+        {
+            FUNC_RETURN_FAILURE("cannot open %s", outfname);
+        }
+    }
+
+    fflush(stdout);
+    pid_t txpid = fork();
+    if(txpid < 0)
+    {
+        if(fp != NULL)
+        {
+            fclose(fp);
+        }
+        FUNC_RETURN_FAILURE("fork error");
+    }
+    if(txpid == 0)
+    {
+        netbench_transmit(sname, UDP);
+    }
+
+    clockid_t txcpuclock;
+    if(clock_getcpuclockid(txpid, &txcpuclock) != 0)
+    {
+        txcpuclock = -1;
+    }
+
+    NETBENCH_RXARG ra;
+    ra.UDP      = UDP;
+    ra.cpuclock = CLOCK_THREAD_CPUTIME_ID;
+    ra.IDready  = -1;
+    pthread_t rxthread;
+    if(pthread_create(&rxthread, NULL, netbench_receive, &ra) != 0)
+    {
+        kill(txpid, SIGKILL);
+        waitpid(txpid, NULL, 0);
+        if(fp != NULL)
+        {
+            fclose(fp);
+        }
+        FUNC_RETURN_FAILURE("cannot start receive thread");
+    }
+
+    PROCESSINFO_HIST *hist =
+        (PROCESSINFO_HIST *) calloc(2, sizeof(PROCESSINFO_HIST));
+    if(hist == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    PROCESSINFO_HIST *histint = &hist[0];
+    PROCESSINFO_HIST *histall = &hist[1];
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    if(processinfo != NULL)
+    {
+        processinfo_waitoninputstream_init(processinfo,
+                                           -1,
+                                           PROCESSINFO_TRIGGERMODE_IMMEDIATE,
+                                           -1);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        // benchmark runs within a single iteration
+        processloopOK = 0;
+
+        // wait for receiver stream, then first frame
+        // images are not looked up while the receiver may create them
+        imageID ID = -1;
+        for(int i = 0; (i < 100) && (ID == -1); i++)
+        {
+            usleep(100000);
+            ID = __atomic_load_n(&ra.IDready, __ATOMIC_ACQUIRE);
+            if((ID != -1) &&
+                    (__atomic_load_n(&data.image[ID].md->cnt0,
+                                     __ATOMIC_ACQUIRE) == 0))
+            {
+                ID = -1;
+            }
+        }
+        if(ID == -1)
+        {
+            PRINT_ERROR("no frame received from transmitter");
+        }
+        else
+        {
+            IMAGE *img = &data.image[ID];
+
+            printf("%s, %u byte frames, %.1f Hz, mode 0x%x\n",
+                   proto,
+                   *framesize,
+                   *fps,
+                   *mode);
+            printf("%10s %10s %9s %8s %8s %8s %8s %7s %7s %8s",
+                   "t[s]",
+                   "frames",
+                   "MB/s",
+                   "p50[us]",
+                   "p99[us]",
+                   "p999[us]",
+                   "max[us]",
+                   "txCPU",
+                   "rxCPU",
+                   "missed");
+            if(UDP == 1)
+            {
+                printf(" %8s %8s %8s %8s", "lost", "recov", "late", "dropped");
+            }
+            printf("\n");
+
+            imageID IDstat = -1;
+
+            NETBENCH_MARK mark0, markint, mark;
+            memset(&mark, 0, sizeof(NETBENCH_MARK));
+
+            uint64_t cnt0   = 0;
+            uint64_t ntorn  = 0;
+            int      marked = 0;
+
+            int64_t tnsend = 0;
+            int64_t tnsreport = 0;
+
+            while((data.signal_INT == 0) && (data.signal_TERM == 0))
+            {
+                uint64_t c = __atomic_load_n(&img->md->cnt0, __ATOMIC_ACQUIRE);
+                if(c == cnt0)
+                {
+                    if(*pollus > 0)
+                    {
+                        usleep(*pollus);
+                    }
+                    continue;
+                }
+                cnt0 = c;
+
+                struct timespec t;
+                clock_gettime(CLOCK_REALTIME, &t);
+                mark.tns = netbench_tns(t);
+
+                NETBENCH_STAMP stamp;
+                memcpy(&stamp, img->array.raw, sizeof(NETBENCH_STAMP));
+                if(stamp.check !=
+                        (stamp.seq ^ (uint64_t) stamp.tns ^ NETBENCH_MAGIC))
+                {
+                    ntorn++;
+                    continue;
+                }
+                mark.cnt0 = c;
+                mark.seq  = stamp.seq;
+
+                if(marked == 1)
+                {
+                    processinfo_hist_add(histint, mark.tns - stamp.tns);
+                    processinfo_hist_add(histall, mark.tns - stamp.tns);
+                }
+
+                if((marked == 1) && (mark.tns < tnsreport) &&
+                        ((tnsend == 0) || (mark.tns < tnsend)))
+                {
+                    continue;
+                }
+
+                // start or end of report interval
+                if(txcpuclock != -1)
+                {
+                    mark.txcpuns = netbench_cpuns(txcpuclock);
+                }
+                mark.rxcpuns = netbench_cpuns(ra.cpuclock);
+                if(UDP == 1)
+                {
+                    if(IDstat == -1)
+                    {
+                        // created by receiver before IDready
+                        IDstat = image_ID(statname);
+                    }
+                    if(IDstat != -1)
+                    {
+                        memcpy(mark.udpstat,
+                               data.image[IDstat].array.UI64,
+                               sizeof(uint64_t) * UDPSTAT_NB);
+                    }
+                }
+
+                if(marked == 0)
+                {
+                    mark0   = mark;
+                    markint = mark;
+                    marked  = 1;
+                    if(*duration > 0.0)
+                    {
+                        tnsend = mark.tns + (int64_t)(1.0e9 * (*duration));
+                    }
+                }
+                else
+                {
+                    netbench_report(fp,
+                                    1.0e-9 * (mark.tns - mark0.tns),
+                                    &markint,
+                                    &mark,
+                                    histint,
+                                    UDP);
+                    memset(histint, 0, sizeof(PROCESSINFO_HIST));
+                    markint = mark;
+
+                    if(processinfo != NULL)
+                    {
+                        char msgstring[STRINGMAXLEN_PROCESSINFO_STATUSMSG];
+                        snprintf(msgstring,
+                                 STRINGMAXLEN_PROCESSINFO_STATUSMSG,
+                                 "%lu frames p99 %.1f us",
+                                 (unsigned long)(mark.cnt0 - mark0.cnt0),
+                                 1.0e-3 *
+                                 processinfo_hist_percentile(histall, 0.99));
+                        processinfo_WriteMessage(processinfo, msgstring);
+                        if(processinfo->CTRLval == PROCESSINFO_CTRLVAL_EXIT)
+                        {
+                            break;
+                        }
+                    }
+
+                    if((tnsend != 0) && (mark.tns >= tnsend))
+                    {
+                        break;
+                    }
+                }
+                tnsreport = mark.tns + (int64_t)(1.0e9 * (*reportdt));
+            }
+
+            if(marked == 1)
+            {
+                printf("TOTAL\n");
+                if(fp != NULL)
+                {
+                    fprintf(fp, "TOTAL\n");
+                }
+                netbench_report(fp,
+                                1.0e-9 * (mark.tns - mark0.tns),
+                                &mark0,
+                                &mark,
+                                histall,
+                                UDP);
+                if(ntorn > 0)
+                {
+                    printf("%lu frames overwritten while reading stamp\n",
+                           (unsigned long) ntorn);
+                }
+            }
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    // stop transmitter, then receiver
+    kill(txpid, SIGTERM);
+    {
+        int txexit = 0;
+        for(int i = 0; (i < 20) && (txexit == 0); i++)
+        {
+            usleep(100000);
+            if(waitpid(txpid, NULL, WNOHANG) == txpid)
+            {
+                txexit = 1;
+            }
+        }
+        if(txexit == 0)
+        {
+            kill(txpid, SIGKILL);
+            waitpid(txpid, NULL, 0);
+        }
+    }
+
+    {
+        // receiver loop exits on signal flag, restore flags once stopped
+        int signal_INT  = data.signal_INT;
+        int signal_TERM = data.signal_TERM;
+        data.signal_INT = 1;
+        pthread_join(rxthread, NULL);
+        data.signal_INT  = signal_INT;
+        data.signal_TERM = signal_TERM;
+    }
+
+    free(hist);
+    if(fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_netbench()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
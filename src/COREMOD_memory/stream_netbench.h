@@ -0,0 +1,10 @@
+/**
+ * @file    stream_netbench.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_NETBENCH_H
+#define MILK_COREMOD_MEMORY_STREAM_NETBENCH_H
+
+errno_t CLIADDCMD_COREMOD_memory__stream_netbench();
+
+#endif // MILK_COREMOD_MEMORY_STREAM_NETBENCH_H
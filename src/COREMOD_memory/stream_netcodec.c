@@ -0,0 +1,329 @@
+/**
+ * @file    stream_netcodec.c
+ * @brief   frame encodings for network stream transfer
+ *
+ * Lossless encodings of a frame of nelem pixels of typesize bytes:
+ *
+ * NETCODEC_SHUFFLERLE : bytes are regrouped by significance (all byte 0,
+ *                       then all byte 1 ...), then run-length encoded.
+ *                       Efficient on smooth or low dynamic range data.
+ * NETCODEC_XORRLE     : as above, on XOR with previous frame, so that
+ *                       unchanged pixels and high-order bits are zero.
+ * NETCODEC_SPARSE     : list of (uint32 index, value) of pixels that
+ *                       differ from previous frame.
+ *
+ * Run-length format (PackBits variant):
+ *   ctrl <  128 : ctrl+1 literal bytes follow
+ *   ctrl >= 128 : next byte is repeated ctrl-128+3 times
+ *
+ * Encoders give up and return -1 as soon as output would exceed outmax,
+ * so that the caller can fall back to raw pixel data.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "stream_netcodec.h"
+
+#define RLE_LITMAX 128
+#define RLE_RUNMIN 3
+#define RLE_RUNMAX (127 + RLE_RUNMIN)
+
+// write literal bytes in[lit0..lit1[, return new output size or -1
+static long rle_literal(const uint8_t *in,
+                        long           lit0,
+                        long           lit1,
+                        uint8_t       *out,
+                        long           o,
+                        long           outmax)
+{
+    while(lit0 < lit1)
+    {
+        long l = lit1 - lit0;
+        if(l > RLE_LITMAX)
+        {
+            l = RLE_LITMAX;
+        }
+        if(o + 1 + l > outmax)
+        {
+            return -1;
+        }
+        out[o++] = (uint8_t)(l - 1);
+        memcpy(out + o, in + lit0, l);
+        o += l;
+        lit0 += l;
+    }
+    return o;
+}
+
+static long rle_encode(const uint8_t *in, long n, uint8_t *out, long outmax)
+{
+    long i    = 0;
+    long o    = 0;
+    long lit0 = 0; // start of pending literal
+
+    while(i < n)
+    {
+        // run length at i
+        long r = 1;
+        while((i + r < n) && (r < RLE_RUNMAX) && (in[i + r] == in[i]))
+        {
+            r++;
+        }
+
+        if(r >= RLE_RUNMIN)
+        {
+            o = rle_literal(in, lit0, i, out, o, outmax);
+            if((o < 0) || (o + 2 > outmax))
+            {
+                return -1;
+            }
+            out[o++] = (uint8_t)(128 + r - RLE_RUNMIN);
+            out[o++] = in[i];
+            i += r;
+            lit0 = i;
+        }
+        else
+        {
+            i += r;
+            if(i - lit0 >= RLE_LITMAX)
+            {
+                o = rle_literal(in, lit0, i, out, o, outmax);
+                if(o < 0)
+                {
+                    return -1;
+                }
+                lit0 = i;
+            }
+        }
+    }
+
+    return rle_literal(in, lit0, n, out, o, outmax);
+}
+
+static errno_t rle_decode(const uint8_t *in, long insize, uint8_t *out, long n)
+{
+    long i = 0;
+    long o = 0;
+
+    while(i < insize)
+    {
+        uint8_t ctrl = in[i++];
+        if(ctrl < 128)
+        {
+            long l = ctrl + 1;
+            if((i + l > insize) || (o + l > n))
+            {
+                return RETURN_FAILURE;
+            }
+            memcpy(out + o, in + i, l);
+            i += l;
+            o += l;
+        }
+        else
+        {
+            long r = ctrl - 128 + RLE_RUNMIN;
+            if((i + 1 > insize) || (o + r > n))
+            {
+                return RETURN_FAILURE;
+            }
+            memset(out + o, in[i], r);
+            i++;
+            o += r;
+        }
+    }
+
+    if(o != n)
+    {
+        return RETURN_FAILURE;
+    }
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Encode frame
+ *
+ * @param codec     NETCODEC_ encoding
+ * @param in        frame
+ * @param ref       previous frame, used by XORRLE and SPARSE
+ * @param nelem     number of pixels
+ * @param typesize  bytes per pixel
+ * @param out       output buffer
+ * @param outmax    output buffer size
+ * @param work      work buffer, nelem*typesize bytes
+ * @return encoded size, -1 if larger than outmax
+ */
+long netcodec_encode(int         codec,
+                     const char *in,
+                     const char *ref,
+                     long        nelem,
+                     int         typesize,
+                     char       *out,
+                     long        outmax,
+                     char       *work)
+{
+    const uint8_t *in8  = (const uint8_t *) in;
+    const uint8_t *ref8 = (const uint8_t *) ref;
+    uint8_t       *w8   = (uint8_t *) work;
+    long           size = nelem * typesize;
+
+    switch(codec)
+    {
+        case NETCODEC_RAW:
+            if(size > outmax)
+            {
+                return -1;
+            }
+            memcpy(out, in, size);
+            return size;
+
+        case NETCODEC_SHUFFLERLE:
+            for(int b = 0; b < typesize; b++)
+            {
+                uint8_t *wb = w8 + b * nelem;
+                for(long ii = 0; ii < nelem; ii++)
+                {
+                    wb[ii] = in8[ii * typesize + b];
+                }
+            }
+            return rle_encode(w8, size, (uint8_t *) out, outmax);
+
+        case NETCODEC_XORRLE:
+            for(int b = 0; b < typesize; b++)
+            {
+                uint8_t *wb = w8 + b * nelem;
+                for(long ii = 0; ii < nelem; ii++)
+                {
+                    wb[ii] = in8[ii * typesize + b] ^ ref8[ii * typesize + b];
+                }
+            }
+            return rle_encode(w8, size, (uint8_t *) out, outmax);
+
+        case NETCODEC_SPARSE:
+        {
+            long o = 0;
+            for(long ii = 0; ii < nelem; ii++)
+            {
+                if(memcmp(in8 + ii * typesize, ref8 + ii * typesize, typesize) !=
+                        0)
+                {
+                    if(o + (long) sizeof(uint32_t) + typesize > outmax)
+                    {
+                        return -1;
+                    }
+                    uint32_t index = ii;
+                    memcpy(out + o, &index, sizeof(uint32_t));
+                    o += sizeof(uint32_t);
+                    memcpy(out + o, in8 + ii * typesize, typesize);
+                    o += typesize;
+                }
+            }
+            return o;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Decode frame
+ *
+ * Arguments as netcodec_encode(). out and ref may not overlap.
+ */
+errno_t netcodec_decode(int         codec,
+                        const char *in,
+                        long        insize,
+                        const char *ref,
+                        long        nelem,
+                        int         typesize,
+                        char       *out,
+                        char       *work)
+{
+    const uint8_t *ref8 = (const uint8_t *) ref;
+    uint8_t       *out8 = (uint8_t *) out;
+    uint8_t       *w8   = (uint8_t *) work;
+    long           size = nelem * typesize;
+
+    switch(codec)
+    {
+        case NETCODEC_RAW:
+            if(insize != size)
+            {
+                return RETURN_FAILURE;
+            }
+            memcpy(out, in, size);
+            return RETURN_SUCCESS;
+
+        case NETCODEC_SHUFFLERLE:
+            if(rle_decode((const uint8_t *) in, insize, w8, size) !=
+                    RETURN_SUCCESS)
+            {
+                return RETURN_FAILURE;
+            }
+            for(int b = 0; b < typesize; b++)
+            {
+                const uint8_t *wb = w8 + b * nelem;
+                for(long ii = 0; ii < nelem; ii++)
+                {
+                    out8[ii * typesize + b] = wb[ii];
+                }
+            }
+            return RETURN_SUCCESS;
+
+        case NETCODEC_XORRLE:
+            if(rle_decode((const uint8_t *) in, insize, w8, size) !=
+                    RETURN_SUCCESS)
+            {
+                return RETURN_FAILURE;
+            }
+            for(int b = 0; b < typesize; b++)
+            {
+                const uint8_t *wb = w8 + b * nelem;
+                for(long ii = 0; ii < nelem; ii++)
+                {
+                    out8[ii * typesize + b] = wb[ii] ^ ref8[ii * typesize + b];
+                }
+            }
+            return RETURN_SUCCESS;
+
+        case NETCODEC_SPARSE:
+        {
+            long entrysize = sizeof(uint32_t) + typesize;
+            if(insize % entrysize != 0)
+            {
+                return RETURN_FAILURE;
+            }
+            memcpy(out, ref, size);
+            for(long o = 0; o < insize; o += entrysize)
+            {
+                uint32_t index;
+                memcpy(&index, in + o, sizeof(uint32_t));
+                if(index >= nelem)
+                {
+                    return RETURN_FAILURE;
+                }
+                memcpy(out8 + (long) index * typesize,
+                       in + o + sizeof(uint32_t),
+                       typesize);
+            }
+            return RETURN_SUCCESS;
+        }
+    }
+
+    return RETURN_FAILURE;
+}
+
+const char *netcodec_name(int codec)
+{
+    switch(codec)
+    {
+        case NETCODEC_RAW:
+            return "RAW";
+        case NETCODEC_SHUFFLERLE:
+            return "SHUFFLERLE";
+        case NETCODEC_XORRLE:
+            return "XORRLE";
+        case NETCODEC_SPARSE:
+            return "SPARSE";
+    }
+    return "???";
+}
@@ -0,0 +1,35 @@
+/**
+ * @file    stream_netcodec.h
+ * @brief   frame encodings for network stream transfer
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_NETCODEC_H
+#define MILK_COREMOD_MEMORY_STREAM_NETCODEC_H
+
+// frame encodings
+#define NETCODEC_RAW        0 // pixel data as is
+#define NETCODEC_SHUFFLERLE 1 // byte shuffle + run-length
+#define NETCODEC_XORRLE     2 // XOR with previous frame + byte shuffle + run-length
+#define NETCODEC_SPARSE     3 // changed pixels (index, value) w.r.t. previous frame
+
+long netcodec_encode(int         codec,
+                     const char *in,
+                     const char *ref,
+                     long        nelem,
+                     int         typesize,
+                     char       *out,
+                     long        outmax,
+                     char       *work);
+
+errno_t netcodec_decode(int         codec,
+                        const char *in,
+                        long        insize,
+                        const char *ref,
+                        long        nelem,
+                        int         typesize,
+                        char       *out,
+                        char       *work);
+
+const char *netcodec_name(int codec);
+
+#endif // MILK_COREMOD_MEMORY_STREAM_NETCODEC_H
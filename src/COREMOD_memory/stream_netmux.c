@@ -0,0 +1,112 @@
+/**
+ * @file    stream_netmux.c
+ * @brief   multiplexed network transfer of several streams, socket I/O
+ *
+ * See stream_netmux_tx.c and stream_netmux_rx.c for the commands.
+ */
+
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "stream_netmux.h"
+
+// max iovec entries per sendmsg() / recvmsg() call, Linux UIO_MAXIOV
+#define NETMUX_IOVMAX 1024
+
+// skip fully transferred iovec entries, trim partially transferred one
+static int netmux_iov_advance(struct iovec **iov, int iovcnt, size_t nbyte)
+{
+    while((iovcnt > 0) && (nbyte >= (*iov)->iov_len))
+    {
+        nbyte -= (*iov)->iov_len;
+        (*iov)++;
+        iovcnt--;
+    }
+    if(iovcnt > 0)
+    {
+        (*iov)->iov_base = (char *)(*iov)->iov_base + nbyte;
+        (*iov)->iov_len -= nbyte;
+    }
+    return iovcnt;
+}
+
+/**
+ * @brief Send all of iov, retrying on partial send
+ *
+ * iov is modified.
+ *
+ * @return number of bytes sent, -1 on error
+ */
+long netmux_sendv(int fd, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg;
+    long          total = 0;
+
+    memset(&msg, 0, sizeof(msg));
+    while(iovcnt > 0)
+    {
+        // MSG_MORE lets the kernel coalesce records sent in successive calls
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = (iovcnt > NETMUX_IOVMAX) ? NETMUX_IOVMAX : iovcnt;
+        ssize_t rs = sendmsg(fd,
+                             &msg,
+                             MSG_NOSIGNAL |
+                             ((iovcnt > NETMUX_IOVMAX) ? MSG_MORE : 0));
+        if(rs < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        total += rs;
+        iovcnt = netmux_iov_advance(&iov, iovcnt, rs);
+    }
+    return total;
+}
+
+/**
+ * @brief Receive all of iov
+ *
+ * iov is modified.
+ * If idleok is set and the socket receive timeout expires before any byte
+ * is received, return 0 so that caller can service its loop.
+ *
+ * @return number of bytes received, -1 on error or connection closed
+ */
+long netmux_recvv(int fd, struct iovec *iov, int iovcnt, int idleok)
+{
+    struct msghdr msg;
+    long          total = 0;
+
+    memset(&msg, 0, sizeof(msg));
+    while(iovcnt > 0)
+    {
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = (iovcnt > NETMUX_IOVMAX) ? NETMUX_IOVMAX : iovcnt;
+        ssize_t rs     = recvmsg(fd, &msg, MSG_WAITALL);
+        if(rs < 0)
+        {
+            if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+            {
+                if((idleok == 1) && (total == 0))
+                {
+                    return 0;
+                }
+                continue;
+            }
+            return -1;
+        }
+        if(rs == 0)
+        {
+            // peer closed connection
+            return -1;
+        }
+        total += rs;
+        iovcnt = netmux_iov_advance(&iov, iovcnt, rs);
+    }
+    return total;
+}
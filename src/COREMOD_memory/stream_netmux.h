@@ -0,0 +1,42 @@
+/**
+ * @file    stream_netmux.h
+ * @brief   multiplexed network transfer of several streams
+ *
+ * Wire format, a sequence of records on a single TCP connection:
+ *
+ *   NETMUX_HEADER, followed by size bytes of payload
+ *
+ *   NETMUX_RECORD_METADATA : IMAGE_METADATA of stream streamID
+ *                            sent once, before first frame of stream
+ *   NETMUX_RECORD_FRAME    : slice cnt1 pixel data, then NBkw keywords
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_NETMUX_H
+#define MILK_COREMOD_MEMORY_STREAM_NETMUX_H
+
+#include <sys/uio.h>
+
+#define NETMUX_MAGIC 0x6D696C78
+
+// max number of streams on a link
+#define NETMUX_NBSTREAMMAX 256
+
+#define NETMUX_RECORD_METADATA 1
+#define NETMUX_RECORD_FRAME    2
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t streamID; // index in transmitter stream list
+    uint16_t type;     // NETMUX_RECORD_
+    uint32_t cnt1;     // slice index
+    uint32_t NBkw;
+    uint64_t cnt0;     // source stream cnt0
+    uint64_t size;     // payload size [byte]
+} NETMUX_HEADER;
+
+long netmux_sendv(int fd, struct iovec *iov, int iovcnt);
+
+long netmux_recvv(int fd, struct iovec *iov, int iovcnt, int idleok);
+
+#endif // MILK_COREMOD_MEMORY_STREAM_NETMUX_H
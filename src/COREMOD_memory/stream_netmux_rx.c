@@ -0,0 +1,386 @@
+/**
+ * @file    stream_netmux_rx.c
+ * @brief   receive several streams over a single TCP connection
+ *
+ * Receiver for imnetwmuxtx. Waits for the transmitter to connect, then
+ * demultiplexes records into local streams. A local stream is connected,
+ * or (re)created if its size, type or number of keywords differ, when
+ * the stream metadata record is received. Pixel data and keywords are
+ * received directly into the local stream.
+ *
+ * Local stream names are the transmitter stream names, prefixed by
+ * .prefix unless set to NULL.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "create_image.h"
+#include "delete_image.h"
+#include "read_shmim.h"
+
+#include "stream_netmux.h"
+
+static uint32_t *port;
+static long      fpi_port;
+
+static char *prefix;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_UINT32,
+        ".port",
+        "port",
+        "30100",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &port,
+        &fpi_port
+    },
+    {
+        CLIARG_STR,
+        ".prefix",
+        "local stream name prefix, NULL if none",
+        "NULL",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &prefix,
+        NULL
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "imnetwmuxrx", "receive streams over one TCP link", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Receive streams sent by imnetwmuxtx over a single TCP link\n");
+    printf("Streams are created on reception of their metadata\n");
+
+    return RETURN_SUCCESS;
+}
+
+typedef struct
+{
+    imageID  ID; // -1 until metadata received
+    long     framesize;
+    long     NBslices;
+    long     NBkw;
+    uint64_t cnt0;    // last received source cnt0
+    uint64_t nbframe;
+    uint64_t nbskip;  // source frames not received
+} NETMUX_RXSTREAM;
+
+/**
+ * @brief Connect to or create local stream matching received metadata
+ */
+static imageID netmux_rx_stream(IMAGE_METADATA *imgmd, const char *sname)
+{
+    imageID ID = image_ID(sname);
+    if(ID == -1)
+    {
+        ID = read_sharedmem_image(sname);
+    }
+
+    if(ID != -1)
+    {
+        IMAGE_METADATA *md = data.image[ID].md;
+
+        int OKim = 1;
+        if((md->naxis != imgmd->naxis) || (md->datatype != imgmd->datatype) ||
+                (md->NBkw != imgmd->NBkw))
+        {
+            OKim = 0;
+        }
+        for(int axis = 0; (OKim == 1) && (axis < imgmd->naxis); axis++)
+        {
+            if(md->size[axis] != imgmd->size[axis])
+            {
+                OKim = 0;
+            }
+        }
+
+        if(OKim == 0)
+        {
+            delete_image_ID(sname, DELETE_IMAGE_ERRMODE_WARNING);
+            ID = -1;
+        }
+    }
+
+    if(ID == -1)
+    {
+        printf("creating stream %s\n", sname);
+        if(create_image_ID(sname,
+                           imgmd->naxis,
+                           imgmd->size,
+                           imgmd->datatype,
+                           1,
+                           imgmd->NBkw,
+                           0,
+                           &ID) != RETURN_SUCCESS)
+        {
+            return -1;
+        }
+    }
+
+    return ID;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    // WAIT FOR TRANSMITTER
+    int fds_server = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(fds_server < 0)
+    {
+        FUNC_RETURN_FAILURE("cannot create socket");
+    }
+    {
+        int flag = 1;
+        setsockopt(fds_server,
+                   SOL_SOCKET,
+                   SO_REUSEADDR,
+                   (char *) &flag,
+                   sizeof(flag));
+    }
+
+    struct sockaddr_in sock_server;
+    memset(&sock_server, 0, sizeof(sock_server));
+    sock_server.sin_family      = AF_INET;
+    sock_server.sin_port        = htons(*port);
+    sock_server.sin_addr.s_addr = htonl(INADDR_ANY);
+    if((bind(fds_server, (struct sockaddr *) &sock_server, sizeof(sock_server)) <
+            0) ||
+            (listen(fds_server, 1) < 0))
+    {
+        close(fds_server);
+        FUNC_RETURN_FAILURE("cannot listen on port %u", *port);
+    }
+
+    printf("waiting for transmitter on port %u\n", *port);
+    int fd = accept(fds_server, NULL, NULL);
+    close(fds_server);
+    if(fd < 0)
+    {
+        FUNC_RETURN_FAILURE("accept error");
+    }
+    printf("transmitter connected\n");
+
+    {
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(int));
+
+        // wake up periodically to service processinfo
+        struct timeval tv;
+        tv.tv_sec  = 1;
+        tv.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof(tv));
+    }
+
+    NETMUX_RXSTREAM *rxs =
+        (NETMUX_RXSTREAM *) malloc(sizeof(NETMUX_RXSTREAM) * NETMUX_NBSTREAMMAX);
+    if(rxs == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    for(int sid = 0; sid < NETMUX_NBSTREAMMAX; sid++)
+    {
+        memset(&rxs[sid], 0, sizeof(NETMUX_RXSTREAM));
+        rxs[sid].ID = -1;
+    }
+    int NBstream = 0;
+
+    long long nbframe = 0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    // loop paced by incoming records
+    if(processinfo != NULL)
+    {
+        processinfo_waitoninputstream_init(processinfo,
+                                           -1,
+                                           PROCESSINFO_TRIGGERMODE_IMMEDIATE,
+                                           -1);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        NETMUX_HEADER hdr;
+        struct iovec  iov[2];
+        long          recvsize;
+
+        iov[0].iov_base = &hdr;
+        iov[0].iov_len  = sizeof(NETMUX_HEADER);
+        recvsize        = netmux_recvv(fd, iov, 1, 1);
+        if(recvsize < 0)
+        {
+            printf("connection closed\n");
+            processloopOK = 0;
+        }
+        else if(recvsize > 0)
+        {
+            int sid = hdr.streamID;
+
+            if((hdr.magic != NETMUX_MAGIC) || (sid >= NETMUX_NBSTREAMMAX))
+            {
+                PRINT_ERROR("invalid record header, stream %d", sid);
+                processloopOK = 0;
+            }
+            else if(hdr.type == NETMUX_RECORD_METADATA)
+            {
+                IMAGE_METADATA imgmd;
+                char           sname[STRINGMAXLEN_IMAGE_NAME];
+
+                iov[0].iov_base = &imgmd;
+                iov[0].iov_len  = sizeof(IMAGE_METADATA);
+                if((hdr.size != sizeof(IMAGE_METADATA)) ||
+                        (netmux_recvv(fd, iov, 1, 0) < 0))
+                {
+                    PRINT_ERROR("stream %d metadata receive error", sid);
+                    processloopOK = 0;
+                }
+                else
+                {
+                    imgmd.name[STRINGMAXLEN_IMAGE_NAME - 1] = '\0';
+                    if(strcmp(prefix, "NULL") == 0)
+                    {
+                        strcpy(sname, imgmd.name);
+                    }
+                    else
+                    {
+                        snprintf(sname,
+                                 STRINGMAXLEN_IMAGE_NAME,
+                                 "%s%s",
+                                 prefix,
+                                 imgmd.name);
+                    }
+
+                    if(rxs[sid].ID == -1)
+                    {
+                        NBstream++;
+                    }
+                    memset(&rxs[sid], 0, sizeof(NETMUX_RXSTREAM));
+                    rxs[sid].ID = netmux_rx_stream(&imgmd, sname);
+                    if(rxs[sid].ID == -1)
+                    {
+                        PRINT_ERROR("cannot create stream %s", sname);
+                        processloopOK = 0;
+                    }
+                    else
+                    {
+                        IMAGE_METADATA *md = data.image[rxs[sid].ID].md;
+
+                        rxs[sid].framesize =
+                            ImageStreamIO_typesize(md->datatype) * md->size[0];
+                        if(md->naxis > 1)
+                        {
+                            rxs[sid].framesize *= md->size[1];
+                        }
+                        rxs[sid].NBslices = 1;
+                        if((md->naxis > 2) && (md->size[2] > 1))
+                        {
+                            rxs[sid].NBslices = md->size[2];
+                        }
+                        rxs[sid].NBkw = md->NBkw;
+                        rxs[sid].cnt0 = imgmd.cnt0;
+
+                        printf("stream %3d  -> %-32s  %ld x %ld byte\n",
+                               sid,
+                               sname,
+                               rxs[sid].NBslices,
+                               rxs[sid].framesize);
+                    }
+                }
+            }
+            else if(hdr.type == NETMUX_RECORD_FRAME)
+            {
+                NETMUX_RXSTREAM *rx = &rxs[sid];
+
+                if((rx->ID == -1) || (hdr.cnt1 >= rx->NBslices) ||
+                        (hdr.NBkw != rx->NBkw) ||
+                        (hdr.size != (uint64_t)(rx->framesize +
+                                                rx->NBkw * sizeof(IMAGE_KEYWORD))))
+                {
+                    PRINT_ERROR("stream %d frame does not match metadata", sid);
+                    processloopOK = 0;
+                }
+                else
+                {
+                    IMAGE *img = &data.image[rx->ID];
+
+                    img->md->write = 1;
+                    iov[0].iov_base =
+                        (char *) img->array.raw + hdr.cnt1 * rx->framesize;
+                    iov[0].iov_len  = rx->framesize;
+                    iov[1].iov_base = img->kw;
+                    iov[1].iov_len  = rx->NBkw * sizeof(IMAGE_KEYWORD);
+                    if(netmux_recvv(fd, iov, (rx->NBkw > 0) ? 2 : 1, 0) < 0)
+                    {
+                        PRINT_ERROR("stream %d frame receive error", sid);
+                        processloopOK = 0;
+                    }
+                    else
+                    {
+                        if((rx->nbframe > 0) && (hdr.cnt0 > rx->cnt0 + 1))
+                        {
+                            rx->nbskip += hdr.cnt0 - rx->cnt0 - 1;
+                        }
+                        rx->cnt0 = hdr.cnt0;
+                        rx->nbframe++;
+                        nbframe++;
+
+                        img->md->cnt1 = hdr.cnt1;
+                        processinfo_update_output_stream(processinfo, rx->ID);
+                    }
+                }
+            }
+            else
+            {
+                PRINT_ERROR("unknown record type %d", (int) hdr.type);
+                processloopOK = 0;
+            }
+        }
+
+        if((processinfo != NULL) && (processinfo->loopcnt % 1000 == 0))
+        {
+            uint64_t nbskip = 0;
+            for(int sid = 0; sid < NETMUX_NBSTREAMMAX; sid++)
+            {
+                nbskip += rxs[sid].nbskip;
+            }
+
+            char msgstring[STRINGMAXLEN_PROCESSINFO_STATUSMSG];
+            snprintf(msgstring,
+                     STRINGMAXLEN_PROCESSINFO_STATUSMSG,
+                     "%d streams %lld frames %lu skipped at source",
+                     NBstream,
+                     nbframe,
+                     (unsigned long) nbskip);
+            processinfo_WriteMessage(processinfo, msgstring);
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    close(fd);
+    free(rxs);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_netmux_rx()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,10 @@
+/**
+ * @file    stream_netmux_rx.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_NETMUX_RX_H
+#define MILK_COREMOD_MEMORY_STREAM_NETMUX_RX_H
+
+errno_t CLIADDCMD_COREMOD_memory__stream_netmux_rx();
+
+#endif // MILK_COREMOD_MEMORY_STREAM_NETMUX_RX_H
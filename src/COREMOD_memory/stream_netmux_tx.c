@@ -0,0 +1,438 @@
+/**
+ * @file    stream_netmux_tx.c
+ * @brief   transmit several streams over a single TCP connection
+ *
+ * Replaces one imnetwtransmit process per stream: all streams in the list
+ * share one connection, one process and one processinfo entry. Receiver
+ * is imnetwmuxrx.
+ *
+ * Each loop iteration scans the streams and sends the current slice of
+ * those that have been updated since last sent, all in a single sendmsg().
+ * The loop is triggered by any input update if all streams exist at
+ * startup and there are at most PROCESSINFO_TRIGGER_NBSTREAMMAX of them,
+ * otherwise it polls every .pollus microsecond.
+ *
+ * Streams that do not exist yet are looked for once per second, and their
+ * metadata is sent to the receiver when found.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "stream_netmux.h"
+
+static char *snamelist;
+
+static char *IPaddr;
+
+static uint32_t *port;
+static long      fpi_port;
+
+static uint32_t *pollus;
+static long      fpi_pollus;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STR,
+        ".snamelist",
+        "streams, space or comma separated",
+        "im1 im2",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &snamelist,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".IPaddr",
+        "receiver IP address",
+        "127.0.0.1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &IPaddr,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".port",
+        "receiver port",
+        "30100",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &port,
+        &fpi_port
+    },
+    {
+        CLIARG_UINT32,
+        ".pollus",
+        "polling interval [us], if not triggered",
+        "100",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &pollus,
+        &fpi_pollus
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "imnetwmuxtx", "transmit streams over one TCP link", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Transmit updates of several streams over a single TCP link\n");
+    printf("Streams are listed in .snamelist, space or comma separated\n");
+    printf("Receiver: imnetwmuxrx\n");
+
+    return RETURN_SUCCESS;
+}
+
+typedef struct
+{
+    char     sname[STRINGMAXLEN_IMAGE_NAME];
+    IMGID    img;
+    int      active;   // 1 if connected, metadata sent
+    long     framesize;
+    long     NBslices;
+    uint64_t cnt0sent;
+} NETMUX_TXSTREAM;
+
+// stream names in list are separated by spaces and/or commas
+static int netmux_parse_list(const char *list, NETMUX_TXSTREAM *txs)
+{
+    int NBstream = 0;
+
+    const char *s = list;
+    while(*s != '\0')
+    {
+        while((*s == ' ') || (*s == ','))
+        {
+            s++;
+        }
+        if(*s == '\0')
+        {
+            break;
+        }
+
+        char entry[STRINGMAXLEN_IMAGE_NAME];
+        int  l = 0;
+        while((*s != '\0') && (*s != ' ') && (*s != ','))
+        {
+            if(l < STRINGMAXLEN_IMAGE_NAME - 1)
+            {
+                entry[l] = *s;
+                l++;
+            }
+            s++;
+        }
+        entry[l] = '\0';
+
+        if(NBstream == NETMUX_NBSTREAMMAX)
+        {
+            PRINT_WARNING("more than %d streams, ignoring %s",
+                          NETMUX_NBSTREAMMAX,
+                          entry);
+            continue;
+        }
+        memset(&txs[NBstream], 0, sizeof(NETMUX_TXSTREAM));
+        strcpy(txs[NBstream].sname, entry);
+        NBstream++;
+    }
+
+    return NBstream;
+}
+
+/**
+ * @brief Connect to stream, send its metadata
+ *
+ * @return 0 if stream does not exist (yet), 1 if connected, -1 on error
+ */
+static int netmux_tx_activate(int fd, NETMUX_TXSTREAM *txs, int streamID)
+{
+    if(image_ID(txs->sname) == -1)
+    {
+        if(read_sharedmem_image(txs->sname) == -1)
+        {
+            return 0;
+        }
+    }
+    txs->img = stream_connect(txs->sname);
+    if(txs->img.ID == -1)
+    {
+        return 0;
+    }
+
+    IMAGE_METADATA *md = txs->img.md;
+
+    txs->framesize = ImageStreamIO_typesize(md->datatype) * md->size[0];
+    if(md->naxis > 1)
+    {
+        txs->framesize *= md->size[1];
+    }
+    txs->NBslices = 1;
+    if((md->naxis > 2) && (md->size[2] > 1))
+    {
+        txs->NBslices = md->size[2];
+    }
+    // current content is sent on next scan
+    txs->cnt0sent = md->cnt0 - 1;
+
+    NETMUX_HEADER hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic    = NETMUX_MAGIC;
+    hdr.streamID = streamID;
+    hdr.type     = NETMUX_RECORD_METADATA;
+    hdr.NBkw     = md->NBkw;
+    hdr.size     = sizeof(IMAGE_METADATA);
+
+    struct iovec iov[2];
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len  = sizeof(NETMUX_HEADER);
+    iov[1].iov_base = md;
+    iov[1].iov_len  = sizeof(IMAGE_METADATA);
+    if(netmux_sendv(fd, iov, 2) < 0)
+    {
+        return -1;
+    }
+
+    txs->active = 1;
+    printf("stream %3d  %-32s  %ld x %ld byte\n",
+           streamID,
+           txs->sname,
+           txs->NBslices,
+           txs->framesize);
+
+    return 1;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    NETMUX_TXSTREAM *txs =
+        (NETMUX_TXSTREAM *) malloc(sizeof(NETMUX_TXSTREAM) * NETMUX_NBSTREAMMAX);
+    if(txs == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    int NBstream = netmux_parse_list(snamelist, txs);
+    if(NBstream == 0)
+    {
+        free(txs);
+        FUNC_RETURN_FAILURE("no stream in list \"%s\"", snamelist);
+    }
+
+    // CONNECT TO RECEIVER
+    int fd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(fd < 0)
+    {
+        free(txs);
+        FUNC_RETURN_FAILURE("cannot create socket");
+    }
+    {
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(int));
+    }
+
+    struct sockaddr_in sock_server;
+    memset(&sock_server, 0, sizeof(sock_server));
+    sock_server.sin_family      = AF_INET;
+    sock_server.sin_port        = htons(*port);
+    sock_server.sin_addr.s_addr = inet_addr(IPaddr);
+    if(connect(fd, (struct sockaddr *) &sock_server, sizeof(sock_server)) < 0)
+    {
+        perror("connect");
+        close(fd);
+        free(txs);
+        FUNC_RETURN_FAILURE("cannot connect to %s port %u", IPaddr, *port);
+    }
+
+    int     NBactive = 0;
+    imageID trigIDarray[PROCESSINFO_TRIGGER_NBSTREAMMAX];
+    for(int sid = 0; sid < NBstream; sid++)
+    {
+        int ret = netmux_tx_activate(fd, &txs[sid], sid);
+        if(ret == -1)
+        {
+            close(fd);
+            free(txs);
+            FUNC_RETURN_FAILURE("send error");
+        }
+        if(ret == 0)
+        {
+            printf("stream %3d  %-32s  not found, will retry\n",
+                   sid,
+                   txs[sid].sname);
+        }
+        else
+        {
+            if(NBactive < PROCESSINFO_TRIGGER_NBSTREAMMAX)
+            {
+                trigIDarray[NBactive] = txs[sid].img.ID;
+            }
+            NBactive++;
+        }
+    }
+
+    // one iovec per header, slice and keywords
+    NETMUX_HEADER *hdr =
+        (NETMUX_HEADER *) malloc(sizeof(NETMUX_HEADER) * NBstream);
+    struct iovec *iov =
+        (struct iovec *) malloc(sizeof(struct iovec) * 3 * NBstream);
+    if((hdr == NULL) || (iov == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    struct timespec tretry;
+    clock_gettime(CLOCK_MILK, &tretry);
+
+    long long nbframesent = 0;
+    long long nbbytesent  = 0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    if(processinfo == NULL)
+    {
+        // single pass, no trigger
+    }
+    else if((NBactive == NBstream) &&
+            (NBstream <= PROCESSINFO_TRIGGER_NBSTREAMMAX))
+    {
+        FUNC_CHECK_RETURN(
+            processinfo_waitoninputstream_init_multi(processinfo,
+                    trigIDarray,
+                    NBstream,
+                    PROCESSINFO_TRIGGERMODE_ANY));
+    }
+    else
+    {
+        PROCINFO_TRIGGER_DELAYUS(*pollus);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        // look for missing streams
+        if(NBactive < NBstream)
+        {
+            struct timespec tnow;
+            clock_gettime(CLOCK_MILK, &tnow);
+            if(tnow.tv_sec > tretry.tv_sec)
+            {
+                tretry = tnow;
+                for(int sid = 0; sid < NBstream; sid++)
+                {
+                    if(txs[sid].active == 0)
+                    {
+                        int ret = netmux_tx_activate(fd, &txs[sid], sid);
+                        if(ret == -1)
+                        {
+                            PRINT_ERROR("send error");
+                            processloopOK = 0;
+                            break;
+                        }
+                        NBactive += ret;
+                    }
+                }
+            }
+        }
+
+        // gather updated streams
+        int iovcnt = 0;
+        int nbsend = 0;
+        for(int sid = 0; sid < NBstream; sid++)
+        {
+            if(txs[sid].active == 0)
+            {
+                continue;
+            }
+            IMAGE_METADATA *md   = txs[sid].img.md;
+            uint64_t        cnt0 = md->cnt0;
+            if(cnt0 == txs[sid].cnt0sent)
+            {
+                continue;
+            }
+
+            long slice = md->cnt1;
+            if((slice < 0) || (slice >= txs[sid].NBslices))
+            {
+                slice = 0;
+            }
+            long kwsize = md->NBkw * sizeof(IMAGE_KEYWORD);
+
+            hdr[nbsend].magic    = NETMUX_MAGIC;
+            hdr[nbsend].streamID = sid;
+            hdr[nbsend].type     = NETMUX_RECORD_FRAME;
+            hdr[nbsend].cnt1     = slice;
+            hdr[nbsend].NBkw     = md->NBkw;
+            hdr[nbsend].cnt0     = cnt0;
+            hdr[nbsend].size     = txs[sid].framesize + kwsize;
+
+            iov[iovcnt].iov_base = &hdr[nbsend];
+            iov[iovcnt].iov_len  = sizeof(NETMUX_HEADER);
+            iovcnt++;
+            iov[iovcnt].iov_base =
+                (char *) txs[sid].img.im->array.raw + slice * txs[sid].framesize;
+            iov[iovcnt].iov_len = txs[sid].framesize;
+            iovcnt++;
+            if(kwsize > 0)
+            {
+                iov[iovcnt].iov_base = txs[sid].img.im->kw;
+                iov[iovcnt].iov_len  = kwsize;
+                iovcnt++;
+            }
+
+            txs[sid].cnt0sent = cnt0;
+            nbbytesent += sizeof(NETMUX_HEADER) + hdr[nbsend].size;
+            nbsend++;
+        }
+
+        if(nbsend > 0)
+        {
+            if(netmux_sendv(fd, iov, iovcnt) < 0)
+            {
+                PRINT_ERROR("send error");
+                processloopOK = 0;
+            }
+            nbframesent += nbsend;
+        }
+
+        if((processinfo != NULL) && (processinfo->loopcnt % 1000 == 0))
+        {
+            char msgstring[STRINGMAXLEN_PROCESSINFO_STATUSMSG];
+            snprintf(msgstring,
+                     STRINGMAXLEN_PROCESSINFO_STATUSMSG,
+                     "%d/%d streams %lld frames %.1f MB",
+                     NBactive,
+                     NBstream,
+                     nbframesent,
+                     1.0e-6 * nbbytesent);
+            processinfo_WriteMessage(processinfo, msgstring);
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    close(fd);
+    free(hdr);
+    free(iov);
+    free(txs);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_netmux_tx()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
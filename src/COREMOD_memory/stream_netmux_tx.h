@@ -0,0 +1,10 @@
+/**
+ * @file    stream_netmux_tx.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_NETMUX_TX_H
+#define MILK_COREMOD_MEMORY_STREAM_NETMUX_TX_H
+
+errno_t CLIADDCMD_COREMOD_memory__stream_netmux_tx();
+
+#endif // MILK_COREMOD_MEMORY_STREAM_NETMUX_TX_H
@@ -1,12 +1,15 @@
 /**
  * @file stream_paste.c
  * @brief Paste two equal size 2D streams into an output 2D stream
+ *
+ * See stream_tile.c for N inputs
 */
 
 #include "CommandLineInterface/CLIcore.h"
 #include "create_image.h"
 #include "image_ID.h"
 #include "stream_sem.h"
+#include "stream_tile.h"
 
 // ==========================================
 // Forward declarations
@@ -80,12 +83,10 @@ imageID COREMOD_MEMORY_streamPaste(const char *IDstream0_name,
     imageID            ID0;
     imageID            ID1;
     imageID            IDout;
-    imageID            IDin;
-    long               Xoffset;
     uint32_t           xsize;
     uint32_t           ysize;
     uint32_t          *arraysize;
-    unsigned long long cnt;
+    unsigned long long cnt = 0;
     uint8_t            datatype;
     int                FrameIndex;
 
@@ -119,6 +120,19 @@ imageID COREMOD_MEMORY_streamPaste(const char *IDstream0_name,
     }
     free(arraysize);
 
+    // stream0 and stream1 rows copied into left and right halves
+    IMGID       imgout = makesetIMGID(IDstreamout_name, IDout);
+    STREAM_TILE tile[2];
+    memset(tile, 0, sizeof(STREAM_TILE) * 2);
+    tile[0].img   = makesetIMGID(IDstream0_name, ID0);
+    tile[1].img   = makesetIMGID(IDstream1_name, ID1);
+    tile[1].xout  = xsize;
+    for(int t = 0; t < 2; t++)
+    {
+        tile[t].xsize = xsize;
+        tile[t].ysize = ysize;
+    }
+
     FrameIndex = 0;
 
     while(1)
@@ -139,8 +153,6 @@ imageID COREMOD_MEMORY_streamPaste(const char *IDstream0_name,
             {
                 sem_wait(data.image[ID0].semptr[semtrig0]);
             }
-            Xoffset = 0;
-            IDin    = 0;
         }
         else
         {
@@ -158,133 +170,16 @@ imageID COREMOD_MEMORY_streamPaste(const char *IDstream0_name,
             {
                 sem_wait(data.image[ID1].semptr[semtrig1]);
             }
-            Xoffset = xsize;
-            IDin    = 1;
         }
 
         data.image[IDout].md[0].write = 1;
 
-        switch(datatype)
+        if(ImageStreamIO_typesize(datatype) < 1)
         {
-            case _DATATYPE_UINT8:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout].array.UI8[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.UI8[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_UINT16:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout]
-                        .array.UI16[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.UI16[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_UINT32:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout]
-                        .array.UI32[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.UI32[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_UINT64:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout]
-                        .array.UI64[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.UI64[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_INT8:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout].array.SI8[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.SI8[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_INT16:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout]
-                        .array.SI16[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.SI16[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_INT32:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout]
-                        .array.SI32[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.SI32[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_INT64:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout]
-                        .array.SI64[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.SI64[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_FLOAT:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout].array.F[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.F[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_DOUBLE:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout].array.D[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.D[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_COMPLEX_FLOAT:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout].array.CF[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.CF[jj * xsize + ii];
-                    }
-                break;
-
-            case _DATATYPE_COMPLEX_DOUBLE:
-                for(uint32_t ii = 0; ii < xsize; ii++)
-                    for(uint32_t jj = 0; jj < ysize; jj++)
-                    {
-                        data.image[IDout].array.CD[jj * 2 * xsize + ii + Xoffset] =
-                            data.image[IDin].array.CD[jj * xsize + ii];
-                    }
-                break;
-
-            default:
-                printf("Unknown data type\n");
-                exit(0);
-                break;
+            printf("Unknown data type\n");
+            exit(0);
         }
+        stream_tile_copy(&imgout, &tile[FrameIndex], 1);
         if(FrameIndex == master)
         {
             COREMOD_MEMORY_image_set_sempost_byID(IDout, -1);
@@ -0,0 +1,513 @@
+/**
+ * @file    stream_proctrace.c
+ * @brief   pipeline latency from stream processing traces
+ *
+ * processinfo_update_output_stream() copies the trigger input stream
+ * streamproctrace entries to the output stream, shifted by one, and writes
+ * its own entry at index 0. The trace of a sink stream therefore lists the
+ * processing chain back to the source:
+ *
+ *   entry k : process k hops upstream of sink
+ *             ts_procstart    : process start
+ *             ts_streamupdate : process output stream update
+ *
+ * Hop k is triggered by the stream update recorded in entry k+1, so
+ * that for each sink frame we get, per hop:
+ *
+ *   wake  = ts_procstart[k]    - ts_streamupdate[k+1]
+ *   exec  = ts_streamupdate[k] - ts_procstart[k]
+ *   hop   = ts_streamupdate[k] - ts_streamupdate[k+1]
+ *   cumul = ts_streamupdate[k] - ts_streamupdate[source]
+ *
+ * where source is the deepest valid trace entry.
+ *
+ * Distributions are collected over a sampling window of sink frames and
+ * reported as a table (stdout and file) and as an image of size
+ * [NBstat, NBhop, NBmetric], in microseconds, which can be saved to FITS.
+ */
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "create_image.h"
+
+#include "COREMOD_tools/COREMOD_tools.h"
+
+// metrics
+#define PROCTRACE_WAKE     0
+#define PROCTRACE_EXEC     1
+#define PROCTRACE_HOP      2
+#define PROCTRACE_CUMUL    3
+#define PROCTRACE_NBMETRIC 4
+
+// statistics
+#define PROCTRACE_STAT_MEAN  0
+#define PROCTRACE_STAT_P50   1
+#define PROCTRACE_STAT_P99   2
+#define PROCTRACE_STAT_P999  3
+#define PROCTRACE_STAT_MAX   4
+#define PROCTRACE_NBSTAT     5
+
+static const char *proctrace_metricname[PROCTRACE_NBMETRIC] =
+{
+    "wake", "exec", "hop", "cumul"
+};
+
+static char *insname;
+
+static uint32_t *NBsample;
+static long      fpi_NBsample = -1;
+
+static char *outfname;
+
+static char *outimname;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STREAM,
+        ".insname",
+        "sink stream",
+        "im1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &insname,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".NBsample",
+        "number of sink frames sampled",
+        "1000",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &NBsample,
+        &fpi_NBsample
+    },
+    {
+        CLIARG_STR,
+        ".outfname",
+        "output table file, NULL if none",
+        "proctrace.txt",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outfname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outimname",
+        "output statistics image",
+        "proctrace",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    }
+};
+
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
+    {
+        // at least one sample
+        if(data.fpsptr->parray[fpi_NBsample].val.ui32[0] < 1)
+        {
+            data.fpsptr->parray[fpi_NBsample].val.ui32[0] = 1;
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamtrace", "pipeline latency from stream proc traces",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Follow streamproctrace of sink stream back to source\n");
+    printf("and measure per-hop latency distributions:\n");
+    printf("  wake  : trigger input update -> process start\n");
+    printf("  exec  : process start        -> output update\n");
+    printf("  hop   : trigger input update -> output update\n");
+    printf("  cumul : source update        -> output update\n");
+    printf("Output image [stat, hop, metric] in us, with\n");
+    printf("  stat   = mean, p50, p99, p99.9, max\n");
+    printf("  metric = wake, exec, hop, cumul\n");
+    printf("  hop 0 is closest to source\n");
+
+    return RETURN_SUCCESS;
+}
+
+static inline int proctrace_entry_valid(STREAM_PROC_TRACE *spt)
+{
+    return ((spt->procwrite_PID != 0) && (spt->ts_streamupdate.tv_sec != 0));
+}
+
+static inline long proctrace_dtns(struct timespec t0, struct timespec t1)
+{
+    return (long)(t1.tv_sec - t0.tv_sec) * 1000000000L +
+           (t1.tv_nsec - t0.tv_nsec);
+}
+
+/**
+ * @brief Find stream name from inode in shared memory directory
+ *
+ * Writes "???" if not found
+ */
+static errno_t proctrace_inode_sname(ino_t inode, char *sname)
+{
+    strcpy(sname, "???");
+
+    DIR *d = opendir(data.shmdir);
+    if(d == NULL)
+    {
+        return RETURN_FAILURE;
+    }
+
+    struct dirent *dir;
+    while((dir = readdir(d)) != NULL)
+    {
+        char *pch = strstr(dir->d_name, ".im.shm");
+        if(pch == NULL)
+        {
+            continue;
+        }
+
+        char        fullname[STRINGMAXLEN_FULLFILENAME];
+        struct stat buf;
+        WRITE_FULLFILENAME(fullname, "%s/%s", data.shmdir, dir->d_name);
+        if(lstat(fullname, &buf) == -1)
+        {
+            continue;
+        }
+        if(S_ISREG(buf.st_mode) && (buf.st_ino == inode))
+        {
+            int slen = (int)(pch - dir->d_name);
+            if(slen > STRINGMAXLEN_IMAGE_NAME - 1)
+            {
+                slen = STRINGMAXLEN_IMAGE_NAME - 1;
+            }
+            strncpy(sname, dir->d_name, slen);
+            sname[slen] = '\0';
+            break;
+        }
+    }
+    closedir(d);
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Sample sink stream traces and compute latency statistics
+ */
+static errno_t stream_proctrace(IMGID img, uint32_t NBsamp)
+{
+    DEBUG_TRACE_FSTART();
+
+    int NBspt = img.md->NBproctrace;
+    if(NBspt < 2)
+    {
+        FUNC_RETURN_FAILURE("stream %s has %d proctrace entries",
+                            img.name,
+                            NBspt);
+    }
+    int NBhopmax = NBspt - 1;
+
+    STREAM_PROC_TRACE *spt =
+        (STREAM_PROC_TRACE *) malloc(sizeof(STREAM_PROC_TRACE) * NBspt);
+    // latency samples [metric][hop][sample], ns
+    long *dtarray =
+        (long *) malloc(sizeof(long) * PROCTRACE_NBMETRIC * NBhopmax * NBsamp);
+    // number of samples [metric][hop]
+    uint32_t *cntarray =
+        (uint32_t *) calloc(PROCTRACE_NBMETRIC * NBhopmax, sizeof(uint32_t));
+    if((spt == NULL) || (dtarray == NULL) || (cntarray == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    // trigger inode and PID of each hop, from last valid sample
+    ino_t *hopinode = (ino_t *) calloc(NBspt, sizeof(ino_t));
+    pid_t *hoppid   = (pid_t *) calloc(NBspt, sizeof(pid_t));
+    if((hopinode == NULL) || (hoppid == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    int semindex = ImageStreamIO_getsemwaitindex(&data.image[img.ID], -1);
+    if(semindex == -1)
+    {
+        PRINT_WARNING("no semaphore available on %s, polling cnt0", img.name);
+    }
+
+    // number of hops = deepest valid entry
+    int      NBhop      = 0;
+    uint32_t samplecnt  = 0;
+    int      timeoutcnt = 0;
+    uint64_t cnt0last   = img.md->cnt0;
+
+    printf("Sampling %u frames of %s\n", NBsamp, img.name);
+    while((samplecnt < NBsamp) && (timeoutcnt < 5))
+    {
+        // wait for sink update
+        if(semindex > -1)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MILK, &ts);
+            ts.tv_sec += 1;
+            if(ImageStreamIO_semtimedwait(&data.image[img.ID],
+                                          semindex,
+                                          &ts) != 0)
+            {
+                timeoutcnt++;
+                continue;
+            }
+        }
+        else
+        {
+            int polltimeus = 0;
+            while((img.md->cnt0 == cnt0last) && (polltimeus < 1000000))
+            {
+                usleep(10);
+                polltimeus += 10;
+            }
+        }
+
+        uint64_t cnt0 = img.md->cnt0;
+        if(cnt0 == cnt0last)
+        {
+            timeoutcnt++;
+            continue;
+        }
+        timeoutcnt = 0;
+
+        // copy trace, discard if stream updated during copy
+        memcpy(spt,
+               data.image[img.ID].streamproctrace,
+               sizeof(STREAM_PROC_TRACE) * NBspt);
+        cnt0last = img.md->cnt0;
+        if(cnt0last != cnt0)
+        {
+            continue;
+        }
+
+        int kdeep = -1;
+        while((kdeep < NBspt - 1) && proctrace_entry_valid(&spt[kdeep + 1]))
+        {
+            kdeep++;
+        }
+        if(kdeep < 1)
+        {
+            // at least two entries needed for one hop
+            continue;
+        }
+        if(kdeep > NBhop)
+        {
+            NBhop = kdeep;
+        }
+
+        // hop k, triggered by entry k+1
+        for(int k = 0; k < kdeep; k++)
+        {
+            long dt[PROCTRACE_NBMETRIC];
+
+            dt[PROCTRACE_WAKE] = proctrace_dtns(spt[k + 1].ts_streamupdate,
+                                                spt[k].ts_procstart);
+            dt[PROCTRACE_EXEC] =
+                proctrace_dtns(spt[k].ts_procstart, spt[k].ts_streamupdate);
+            dt[PROCTRACE_HOP] = proctrace_dtns(spt[k + 1].ts_streamupdate,
+                                               spt[k].ts_streamupdate);
+            dt[PROCTRACE_CUMUL] = proctrace_dtns(spt[kdeep].ts_streamupdate,
+                                                 spt[k].ts_streamupdate);
+
+            // hop index counted from source
+            int hop = kdeep - 1 - k;
+            for(int m = 0; m < PROCTRACE_NBMETRIC; m++)
+            {
+                long ii = (long) m * NBhopmax + hop;
+                dtarray[ii * NBsamp + cntarray[ii]] = dt[m];
+                cntarray[ii]++;
+            }
+            hopinode[hop] = spt[k].trigger_inode;
+            hoppid[hop]   = spt[k].procwrite_PID;
+        }
+        samplecnt++;
+    }
+
+    if(timeoutcnt > 0)
+    {
+        PRINT_WARNING("sink stream %s not updating, %u samples collected",
+                      img.name,
+                      samplecnt);
+    }
+
+    // statistics image [stat, hop, metric]
+    imageID IDout = -1;
+    if(NBhop > 0)
+    {
+        FUNC_CHECK_RETURN(create_3Dimage_ID_float(outimname,
+                          PROCTRACE_NBSTAT,
+                          NBhop,
+                          PROCTRACE_NBMETRIC,
+                          &IDout));
+    }
+
+    for(int m = 0; m < PROCTRACE_NBMETRIC; m++)
+    {
+        for(int hop = 0; hop < NBhop; hop++)
+        {
+            long  ii  = (long) m * NBhopmax + hop;
+            long *dtv = &dtarray[ii * NBsamp];
+            long  n   = cntarray[ii];
+
+            float stat[PROCTRACE_NBSTAT] = {0};
+            if(n > 0)
+            {
+                double sum = 0.0;
+                for(long i = 0; i < n; i++)
+                {
+                    sum += dtv[i];
+                }
+                quick_sort_long(dtv, n);
+                stat[PROCTRACE_STAT_MEAN] = 0.001 * sum / n;
+                stat[PROCTRACE_STAT_P50]  = 0.001 * dtv[(long)(0.5 * (n - 1))];
+                stat[PROCTRACE_STAT_P99]  = 0.001 * dtv[(long)(0.99 * (n - 1))];
+                stat[PROCTRACE_STAT_P999] =
+                    0.001 * dtv[(long)(0.999 * (n - 1))];
+                stat[PROCTRACE_STAT_MAX] = 0.001 * dtv[n - 1];
+            }
+            for(int s = 0; s < PROCTRACE_NBSTAT; s++)
+            {
+                data.image[IDout]
+                .array.F[((long) m * NBhop + hop) * PROCTRACE_NBSTAT + s] =
+                    stat[s];
+            }
+        }
+    }
+
+    // table
+    FILE *fpout = NULL;
+    if(strcmp(outfname, "NULL") != 0)
+    {
+        fpout = fopen(outfname, "w");
+        if(fpout == NULL)
+        {
+            PRINT_WARNING("cannot write file %s", outfname);
+        }
+        else
+        {
+            fprintf(fpout, "# stream proc trace of %s\n", img.name);
+            fprintf(fpout, "# %u samples\n", samplecnt);
+            fprintf(fpout,
+                    "# hop  PID  trigger-stream  metric  cnt  mean  p50  p99  "
+                    "p99.9  max [us]\n");
+        }
+    }
+
+    printf("\n%u samples, %d hops (source -> %s)\n",
+           samplecnt,
+           NBhop,
+           img.name);
+    printf("%3s %8s %-20s %-6s %9s %9s %9s %9s %9s  [us]\n",
+           "hop",
+           "PID",
+           "trigger",
+           "metric",
+           "mean",
+           "p50",
+           "p99",
+           "p99.9",
+           "max");
+    for(int hop = 0; hop < NBhop; hop++)
+    {
+        char sname[STRINGMAXLEN_IMAGE_NAME];
+        proctrace_inode_sname(hopinode[hop], sname);
+
+        for(int m = 0; m < PROCTRACE_NBMETRIC; m++)
+        {
+            float *stat = &data.image[IDout].array.F[((long) m * NBhop + hop) *
+                                                     PROCTRACE_NBSTAT];
+            printf("%3d %8d %-20s %-6s %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                   hop,
+                   (int) hoppid[hop],
+                   sname,
+                   proctrace_metricname[m],
+                   stat[PROCTRACE_STAT_MEAN],
+                   stat[PROCTRACE_STAT_P50],
+                   stat[PROCTRACE_STAT_P99],
+                   stat[PROCTRACE_STAT_P999],
+                   stat[PROCTRACE_STAT_MAX]);
+            if(fpout != NULL)
+            {
+                fprintf(fpout,
+                        "%3d %8d %-20s %-6s %6u %9.3f %9.3f %9.3f %9.3f "
+                        "%9.3f\n",
+                        hop,
+                        (int) hoppid[hop],
+                        sname,
+                        proctrace_metricname[m],
+                        cntarray[(long) m * NBhopmax + hop],
+                        stat[PROCTRACE_STAT_MEAN],
+                        stat[PROCTRACE_STAT_P50],
+                        stat[PROCTRACE_STAT_P99],
+                        stat[PROCTRACE_STAT_P999],
+                        stat[PROCTRACE_STAT_MAX]);
+            }
+        }
+    }
+
+    if(fpout != NULL)
+    {
+        fclose(fpout);
+    }
+
+    free(spt);
+    free(dtarray);
+    free(cntarray);
+    free(hopinode);
+    free(hoppid);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    if(*NBsample < 1)
+    {
+        FUNC_RETURN_FAILURE("NBsample must be >= 1");
+    }
+
+    IMGID img = stream_connect(insname);
+    if(img.ID == -1)
+    {
+        FUNC_RETURN_FAILURE("cannot connect to stream %s", insname);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_START
+
+    stream_proctrace(img, *NBsample);
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_proctrace()
+{
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,10 @@
+/**
+ * @file    stream_proctrace.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_PROCTRACE_H
+#define MILK_COREMOD_MEMORY_STREAM_PROCTRACE_H
+
+errno_t CLIADDCMD_COREMOD_memory__stream_proctrace();
+
+#endif // MILK_COREMOD_MEMORY_STREAM_PROCTRACE_H
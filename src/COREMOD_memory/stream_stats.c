@@ -0,0 +1,823 @@
+/**
+ * @file    stream_stats.c
+ * @brief   online per-pixel statistics of a stream
+ *
+ * Statistics are updated at each input frame and published continuously
+ * (every .pubevery frames), without block resets. Modes :
+ *
+ *   0 : cumulative since start or .reset (Welford, with M3/M4 update for
+ *       higher moments)
+ *   1 : exponentially weighted, time constant .tau frames
+ *   2 : sliding window over last .window frames. Frames are kept in a ring
+ *       buffer (input datatype), power sums of the window are updated by
+ *       adding the new frame and subtracting the oldest, and recomputed
+ *       from the ring once per window length to cancel rounding drift.
+ *
+ * Outputs (float) :
+ *   <prefix>_mean, <prefix>_std
+ *   <prefix>_min, <prefix>_max     (.comp.minmax)
+ *   <prefix>_skew, <prefix>_kurt   (.comp.moments, excess kurtosis)
+ *
+ * std is the sample standard deviation (N-1 normalization), except in
+ * mode 1. Min/max are over the window in mode 2 (scanned from the ring
+ * at each publication, use .pubevery to limit cost), since start or
+ * reset otherwise. Higher moments are not computed in mode 1.
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "stream_stats.h"
+
+#define OMP_NELEMENT_LIMIT 1000000
+
+#define STREAMSTATS_MODE_CUMUL  0
+#define STREAMSTATS_MODE_EWMA   1
+#define STREAMSTATS_MODE_WINDOW 2
+
+static char *inimname;
+static char *outprefix;
+
+static int64_t *mode;
+static long     fpi_mode = -1;
+
+static double *tau;
+static long    fpi_tau = -1;
+
+static uint64_t *window;
+static long      fpi_window = -1;
+
+static uint64_t *pubevery;
+static long      fpi_pubevery = -1;
+
+static int64_t *compminmax;
+static long     fpi_compminmax = -1;
+
+static int64_t *compmoments;
+static long     fpi_compmoments = -1;
+
+static int64_t *reset;
+static long     fpi_reset = -1;
+
+static uint64_t *cnt;
+static long      fpi_cnt = -1;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_IMG,
+        ".in_name",
+        "input image",
+        "im1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outprefix",
+        "output streams prefix",
+        "stats",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outprefix,
+        NULL
+    },
+    {
+        CLIARG_INT64,
+        ".mode",
+        "0: cumulative, 1: exponential, 2: sliding window",
+        "0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &mode,
+        &fpi_mode
+    },
+    {
+        CLIARG_FLOAT64,
+        ".tau",
+        "exponential time constant [frame]",
+        "100.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &tau,
+        &fpi_tau
+    },
+    {
+        CLIARG_UINT64,
+        ".window",
+        "sliding window length [frame]",
+        "100",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &window,
+        &fpi_window
+    },
+    {
+        CLIARG_UINT64,
+        ".pubevery",
+        "publish every N frames",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &pubevery,
+        &fpi_pubevery
+    },
+    {
+        CLIARG_ONOFF,
+        ".comp.minmax",
+        "compute min and max",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &compminmax,
+        &fpi_compminmax
+    },
+    {
+        CLIARG_ONOFF,
+        ".comp.moments",
+        "compute skewness and kurtosis",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &compmoments,
+        &fpi_compmoments
+    },
+    {
+        CLIARG_ONOFF,
+        ".reset",
+        "reset statistics",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &reset,
+        &fpi_reset
+    },
+    {
+        CLIARG_UINT64,
+        ".cnt",
+        "frames in statistics",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &cnt,
+        &fpi_cnt
+    }
+};
+
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_tau].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_pubevery].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_reset].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t customCONFcheck()
+{
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamstats",
+    "online per-pixel statistics of stream",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Per-pixel statistics, updated at each frame\n");
+    printf("  .mode 0 : cumulative since start or .reset\n");
+    printf("  .mode 1 : exponentially weighted, time constant .tau\n");
+    printf("  .mode 2 : sliding window of .window frames\n");
+    printf("Outputs <prefix>_mean, _std, and optionally\n");
+    printf("  _min, _max (.comp.minmax), _skew, _kurt (.comp.moments)\n");
+    printf("Higher moments are not available in mode 1\n");
+
+    return RETURN_SUCCESS;
+}
+
+// statistics state, per pixel arrays
+typedef struct
+{
+    uint64_t nelem;
+    uint64_t n; // frames in statistics
+
+    double *x; // current frame
+
+    double *mean; // mode 0 and 1, reference in mode 2
+    double *m2;
+    double *m3;
+    double *m4;
+    double *min;
+    double *max;
+
+    // mode 2
+    double  *s1; // sums of (x - mean) powers over window
+    double  *s2;
+    double  *s3;
+    double  *s4;
+    char    *ring;
+    uint64_t ringsize;
+    uint64_t ringindex;  // next slot
+    uint64_t ringupdate; // frames since sums recomputed
+} STREAMSTATS;
+
+/**
+ * @brief Convert frame to double
+ *
+ * @return 0 if OK, 1 if datatype not supported
+ */
+static int streamstats_todouble(double     *x,
+                                const void *raw,
+                                uint8_t     datatype,
+                                uint64_t    nelem)
+{
+#ifdef _OPENMP
+#define STREAMSTATS_CONVERT(type)                                              \
+    do                                                                         \
+    {                                                                          \
+        const type *in = (const type *) raw;                                   \
+        _Pragma("omp parallel for if (nelem > OMP_NELEMENT_LIMIT)")            \
+        for(uint64_t ii = 0; ii < nelem; ii++)                                 \
+        {                                                                      \
+            x[ii] = (double) in[ii];                                           \
+        }                                                                      \
+    } while(0)
+#else
+#define STREAMSTATS_CONVERT(type)                                              \
+    do                                                                         \
+    {                                                                          \
+        const type *in = (const type *) raw;                                   \
+        for(uint64_t ii = 0; ii < nelem; ii++)                                 \
+        {                                                                      \
+            x[ii] = (double) in[ii];                                           \
+        }                                                                      \
+    } while(0)
+#endif
+
+    switch(datatype)
+    {
+        case _DATATYPE_UINT8:
+            STREAMSTATS_CONVERT(uint8_t);
+            break;
+        case _DATATYPE_INT8:
+            STREAMSTATS_CONVERT(int8_t);
+            break;
+        case _DATATYPE_UINT16:
+            STREAMSTATS_CONVERT(uint16_t);
+            break;
+        case _DATATYPE_INT16:
+            STREAMSTATS_CONVERT(int16_t);
+            break;
+        case _DATATYPE_UINT32:
+            STREAMSTATS_CONVERT(uint32_t);
+            break;
+        case _DATATYPE_INT32:
+            STREAMSTATS_CONVERT(int32_t);
+            break;
+        case _DATATYPE_UINT64:
+            STREAMSTATS_CONVERT(uint64_t);
+            break;
+        case _DATATYPE_INT64:
+            STREAMSTATS_CONVERT(int64_t);
+            break;
+        case _DATATYPE_FLOAT:
+            STREAMSTATS_CONVERT(float);
+            break;
+        case _DATATYPE_DOUBLE:
+            STREAMSTATS_CONVERT(double);
+            break;
+        default:
+            return 1;
+    }
+
+#undef STREAMSTATS_CONVERT
+
+    return 0;
+}
+
+// cumulative update, Welford / Terriberry
+static void streamstats_update_cumul(STREAMSTATS *st, int moments)
+{
+    double n1 = (double) st->n;
+    double n  = n1 + 1.0;
+
+    double *restrict x    = st->x;
+    double *restrict mean = st->mean;
+    double *restrict m2   = st->m2;
+    double *restrict m3   = st->m3;
+    double *restrict m4   = st->m4;
+
+    if(moments)
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for if (st->nelem > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ii = 0; ii < st->nelem; ii++)
+        {
+            double delta    = x[ii] - mean[ii];
+            double delta_n  = delta / n;
+            double delta_n2 = delta_n * delta_n;
+            double term1    = delta * delta_n * n1;
+
+            mean[ii] += delta_n;
+            m4[ii] += term1 * delta_n2 * (n * n - 3.0 * n + 3.0) +
+                      6.0 * delta_n2 * m2[ii] - 4.0 * delta_n * m3[ii];
+            m3[ii] += term1 * delta_n * (n - 2.0) - 3.0 * delta_n * m2[ii];
+            m2[ii] += term1;
+        }
+    }
+    else
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for if (st->nelem > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ii = 0; ii < st->nelem; ii++)
+        {
+            double delta = x[ii] - mean[ii];
+            mean[ii] += delta / n;
+            m2[ii] += delta * (x[ii] - mean[ii]);
+        }
+    }
+    st->n++;
+}
+
+// exponentially weighted update, m2 holds variance
+static void streamstats_update_ewma(STREAMSTATS *st, double alpha)
+{
+    double *restrict x    = st->x;
+    double *restrict mean = st->mean;
+    double *restrict m2   = st->m2;
+
+    if(st->n == 0)
+    {
+        memcpy(mean, x, sizeof(double) * st->nelem);
+        memset(m2, 0, sizeof(double) * st->nelem);
+    }
+    else
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for if (st->nelem > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ii = 0; ii < st->nelem; ii++)
+        {
+            double delta = x[ii] - mean[ii];
+            double incr  = alpha * delta;
+            mean[ii] += incr;
+            m2[ii] = (1.0 - alpha) * (m2[ii] + delta * incr);
+        }
+    }
+    st->n++;
+}
+
+// add (sign 1) or remove (sign -1) frame x from window sums
+static void streamstats_window_sums(STREAMSTATS *st, const double *x, double sign)
+{
+    double *restrict mean = st->mean;
+    double *restrict s1   = st->s1;
+    double *restrict s2   = st->s2;
+    double *restrict s3   = st->s3;
+    double *restrict s4   = st->s4;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (st->nelem > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t ii = 0; ii < st->nelem; ii++)
+    {
+        double y  = x[ii] - mean[ii];
+        double y2 = y * y;
+        s1[ii] += sign * y;
+        s2[ii] += sign * y2;
+        s3[ii] += sign * y2 * y;
+        s4[ii] += sign * y2 * y2;
+    }
+}
+
+/**
+ * @brief Sliding window update
+ *
+ * x is stored in ring, oldest frame dropped once window is full. Sums
+ * are relative to reference st->mean, which is set to the window mean
+ * each time sums are recomputed.
+ */
+static void streamstats_update_window(STREAMSTATS *st,
+                                      uint8_t      datatype,
+                                      const void  *raw,
+                                      double      *scratch)
+{
+    size_t framesize =
+        (size_t) st->nelem * ImageStreamIO_typesize(datatype);
+    char *slot = st->ring + framesize * st->ringindex;
+
+    if(st->n == 0)
+    {
+        memcpy(st->mean, st->x, sizeof(double) * st->nelem);
+        memset(st->s1, 0, sizeof(double) * st->nelem);
+        memset(st->s2, 0, sizeof(double) * st->nelem);
+        memset(st->s3, 0, sizeof(double) * st->nelem);
+        memset(st->s4, 0, sizeof(double) * st->nelem);
+    }
+
+    if(st->n == st->ringsize)
+    {
+        // drop oldest, in slot about to be overwritten
+        streamstats_todouble(scratch, slot, datatype, st->nelem);
+        streamstats_window_sums(st, scratch, -1.0);
+        st->n--;
+    }
+    memcpy(slot, raw, framesize);
+    streamstats_window_sums(st, st->x, 1.0);
+    st->n++;
+    st->ringindex = (st->ringindex + 1) % st->ringsize;
+    st->ringupdate++;
+
+    if(st->ringupdate >= st->ringsize)
+    {
+        // new reference, recompute sums from ring
+        for(uint64_t ii = 0; ii < st->nelem; ii++)
+        {
+            st->mean[ii] += st->s1[ii] / st->n;
+        }
+        memset(st->s1, 0, sizeof(double) * st->nelem);
+        memset(st->s2, 0, sizeof(double) * st->nelem);
+        memset(st->s3, 0, sizeof(double) * st->nelem);
+        memset(st->s4, 0, sizeof(double) * st->nelem);
+        for(uint64_t k = 0; k < st->n; k++)
+        {
+            streamstats_todouble(scratch,
+                                 st->ring + framesize * k,
+                                 datatype,
+                                 st->nelem);
+            streamstats_window_sums(st, scratch, 1.0);
+        }
+        st->ringupdate = 0;
+    }
+}
+
+// min and max over window
+static void streamstats_window_minmax(STREAMSTATS *st,
+                                      uint8_t      datatype,
+                                      double      *scratch)
+{
+    size_t framesize =
+        (size_t) st->nelem * ImageStreamIO_typesize(datatype);
+
+    for(uint64_t k = 0; k < st->n; k++)
+    {
+        streamstats_todouble(scratch,
+                             st->ring + framesize * k,
+                             datatype,
+                             st->nelem);
+        if(k == 0)
+        {
+            memcpy(st->min, scratch, sizeof(double) * st->nelem);
+            memcpy(st->max, scratch, sizeof(double) * st->nelem);
+            continue;
+        }
+#ifdef _OPENMP
+        #pragma omp parallel for if (st->nelem > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ii = 0; ii < st->nelem; ii++)
+        {
+            st->min[ii] = fmin(st->min[ii], scratch[ii]);
+            st->max[ii] = fmax(st->max[ii], scratch[ii]);
+        }
+    }
+}
+
+// running min and max
+static void streamstats_update_minmax(STREAMSTATS *st)
+{
+    if(st->n == 1)
+    {
+        memcpy(st->min, st->x, sizeof(double) * st->nelem);
+        memcpy(st->max, st->x, sizeof(double) * st->nelem);
+        return;
+    }
+#ifdef _OPENMP
+    #pragma omp parallel for if (st->nelem > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t ii = 0; ii < st->nelem; ii++)
+    {
+        st->min[ii] = fmin(st->min[ii], st->x[ii]);
+        st->max[ii] = fmax(st->max[ii], st->x[ii]);
+    }
+}
+
+/**
+ * @brief Write statistics to output arrays
+ *
+ * skew and kurt may be NULL
+ */
+static void streamstats_publish(STREAMSTATS *st,
+                                int          statmode,
+                                float       *omean,
+                                float       *ostd,
+                                float       *oskew,
+                                float       *okurt)
+{
+    double n = (double) st->n;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (st->nelem > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t ii = 0; ii < st->nelem; ii++)
+    {
+        double mean;
+        double var; // population central moments
+        double cm3 = 0.0;
+        double cm4 = 0.0;
+
+        switch(statmode)
+        {
+            case STREAMSTATS_MODE_EWMA:
+                mean = st->mean[ii];
+                var  = st->m2[ii];
+                break;
+
+            case STREAMSTATS_MODE_WINDOW:
+            {
+                double r1 = st->s1[ii] / n;
+                double r2 = st->s2[ii] / n;
+                mean      = st->mean[ii] + r1;
+                var       = r2 - r1 * r1;
+                if(oskew != NULL)
+                {
+                    double r3 = st->s3[ii] / n;
+                    double r4 = st->s4[ii] / n;
+                    cm3       = r3 - 3.0 * r1 * r2 + 2.0 * r1 * r1 * r1;
+                    cm4 = r4 - 4.0 * r1 * r3 + 6.0 * r1 * r1 * r2 -
+                          3.0 * r1 * r1 * r1 * r1;
+                }
+            }
+            break;
+
+            default:
+                mean = st->mean[ii];
+                var  = st->m2[ii] / n;
+                if(oskew != NULL)
+                {
+                    cm3 = st->m3[ii] / n;
+                    cm4 = st->m4[ii] / n;
+                }
+                break;
+        }
+        if(var < 0.0)
+        {
+            var = 0.0;
+        }
+
+        omean[ii] = (float) mean;
+        if(statmode == STREAMSTATS_MODE_EWMA)
+        {
+            ostd[ii] = (float) sqrt(var);
+        }
+        else
+        {
+            ostd[ii] = (n > 1.0) ? (float) sqrt(var * n / (n - 1.0)) : 0.0f;
+        }
+        if(oskew != NULL)
+        {
+            if(var > 0.0)
+            {
+                oskew[ii] = (float)(cm3 / (var * sqrt(var)));
+                okurt[ii] = (float)(cm4 / (var * var) - 3.0);
+            }
+            else
+            {
+                oskew[ii] = 0.0f;
+                okurt[ii] = 0.0f;
+            }
+        }
+    }
+}
+
+// output stream <prefix>_<name>, float
+static IMGID streamstats_mkout(const char *name, uint32_t xsize, uint32_t ysize)
+{
+    char sname[STRINGMAXLEN_STREAMNAME];
+    WRITE_IMAGENAME(sname, "%s_%s", outprefix, name);
+
+    IMGID img  = makeIMGID_2D(sname, xsize, ysize);
+    img.shared = 1;
+    imcreateIMGID(&img);
+
+    return img;
+}
+
+static double *streamstats_alloc(uint64_t nelem)
+{
+    double *array = (double *) calloc(nelem, sizeof(double));
+    if(array == NULL)
+    {
+        PRINT_ERROR("calloc error, size %lu", (unsigned long) nelem);
+        abort();
+    }
+    return array;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID inimg = mkIMGID_from_name(inimname);
+    resolveIMGID(&inimg, ERRMODE_ABORT);
+
+    uint32_t xsize = inimg.size[0];
+    uint32_t ysize = (inimg.naxis > 1) ? inimg.size[1] : 1;
+
+    int statmode = (int) *mode;
+    if((statmode < STREAMSTATS_MODE_CUMUL) ||
+            (statmode > STREAMSTATS_MODE_WINDOW))
+    {
+        FUNC_RETURN_FAILURE("invalid mode %d", statmode);
+    }
+    int minmax  = (*compminmax == 1);
+    int moments = (*compmoments == 1) && (statmode != STREAMSTATS_MODE_EWMA);
+
+    STREAMSTATS st;
+    memset(&st, 0, sizeof(st));
+    st.nelem = (uint64_t) xsize * ysize;
+
+    double *scratch = streamstats_alloc(st.nelem);
+    {
+        int status = streamstats_todouble(scratch,
+                                          inimg.im->array.raw,
+                                          inimg.datatype,
+                                          st.nelem);
+        if(status != 0)
+        {
+            free(scratch);
+            FUNC_RETURN_FAILURE("datatype of %s not supported", inimname);
+        }
+    }
+
+    st.x    = streamstats_alloc(st.nelem);
+    st.mean = streamstats_alloc(st.nelem);
+    st.m2   = streamstats_alloc(st.nelem);
+    if(moments && (statmode == STREAMSTATS_MODE_CUMUL))
+    {
+        st.m3 = streamstats_alloc(st.nelem);
+        st.m4 = streamstats_alloc(st.nelem);
+    }
+    if(minmax)
+    {
+        st.min = streamstats_alloc(st.nelem);
+        st.max = streamstats_alloc(st.nelem);
+    }
+    if(statmode == STREAMSTATS_MODE_WINDOW)
+    {
+        st.s1       = streamstats_alloc(st.nelem);
+        st.s2       = streamstats_alloc(st.nelem);
+        st.s3       = streamstats_alloc(st.nelem);
+        st.s4       = streamstats_alloc(st.nelem);
+        st.ringsize = (*window > 0) ? *window : 1;
+        st.ring     = (char *) malloc((size_t) st.ringsize * st.nelem *
+                                      ImageStreamIO_typesize(inimg.datatype));
+        if(st.ring == NULL)
+        {
+            PRINT_ERROR("malloc error, %lu frames",
+                        (unsigned long) st.ringsize);
+            abort();
+        }
+    }
+
+    IMGID outmean = streamstats_mkout("mean", xsize, ysize);
+    IMGID outstd  = streamstats_mkout("std", xsize, ysize);
+    IMGID outmin;
+    IMGID outmax;
+    IMGID outskew;
+    IMGID outkurt;
+    if(minmax)
+    {
+        outmin = streamstats_mkout("min", xsize, ysize);
+        outmax = streamstats_mkout("max", xsize, ysize);
+    }
+    if(moments)
+    {
+        outskew = streamstats_mkout("skew", xsize, ysize);
+        outkurt = streamstats_mkout("kurt", xsize, ysize);
+    }
+
+    uint64_t pubcnt = 0;
+    *cnt            = 0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_START
+    {
+        if(*reset == 1)
+        {
+            st.n          = 0;
+            st.ringindex  = 0;
+            st.ringupdate = 0;
+            if(st.m3 != NULL)
+            {
+                memset(st.m3, 0, sizeof(double) * st.nelem);
+                memset(st.m4, 0, sizeof(double) * st.nelem);
+            }
+            memset(st.mean, 0, sizeof(double) * st.nelem);
+            memset(st.m2, 0, sizeof(double) * st.nelem);
+            *reset = 0;
+        }
+
+        streamstats_todouble(st.x,
+                             inimg.im->array.raw,
+                             inimg.datatype,
+                             st.nelem);
+
+        switch(statmode)
+        {
+            case STREAMSTATS_MODE_CUMUL:
+                streamstats_update_cumul(&st, moments);
+                break;
+            case STREAMSTATS_MODE_EWMA:
+                streamstats_update_ewma(&st, (*tau > 1.0) ? 1.0 / (*tau) : 1.0);
+                break;
+            case STREAMSTATS_MODE_WINDOW:
+                streamstats_update_window(&st,
+                                          inimg.datatype,
+                                          inimg.im->array.raw,
+                                          scratch);
+                break;
+        }
+        if(minmax && (statmode != STREAMSTATS_MODE_WINDOW))
+        {
+            streamstats_update_minmax(&st);
+        }
+        *cnt = st.n;
+
+        pubcnt++;
+        if(pubcnt >= *pubevery)
+        {
+            pubcnt = 0;
+
+            outmean.md->write = 1;
+            outstd.md->write  = 1;
+            if(moments)
+            {
+                outskew.md->write = 1;
+                outkurt.md->write = 1;
+            }
+            streamstats_publish(&st,
+                                statmode,
+                                outmean.im->array.F,
+                                outstd.im->array.F,
+                                moments ? outskew.im->array.F : NULL,
+                                moments ? outkurt.im->array.F : NULL);
+
+            if(minmax)
+            {
+                if(statmode == STREAMSTATS_MODE_WINDOW)
+                {
+                    streamstats_window_minmax(&st, inimg.datatype, scratch);
+                }
+                outmin.md->write = 1;
+                outmax.md->write = 1;
+                for(uint64_t ii = 0; ii < st.nelem; ii++)
+                {
+                    outmin.im->array.F[ii] = (float) st.min[ii];
+                    outmax.im->array.F[ii] = (float) st.max[ii];
+                }
+                processinfo_update_output_stream(processinfo, outmin.ID);
+                processinfo_update_output_stream(processinfo, outmax.ID);
+            }
+
+            processinfo_update_output_stream(processinfo, outmean.ID);
+            processinfo_update_output_stream(processinfo, outstd.ID);
+            if(moments)
+            {
+                processinfo_update_output_stream(processinfo, outskew.ID);
+                processinfo_update_output_stream(processinfo, outkurt.ID);
+            }
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    free(scratch);
+    free(st.x);
+    free(st.mean);
+    free(st.m2);
+    free(st.m3);
+    free(st.m4);
+    free(st.min);
+    free(st.max);
+    free(st.s1);
+    free(st.s2);
+    free(st.s3);
+    free(st.s4);
+    free(st.ring);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_stats()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
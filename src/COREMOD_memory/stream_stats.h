@@ -0,0 +1,10 @@
+/**
+ * @file    stream_stats.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_STATS_H
+#define MILK_COREMOD_MEMORY_STREAM_STATS_H
+
+errno_t CLIADDCMD_COREMOD_memory__stream_stats();
+
+#endif // MILK_COREMOD_MEMORY_STREAM_STATS_H
@@ -0,0 +1,582 @@
+/**
+ * @file    stream_tile.c
+ * @brief   tile N input streams into an output mosaic stream
+ *
+ * Each input stream, or a rectangle within it, is placed at a position
+ * in the 2D output stream. Copies are done row by row (memcpy), full
+ * frame copy when rectangles span complete rows.
+ *
+ * Layout file, one input per line :
+ *
+ *   <streamname> <xout> <yout> [<xin> <yin> <xsize> <ysize>]
+ *
+ * Default input rectangle is the full input frame. Lines starting with
+ * # are ignored.
+ *
+ * The output is updated when all inputs have been updated (join), or
+ * when any input is updated (.trigmode 1). Input keywords are merged
+ * into the output, first input in the layout wins on name collision.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "create_image.h"
+#include "stream_tile.h"
+
+// max number of input streams, one trigger semaphore per input
+#define STREAM_TILE_NBMAX PROCESSINFO_TRIGGER_NBSTREAMMAX
+
+static char *layoutfname;
+static long  fpi_layoutfname = -1;
+static char *outsname;
+
+static uint32_t *outxsize;
+static long      fpi_outxsize = -1;
+
+static uint32_t *outysize;
+static long      fpi_outysize = -1;
+
+static int64_t *trigmode;
+static long     fpi_trigmode = -1;
+
+static int64_t *kwmerge;
+static long     fpi_kwmerge = -1;
+
+static uint64_t *NBtile;
+static long      fpi_NBtile = -1;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STR,
+        ".layout",
+        "layout file",
+        "tile.conf",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &layoutfname,
+        &fpi_layoutfname
+    },
+    {
+        CLIARG_STR,
+        ".outsname",
+        "output stream",
+        "mosaic",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outsname,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".outxsize",
+        "output x size, 0: fit layout",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &outxsize,
+        &fpi_outxsize
+    },
+    {
+        CLIARG_UINT32,
+        ".outysize",
+        "output y size, 0: fit layout",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &outysize,
+        &fpi_outysize
+    },
+    {
+        CLIARG_INT64,
+        ".trigmode",
+        "0: all inputs updated, 1: any input updated",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &trigmode,
+        &fpi_trigmode
+    },
+    {
+        CLIARG_ONOFF,
+        ".kwmerge",
+        "merge input keywords into output",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &kwmerge,
+        &fpi_kwmerge
+    },
+    {
+        CLIARG_UINT64,
+        ".NBtile",
+        "number of inputs",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBtile,
+        &fpi_NBtile
+    }
+};
+
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_kwmerge].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static int stream_tile_readlayout(const char *fname, STREAM_TILE *tile);
+
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
+    {
+        // inputs beyond STREAM_TILE_NBMAX are ignored
+        if(access(layoutfname, R_OK) == 0)
+        {
+            int NB  = stream_tile_readlayout(layoutfname, NULL);
+            *NBtile = (NB > 0) ? NB : 0;
+            if(NB > STREAM_TILE_NBMAX)
+            {
+                data.fpsptr->parray[fpi_layoutfname].fpflag |= FPFLAG_ERROR;
+            }
+            else
+            {
+                data.fpsptr->parray[fpi_layoutfname].fpflag &= ~FPFLAG_ERROR;
+            }
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamtile", "tile N streams into mosaic stream", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Paste input streams, or rectangles within them, into a 2D\n");
+    printf("output stream. Layout file, one input per line:\n");
+    printf("  <streamname> <xout> <yout> [<xin> <yin> <xsize> <ysize>]\n");
+    printf("Inputs and output must have the same datatype\n");
+    printf("Output is created if it does not exist\n");
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Copy input rectangles into output
+ *
+ * Rectangles must be within input and output frames, see
+ * stream_tile_check().
+ */
+errno_t stream_tile_copy(IMGID *imgout, STREAM_TILE *tile, int NBtile)
+{
+    int      typesize = ImageStreamIO_typesize(imgout->md->datatype);
+    uint32_t oxsize   = imgout->md->size[0];
+    char    *out      = (char *) imgout->im->array.raw;
+
+    for(int t = 0; t < NBtile; t++)
+    {
+        STREAM_TILE *tl     = &tile[t];
+        uint32_t     ixsize = tl->img.md->size[0];
+        char        *in     = (char *) tl->img.im->array.raw;
+        size_t       rowlen = (size_t) tl->xsize * typesize;
+
+        char *dst = out + ((size_t) tl->yout * oxsize + tl->xout) * typesize;
+        char *src = in + ((size_t) tl->yin * ixsize + tl->xin) * typesize;
+
+        if((tl->xsize == ixsize) && (tl->xsize == oxsize))
+        {
+            // contiguous in input and output
+            memcpy(dst, src, rowlen * tl->ysize);
+        }
+        else
+        {
+            for(uint32_t jj = 0; jj < tl->ysize; jj++)
+            {
+                memcpy(dst, src, rowlen);
+                dst += (size_t) oxsize * typesize;
+                src += (size_t) ixsize * typesize;
+            }
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Check rectangles against input and output frames
+ *
+ * Sets default rectangle (full input frame) where xsize or ysize is 0.
+ *
+ * @return 0 if OK, index+1 of first bad tile otherwise
+ */
+int stream_tile_check(IMGID *imgout, STREAM_TILE *tile, int NBtile)
+{
+    uint32_t oxsize = imgout->md->size[0];
+    uint32_t oysize = (imgout->md->naxis > 1) ? imgout->md->size[1] : 1;
+
+    for(int t = 0; t < NBtile; t++)
+    {
+        STREAM_TILE *tl     = &tile[t];
+        uint32_t     ixsize = tl->img.md->size[0];
+        uint32_t     iysize =
+            (tl->img.md->naxis > 1) ? tl->img.md->size[1] : 1;
+
+        if((tl->xsize == 0) || (tl->ysize == 0))
+        {
+            tl->xsize = ixsize;
+            tl->ysize = iysize;
+        }
+        if((tl->img.md->datatype != imgout->md->datatype) ||
+                ((uint64_t) tl->xin + tl->xsize > ixsize) ||
+                ((uint64_t) tl->yin + tl->ysize > iysize) ||
+                ((uint64_t) tl->xout + tl->xsize > oxsize) ||
+                ((uint64_t) tl->yout + tl->ysize > oysize))
+        {
+            return t + 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Map input keywords to output keyword slots
+ *
+ * Keywords already in output are updated, others take free output
+ * slots. On name collision, first input wins. Keywords are mapped once,
+ * when merge is first enabled: keywords added to inputs afterwards are
+ * not merged.
+ *
+ * @return number of entries in kwmap
+ */
+long stream_tile_kwmap(IMGID            *imgout,
+                       IMGID            *imgin,
+                       int               NBin,
+                       STREAM_TILE_KWMAP *kwmap,
+                       long              NBkwmapmax)
+{
+    long NBkwmap = 0;
+    int  NBkwout = imgout->md->NBkw;
+    long NBdrop  = 0;
+
+    for(int k = 0; k < NBin; k++)
+    {
+        for(int kwi = 0; kwi < imgin[k].md->NBkw; kwi++)
+        {
+            IMAGE_KEYWORD *kw = &imgin[k].im->kw[kwi];
+            if(kw->type == 'N')
+            {
+                continue;
+            }
+
+            int  kwo     = -1;
+            int  mapped  = 0;
+            for(int j = 0; j < NBkwout; j++)
+            {
+                if(imgout->im->kw[j].type == 'N')
+                {
+                    if(kwo == -1)
+                    {
+                        kwo = j;
+                    }
+                    continue;
+                }
+                if(strcmp(imgout->im->kw[j].name, kw->name) == 0)
+                {
+                    kwo = j;
+                    // already mapped from previous input ?
+                    for(long m = 0; m < NBkwmap; m++)
+                    {
+                        if(kwmap[m].kwout == j)
+                        {
+                            mapped = 1;
+                        }
+                    }
+                    break;
+                }
+            }
+            if(mapped)
+            {
+                continue;
+            }
+            if((kwo == -1) || (NBkwmap == NBkwmapmax))
+            {
+                NBdrop++;
+                continue;
+            }
+
+            // reserve slot
+            imgout->im->kw[kwo] = *kw;
+
+            kwmap[NBkwmap].in    = k;
+            kwmap[NBkwmap].kwin  = kwi;
+            kwmap[NBkwmap].kwout = kwo;
+            NBkwmap++;
+        }
+    }
+
+    if(NBdrop > 0)
+    {
+        PRINT_WARNING("%ld keywords not merged into %s, no free entry",
+                      NBdrop,
+                      imgout->name);
+    }
+
+    return NBkwmap;
+}
+
+// copy mapped keyword values to output
+void stream_tile_kwcopy(IMGID            *imgout,
+                        IMGID            *imgin,
+                        STREAM_TILE_KWMAP *kwmap,
+                        long              NBkwmap)
+{
+    for(long m = 0; m < NBkwmap; m++)
+    {
+        imgout->im->kw[kwmap[m].kwout] =
+            imgin[kwmap[m].in].im->kw[kwmap[m].kwin];
+    }
+}
+
+/**
+ * @brief Read layout file
+ *
+ * With tile NULL, only counts entries, without the STREAM_TILE_NBMAX cap.
+ *
+ * @return number of tiles, -1 on error
+ */
+static int stream_tile_readlayout(const char *fname, STREAM_TILE *tile)
+{
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL)
+    {
+        PRINT_ERROR("cannot open layout \"%s\"", fname);
+        return -1;
+    }
+
+    int  NB = 0;
+    char line[STRINGMAXLEN_DEFAULT];
+    while(fgets(line, STRINGMAXLEN_DEFAULT, fp) != NULL)
+    {
+        char     sname[STRINGMAXLEN_STREAMNAME];
+        uint32_t xout  = 0;
+        uint32_t yout  = 0;
+        uint32_t xin   = 0;
+        uint32_t yin   = 0;
+        uint32_t xsize = 0;
+        uint32_t ysize = 0;
+
+        if(line[0] == '#')
+        {
+            continue;
+        }
+        int n = sscanf(line,
+                       "%99s %u %u %u %u %u %u",
+                       sname,
+                       &xout,
+                       &yout,
+                       &xin,
+                       &yin,
+                       &xsize,
+                       &ysize);
+        if(n < 1)
+        {
+            continue;
+        }
+        if((n != 3) && (n != 7))
+        {
+            PRINT_ERROR("layout \"%s\": bad line for %s", fname, sname);
+            fclose(fp);
+            return -1;
+        }
+        if(tile == NULL)
+        {
+            // count only
+            NB++;
+            continue;
+        }
+        if(NB == STREAM_TILE_NBMAX)
+        {
+            PRINT_WARNING("max %d inputs, ignoring %s",
+                          STREAM_TILE_NBMAX,
+                          sname);
+            continue;
+        }
+
+        memset(&tile[NB], 0, sizeof(STREAM_TILE));
+        tile[NB].img   = mkIMGID_from_name(sname);
+        tile[NB].xout  = xout;
+        tile[NB].yout  = yout;
+        tile[NB].xin   = xin;
+        tile[NB].yin   = yin;
+        tile[NB].xsize = xsize;
+        tile[NB].ysize = ysize;
+        NB++;
+    }
+    fclose(fp);
+
+    return NB;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    STREAM_TILE *tile =
+        (STREAM_TILE *) malloc(sizeof(STREAM_TILE) * STREAM_TILE_NBMAX);
+    if(tile == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    int NBt = stream_tile_readlayout(layoutfname, tile);
+    if(NBt < 1)
+    {
+        free(tile);
+        FUNC_RETURN_FAILURE("no input in layout \"%s\"", layoutfname);
+    }
+
+    // connect to inputs, output size fitting layout
+    imageID *IDin   = (imageID *) malloc(sizeof(imageID) * NBt);
+    IMGID   *imgin  = (IMGID *) malloc(sizeof(IMGID) * NBt);
+    if((IDin == NULL) || (imgin == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    uint32_t xfit = 0;
+    uint32_t yfit = 0;
+    for(int t = 0; t < NBt; t++)
+    {
+        if(resolveIMGID(&tile[t].img, ERRMODE_WARN) == -1)
+        {
+            char sname[STRINGMAXLEN_STREAMNAME];
+            strcpy(sname, tile[t].img.name);
+            free(tile);
+            free(IDin);
+            free(imgin);
+            FUNC_RETURN_FAILURE("cannot connect to input %s", sname);
+        }
+        IDin[t]  = tile[t].img.ID;
+        imgin[t] = tile[t].img;
+
+        uint32_t xs = tile[t].xsize;
+        uint32_t ys = tile[t].ysize;
+        if((xs == 0) || (ys == 0))
+        {
+            xs = tile[t].img.md->size[0];
+            ys = (tile[t].img.md->naxis > 1) ? tile[t].img.md->size[1] : 1;
+        }
+        if(tile[t].xout + xs > xfit)
+        {
+            xfit = tile[t].xout + xs;
+        }
+        if(tile[t].yout + ys > yfit)
+        {
+            yfit = tile[t].yout + ys;
+        }
+    }
+
+    IMGID imgout = mkIMGID_from_name(outsname);
+    if(resolveIMGID(&imgout, ERRMODE_WARN) == -1)
+    {
+        uint32_t size[2];
+        size[0] = (*outxsize > 0) ? *outxsize : xfit;
+        size[1] = (*outysize > 0) ? *outysize : yfit;
+        create_image_ID(outsname,
+                        2,
+                        size,
+                        tile[0].img.md->datatype,
+                        1,
+                        NB_KEYWNODE_MAX,
+                        0,
+                        &imgout.ID);
+        resolveIMGID(&imgout, ERRMODE_ABORT);
+    }
+
+    int tbad = stream_tile_check(&imgout, tile, NBt);
+    if(tbad != 0)
+    {
+        char sname[STRINGMAXLEN_STREAMNAME];
+        strcpy(sname, tile[tbad - 1].img.name);
+        free(tile);
+        free(IDin);
+        free(imgin);
+        FUNC_RETURN_FAILURE("input %s: datatype or rectangle does not fit %s",
+                            sname,
+                            outsname);
+    }
+
+    // built when .kwmerge is first set, which may be at run time
+    long               NBkwmap = -1;
+    STREAM_TILE_KWMAP *kwmap   = (STREAM_TILE_KWMAP *) malloc(
+                                     sizeof(STREAM_TILE_KWMAP) * imgout.md->NBkw);
+    if(kwmap == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    *NBtile = NBt;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    // Wait for all (or any) inputs to be updated, 1 sec timeout
+    if(processinfo != NULL)
+    {
+        processinfo->triggertimeout.tv_sec  = 1;
+        processinfo->triggertimeout.tv_nsec = 0;
+        FUNC_CHECK_RETURN(processinfo_waitoninputstream_init_multi(
+                              processinfo,
+                              IDin,
+                              NBt,
+                              (*trigmode == 1) ? PROCESSINFO_TRIGGERMODE_ANY
+                              : PROCESSINFO_TRIGGERMODE_ALL));
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        imgout.md->write = 1;
+
+        stream_tile_copy(&imgout, tile, NBt);
+        if(*kwmerge)
+        {
+            if(NBkwmap == -1)
+            {
+                NBkwmap = stream_tile_kwmap(&imgout,
+                                            imgin,
+                                            NBt,
+                                            kwmap,
+                                            imgout.md->NBkw);
+            }
+            stream_tile_kwcopy(&imgout, imgin, kwmap, NBkwmap);
+        }
+
+        processinfo_update_output_stream(processinfo, imgout.ID);
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    free(kwmap);
+    free(tile);
+    free(IDin);
+    free(imgin);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_COREMOD_memory__stream_tile()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file    stream_tile.h
+ */
+
+#ifndef MILK_COREMOD_MEMORY_STREAM_TILE_H
+#define MILK_COREMOD_MEMORY_STREAM_TILE_H
+
+// input rectangle and placement in output
+typedef struct
+{
+    IMGID img;
+
+    uint32_t xin; // rectangle origin in input
+    uint32_t yin;
+    uint32_t xsize; // rectangle size, 0 for full input frame
+    uint32_t ysize;
+    uint32_t xout; // rectangle origin in output
+    uint32_t yout;
+} STREAM_TILE;
+
+// input keyword to output keyword entry
+typedef struct
+{
+    int in;   // input index
+    int kwin; // keyword index in input
+    int kwout; // keyword index in output
+} STREAM_TILE_KWMAP;
+
+errno_t CLIADDCMD_COREMOD_memory__stream_tile();
+
+errno_t stream_tile_copy(IMGID *imgout, STREAM_TILE *tile, int NBtile);
+
+int stream_tile_check(IMGID *imgout, STREAM_TILE *tile, int NBtile);
+
+long stream_tile_kwmap(IMGID            *imgout,
+                       IMGID            *imgin,
+                       int               NBin,
+                       STREAM_TILE_KWMAP *kwmap,
+                       long              NBkwmapmax);
+
+void stream_tile_kwcopy(IMGID            *imgout,
+                        IMGID            *imgin,
+                        STREAM_TILE_KWMAP *kwmap,
+                        long              NBkwmap);
+
+#endif // MILK_COREMOD_MEMORY_STREAM_TILE_H
@@ -115,6 +115,7 @@ errno_t CLI_data_init()
         data.fpsarray[fpsindex].SMfd   = -1;
         data.fpsarray[fpsindex].md     = NULL;
         data.fpsarray[fpsindex].parray = NULL;
+        data.fpsarray[fpsindex].pindexhash = NULL;
     }
 
     create_variable_ID("_PI", 3.14159265358979323846264338328);
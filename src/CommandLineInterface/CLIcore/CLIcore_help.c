@@ -702,6 +702,15 @@ errno_t help_command(
                         case PROCESSINFO_TRIGGERMODE_DELAY:
                             printf("DELAY");
                             break;
+                        case PROCESSINFO_TRIGGERMODE_ANY:
+                            printf("ANY");
+                            break;
+                        case PROCESSINFO_TRIGGERMODE_ALL:
+                            printf("ALL");
+                            break;
+                        case PROCESSINFO_TRIGGERMODE_SPINSEM:
+                            printf("SPINSEM");
+                            break;
                         default:
                             printf("unknown");
                             break;
@@ -711,6 +720,9 @@ errno_t help_command(
                     printf("        triggerstreamname  : %s\n",
                            data.cmd[cmdi].cmdsettings.triggerstreamname);
 
+                    printf("        triggerspinns      : %ld\n",
+                           data.cmd[cmdi].cmdsettings.triggerspinns);
+
                     printf(
                         "        triggerdelay       : "
                         "%lld.%09ld\n",
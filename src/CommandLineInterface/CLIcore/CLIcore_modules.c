@@ -675,6 +675,8 @@ uint32_t RegisterCLIcmd(
     data.cmd[data.NBcmd].cmdsettings.triggertimeout.tv_sec  = 1;
     data.cmd[data.NBcmd].cmdsettings.triggertimeout.tv_nsec = 0;
 
+    data.cmd[data.NBcmd].cmdsettings.triggerspinns = 20000;
+
     data.NBcmd++;
 
     DEBUG_TRACE_FEXIT();
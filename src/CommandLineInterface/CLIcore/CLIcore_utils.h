@@ -217,6 +217,7 @@ typedef struct
                 CLIcmddata.cmdsettings->triggertimeout.tv_sec;                 \
             fps.cmdset.triggertimeout.tv_nsec =                                \
                 CLIcmddata.cmdsettings->triggertimeout.tv_nsec;                \
+            fps.cmdset.triggerspinns = CLIcmddata.cmdsettings->triggerspinns;  \
             fps_add_processinfo_entries(&fps);                                 \
         }                                                                      \
         data.fpsptr = &fps;                                                    \
@@ -263,6 +264,8 @@ typedef struct
             data.fpsptr->cmdset.triggertimeout.tv_sec;                         \
         CLIcmddata.cmdsettings->triggertimeout.tv_nsec =                       \
             data.fpsptr->cmdset.triggertimeout.tv_nsec;                        \
+        CLIcmddata.cmdsettings->triggerspinns =                                \
+            data.fpsptr->cmdset.triggerspinns;                                 \
     }                                                                          \
     if (CLIcmddata.cmdsettings->flags & CLICMDFLAG_PROCINFO)                   \
     {                                                                          \
@@ -306,6 +309,7 @@ typedef struct
                CLIcmddata.cmdsettings->triggerstreamname, STRINGMAXLEN_IMAGE_NAME-1);  \
         processinfo->triggerdelay   = CLIcmddata.cmdsettings->triggerdelay;    \
         processinfo->triggertimeout = CLIcmddata.cmdsettings->triggertimeout;  \
+        processinfo->triggerspinns  = CLIcmddata.cmdsettings->triggerspinns;   \
         processinfo->triggerstreamID =                                         \
             image_ID(processinfo->triggerstreamname);                          \
         DEBUG_TRACEPOINT("triggerstreamID = %ld",                              \
@@ -364,14 +368,19 @@ typedef struct
     if (CLIcmddata.cmdsettings->flags & CLICMDFLAG_PROCINFO) {                 \
      if(processinfo != NULL) {                                                 \
       if(data.fpsptr != NULL) {                                                \
-        if(data.fpsptr->cmdset.triggermodeptr != NULL){                        \
+        /* multi-stream trigger mode and timeout are set by function */       \
+        if((data.fpsptr->cmdset.triggermodeptr != NULL) &&                     \
+           (processinfo->triggerNBstream == 0)){                               \
           processinfo->triggermode = *data.fpsptr->cmdset.triggermodeptr;}     \
         if(data.fpsptr->cmdset.procinfo_loopcntMax_ptr != NULL){               \
           processinfo->loopcntMax = *data.fpsptr->cmdset.procinfo_loopcntMax_ptr;}  \
         if(data.fpsptr->cmdset.triggerdelayptr != NULL){                       \
           processinfo->triggerdelay = data.fpsptr->cmdset.triggerdelayptr[0];} \
-        if(data.fpsptr->cmdset.triggertimeoutptr != NULL){                     \
+        if((data.fpsptr->cmdset.triggertimeoutptr != NULL) &&                  \
+           (processinfo->triggerNBstream == 0)){                               \
           processinfo->triggertimeout = data.fpsptr->cmdset.triggertimeoutptr[0];} \
+        if(data.fpsptr->cmdset.triggerspinnsptr != NULL){                      \
+          processinfo->triggerspinns = data.fpsptr->cmdset.triggerspinnsptr[0];} \
         }}                                                                     \
     if(processinfo != NULL) {                                              \
           processinfo_exec_end(processinfo);}                                  \
@@ -379,6 +388,8 @@ typedef struct
     }                                                                          \
     if (CLIcmddata.cmdsettings->flags & CLICMDFLAG_PROCINFO)                   \
     {                                                                          \
+        if(processinfo->triggerNBstream > 0) {                                 \
+          processinfo_waitoninputstream_end_multi(processinfo);}               \
         processinfo_cleanExit(processinfo);                                    \
     }
 
@@ -29,6 +29,10 @@ typedef struct
     struct timespec triggertimeout;
     struct timespec *triggertimeoutptr;
 
+    // spin duration before blocking, PROCESSINFO_TRIGGERMODE_SPINSEM
+    long            triggerspinns;
+    int64_t        *triggerspinnsptr;
+
 
     int             semindexrequested;
 
@@ -28,6 +28,7 @@ errno_t functionparameter_CONFstart(FUNCTION_PARAMETER_STRUCT *fps)
 
     // notify GUI loop to update
     fps->md->signal |= FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE;
+    functionparameter_notify(fps);
 
     return RETURN_SUCCESS;
 }
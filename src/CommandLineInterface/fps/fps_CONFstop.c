@@ -12,6 +12,7 @@ errno_t functionparameter_CONFstop(FUNCTION_PARAMETER_STRUCT *fps)
 {
     // send conf stop signal
     fps->md->signal &= ~FUNCTION_PARAMETER_STRUCT_SIGNAL_CONFRUN;
+    functionparameter_notify(fps);
 
     return RETURN_SUCCESS;
 }
@@ -13,6 +13,9 @@ uint16_t function_parameter_FPCONFloopstep(FUNCTION_PARAMETER_STRUCT *fps)
     static uint32_t prev_status;
     //static uint32_t statuschanged = 0;
 
+    // changes notified after this point end the wait below
+    uint32_t notifyseq = functionparameter_notify_seq(fps);
+
     if(loopINIT == 0)
     {
         loopINIT = 1; // update on first loop iteration
@@ -67,7 +70,14 @@ uint16_t function_parameter_FPCONFloopstep(FUNCTION_PARAMETER_STRUCT *fps)
             fps->md->signal &=
                 ~FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE; // disable update (should be moved to conf process)
         }
-        usleep(fps->md->confwaitus);
+        else
+        {
+            // wait for change notification, at most confwaitus
+            // (no wait if 0), so that run process status is re-checked
+            functionparameter_notify_wait(fps,
+                                          notifyseq,
+                                          fps->md->confwaitus);
+        }
     }
     else
     {
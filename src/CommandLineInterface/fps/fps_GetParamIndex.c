@@ -1,29 +1,272 @@
 /**
- * @file    fps_GetParamIndex.h
+ * @file    fps_GetParamIndex.c
  * @brief   Get index of parameter
+ *
+ * Parameters are indexed in a hash table (open addressing, linear probing)
+ * stored in shared memory after the parameter array, so that all processes
+ * connected to the FPS share it. The hash key is the keyword with the FPS
+ * name removed, for example ".conf.timestring".
+ *
+ * The index is built on FPS create and extended as parameters are added.
+ * On connect, it is rebuilt only if the number of indexed parameters
+ * does not match the number of active parameters. Writers make the
+ * generation counter md->indexgen odd while modifying the index, so that
+ * a lookup overlapping a modification falls back to a scan.
+ *
+ * Lookup is an exact match on the key. If no exact match is found, the
+ * parameter array is scanned for the first keyword containing paramname,
+ * as was done before the index was introduced.
+ *
+ * Parameters do not move in the parameter array once created, so callers
+ * looking up the same parameter repeatedly (conf loops) can keep a
+ * FPS_PINDEX_HANDLE, valid as long as md->indexgen is unchanged.
  */
 
 #include "CommandLineInterface/CLIcore.h"
 
+#include "fps_GetParamIndex.h"
+
+// FNV-1a hash
+static inline uint64_t fps_paramkey_hash(const char *key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    while(*key != '\0')
+    {
+        h ^= (uint8_t) *key;
+        h *= 1099511628211ULL;
+        key++;
+    }
+    return h;
+}
+
+/**
+ * @brief Hash key: keyword without leading FPS name
+ */
+static const char *fps_paramkey(FUNCTION_PARAMETER_STRUCT *fps,
+                                const char                *keyword)
+{
+    size_t namelen = strlen(fps->md->name);
+
+    if((strncmp(keyword, fps->md->name, namelen) == 0) &&
+            (keyword[namelen] == '.'))
+    {
+        return keyword + namelen;
+    }
+    return keyword;
+}
+
+/**
+ * @brief Check that active parameter pindex has key
+ */
+static inline int fps_paramindex_match(FUNCTION_PARAMETER_STRUCT *fps,
+                                       long                       pindex,
+                                       const char                *key)
+{
+    return ((pindex >= 0) && (pindex < fps->md->NBparamMAX) &&
+            (fps->parray[pindex].fpflag & FPFLAG_ACTIVE) &&
+            (strcmp(fps_paramkey(fps, fps->parray[pindex].keywordfull), key) ==
+             0));
+}
+
+// lookup result when index was modified during lookup
+#define FPS_PINDEX_RETRY -2
+
+static inline void fps_paramindex_writebegin(FUNCTION_PARAMETER_STRUCT *fps)
+{
+    __atomic_add_fetch(&fps->md->indexgen, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void fps_paramindex_writeend(FUNCTION_PARAMETER_STRUCT *fps)
+{
+    __atomic_add_fetch(&fps->md->indexgen, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Insert parameter in hash index
+ *
+ * @return 1 if inserted, 0 if already in index
+ */
+static int fps_paramindex_insert(FUNCTION_PARAMETER_STRUCT *fps, long pindex)
+{
+    long mask = fps->md->NBparamHASH - 1;
+    long k    = (long)(fps_paramkey_hash(
+                           fps_paramkey(fps, fps->parray[pindex].keywordfull)) &
+                       mask);
+
+    while(fps->pindexhash[k] != FPS_PINDEXHASH_EMPTY)
+    {
+        if(fps->pindexhash[k] == pindex)
+        {
+            return 0;
+        }
+        k = (k + 1) & mask;
+    }
+    __atomic_store_n(&fps->pindexhash[k], (int32_t) pindex, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+/**
+ * @brief (Re)build parameter hash index from parameter array
+ */
+errno_t functionparameter_index_rebuild(FUNCTION_PARAMETER_STRUCT *fps)
+{
+    if(fps->pindexhash == NULL)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    fps_paramindex_writebegin(fps);
+
+    for(long k = 0; k < fps->md->NBparamHASH; k++)
+    {
+        __atomic_store_n(&fps->pindexhash[k],
+                         FPS_PINDEXHASH_EMPTY,
+                         __ATOMIC_RELAXED);
+    }
+
+    long NBindexed = 0;
+    for(long pindex = 0; pindex < fps->md->NBparamMAX; pindex++)
+    {
+        if(fps->parray[pindex].fpflag & FPFLAG_ACTIVE)
+        {
+            NBindexed += fps_paramindex_insert(fps, pindex);
+        }
+    }
+    fps->md->NBparamINDEXED = NBindexed;
+
+    fps_paramindex_writeend(fps);
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Rebuild hash index if it does not cover active parameters
+ *
+ * Called on FPS connect
+ */
+errno_t functionparameter_index_sync(FUNCTION_PARAMETER_STRUCT *fps)
+{
+    if(fps->pindexhash == NULL)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    long NBactive = 0;
+    for(long pindex = 0; pindex < fps->md->NBparamMAX; pindex++)
+    {
+        if(fps->parray[pindex].fpflag & FPFLAG_ACTIVE)
+        {
+            NBactive++;
+        }
+    }
+
+    if(NBactive != fps->md->NBparamINDEXED)
+    {
+        functionparameter_index_rebuild(fps);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Add parameter to hash index
+ *
+ * To be called once parray[pindex].keywordfull is set
+ */
+errno_t functionparameter_index_add(FUNCTION_PARAMETER_STRUCT *fps,
+                                    long                       pindex)
+{
+    if(fps->pindexhash == NULL)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    fps_paramindex_writebegin(fps);
+    fps->md->NBparamINDEXED += fps_paramindex_insert(fps, pindex);
+    fps_paramindex_writeend(fps);
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Exact match lookup in hash index
+ *
+ * Returns -1 if not found or if no index, FPS_PINDEX_RETRY if not found
+ * while the index was modified
+ */
+static long fps_paramindex_lookup(FUNCTION_PARAMETER_STRUCT *fps,
+                                  const char                *paramname)
+{
+    if(fps->pindexhash == NULL)
+    {
+        return -1;
+    }
+
+    uint32_t gen = __atomic_load_n(&fps->md->indexgen, __ATOMIC_ACQUIRE);
+
+    const char *key  = fps_paramkey(fps, paramname);
+    long        mask = fps->md->NBparamHASH - 1;
+    long        k    = (long)(fps_paramkey_hash(key) & mask);
+
+    // bounded probe: index may be modified by another process
+    for(long n = 0; n < fps->md->NBparamHASH; n++)
+    {
+        long pindex = __atomic_load_n(&fps->pindexhash[k], __ATOMIC_RELAXED);
+        if(pindex == FPS_PINDEXHASH_EMPTY)
+        {
+            break;
+        }
+        if(fps_paramindex_match(fps, pindex, key))
+        {
+            return pindex;
+        }
+        k = (k + 1) & mask;
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if((gen & 1) ||
+            (__atomic_load_n(&fps->md->indexgen, __ATOMIC_RELAXED) != gen))
+    {
+        return FPS_PINDEX_RETRY;
+    }
+
+    return -1;
+}
+
 int functionparameter_GetParamIndex(FUNCTION_PARAMETER_STRUCT *fps,
                                     const char                *paramname)
 {
-    long index  = -1;
-    long pindex = 0;
+    long index = fps_paramindex_lookup(fps, paramname);
 
-    long NBparamMAX = fps->md->NBparamMAX;
+    if(index == FPS_PINDEX_RETRY)
+    {
+        // exact match, first active entry
+        const char *key = fps_paramkey(fps, paramname);
+        index           = -1;
+        for(long pindex = 0; pindex < fps->md->NBparamMAX; pindex++)
+        {
+            if(fps_paramindex_match(fps, pindex, key))
+            {
+                index = pindex;
+                break;
+            }
+        }
+    }
 
-    int found = 0;
-    for(pindex = 0; pindex < NBparamMAX; pindex++)
+    if(index == -1)
     {
-        if(found == 0)
+        // substring match, first active entry
+        long NBparamMAX = fps->md->NBparamMAX;
+        for(long pindex = 0; pindex < NBparamMAX; pindex++)
         {
             if(fps->parray[pindex].fpflag & FPFLAG_ACTIVE)
             {
                 if(strstr(fps->parray[pindex].keywordfull, paramname) != NULL)
                 {
                     index = pindex;
-                    found = 1;
+                    break;
                 }
             }
         }
@@ -41,3 +284,78 @@ int functionparameter_GetParamIndex(FUNCTION_PARAMETER_STRUCT *fps,
 
     return index;
 }
+
+/**
+ * @brief Get index of parameter, using caller-provided handle
+ *
+ * The handle is resolved on first call and reused while md->indexgen is
+ * unchanged. If the index was modified since, the cached parameter is
+ * checked against paramname before a new lookup.
+ * handle should be initialized to FPS_PINDEX_HANDLE_INIT, and only used
+ * with the same paramname.
+ */
+int functionparameter_GetParamIndex_cached(FUNCTION_PARAMETER_STRUCT *fps,
+        const char        *paramname,
+        FPS_PINDEX_HANDLE *handle)
+{
+    uint32_t gen = __atomic_load_n(&fps->md->indexgen, __ATOMIC_ACQUIRE);
+
+    if(handle->pindex >= 0)
+    {
+        if(((gen & 1) == 0) && (handle->indexgen == gen))
+        {
+            return handle->pindex;
+        }
+        if(fps_paramindex_match(fps,
+                                handle->pindex,
+                                fps_paramkey(fps, paramname)))
+        {
+            handle->indexgen = gen;
+            return handle->pindex;
+        }
+    }
+
+    handle->pindex   = functionparameter_GetParamIndex(fps, paramname);
+    handle->indexgen = gen;
+
+    return handle->pindex;
+}
+
+/**
+ * @brief Reset local parameter lookup cache
+ */
+errno_t functionparameter_index_cacheinit(FUNCTION_PARAMETER_STRUCT *fps)
+{
+    for(int i = 0; i < FPS_PINDEXCACHE_SIZE; i++)
+    {
+        fps->pindexcache[i].pindex   = -1;
+        fps->pindexcache[i].indexgen = 0;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Get index of parameter, using local cache slot of paramname
+ *
+ * Used by get/set value functions, called in loops with the same
+ * paramname string. The slot is selected by paramname address, which
+ * may be reused for another name, so the cached parameter keyword is
+ * always compared to paramname.
+ */
+int functionparameter_GetParamIndex_local(FUNCTION_PARAMETER_STRUCT *fps,
+        const char *paramname)
+{
+    FPS_PINDEX_HANDLE *handle =
+        &fps->pindexcache[((uintptr_t) paramname >> 3) %
+                          FPS_PINDEXCACHE_SIZE];
+
+    if(fps_paramindex_match(fps, handle->pindex, fps_paramkey(fps, paramname)))
+    {
+        return handle->pindex;
+    }
+
+    handle->pindex = functionparameter_GetParamIndex(fps, paramname);
+
+    return handle->pindex;
+}
@@ -8,7 +8,23 @@
 
 #include "function_parameters.h"
 
+errno_t functionparameter_index_rebuild(FUNCTION_PARAMETER_STRUCT *fps);
+
+errno_t functionparameter_index_sync(FUNCTION_PARAMETER_STRUCT *fps);
+
+errno_t functionparameter_index_add(FUNCTION_PARAMETER_STRUCT *fps,
+                                    long                       pindex);
+
 int functionparameter_GetParamIndex(FUNCTION_PARAMETER_STRUCT *fps,
                                     const char                *paramname);
 
+int functionparameter_GetParamIndex_cached(FUNCTION_PARAMETER_STRUCT *fps,
+        const char        *paramname,
+        FPS_PINDEX_HANDLE *handle);
+
+errno_t functionparameter_index_cacheinit(FUNCTION_PARAMETER_STRUCT *fps);
+
+int functionparameter_GetParamIndex_local(FUNCTION_PARAMETER_STRUCT *fps,
+        const char *paramname);
+
 #endif
@@ -110,6 +110,7 @@ errno_t functionparameter_RUNstart(
         fps->md->status |= FUNCTION_PARAMETER_STRUCT_STATUS_CMDRUN;
         fps->md->signal |=
             FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE; // notify GUI loop to update
+        functionparameter_notify(fps);
     }
 
 
@@ -27,6 +27,7 @@ errno_t functionparameter_RUNstop(FUNCTION_PARAMETER_STRUCT *fps)
     fps->md->status &= ~FUNCTION_PARAMETER_STRUCT_STATUS_CMDRUN;
     fps->md->signal |=
         FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE; // notify GUI loop to update
+    functionparameter_notify(fps);
 
     return RETURN_SUCCESS;
 }
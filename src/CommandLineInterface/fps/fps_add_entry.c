@@ -5,6 +5,8 @@
 
 #include "CommandLineInterface/CLIcore.h"
 
+#include "fps_GetParamIndex.h"
+
 /** @brief Add parameter to database with default settings
  *
  * If entry already exists, do not modify it
@@ -61,6 +63,7 @@ errno_t function_parameter_add_entry(FUNCTION_PARAMETER_STRUCT *fps,
         {
             pindex = pindexscan;
             scanOK = 1;
+            break;
         }
     }
 
@@ -108,6 +111,7 @@ errno_t function_parameter_add_entry(FUNCTION_PARAMETER_STRUCT *fps,
             funcparamarray[pindex].keywordlevel++;
             pch = strtok(NULL, ".");
         }
+        functionparameter_index_add(fps, pindex);
 
         // Write description
         strncpy(funcparamarray[pindex].description,
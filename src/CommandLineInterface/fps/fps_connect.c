@@ -154,6 +154,20 @@ long function_parameter_struct_connect(
 
     //	NBparam = (int) (file_stat.st_size / sizeof(FUNCTION_PARAMETER));
     NBparamMAX = fps->md->NBparamMAX;
+
+    // parameter hash index, if present in file
+    fps->pindexhash = NULL;
+    functionparameter_index_cacheinit(fps);
+    if((fps->md->NBparamHASH > 0) &&
+            ((size_t) file_stat.st_size >=
+             sizeof(FUNCTION_PARAMETER_STRUCT_MD) +
+             sizeof(FUNCTION_PARAMETER) * NBparamMAX +
+             sizeof(int32_t) * fps->md->NBparamHASH))
+    {
+        mapv += sizeof(FUNCTION_PARAMETER) * NBparamMAX;
+        fps->pindexhash = (int32_t *) mapv;
+        functionparameter_index_sync(fps);
+    }
     printf("    Connected to %s, %ld entries\n", SM_fname, NBparamMAX);
     fflush(stdout);
 
@@ -383,6 +397,22 @@ long function_parameter_struct_connect(
                 }
             }
         }
+
+        {
+            // triggerspinns
+            fps->cmdset.triggerspinnsptr = NULL;
+            int pindex =
+                functionparameter_GetParamIndex(fps, ".procinfo.triggerspinns");
+            if(pindex > -1)
+            {
+                if(fps->parray[pindex].type == FPTYPE_INT64)
+                {
+                    fps->cmdset.triggerspinns = fps->parray[pindex].val.i64[0];
+
+                    fps->cmdset.triggerspinnsptr = fps->parray[pindex].val.i64;
+                }
+            }
+        }
     }
 
     return (NBparamMAX);
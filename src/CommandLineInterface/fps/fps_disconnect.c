@@ -16,6 +16,7 @@ int function_parameter_struct_disconnect(
     //NBparamMAX = funcparamstruct->md->NBparamMAX;
     //funcparamstruct->md->NBparam = 0;
     funcparamstruct->parray = NULL;
+    funcparamstruct->pindexhash = NULL;
 
     // get file size
     //
@@ -25,7 +26,8 @@ int function_parameter_struct_disconnect(
     munmap(funcparamstruct->md, file_stat.st_size);
     // note: file size should be equal to :
     // sizeof(FUNCTION_PARAMETER_STRUCT_MD) +
-    // sizeof(FUNCTION_PARAMETER) * NBparamMAX)
+    // sizeof(FUNCTION_PARAMETER) * NBparamMAX +
+    // sizeof(int32_t) * NBparamHASH
 
     close(funcparamstruct->SMfd);
 
@@ -171,6 +171,17 @@ errno_t function_parameter_getFPSargs_from_CLIfunc(char *fpsname_default)
             return RETURN_SUCCESS;
         }
 
+        if(strcmp(data.cmdargtoken[1].val.string, "..triggerspinns") == 0)
+        {
+            printf("Command %ld: updating triggerspinns to value %ld\n",
+                   data.cmdindex,
+                   data.cmdargtoken[2].val.numl);
+            data.cmd[data.cmdindex].cmdsettings.triggerspinns =
+                data.cmdargtoken[2].val.numl;
+            data.FPS_CMDCODE = FPSCMDCODE_IGNORE;
+            return RETURN_SUCCESS;
+        }
+
         // check that first arg is a string
         // if it isn't, the non-FPS implementation should be called
 
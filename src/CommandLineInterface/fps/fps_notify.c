@@ -0,0 +1,111 @@
+/**
+ * @file    fps_notify.c
+ * @brief   FPS change notification
+ *
+ * md->notifyseq is a sequence counter in the FPS shared memory, incremented
+ * by writers whenever a parameter value or signal changes. Readers record
+ * the counter value, and block on it (futex) until it changes or a timeout
+ * expires, instead of polling at fixed interval.
+ *
+ * The futex syscall is only issued by writers if a process is waiting.
+ */
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fps_notify.h"
+
+/**
+ * @brief Notify processes waiting on FPS that a change occurred
+ */
+errno_t functionparameter_notify(FUNCTION_PARAMETER_STRUCT *fps)
+{
+    __atomic_add_fetch(&fps->md->notifyseq, 1, __ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(&fps->md->notifywaiters, __ATOMIC_SEQ_CST) > 0)
+    {
+        syscall(SYS_futex,
+                &fps->md->notifyseq,
+                FUTEX_WAKE,
+                INT_MAX,
+                NULL,
+                NULL,
+                0);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Current value of FPS notification counter
+ */
+uint32_t functionparameter_notify_seq(FUNCTION_PARAMETER_STRUCT *fps)
+{
+    return __atomic_load_n(&fps->md->notifyseq, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Wait until FPS notification counter differs from seq
+ *
+ * Returns 1 if a change was notified, 0 on timeout.
+ * timeoutus = 0 only checks the counter, without waiting.
+ * timeoutus = FPS_NOTIFY_WAIT_FOREVER waits without timeout.
+ */
+int functionparameter_notify_wait(FUNCTION_PARAMETER_STRUCT *fps,
+                                  uint32_t                   seq,
+                                  uint64_t                   timeoutus)
+{
+    if(timeoutus == 0)
+    {
+        return (__atomic_load_n(&fps->md->notifyseq, __ATOMIC_SEQ_CST) != seq);
+    }
+
+    struct timespec tstart;
+    clock_gettime(CLOCK_MONOTONIC, &tstart);
+
+    __atomic_add_fetch(&fps->md->notifywaiters, 1, __ATOMIC_SEQ_CST);
+
+    int changed = 0;
+    while(changed == 0)
+    {
+        if(__atomic_load_n(&fps->md->notifyseq, __ATOMIC_SEQ_CST) != seq)
+        {
+            changed = 1;
+            break;
+        }
+
+        struct timespec  trem;
+        struct timespec *ptrem = NULL;
+        if(timeoutus != FPS_NOTIFY_WAIT_FOREVER)
+        {
+            struct timespec tnow;
+            clock_gettime(CLOCK_MONOTONIC, &tnow);
+            int64_t remns = (int64_t)(timeoutus * 1000) -
+                            ((int64_t)(tnow.tv_sec - tstart.tv_sec) * 1000000000 +
+                             (tnow.tv_nsec - tstart.tv_nsec));
+            if(remns <= 0)
+            {
+                break;
+            }
+            trem.tv_sec  = remns / 1000000000;
+            trem.tv_nsec = remns % 1000000000;
+            ptrem        = &trem;
+        }
+
+        // returns immediately (EAGAIN) if counter already changed
+        syscall(SYS_futex,
+                &fps->md->notifyseq,
+                FUTEX_WAIT,
+                seq,
+                ptrem,
+                NULL,
+                0);
+    }
+
+    __atomic_sub_fetch(&fps->md->notifywaiters, 1, __ATOMIC_SEQ_CST);
+
+    return changed;
+}
@@ -0,0 +1,20 @@
+/**
+ * @file    fps_notify.h
+ * @brief   FPS change notification
+ */
+
+#ifndef FPS_NOTIFY_H
+#define FPS_NOTIFY_H
+
+// functionparameter_notify_wait timeout : no timeout
+#define FPS_NOTIFY_WAIT_FOREVER UINT64_MAX
+
+errno_t functionparameter_notify(FUNCTION_PARAMETER_STRUCT *fps);
+
+uint32_t functionparameter_notify_seq(FUNCTION_PARAMETER_STRUCT *fps);
+
+int functionparameter_notify_wait(FUNCTION_PARAMETER_STRUCT *fps,
+                                  uint32_t                   seq,
+                                  uint64_t                   timeoutus);
+
+#endif
@@ -20,7 +20,7 @@ int64_t *functionparameter_GetParamPtr_generic(FUNCTION_PARAMETER_STRUCT *fps,
 {
     int64_t *ptr;
 
-    long fpsi = functionparameter_GetParamIndex(fps, paramname);
+    long fpsi = functionparameter_GetParamIndex_local(fps, paramname);
 
     // type is arbitrary
     ptr = &fps->parray[fpsi].val.i64[0];
@@ -40,7 +40,7 @@ int64_t functionparameter_GetParamValue_INT64(FUNCTION_PARAMETER_STRUCT *fps,
 {
     int64_t value;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     value    = fps->parray[fpsi].val.i64[0];
     fps->parray[fpsi].val.i64[3] = value;
 
@@ -51,9 +51,10 @@ errno_t functionparameter_SetParamValue_INT64(FUNCTION_PARAMETER_STRUCT *fps,
         const char *paramname,
         int64_t     value)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     fps->parray[fpsi].val.i64[0] = value;
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -104,7 +105,7 @@ int64_t *functionparameter_GetParamPtr_INT64(FUNCTION_PARAMETER_STRUCT *fps,
 {
     int64_t *ptr;
 
-    long fpsi = functionparameter_GetParamIndex(fps, paramname);
+    long fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr       = &fps->parray[fpsi].val.i64[0];
 
     return ptr;
@@ -115,7 +116,7 @@ uint64_t functionparameter_GetParamValue_UINT64(FUNCTION_PARAMETER_STRUCT *fps,
 {
     uint64_t value;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     value    = fps->parray[fpsi].val.ui64[0];
     fps->parray[fpsi].val.ui64[3] = value;
 
@@ -126,9 +127,10 @@ errno_t functionparameter_SetParamValue_UINT64(FUNCTION_PARAMETER_STRUCT *fps,
         const char *paramname,
         uint64_t    value)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     fps->parray[fpsi].val.ui64[0] = value;
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -138,7 +140,7 @@ uint64_t *functionparameter_GetParamPtr_UINT64(FUNCTION_PARAMETER_STRUCT *fps,
 {
     uint64_t *ptr;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr      = &fps->parray[fpsi].val.ui64[0];
 
     return ptr;
@@ -149,7 +151,7 @@ int32_t functionparameter_GetParamValue_INT32(FUNCTION_PARAMETER_STRUCT *fps,
 {
     int32_t value;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     value    = fps->parray[fpsi].val.i32[0];
     fps->parray[fpsi].val.i32[3] = value;
 
@@ -160,9 +162,10 @@ errno_t functionparameter_SetParamValue_INT32(FUNCTION_PARAMETER_STRUCT *fps,
         const char *paramname,
         int32_t     value)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     fps->parray[fpsi].val.i32[0] = value;
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -172,7 +175,7 @@ int32_t *functionparameter_GetParamPtr_INT32(FUNCTION_PARAMETER_STRUCT *fps,
 {
     int32_t *ptr;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr      = &fps->parray[fpsi].val.i32[0];
 
     return ptr;
@@ -183,7 +186,7 @@ uint32_t functionparameter_GetParamValue_UINT32(FUNCTION_PARAMETER_STRUCT *fps,
 {
     long value;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     value    = fps->parray[fpsi].val.ui32[0];
     fps->parray[fpsi].val.ui32[3] = value;
 
@@ -194,9 +197,10 @@ errno_t functionparameter_SetParamValue_UINT32(FUNCTION_PARAMETER_STRUCT *fps,
         const char *paramname,
         uint32_t    value)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     fps->parray[fpsi].val.ui32[0] = value;
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -206,7 +210,7 @@ uint32_t *functionparameter_GetParamPtr_UINT32(FUNCTION_PARAMETER_STRUCT *fps,
 {
     uint32_t *ptr;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr      = &fps->parray[fpsi].val.ui32[0];
 
     return ptr;
@@ -217,7 +221,7 @@ double functionparameter_GetParamValue_FLOAT64(FUNCTION_PARAMETER_STRUCT *fps,
 {
     double value;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     value    = fps->parray[fpsi].val.f64[0];
     fps->parray[fpsi].val.f64[3] = value;
 
@@ -228,9 +232,10 @@ errno_t functionparameter_SetParamValue_FLOAT64(FUNCTION_PARAMETER_STRUCT *fps,
         const char *paramname,
         double      value)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     fps->parray[fpsi].val.f64[0] = value;
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -240,7 +245,7 @@ double *functionparameter_GetParamPtr_FLOAT64(FUNCTION_PARAMETER_STRUCT *fps,
 {
     double *ptr;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr      = &fps->parray[fpsi].val.f64[0];
 
     return ptr;
@@ -251,7 +256,7 @@ float functionparameter_GetParamValue_FLOAT32(FUNCTION_PARAMETER_STRUCT *fps,
 {
     float value;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     value    = fps->parray[fpsi].val.f32[0];
     fps->parray[fpsi].val.f32[3] = value;
 
@@ -262,9 +267,10 @@ int functionparameter_SetParamValue_FLOAT32(FUNCTION_PARAMETER_STRUCT *fps,
         const char *paramname,
         float       value)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     fps->parray[fpsi].val.f32[0] = value;
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -274,7 +280,7 @@ float *functionparameter_GetParamPtr_FLOAT32(FUNCTION_PARAMETER_STRUCT *fps,
 {
     float *ptr;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr      = &fps->parray[fpsi].val.f32[0];
 
     return ptr;
@@ -286,7 +292,7 @@ float functionparameter_GetParamValue_TIMESPEC(FUNCTION_PARAMETER_STRUCT *fps,
     long value_sec;
     long value_nsec;
 
-    int fpsi   = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi   = functionparameter_GetParamIndex_local(fps, paramname);
     value_sec  = fps->parray[fpsi].val.ts[0].tv_sec;
     value_nsec = fps->parray[fpsi].val.ts[0].tv_nsec;
     fps->parray[fpsi].val.ts[3].tv_sec  = value_sec;
@@ -300,7 +306,7 @@ int functionparameter_SetParamValue_TIMESPEC(FUNCTION_PARAMETER_STRUCT *fps,
         const char *paramname,
         float       value)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
 
     long valuesec                       = (long) value;
     long valuensec                      = (long)(1.0e9 * (value - valuesec));
@@ -308,6 +314,7 @@ int functionparameter_SetParamValue_TIMESPEC(FUNCTION_PARAMETER_STRUCT *fps,
     fps->parray[fpsi].val.ts[0].tv_nsec = valuensec;
 
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -318,7 +325,7 @@ functionparameter_GetParamPtr_TIMESPEC(FUNCTION_PARAMETER_STRUCT *fps,
 {
     struct timespec *ptr;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr      = &fps->parray[fpsi].val.ts[0];
 
     return ptr;
@@ -327,7 +334,7 @@ functionparameter_GetParamPtr_TIMESPEC(FUNCTION_PARAMETER_STRUCT *fps,
 char *functionparameter_GetParamPtr_STRING(FUNCTION_PARAMETER_STRUCT *fps,
         const char                *paramname)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     return fps->parray[fpsi].val.string[0];
 }
 
@@ -335,12 +342,13 @@ int functionparameter_SetParamValue_STRING(FUNCTION_PARAMETER_STRUCT *fps,
         const char                *paramname,
         const char *stringvalue)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
 
     strncpy(fps->parray[fpsi].val.string[0],
             stringvalue,
             FUNCTION_PARAMETER_STRMAXLEN - 1);
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -348,7 +356,7 @@ int functionparameter_SetParamValue_STRING(FUNCTION_PARAMETER_STRUCT *fps,
 int functionparameter_GetParamValue_ONOFF(FUNCTION_PARAMETER_STRUCT *fps,
         const char                *paramname)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
 
     if(fps->parray[fpsi].fpflag & FPFLAG_ONOFF)
     {
@@ -364,7 +372,7 @@ int functionparameter_SetParamValue_ONOFF(FUNCTION_PARAMETER_STRUCT *fps,
         const char                *paramname,
         int                        ONOFFvalue)
 {
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
 
     if(ONOFFvalue == 1)
     {
@@ -378,6 +386,7 @@ int functionparameter_SetParamValue_ONOFF(FUNCTION_PARAMETER_STRUCT *fps,
     }
 
     fps->parray[fpsi].cnt0++;
+    functionparameter_notify(fps);
 
     return EXIT_SUCCESS;
 }
@@ -387,7 +396,7 @@ uint64_t *functionparameter_GetParamPtr_fpflag(FUNCTION_PARAMETER_STRUCT *fps,
 {
     uint64_t *ptr;
 
-    int fpsi = functionparameter_GetParamIndex(fps, paramname);
+    int fpsi = functionparameter_GetParamIndex_local(fps, paramname);
     ptr      = &fps->parray[fpsi].fpflag;
 
     return ptr;
@@ -510,6 +510,7 @@ int functionparameter_FPSprocess_cmdline(
                     FUNCTION_PARAMETER_STRUCT_SIGNAL_CHECKED; // update status: check waiting to be done
                 fps[fpsindex].md->signal |=
                     FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE; // request an update
+                functionparameter_notify(&fps[fpsindex]);
 
                 functionparameter_outlog("FPSCTRL",
                                          "CONFUPDATE %s",
@@ -550,6 +551,7 @@ int functionparameter_FPSprocess_cmdline(
                         FUNCTION_PARAMETER_STRUCT_SIGNAL_CHECKED; // update status: check waiting to be done
                     fps[fpsindex].md->signal |=
                         FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE; // request an update
+                    functionparameter_notify(&fps[fpsindex]);
 
                     while(((fps[fpsindex].md->signal &
                             FUNCTION_PARAMETER_STRUCT_SIGNAL_CHECKED)) &&
@@ -1209,6 +1211,7 @@ int functionparameter_FPSprocess_cmdline(
                                                            "InputCommandFile");
                     fps[fpsindex].md->signal |=
                         FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE;
+                    functionparameter_notify(&fps[fpsindex]);
                 }
                 else
                 {
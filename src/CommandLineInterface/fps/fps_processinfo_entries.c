@@ -199,6 +199,15 @@ errno_t fps_add_processinfo_entries(
                                  &triggertimeout_default,
                                  NULL);
 
+    long triggerspinns_default[4] = {fps->cmdset.triggerspinns, 0, 1000000000, 0};
+    function_parameter_add_entry(fps,
+                                 ".procinfo.triggerspinns",
+                                 "trigger spin duration before blocking [ns]",
+                                 FPTYPE_INT64,
+                                 FPFLAG|FPFLAG_WRITERUN,
+                                 &triggerspinns_default,
+                                 NULL);
+
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
 }
@@ -441,6 +441,7 @@ int functionparameter_UserInputSetParamValue(
 
             // notify GUI
             fpsentry->md->signal |= FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE;
+            functionparameter_notify(fpsentry);
 
             // Save to disk
             if(fpsentry->parray[pindex].fpflag & FPFLAG_SAVEONCHANGE)
@@ -490,6 +490,9 @@ errno_t functionparameter_CTRLscreen(
 
     int refresh_screen = 1; // 1 if screen should be refreshed
 
+    // sum of FPS notification counters at last refresh
+    uint32_t fpsnotifysum = 0;
+
 
 
     while(loopOK == 1)
@@ -562,6 +565,21 @@ errno_t functionparameter_CTRLscreen(
                 refresh_screen = 1;
             }
 
+            // refresh if any FPS notified a change
+            uint32_t notifysum = 0;
+            for(int fpsindex = 0; fpsindex < fpsCTRLvar.NBfps; fpsindex++)
+            {
+                if(data.fpsarray[fpsindex].md != NULL)
+                {
+                    notifysum += data.fpsarray[fpsindex].md->notifyseq;
+                }
+            }
+            if(notifysum != fpsnotifysum)
+            {
+                fpsnotifysum   = notifysum;
+                refresh_screen = 1;
+            }
+
             DEBUG_TRACEPOINT(" ");
         }
 
@@ -311,6 +311,7 @@ int fpsCTRL_TUI_process_user_key(
                 fps[fpsindex].parray[pindex].cnt0++;
                 fps[fpsindex].md->signal |=
                     FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE; // notify GUI loop to update
+                functionparameter_notify(&fps[fpsindex]);
             }
         }
 
@@ -333,6 +334,7 @@ int fpsCTRL_TUI_process_user_key(
         fpsindex = keywnode[fpsCTRLvar->nodeSelected].fpsindex;
         fps[fpsindex].md->signal |=
             FUNCTION_PARAMETER_STRUCT_SIGNAL_UPDATE; // notify GUI loop to update
+        functionparameter_notify(&fps[fpsindex]);
         functionparameter_outlog("FPSCTRL", "UPDATE %s", fps[fpsindex].md->name);
         break;
 
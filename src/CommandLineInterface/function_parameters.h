@@ -303,6 +303,8 @@
 #define FUNCTION_PARAMETER_NBPARAM_DEFAULT                                     \
     200 // size of dynamically allocated array of parameters
 
+#define FPS_PINDEXHASH_EMPTY -1 // empty slot in parameter hash index
+
 typedef struct
 {
     long    streamID; // if type is stream and MASK_CHECKSTREAM. For CONF only
@@ -516,6 +518,16 @@ typedef struct
 
     uint32_t conferrcnt;
 
+    // size of parameter hash index, stored after parameter array
+    // power of 2, 0 if no index
+    long NBparamHASH;
+    long NBparamINDEXED; // number of parameters in hash index
+    uint32_t indexgen;   // hash index generation, odd while modified
+
+    // change notification, see fps_notify.c
+    uint32_t notifyseq;     // incremented on parameter or signal change
+    uint32_t notifywaiters; // number of processes waiting on notifyseq
+
 } FUNCTION_PARAMETER_STRUCT_MD;
 
 // localstatus flags
@@ -523,11 +535,24 @@ typedef struct
 // run configuration loop
 #define FPS_LOCALSTATUS_CONFLOOP 0x0001
 
+// parameter index handle, see functionparameter_GetParamIndex_cached
+typedef struct
+{
+    long     pindex;   // -1 if not resolved
+    uint32_t indexgen; // md->indexgen when resolved
+} FPS_PINDEX_HANDLE;
+
+#define FPS_PINDEX_HANDLE_INIT {-1, 0}
+
+// local cache of parameter lookups by name, see fps_paramvalue.c
+#define FPS_PINDEXCACHE_SIZE 64
+
 typedef struct
 {
     // these two structures are shared
     FUNCTION_PARAMETER_STRUCT_MD *md;
     FUNCTION_PARAMETER           *parray; // array of function parameters
+    int32_t *pindexhash; // parameter hash index, NULL if not available
 
     // these variables are local to each process
     uint16_t localstatus; // 1 if conf loop should be active
@@ -538,6 +563,8 @@ typedef struct
     long NBparamActive; // number of active parameters
 
     CMDSETTINGS cmdset; // local copy of cmd settings
+
+    FPS_PINDEX_HANDLE pindexcache[FPS_PINDEXCACHE_SIZE];
 } FUNCTION_PARAMETER_STRUCT;
 
 
@@ -675,6 +702,7 @@ typedef struct
 #include "fps/fps_execFPScmd.h"
 #include "fps/fps_getFPSargs.h"
 #include "fps/fps_load.h"
+#include "fps/fps_notify.h"
 #include "fps/fps_outlog.h"
 #include "fps/fps_paramvalue.h"
 #include "fps/fps_processinfo_entries.h"
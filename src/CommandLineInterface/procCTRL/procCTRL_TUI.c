@@ -64,6 +64,7 @@ typedef int errno_t;
 #include "processinfo/processinfo_shm_list_create.h"
 #include "processinfo/processinfo_exec_start.h"
 #include "processinfo/processinfo_exec_end.h"
+#include "processinfo/processinfo_hist.h"
 
 
 #include "procCTRL/procCTRL_PIDcollectSystemInfo.h"
@@ -1043,6 +1044,25 @@ errno_t processinfo_CTRLscreen()
                 }
                 break;
 
+            case 'w': // reset latency histograms
+                selectedOK = 0;
+                for(index = 0; index < procinfoproc.NBpindexActive; index++)
+                {
+                    pindex = procinfoproc.pindexActive[index];
+                    if(procinfoproc.selectedarray[pindex] == 1)
+                    {
+                        selectedOK = 1;
+                        processinfo_hist_reset(
+                            procinfoproc.pinfoarray[pindex]);
+                    }
+                }
+                if((selectedOK == 0) && (pindexSelectedOK == 1))
+                {
+                    processinfo_hist_reset(
+                        procinfoproc.pinfoarray[pindexSelected]);
+                }
+                break;
+
             case 't':
                 TUI_exit();
                 EXECUTE_SYSTEM_COMMAND(
@@ -1379,6 +1399,12 @@ errno_t processinfo_CTRLscreen()
                 TUI_printfw("    Enable iteration/execution time limit");
                 TUI_newline();
 
+                attron(attrval);
+                TUI_printfw(" w");
+                attroff(attrval);
+                TUI_printfw("    reset latency histograms of selected processes");
+                TUI_newline();
+
                 TUI_printfw("============ AFFINITY");
                 TUI_newline();
 
@@ -2660,6 +2686,39 @@ errno_t processinfo_CTRLscreen()
                                             ->triggermode);
                                         break;
 
+                                    case PROCESSINFO_TRIGGERMODE_ANY:
+                                        TUI_printfw(
+                                            "%2d:"
+                                            "ANY%"
+                                            "01d ",
+                                            procinfoproc.pinfoarray[pindex]
+                                            ->triggermode,
+                                            procinfoproc.pinfoarray[pindex]
+                                            ->triggerNBstream % 10);
+                                        break;
+
+                                    case PROCESSINFO_TRIGGERMODE_ALL:
+                                        TUI_printfw(
+                                            "%2d:"
+                                            "ALL%"
+                                            "01d ",
+                                            procinfoproc.pinfoarray[pindex]
+                                            ->triggermode,
+                                            procinfoproc.pinfoarray[pindex]
+                                            ->triggerNBstream % 10);
+                                        break;
+
+                                    case PROCESSINFO_TRIGGERMODE_SPINSEM:
+                                        TUI_printfw(
+                                            "%2d:"
+                                            "sps%"
+                                            "01d ",
+                                            procinfoproc.pinfoarray[pindex]
+                                            ->triggermode,
+                                            procinfoproc.pinfoarray[pindex]
+                                            ->triggersem);
+                                        break;
+
                                     default:
                                         TUI_printfw(
                                             "%2d:"
@@ -2967,6 +3026,42 @@ errno_t processinfo_CTRLscreen()
                                                                 PROCESSINFO_NBtimer)] +
                                          1));
 
+                                    // latency histograms since last reset
+                                    {
+                                        static PROCESSINFO_HIST hiter;
+                                        static PROCESSINFO_HIST hexec;
+                                        static PROCESSINFO_HIST hwait;
+
+                                        if(processinfo_hist_snapshot(
+                                                    procinfoproc
+                                                    .pinfoarray[pindex],
+                                                    &hiter,
+                                                    &hexec,
+                                                    &hwait) ==
+                                                RETURN_SUCCESS)
+                                        {
+                                            TUI_printfw(
+                                                "  ITER p50/p99/p999/max "
+                                                "%7.1f %7.1f %7.1f %7.1f us",
+                                                0.001 *
+                                                processinfo_hist_percentile(
+                                                    &hiter, 0.5),
+                                                0.001 *
+                                                processinfo_hist_percentile(
+                                                    &hiter, 0.99),
+                                                0.001 *
+                                                processinfo_hist_percentile(
+                                                    &hiter, 0.999),
+                                                0.001 * hiter.maxns);
+                                            TUI_printfw(
+                                                "  EXEC p99/max %7.1f %7.1f us",
+                                                0.001 *
+                                                processinfo_hist_percentile(
+                                                    &hexec, 0.99),
+                                                0.001 * hexec.maxns);
+                                        }
+                                    }
+
                                     free(dtiter_array);
                                     free(dtexec_array);
                                 }
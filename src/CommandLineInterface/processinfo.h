@@ -19,6 +19,19 @@
 // timing info for real-time loop processes
 #define PROCESSINFO_NBtimer 100
 
+// max number of input streams for multi-stream trigger
+#define PROCESSINFO_TRIGGER_NBSTREAMMAX 16
+
+// latency histograms, see processinfo_hist.c
+// values below 2^PROCESSINFO_HIST_SUBBITS ns are counted exactly, larger
+// values are binned with 2^PROCESSINFO_HIST_SUBBITS buckets per power of 2
+// (resolution better than 6.25%), up to 2^PROCESSINFO_HIST_MSBMAX ns (~9 min)
+#define PROCESSINFO_HIST_SUBBITS  4
+#define PROCESSINFO_HIST_MSBMAX   39
+#define PROCESSINFO_HIST_NBBUCKET                                              \
+    ((PROCESSINFO_HIST_MSBMAX - PROCESSINFO_HIST_SUBBITS + 2)                  \
+     << PROCESSINFO_HIST_SUBBITS)
+
 
 #define PROCESSINFO_CTRLVAL_RUN   0
 #define PROCESSINFO_CTRLVAL_PAUSE 1
@@ -37,6 +50,16 @@
 #include "CLIcore.h"
 
 
+typedef struct
+{
+    uint64_t cnt;   // number of samples
+    uint64_t sumns; // sum of samples [ns]
+    uint64_t minns;
+    uint64_t maxns;
+    uint64_t bucket[PROCESSINFO_HIST_NBBUCKET];
+} PROCESSINFO_HIST;
+
+
 // uncomment to enable LOGFILE for debugging
 //#define PROCESSINFO_LOGFILE
 
@@ -116,6 +139,23 @@ typedef struct
     uint64_t triggermissedframe_cumul; // cumulative missed frames
     int      triggerstatus;            // see TRIGGERSTATUS codes
 
+    // MULTI-STREAM TRIGGER (TRIGGERMODE_ANY, TRIGGERMODE_ALL)
+    // Must be initialized by processinfo_waitoninputstream_init_multi()
+    // triggerstreamID is set to first input stream
+    int      triggerNBstream; // number of input streams, 0 if unused
+    imageID  triggerstreamIDarray[PROCESSINFO_TRIGGER_NBSTREAMMAX];
+    int      triggersemarray[PROCESSINFO_TRIGGER_NBSTREAMMAX];
+    uint64_t triggerstreamcntarray[PROCESSINFO_TRIGGER_NBSTREAMMAX]; // last seen cnt0
+    uint64_t triggermissedframe_cumularray[PROCESSINFO_TRIGGER_NBSTREAMMAX];
+    uint64_t triggertimeoutcntarray[PROCESSINFO_TRIGGER_NBSTREAMMAX];
+    int triggerstreamfired; // ANY: index of input which triggered, -1 on timeout
+
+    // SPIN-THEN-BLOCK TRIGGER (TRIGGERMODE_SPINSEM)
+    long     triggerspinns;     // spin duration before blocking on semaphore [ns]
+    uint64_t triggerspincnt;    // triggers received while spinning
+    uint64_t triggerblockcnt;   // triggers received after blocking
+    uint64_t triggerspintotns;  // cumulative time spent spinning [ns]
+
     int       RT_priority; // -1 if unused. 0-99 for higher priority
     cpu_set_t CPUmask;
 
@@ -135,6 +175,16 @@ typedef struct
     long dtmedian_iter_ns; // median time offset between iterations [nanosec]
     long dtmedian_exec_ns; // median compute/busy time [nanosec]
 
+    // latency histograms since last reset, updated if MeasureTiming = 1
+    // written by process only, read with processinfo_hist_snapshot()
+    uint32_t         histseq;   // odd while histograms are being updated
+    int              histreset; // set to 1 to request reset
+    struct timespec  histresettime;
+    struct timespec  twaitstart; // time at which input wait started
+    PROCESSINFO_HIST hist_dtiter; // iteration period
+    PROCESSINFO_HIST hist_dtexec; // execution time
+    PROCESSINFO_HIST hist_dtwait; // trigger wait time
+
     // If enabled=1, pause process if dtiter larger than limit
     int  dtiter_limit_enable;
     long dtiter_limit_value;
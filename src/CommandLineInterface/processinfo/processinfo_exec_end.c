@@ -1,6 +1,8 @@
 #include "CLIcore.h"
 #include <processtools.h>
 
+#include "processinfo_hist.h"
+
 
 int processinfo_exec_end(PROCESSINFO *processinfo)
 {
@@ -13,6 +15,16 @@ int processinfo_exec_end(PROCESSINFO *processinfo)
         clock_gettime(CLOCK_MILK,
                       &processinfo->texecend[processinfo->timerindex]);
 
+        processinfo_hist_writebegin(processinfo);
+        processinfo_hist_add(
+            &processinfo->hist_dtexec,
+            (processinfo->texecend[processinfo->timerindex].tv_sec -
+             processinfo->texecstart[processinfo->timerindex].tv_sec) *
+            1000000000L +
+            (processinfo->texecend[processinfo->timerindex].tv_nsec -
+             processinfo->texecstart[processinfo->timerindex].tv_nsec));
+        processinfo_hist_writeend(processinfo);
+
         if(processinfo->dtexec_limit_enable != 0)
         {
             long dtexec;
@@ -21,7 +33,7 @@ int processinfo_exec_end(PROCESSINFO *processinfo)
                      processinfo->texecstart[processinfo->timerindex].tv_nsec;
             dtexec += 1000000000 *
                       (processinfo->texecend[processinfo->timerindex].tv_sec -
-                       processinfo->texecend[processinfo->timerindex].tv_sec);
+                       processinfo->texecstart[processinfo->timerindex].tv_sec);
 
             if(dtexec > processinfo->dtexec_limit_value)
             {
@@ -1,6 +1,8 @@
 #include "CLIcore.h"
 #include <processtools.h>
 
+#include "processinfo_hist.h"
+
 
 int processinfo_exec_start(PROCESSINFO *processinfo)
 {
@@ -18,6 +20,36 @@ int processinfo_exec_start(PROCESSINFO *processinfo)
         clock_gettime(CLOCK_MILK,
                       &processinfo->texecstart[processinfo->timerindex]);
 
+        // update latency histograms
+        {
+            struct timespec *tstart =
+                    &processinfo->texecstart[processinfo->timerindex];
+            struct timespec *tstartlast =
+                    &processinfo->texecstart[(processinfo->timerindex +
+                                              PROCESSINFO_NBtimer - 1) %
+                                             PROCESSINFO_NBtimer];
+
+            processinfo_hist_update_reset(processinfo);
+
+            processinfo_hist_writebegin(processinfo);
+            if(tstartlast->tv_sec != 0)
+            {
+                processinfo_hist_add(
+                    &processinfo->hist_dtiter,
+                    (tstart->tv_sec - tstartlast->tv_sec) * 1000000000L +
+                    (tstart->tv_nsec - tstartlast->tv_nsec));
+            }
+            if(processinfo->twaitstart.tv_sec != 0)
+            {
+                processinfo_hist_add(
+                    &processinfo->hist_dtwait,
+                    (tstart->tv_sec - processinfo->twaitstart.tv_sec) *
+                    1000000000L +
+                    (tstart->tv_nsec - processinfo->twaitstart.tv_nsec));
+            }
+            processinfo_hist_writeend(processinfo);
+        }
+
         if(processinfo->dtiter_limit_enable != 0)
         {
             long dtiter;
@@ -0,0 +1,192 @@
+/**
+ * @file processinfo_hist.c
+ * @brief Latency histograms in PROCESSINFO
+ *
+ * Iteration period, execution time and trigger wait time are accumulated
+ * in fixed-size log-bucketed histograms held in the PROCESSINFO shared
+ * memory, so that tail latency can be followed over long periods.
+ *
+ * Histograms are only written by the process itself. Readers use
+ * processinfo_hist_snapshot(), which retries if the process was updating
+ * histograms during the copy (seqlock on histseq). Readers request a reset
+ * with processinfo_hist_reset(), which the process applies on its next
+ * iteration.
+ */
+
+#include "CLIcore.h"
+#include <processtools.h>
+
+#include "processinfo_hist.h"
+
+#define HIST_NBSUB (1 << PROCESSINFO_HIST_SUBBITS)
+
+/**
+ * @brief Bucket index for value dtns
+ */
+int processinfo_hist_bucket(uint64_t dtns)
+{
+    if(dtns < HIST_NBSUB)
+    {
+        return (int) dtns;
+    }
+
+    int msb = 63 - __builtin_clzll(dtns);
+    if(msb > PROCESSINFO_HIST_MSBMAX)
+    {
+        return PROCESSINFO_HIST_NBBUCKET - 1;
+    }
+
+    int shift = msb - PROCESSINFO_HIST_SUBBITS;
+    int sub   = (int)((dtns >> shift) & (HIST_NBSUB - 1));
+
+    return ((shift + 1) << PROCESSINFO_HIST_SUBBITS) + sub;
+}
+
+/**
+ * @brief Lowest value counted in bucket
+ */
+uint64_t processinfo_hist_bucketvalue(int bucket)
+{
+    if(bucket < HIST_NBSUB)
+    {
+        return (uint64_t) bucket;
+    }
+
+    int shift = (bucket >> PROCESSINFO_HIST_SUBBITS) - 1;
+    int sub   = bucket & (HIST_NBSUB - 1);
+
+    return ((uint64_t)(HIST_NBSUB + sub)) << shift;
+}
+
+void processinfo_hist_add(PROCESSINFO_HIST *hist, int64_t dtns)
+{
+    if(dtns < 0)
+    {
+        dtns = 0;
+    }
+
+    hist->bucket[processinfo_hist_bucket((uint64_t) dtns)]++;
+    if((hist->cnt == 0) || ((uint64_t) dtns < hist->minns))
+    {
+        hist->minns = dtns;
+    }
+    if((uint64_t) dtns > hist->maxns)
+    {
+        hist->maxns = dtns;
+    }
+    hist->sumns += dtns;
+    hist->cnt++;
+}
+
+/**
+ * @brief Apply pending reset request
+ *
+ * Called by process owning processinfo
+ */
+errno_t processinfo_hist_update_reset(PROCESSINFO *processinfo)
+{
+    if(processinfo->histreset != 0)
+    {
+        processinfo_hist_writebegin(processinfo);
+        memset(&processinfo->hist_dtiter, 0, sizeof(PROCESSINFO_HIST));
+        memset(&processinfo->hist_dtexec, 0, sizeof(PROCESSINFO_HIST));
+        memset(&processinfo->hist_dtwait, 0, sizeof(PROCESSINFO_HIST));
+        clock_gettime(CLOCK_MILK, &processinfo->histresettime);
+        processinfo->histreset = 0;
+        processinfo_hist_writeend(processinfo);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Request histograms reset
+ *
+ * Can be called from any process
+ */
+errno_t processinfo_hist_reset(PROCESSINFO *processinfo)
+{
+    processinfo->histreset = 1;
+
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Consistent copy of histograms
+ *
+ * NULL pointers are skipped
+ */
+errno_t processinfo_hist_snapshot(PROCESSINFO      *processinfo,
+                                  PROCESSINFO_HIST *hist_dtiter,
+                                  PROCESSINFO_HIST *hist_dtexec,
+                                  PROCESSINFO_HIST *hist_dtwait)
+{
+    // give up consistency after too many attempts
+    for(int attempt = 0; attempt < 1000; attempt++)
+    {
+        uint32_t seq0 = __atomic_load_n(&processinfo->histseq, __ATOMIC_ACQUIRE);
+        if(seq0 & 1)
+        {
+            continue;
+        }
+
+        if(hist_dtiter != NULL)
+        {
+            memcpy(hist_dtiter, &processinfo->hist_dtiter, sizeof(PROCESSINFO_HIST));
+        }
+        if(hist_dtexec != NULL)
+        {
+            memcpy(hist_dtexec, &processinfo->hist_dtexec, sizeof(PROCESSINFO_HIST));
+        }
+        if(hist_dtwait != NULL)
+        {
+            memcpy(hist_dtwait, &processinfo->hist_dtwait, sizeof(PROCESSINFO_HIST));
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&processinfo->histseq, __ATOMIC_ACQUIRE) == seq0)
+        {
+            return RETURN_SUCCESS;
+        }
+    }
+
+    return RETURN_FAILURE;
+}
+
+/**
+ * @brief Value below which fraction p of samples fall [ns]
+ *
+ * Returns upper edge of bucket, capped to max value
+ */
+uint64_t processinfo_hist_percentile(const PROCESSINFO_HIST *hist, double p)
+{
+    if(hist->cnt == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(p * hist->cnt);
+    if(target >= hist->cnt)
+    {
+        target = hist->cnt - 1;
+    }
+
+    uint64_t cumul = 0;
+    for(int b = 0; b < PROCESSINFO_HIST_NBBUCKET; b++)
+    {
+        cumul += hist->bucket[b];
+        if(cumul > target)
+        {
+            uint64_t val = (b < PROCESSINFO_HIST_NBBUCKET - 1)
+                           ? processinfo_hist_bucketvalue(b + 1) - 1
+                           : hist->maxns;
+            if(val > hist->maxns)
+            {
+                val = hist->maxns;
+            }
+            return val;
+        }
+    }
+
+    return hist->maxns;
+}
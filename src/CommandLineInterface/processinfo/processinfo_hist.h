@@ -0,0 +1,34 @@
+#ifndef _PROCESSINFO_HIST_H
+#define _PROCESSINFO_HIST_H
+
+// histseq seqlock, writer side : odd while histograms are updated
+static inline void processinfo_hist_writebegin(PROCESSINFO *processinfo)
+{
+    __atomic_add_fetch(&processinfo->histseq, 1, __ATOMIC_RELAXED);
+    // odd histseq visible before histogram writes
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void processinfo_hist_writeend(PROCESSINFO *processinfo)
+{
+    __atomic_add_fetch(&processinfo->histseq, 1, __ATOMIC_RELEASE);
+}
+
+int processinfo_hist_bucket(uint64_t dtns);
+
+uint64_t processinfo_hist_bucketvalue(int bucket);
+
+void processinfo_hist_add(PROCESSINFO_HIST *hist, int64_t dtns);
+
+errno_t processinfo_hist_update_reset(PROCESSINFO *processinfo);
+
+errno_t processinfo_hist_reset(PROCESSINFO *processinfo);
+
+errno_t processinfo_hist_snapshot(PROCESSINFO      *processinfo,
+                                  PROCESSINFO_HIST *hist_dtiter,
+                                  PROCESSINFO_HIST *hist_dtexec,
+                                  PROCESSINFO_HIST *hist_dtwait);
+
+uint64_t processinfo_hist_percentile(const PROCESSINFO_HIST *hist, double p);
+
+#endif
@@ -44,7 +44,7 @@ errno_t processinfo_update_output_stream(
 
             // write first streamproctrace entry
             DEBUG_TRACEPOINT("trigger info");
-            data.image[outstreamID].streamproctrace[0].trigsemindex =
+            data.image[outstreamID].streamproctrace[0].triggermode =
                 processinfo->triggermode;
 
             data.image[outstreamID].streamproctrace[0].procwrite_PID = getpid();
@@ -215,6 +215,15 @@ int processinfo_WriteMessage_fmt(
 int processinfo_exec_start(PROCESSINFO *processinfo);
 int processinfo_exec_end(PROCESSINFO *processinfo);
 
+errno_t processinfo_hist_reset(PROCESSINFO *processinfo);
+
+errno_t processinfo_hist_snapshot(PROCESSINFO      *processinfo,
+                                  PROCESSINFO_HIST *hist_dtiter,
+                                  PROCESSINFO_HIST *hist_dtexec,
+                                  PROCESSINFO_HIST *hist_dtwait);
+
+uint64_t processinfo_hist_percentile(const PROCESSINFO_HIST *hist, double p);
+
 int processinfo_CatchSignals();
 int processinfo_ProcessSignals(PROCESSINFO *processinfo);
 
@@ -4,7 +4,9 @@
  *
  */
 
+#include <pthread.h>
 #include <sched.h>
+#include <semaphore.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -114,6 +116,39 @@ errno_t processinfo_waitoninputstream_init(
         //data.image[processinfo->triggerstreamID].md[0].cnt0;
     }
 
+    if(triggermode == PROCESSINFO_TRIGGERMODE_SPINSEM)
+    {
+        DEBUG_TRACEPOINT("trigger mode %d = spin then semaphore %d on ID %ld",
+                         PROCESSINFO_TRIGGERMODE_SPINSEM,
+                         semindexrequested,
+                         trigID);
+
+        if(trigID == -1)
+        {
+            FUNC_RETURN_FAILURE("missing trigger ID");
+        }
+        processinfo->triggerstreamcnt = data.image[trigID].md[0].cnt0;
+        processinfo->triggerspincnt   = 0;
+        processinfo->triggerblockcnt  = 0;
+        processinfo->triggerspintotns = 0;
+
+        processinfo->triggersem =
+            ImageStreamIO_getsemwaitindex(&data.image[trigID],
+                                          semindexrequested);
+        if(processinfo->triggersem == -1)
+        {
+            // could not find available semaphore
+            // fall back to CNT0 trigger mode
+            processinfo->triggermode = PROCESSINFO_TRIGGERMODE_CNT0;
+        }
+        else
+        {
+            processinfo->triggermode = PROCESSINFO_TRIGGERMODE_SPINSEM;
+            // register PID to stream
+            data.image[trigID].semReadPID[processinfo->triggersem] = getpid();
+        }
+    }
+
     // checking if semaphore trigger mode OK
     if(processinfo->triggermode == PROCESSINFO_TRIGGERMODE_SEMAPHORE)
     {
@@ -153,6 +188,436 @@ errno_t processinfo_waitoninputstream_init(
 
 
 
+/*
+ * Multi-stream trigger
+ *
+ * POSIX semaphores cannot be waited on as a group, so each input stream
+ * semaphore is relayed by a thread to a single local semaphore, on which
+ * the loop process waits. Input stream cnt0 values, compared to the last
+ * seen values, tell which inputs have been updated : relayed posts are
+ * only used to wake up the loop process.
+ */
+
+typedef struct
+{
+    int       NBstream;
+    pthread_t thread[PROCESSINFO_TRIGGER_NBSTREAMMAX];
+    sem_t    *insemptr[PROCESSINFO_TRIGGER_NBSTREAMMAX];
+    sem_t     wakesem;
+    int       wakeseminit;
+} TRIGGER_RELAY;
+
+static TRIGGER_RELAY trigrelay = {0};
+
+static void *trigger_relay_thread(void *ptr)
+{
+    sem_t *insem = (sem_t *) ptr;
+
+    while(1)
+    {
+        // sem_wait is a cancellation point
+        if(sem_wait(insem) == 0)
+        {
+            sem_post(&trigrelay.wakesem);
+        }
+    }
+
+    return NULL;
+}
+
+static void trigger_relay_stop()
+{
+    for(int i = 0; i < trigrelay.NBstream; i++)
+    {
+        pthread_cancel(trigrelay.thread[i]);
+        pthread_join(trigrelay.thread[i], NULL);
+    }
+    trigrelay.NBstream = 0;
+}
+
+/** @brief Set up multiple input wait streams
+ *
+ * triggermode is PROCESSINFO_TRIGGERMODE_ANY or PROCESSINFO_TRIGGERMODE_ALL.
+ *
+ * ANY : processinfo_waitoninputstream() returns when any input has been
+ * updated, and writes its index in processinfo->triggerstreamfired.
+ * Inputs are served in turn, so that a fast input cannot starve others.
+ *
+ * ALL : processinfo_waitoninputstream() returns when every input has been
+ * updated since last trigger.
+ *
+ * Missed frames and timeouts are counted per input.
+ */
+errno_t processinfo_waitoninputstream_init_multi(
+    PROCESSINFO *processinfo,
+    imageID     *trigIDarray,
+    int          NBtrigstream,
+    int          triggermode
+)
+{
+    DEBUG_TRACE_FSTART("%d %d", NBtrigstream, triggermode);
+
+    if((triggermode != PROCESSINFO_TRIGGERMODE_ANY) &&
+            (triggermode != PROCESSINFO_TRIGGERMODE_ALL))
+    {
+        FUNC_RETURN_FAILURE("invalid multi-stream trigger mode %d",
+                            triggermode);
+    }
+    if((NBtrigstream < 1) || (NBtrigstream > PROCESSINFO_TRIGGER_NBSTREAMMAX))
+    {
+        FUNC_RETURN_FAILURE("number of trigger streams %d out of range [1-%d]",
+                            NBtrigstream,
+                            PROCESSINFO_TRIGGER_NBSTREAMMAX);
+    }
+    for(int i = 0; i < NBtrigstream; i++)
+    {
+        if(trigIDarray[i] < 0)
+        {
+            FUNC_RETURN_FAILURE("invalid image ID %ld for input %d",
+                                trigIDarray[i],
+                                i);
+        }
+    }
+
+    // first input is reported as trigger stream
+    FUNC_CHECK_RETURN(
+        processinfo_waitoninputstream_init(processinfo,
+                                           trigIDarray[0],
+                                           PROCESSINFO_TRIGGERMODE_IMMEDIATE,
+                                           -1));
+
+    trigger_relay_stop();
+    if(trigrelay.wakeseminit == 0)
+    {
+        sem_init(&trigrelay.wakesem, 0, 0);
+        trigrelay.wakeseminit = 1;
+    }
+    while(sem_trywait(&trigrelay.wakesem) == 0)
+    {
+    }
+
+    processinfo->triggerNBstream    = NBtrigstream;
+    processinfo->triggerstreamfired = -1;
+    for(int i = 0; i < NBtrigstream; i++)
+    {
+        imageID ID = trigIDarray[i];
+
+        processinfo->triggerstreamIDarray[i] = ID;
+        processinfo->triggerstreamcntarray[i] = data.image[ID].md[0].cnt0;
+        processinfo->triggermissedframe_cumularray[i] = 0;
+        processinfo->triggertimeoutcntarray[i]        = 0;
+
+        processinfo->triggersemarray[i] =
+            ImageStreamIO_getsemwaitindex(&data.image[ID], -1);
+        if(processinfo->triggersemarray[i] == -1)
+        {
+            trigger_relay_stop();
+            processinfo->triggerNBstream = 0;
+            FUNC_RETURN_FAILURE("no semaphore available on stream %s",
+                                data.image[ID].md[0].name);
+        }
+        data.image[ID].semReadPID[processinfo->triggersemarray[i]] = getpid();
+
+        trigrelay.insemptr[i] =
+            data.image[ID].semptr[processinfo->triggersemarray[i]];
+        if(pthread_create(&trigrelay.thread[i],
+                          NULL,
+                          trigger_relay_thread,
+                          trigrelay.insemptr[i]) != 0)
+        {
+            trigger_relay_stop();
+            processinfo->triggerNBstream = 0;
+            FUNC_RETURN_FAILURE("pthread_create error");
+        }
+        trigrelay.NBstream++;
+    }
+
+    processinfo->triggermode = triggermode;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/** @brief Stop multiple input wait streams
+ *
+ * Cancels and joins relay threads, and releases input semaphores.
+ * Called on loop exit by INSERT_STD_PROCINFO_COMPUTEFUNC_END.
+ */
+errno_t processinfo_waitoninputstream_end_multi(PROCESSINFO *processinfo)
+{
+    DEBUG_TRACE_FSTART();
+
+    trigger_relay_stop();
+
+    for(int i = 0; i < processinfo->triggerNBstream; i++)
+    {
+        imageID ID = processinfo->triggerstreamIDarray[i];
+        if(data.image[ID].used == 1)
+        {
+            data.image[ID].semReadPID[processinfo->triggersemarray[i]] = 0;
+        }
+    }
+    processinfo->triggerNBstream = 0;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Wait on relayed semaphore until absolute time ts (CLOCK_REALTIME)
+ *
+ * Returns 0 if woken up, -1 on timeout
+ */
+static int trigger_relay_timedwait(struct timespec *ts)
+{
+    while(sem_timedwait(&trigrelay.wakesem, ts) == -1)
+    {
+        if(errno != EINTR)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static errno_t processinfo_waitoninputstream_multi(PROCESSINFO *processinfo)
+{
+    int NBstream = processinfo->triggerNBstream;
+    int tmpstatus = PROCESSINFO_TRIGGERSTATUS_RECEIVED;
+
+    processinfo->triggerstatus = PROCESSINFO_TRIGGERSTATUS_WAITING;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += processinfo->triggertimeout.tv_sec;
+    ts.tv_nsec += processinfo->triggertimeout.tv_nsec;
+    while(ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_nsec -= 1000000000;
+        ts.tv_sec++;
+    }
+
+    if(processinfo->triggermode == PROCESSINFO_TRIGGERMODE_ANY)
+    {
+        // start scan after last input served
+        int i0    = processinfo->triggerstreamfired + 1;
+        int fired = -1;
+        while(fired == -1)
+        {
+            for(int j = 0; j < NBstream; j++)
+            {
+                int i = (i0 + j) % NBstream;
+                if(data.image[processinfo->triggerstreamIDarray[i]].md[0].cnt0 !=
+                        processinfo->triggerstreamcntarray[i])
+                {
+                    fired = i;
+                    break;
+                }
+            }
+            if(fired == -1)
+            {
+                if(trigger_relay_timedwait(&ts) == -1)
+                {
+                    break;
+                }
+            }
+        }
+
+        if(fired == -1)
+        {
+            for(int i = 0; i < NBstream; i++)
+            {
+                processinfo->triggertimeoutcntarray[i]++;
+            }
+            processinfo->trigggertimeoutcnt++;
+            tmpstatus = PROCESSINFO_TRIGGERSTATUS_TIMEDOUT;
+        }
+        else
+        {
+            uint64_t cnt0 =
+                data.image[processinfo->triggerstreamIDarray[fired]].md[0].cnt0;
+            processinfo->triggermissedframe =
+                cnt0 - processinfo->triggerstreamcntarray[fired] - 1;
+            processinfo->triggermissedframe_cumularray[fired] +=
+                processinfo->triggermissedframe;
+            processinfo->triggerstreamcntarray[fired] = cnt0;
+        }
+        processinfo->triggerstreamfired = fired;
+    }
+    else // PROCESSINFO_TRIGGERMODE_ALL
+    {
+        int alldone = 0;
+        while(alldone == 0)
+        {
+            alldone = 1;
+            for(int i = 0; i < NBstream; i++)
+            {
+                if(data.image[processinfo->triggerstreamIDarray[i]].md[0].cnt0 ==
+                        processinfo->triggerstreamcntarray[i])
+                {
+                    alldone = 0;
+                    break;
+                }
+            }
+            if(alldone == 0)
+            {
+                if(trigger_relay_timedwait(&ts) == -1)
+                {
+                    break;
+                }
+            }
+        }
+
+        for(int i = 0; i < NBstream; i++)
+        {
+            uint64_t cnt0 =
+                data.image[processinfo->triggerstreamIDarray[i]].md[0].cnt0;
+            if(cnt0 == processinfo->triggerstreamcntarray[i])
+            {
+                // input not updated before timeout
+                processinfo->triggertimeoutcntarray[i]++;
+            }
+            else
+            {
+                int missed = cnt0 - processinfo->triggerstreamcntarray[i] - 1;
+                processinfo->triggermissedframe_cumularray[i] += missed;
+                if(missed > processinfo->triggermissedframe)
+                {
+                    processinfo->triggermissedframe = missed;
+                }
+                processinfo->triggerstreamcntarray[i] = cnt0;
+            }
+        }
+        if(alldone == 0)
+        {
+            // inputs updated before timeout remain consumed
+            processinfo->trigggertimeoutcnt++;
+            tmpstatus = PROCESSINFO_TRIGGERSTATUS_TIMEDOUT;
+        }
+    }
+
+    processinfo->triggermissedframe_cumul += processinfo->triggermissedframe;
+    processinfo->triggerstreamcnt =
+        processinfo->triggerstreamcntarray[0];
+
+    processinfo->triggerstatus = tmpstatus;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// spin-wait hint to CPU
+static inline void trigger_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * @brief Spin on cnt0 for up to triggerspinns, then wait on semaphore
+ *
+ * Spinning avoids the semaphore wake-up latency when the next frame is
+ * expected soon, at the cost of keeping the CPU busy. cnt0 is used to
+ * detect new frames, semaphore posts only to wake up.
+ */
+static errno_t processinfo_waitoninputstream_spinsem(PROCESSINFO *processinfo)
+{
+    IMAGE   *img       = &data.image[processinfo->triggerstreamID];
+    sem_t   *semptr    = img->semptr[processinfo->triggersem];
+    int      tmpstatus = PROCESSINFO_TRIGGERSTATUS_RECEIVED;
+    uint64_t cnt0      = __atomic_load_n(&img->md[0].cnt0, __ATOMIC_ACQUIRE);
+
+    processinfo->triggerstatus = PROCESSINFO_TRIGGERSTATUS_WAITING;
+
+    if((cnt0 == processinfo->triggerstreamcnt) &&
+            (processinfo->triggerspinns > 0))
+    {
+        struct timespec t0;
+        struct timespec t1;
+        long            spinns = 0;
+        long            iter   = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        while((cnt0 == processinfo->triggerstreamcnt) &&
+                (spinns < processinfo->triggerspinns))
+        {
+            trigger_cpu_relax();
+            cnt0 = __atomic_load_n(&img->md[0].cnt0, __ATOMIC_ACQUIRE);
+            iter++;
+            if((iter & 63) == 0)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                spinns = (t1.tv_sec - t0.tv_sec) * 1000000000L +
+                         (t1.tv_nsec - t0.tv_nsec);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        processinfo->triggerspintotns +=
+            (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
+    }
+
+    if(cnt0 != processinfo->triggerstreamcnt)
+    {
+        processinfo->triggerspincnt++;
+    }
+    else
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += processinfo->triggertimeout.tv_sec;
+        ts.tv_nsec += processinfo->triggertimeout.tv_nsec;
+        while(ts.tv_nsec >= 1000000000)
+        {
+            ts.tv_nsec -= 1000000000;
+            ts.tv_sec++;
+        }
+
+        while(cnt0 == processinfo->triggerstreamcnt)
+        {
+            if(sem_timedwait(semptr, &ts) == -1)
+            {
+                if(errno == ETIMEDOUT)
+                {
+                    processinfo->trigggertimeoutcnt++;
+                    tmpstatus = PROCESSINFO_TRIGGERSTATUS_TIMEDOUT;
+                    break;
+                }
+            }
+            cnt0 = __atomic_load_n(&img->md[0].cnt0, __ATOMIC_ACQUIRE);
+        }
+        if(cnt0 != processinfo->triggerstreamcnt)
+        {
+            processinfo->triggerblockcnt++;
+        }
+    }
+
+    // discard posts for frames already seen
+    while(sem_trywait(semptr) == 0)
+    {
+    }
+
+    if(cnt0 != processinfo->triggerstreamcnt)
+    {
+        processinfo->triggermissedframe =
+            cnt0 - processinfo->triggerstreamcnt - 1;
+        processinfo->triggermissedframe_cumul +=
+            processinfo->triggermissedframe;
+        processinfo->triggerstreamcnt = cnt0;
+    }
+
+    processinfo->triggerstatus = tmpstatus;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
 /** @brief Wait on a stream
  *
  */
@@ -160,6 +625,11 @@ errno_t processinfo_waitoninputstream(PROCESSINFO *processinfo)
 {
     processinfo->triggermissedframe = 0;
 
+    if(processinfo->MeasureTiming == 1)
+    {
+        clock_gettime(CLOCK_MILK, &processinfo->twaitstart);
+    }
+
     if(processinfo->triggermode == PROCESSINFO_TRIGGERMODE_IMMEDIATE)
     {
         processinfo->triggerstatus = PROCESSINFO_TRIGGERSTATUS_RECEIVED;
@@ -236,6 +706,23 @@ errno_t processinfo_waitoninputstream(PROCESSINFO *processinfo)
         return RETURN_SUCCESS;
     }
 
+    if(processinfo->triggermode == PROCESSINFO_TRIGGERMODE_SPINSEM)
+    {
+        return processinfo_waitoninputstream_spinsem(processinfo);
+    }
+
+    if((processinfo->triggermode == PROCESSINFO_TRIGGERMODE_ANY) ||
+            (processinfo->triggermode == PROCESSINFO_TRIGGERMODE_ALL))
+    {
+        if(processinfo->triggerNBstream == 0)
+        {
+            // not initialized for multiple streams
+            processinfo->triggerstatus = PROCESSINFO_TRIGGERSTATUS_RECEIVED;
+            return RETURN_FAILURE;
+        }
+        return processinfo_waitoninputstream_multi(processinfo);
+    }
+
     if(processinfo->triggermode == PROCESSINFO_TRIGGERMODE_SEMAPHORE)
     {
         int semr;
@@ -26,6 +26,16 @@
 // trigger after a time delay
 #define PROCESSINFO_TRIGGERMODE_DELAY 4
 
+// multiple input streams, see processinfo_waitoninputstream_init_multi()
+// trigger when any input stream is updated
+#define PROCESSINFO_TRIGGERMODE_ANY 5
+
+// trigger when all input streams have been updated
+#define PROCESSINFO_TRIGGERMODE_ALL 6
+
+// poll cnt0 for triggerspinns, then wait on semaphore
+#define PROCESSINFO_TRIGGERMODE_SPINSEM 7
+
 // trigger is currently waiting for input
 #define PROCESSINFO_TRIGGERSTATUS_WAITING 1
 
@@ -42,6 +52,13 @@ errno_t processinfo_waitoninputstream_init(PROCESSINFO *processinfo,
         int          triggermode,
         int          semindexrequested);
 
+errno_t processinfo_waitoninputstream_init_multi(PROCESSINFO *processinfo,
+        imageID     *trigIDarray,
+        int          NBtrigstream,
+        int          triggermode);
+
+errno_t processinfo_waitoninputstream_end_multi(PROCESSINFO *processinfo);
+
 errno_t processinfo_waitoninputstream(PROCESSINFO *processinfo);
 
 #define PROCINFO_TRIGGER_DELAYUS(delayus)                                      \
@@ -78,6 +78,7 @@ void quick_sort_long(long *array, long count);
 #include "fps_getFPSargs.h"
 #include "fps_load.h"
 #include "fps_loadstream.h"
+#include "fps_notify.h"
 #include "fps_outlog.h"
 #include "fps_paramvalue.h"
 #include "fps_printparameter_valuestring.h"
@@ -1266,6 +1266,28 @@ static errno_t streamCTRL_print_SPTRACE_details(
                             "DELA");
                 break;
 
+            case PROCESSINFO_TRIGGERMODE_ANY:
+                TUI_printfw("%d%*s",
+                            streamCTRLimages[ID].streamproctrace[spti].triggermode,
+                            Disp_type_NBchar - 1,
+                            "ANY");
+                break;
+
+            case PROCESSINFO_TRIGGERMODE_ALL:
+                TUI_printfw("%d%*s",
+                            streamCTRLimages[ID].streamproctrace[spti].triggermode,
+                            Disp_type_NBchar - 1,
+                            "ALL");
+                break;
+
+            case PROCESSINFO_TRIGGERMODE_SPINSEM:
+                TUI_printfw("%d%*s",
+                            streamCTRLimages[ID].streamproctrace[spti].triggermode,
+                            Disp_type_NBchar - 4,
+                            "SS");
+                TUI_printfw(" %2d", sem);
+                break;
+
             default:
                 TUI_printfw("%d%*s",
                             streamCTRLimages[ID].streamproctrace[spti].triggermode,